@@ -6,22 +6,30 @@ varying vec4 tangent;
 varying vec4 color;
 varying vec2 uv;
 
-uniform vec3  view_position;
+/* Constant for the whole pass, uploaded once (Shaders/Common.h) */
+layout(std140, row_major) uniform frame_block {
+    mat4 projection;
+    mat4 view;
+    mat4 light_space;
+    vec3 view_position;
+    float exposure;
+};
+
+/* Deduplicated scene materials, material_index picks one per draw */
+#define MATERIAL_BLOCK_SIZE 256
+layout(std140) uniform material_block {
+    vec4 material_color[MATERIAL_BLOCK_SIZE];
+    vec4 material_params[MATERIAL_BLOCK_SIZE];
+};
+
+uniform int material_index;
+uniform int has_vertex_color;
+
 uniform samplerCube skybox;
 uniform samplerCube prefiltered_env;
-
-uniform vec3  base_color;
-uniform float roughness;
-uniform float metallic;
-uniform float exposure;
-
 uniform sampler2D shadow_map;
-uniform mat4      light_space;
 uniform sampler2D brdf_lut;
-
 uniform sampler2D base_color_texture;
-uniform int       has_color_texture;
-uniform int       has_vertex_color;
 
 #define PREFILTER_MIPS 5
 
@@ -117,12 +125,13 @@ void main()
     float NdotH   = max(dot(N, H),       0.0);
     float NdotV   = max(dot(N, V),       0.0);
 
-    float r = clamp(roughness, 0.05, 1.0);
-    float m = clamp(metallic,  0.0,  1.0);
+    vec4 params = material_params[material_index];
+    float r = clamp(params.x, 0.05, 1.0);
+    float m = clamp(params.y, 0.0,  1.0);
 
     /* Resolve albedo: base_color_factor × texture × vertex_color (GLTF spec) */
-    vec3 albedo = base_color;
-    if (has_color_texture != 0)
+    vec3 albedo = material_color[material_index].rgb;
+    if (params.z != 0.0)
         albedo *= texture(base_color_texture, uv).rgb;
     if (has_vertex_color != 0)
         albedo *= color.rgb;
@@ -6,9 +6,38 @@ attribute vec4 vertex_tangent;
 attribute vec4 vertex_color;
 attribute vec2 vertex_uv;
 
-uniform mat4 projection;
-uniform mat4 model;
-uniform mat4 view;
+layout(std140, row_major) uniform frame_block {
+    mat4 projection;
+    mat4 view;
+    mat4 light_space;
+    vec3 view_position;
+    float exposure;
+};
+
+/* World matrices, 4 rgba32f texels (the rows) per node, 256 nodes per texture row (Shaders/Common.h) */
+#define TRANSFORMS_PER_ROW 256
+uniform sampler2D transforms;
+
+/* Transform indices of the pass instances, 4 per rgba32f texel, 4096 per texture row (Shaders/Common.h) */
+#define INSTANCES_PER_ROW 4096
+uniform sampler2D instances;
+uniform int instance_offset;
+
+int instance_transform()
+{
+    int index = instance_offset + gl_InstanceID;
+    vec4 texel = texelFetch(instances, ivec2((index % INSTANCES_PER_ROW) / 4, index / INSTANCES_PER_ROW), 0);
+    return int(texel[index % 4] + 0.5);
+}
+
+mat4 transform_fetch(int index)
+{
+    ivec2 texel = ivec2((index % TRANSFORMS_PER_ROW) * 4, index / TRANSFORMS_PER_ROW);
+    return transpose(mat4(texelFetch(transforms, texel, 0),
+                          texelFetch(transforms, texel + ivec2(1, 0), 0),
+                          texelFetch(transforms, texel + ivec2(2, 0), 0),
+                          texelFetch(transforms, texel + ivec2(3, 0), 0)));
+}
 
 varying vec3 position;
 varying vec3 normal;
@@ -17,6 +46,7 @@ varying vec4 color;
 varying vec2 uv;
 
 void main() {
+    mat4 model = transform_fetch(instance_transform());
     position = (model * vec4(vertex_pos, 1.0)).xyz;
     normal = mat3(transpose(inverse(model))) * vertex_normal;
     tangent = vertex_tangent;
@@ -1,7 +1,31 @@
 #version 330
 attribute vec3 vertex_pos;
-uniform mat4 model;
 uniform mat4 light_space;
+/* World matrices, 4 rgba32f texels (the rows) per node, 256 nodes per texture row (Shaders/Common.h) */
+#define TRANSFORMS_PER_ROW 256
+uniform sampler2D transforms;
+
+/* Transform indices of the pass instances, 4 per rgba32f texel, 4096 per texture row (Shaders/Common.h) */
+#define INSTANCES_PER_ROW 4096
+uniform sampler2D instances;
+uniform int instance_offset;
+
+int instance_transform()
+{
+    int index = instance_offset + gl_InstanceID;
+    vec4 texel = texelFetch(instances, ivec2((index % INSTANCES_PER_ROW) / 4, index / INSTANCES_PER_ROW), 0);
+    return int(texel[index % 4] + 0.5);
+}
+
+mat4 transform_fetch(int index)
+{
+    ivec2 texel = ivec2((index % TRANSFORMS_PER_ROW) * 4, index / TRANSFORMS_PER_ROW);
+    return transpose(mat4(texelFetch(transforms, texel, 0),
+                          texelFetch(transforms, texel + ivec2(1, 0), 0),
+                          texelFetch(transforms, texel + ivec2(2, 0), 0),
+                          texelFetch(transforms, texel + ivec2(3, 0), 0)));
+}
+
 void main() {
-    gl_Position = light_space * model * vec4(vertex_pos, 1.0);
+    gl_Position = light_space * transform_fetch(instance_transform()) * vec4(vertex_pos, 1.0);
 }
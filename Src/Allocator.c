@@ -5,9 +5,23 @@
  */
 
 #include "Allocator.h"
+#include "Thread.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #ifndef CORE_ASSERT
 #include "assert.h"
@@ -26,6 +40,19 @@ int32_t total_size;
 int32_t tracked_allocations_length;
 os_proxy_header** tracked_allocations;
 
+/*
+ * Loaders allocate from worker threads, the tracking table is guarded by a spin lock.
+ */
+static volatile int32_t allocator_lock;
+
+static void os_allocator_lock() {
+    while (!os_atomic_cas(&allocator_lock, 0, 1)) {}
+}
+
+static void os_allocator_unlock() {
+    os_atomic_store(&allocator_lock, 0);
+}
+
 typedef struct os_chunk{
     void* ptr;
     uint32_t cur_size;
@@ -42,6 +69,7 @@ void *os_allocate_proxy(uint32_t size, char const *file, uint32_t line) {
     mem->line = line;
     mem->size = size;
     mem->realloc = false;
+    os_allocator_lock();
     total_allocations++;
     total_size += size;
     bool is_tracked = false;
@@ -65,6 +93,7 @@ void *os_allocate_proxy(uint32_t size, char const *file, uint32_t line) {
 
         tracked_allocations_length += TRACKED_ALLOCATIONS_REALLOC_LENGTH;
     }
+    os_allocator_unlock();
 
     return (void*)(mem + 1);
 }
@@ -74,6 +103,7 @@ void *os_reallocate_proxy(void *src, uint32_t size, char const *file, uint32_t l
         return os_allocate_proxy(size, file, line);
 
     os_proxy_header* mem = (os_proxy_header*)(src) - 1;
+    os_allocator_lock();
     CORE_ASSERT(tracked_allocations[mem->index] == mem && "Invalid realloc pointer, not allocated by this allocator!");
 
     total_size -= mem->size;
@@ -84,16 +114,19 @@ void *os_reallocate_proxy(void *src, uint32_t size, char const *file, uint32_t l
     mem->realloc = true;
     tracked_allocations[mem->index] = mem;
     total_size += size;
+    os_allocator_unlock();
     return (void*)(mem + 1);
 }
 
 void os_free_proxy(void *src, char const *file, uint32_t line) {
     if(src == 0) return;
     os_proxy_header* mem = (os_proxy_header*)(src) - 1;
+    os_allocator_lock();
     total_allocations--;
     total_size -= mem->size;
     CORE_ASSERT(tracked_allocations[mem->index] == mem && "Invalid realloc pointer, not allocated by this allocator!");
     tracked_allocations[mem->index] = 0;
+    os_allocator_unlock();
     FREE(mem);
 }
 
@@ -170,3 +203,48 @@ void os_chunk_free(os_chunk_handle handle) {
     OS_FREE(handle);
 }
 
+void* os_file_map(const char* path, uint64_t* size) {
+    *size = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return 0;
+    }
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    CloseHandle(file);
+    if (mapping == 0) return 0;
+    void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (ptr == 0) return 0;
+    *size = (uint64_t)file_size.QuadPart;
+    return ptr;
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0) return 0;
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+        close(file);
+        return 0;
+    }
+    void* ptr = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (ptr == MAP_FAILED) return 0;
+#ifdef MADV_SEQUENTIAL
+    madvise(ptr, (size_t)info.st_size, MADV_SEQUENTIAL);
+#endif
+    *size = (uint64_t)info.st_size;
+    return ptr;
+#endif
+}
+
+void os_file_unmap(void* ptr, uint64_t size) {
+    if (ptr == 0) return;
+#ifdef _WIN32
+    UnmapViewOfFile(ptr);
+#else
+    munmap(ptr, (size_t)size);
+#endif
+}
@@ -43,6 +43,12 @@ IBC_API void *os_allocate_proxy(uint32_t size, char const *file, uint32_t line);
 IBC_API void *os_reallocate_proxy(void *src, uint32_t size, char const *file, uint32_t line);
 IBC_API void os_free_proxy(void *src, char const *file, uint32_t line);
 
+/*
+ * Read only mapping of a whole file, returns 0 when the file is missing or empty.
+ */
+IBC_API void* os_file_map(const char* path, uint64_t* size);
+IBC_API void os_file_unmap(void* ptr, uint64_t size);
+
 IBC_API int32_t os_get_tracked_allocations_length();
 IBC_API int32_t os_get_tracked_allocations_size();
 IBC_API void os_get_tracked_allocations(os_proxy_header const** allocations);
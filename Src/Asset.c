@@ -0,0 +1,702 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "Asset.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Allocator.h"
+
+#define ASSET_NO_NAME 0xffffffffu
+//tables are built in one allocation and addressed with 32 bit offsets, payloads have 64 bit ones
+#define ASSET_MAXIMUM_TABLE_BYTES 0x7fffffffull
+
+typedef struct asset_header{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t file_size;
+
+    uint32_t nodes_offset, nodes_count;
+    uint32_t children_offset, children_count;
+    uint32_t meshes_offset, meshes_count;
+    uint32_t primitives_offset, primitives_count;
+    uint32_t attributes_offset, attributes_count;
+    uint32_t lods_offset, lods_count;
+    uint32_t materials_offset, materials_count;
+    uint32_t textures_offset, textures_count;
+    uint32_t cameras_offset, cameras_count;
+    uint32_t lights_offset, lights_count;
+    uint32_t joints_offset, joints_count;
+    uint32_t strings_offset, strings_size;
+    uint32_t name;
+    uint32_t reserved;
+    //mdl_geometry_hash, the chunk cache written with the asset stores the same one
+    uint64_t geometry_hash;
+} asset_header;
+
+typedef struct asset_node{
+    uint32_t name;
+    uint32_t node_type;
+    float local_pos[3];
+    float local_rot[4];
+    float local_scale[3];
+    int32_t mesh_index;
+    int32_t camera_index;
+    int32_t light_index;
+    int32_t parent_id;
+    uint32_t children_start;
+    uint32_t children_count;
+} asset_node;
+
+typedef struct asset_mesh{
+    uint32_t name;
+    uint32_t primitives_start;
+    uint32_t primitives_count;
+} asset_mesh;
+
+typedef struct asset_primitive{
+    uint64_t vertices_offset;
+    uint64_t indices_offset;
+    uint32_t primitive_type;
+    uint32_t attributes_flag;
+    uint32_t attributes_start;
+    uint32_t attributes_count;
+    uint32_t vertices_count;
+    uint32_t vertex_stride;
+    uint32_t indices_count;
+    uint32_t indices_total;
+    int32_t material_id;
+    uint32_t lods_start;
+    uint32_t lods_count;
+    uint32_t bounds_valid;
+    float bounds_min[3];
+    float bounds_max[3];
+} asset_primitive;
+
+typedef struct asset_attribute{
+    uint32_t type;
+    uint32_t format;
+    uint32_t offset;
+    uint32_t count;
+    uint32_t element_size;
+} asset_attribute;
+
+typedef struct asset_material{
+    uint32_t name;
+    uint32_t valid;
+    int32_t color_texture_id;
+    float color_factor[4];
+    float metallic_factor;
+    float roughness_factor;
+} asset_material;
+
+typedef struct asset_texture{
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint32_t name;
+    uint32_t valid;
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    uint32_t format;
+    uint32_t srgb;
+    int32_t levels_count;
+    uint32_t level_offsets[MDL_MAXIMUM_TEXTURE_LEVELS];
+    uint32_t level_sizes[MDL_MAXIMUM_TEXTURE_LEVELS];
+} asset_texture;
+
+typedef struct asset_camera{
+    uint32_t name;
+    uint32_t ortographic;
+    float fov;
+    float zfar, znear;
+    float xmag, ymag;
+} asset_camera;
+
+typedef struct asset_light{
+    uint32_t name;
+    uint32_t light_type;
+    float color[3];
+    float intensity;
+} asset_light;
+
+typedef struct asset_joint{
+    uint32_t name;
+    uint32_t joint_type;
+    float axis[3];
+    float lower, upper;
+    int32_t node_index;
+    int32_t child_node_index;
+} asset_joint;
+
+//lod ranges are handed out straight from the mapping
+_Static_assert(sizeof(mdl_lod) == 3 * sizeof(uint32_t), "mdl_lod must stay three 32 bit fields");
+
+typedef struct asset_buffer{
+    uint8_t* data;
+    uint64_t size;
+    uint64_t capacity;
+} asset_buffer;
+
+static uint64_t asset_buffer_reserve(asset_buffer* buffer, uint64_t bytes, uint64_t alignment)
+{
+    uint64_t offset = (buffer->size + alignment - 1) & ~(alignment - 1);
+    uint64_t end = offset + bytes;
+    if (end > buffer->capacity) {
+        uint64_t capacity = buffer->capacity > 0 ? buffer->capacity : 4096;
+        while (capacity < end) capacity *= 2;
+        buffer->data = OS_REALLOC(buffer->data, (uint32_t)capacity);
+        buffer->capacity = capacity;
+    }
+    memset(buffer->data + buffer->size, 0, (size_t)(end - buffer->size));
+    buffer->size = end;
+    return offset;
+}
+
+static uint64_t asset_buffer_append(asset_buffer* buffer, void const* data, uint64_t bytes, uint64_t alignment)
+{
+    uint64_t offset = asset_buffer_reserve(buffer, bytes, alignment);
+    if (bytes > 0)
+        memcpy(buffer->data + offset, data, (size_t)bytes);
+    return offset;
+}
+
+static uint64_t asset_align(uint64_t offset)
+{
+    return (offset + ASSET_ALIGNMENT - 1) & ~(uint64_t)(ASSET_ALIGNMENT - 1);
+}
+
+static uint64_t asset_string_bytes(const char* value)
+{
+    return value != 0 ? strlen(value) + 1 : 0;
+}
+
+//upper bound of the tables and string table, alignment padding included
+static uint64_t asset_table_bytes(mdl_data const* model, uint64_t children_count, uint64_t primitives_count,
+                                  uint64_t attributes_count, uint64_t lods_count)
+{
+    uint64_t bytes = 16 * ASSET_ALIGNMENT + sizeof(asset_header) +
+                     sizeof(asset_node) * (uint64_t)model->nodes_count + sizeof(int32_t) * children_count +
+                     sizeof(asset_mesh) * (uint64_t)model->meshes_count + sizeof(asset_primitive) * primitives_count +
+                     sizeof(asset_attribute) * attributes_count + sizeof(mdl_lod) * lods_count +
+                     sizeof(asset_material) * (uint64_t)model->materials_count +
+                     sizeof(asset_texture) * (uint64_t)model->textures_count +
+                     sizeof(asset_camera) * (uint64_t)model->cameras_count +
+                     sizeof(asset_light) * (uint64_t)model->lights_count +
+                     sizeof(asset_joint) * (uint64_t)model->joints_count;
+    bytes += asset_string_bytes(model->name);
+    for (int32_t i = 0; i < model->nodes_count; ++i) bytes += asset_string_bytes(model->nodes[i].name);
+    for (int32_t i = 0; i < model->meshes_count; ++i) bytes += asset_string_bytes(model->meshes[i].name);
+    for (int32_t i = 0; i < model->materials_count; ++i) bytes += asset_string_bytes(model->materials[i].name);
+    for (int32_t i = 0; i < model->textures_count; ++i) bytes += asset_string_bytes(model->textures[i].name);
+    for (int32_t i = 0; i < model->cameras_count; ++i) bytes += asset_string_bytes(model->cameras[i].name);
+    for (int32_t i = 0; i < model->lights_count; ++i) bytes += asset_string_bytes(model->lights[i].name);
+    for (int32_t i = 0; i < model->joints_count; ++i) bytes += asset_string_bytes(model->joints[i].name);
+    return bytes;
+}
+
+//zero padding up to offset, then the bytes
+static bool asset_write_at(FILE* out, uint64_t* position, uint64_t offset, void const* data, uint64_t bytes)
+{
+    static const uint8_t zeros[ASSET_ALIGNMENT] = {0};
+    if (offset < *position || offset - *position > sizeof(zeros)) return false;
+    size_t padding = (size_t)(offset - *position);
+    if (padding > 0 && fwrite(zeros, 1, padding, out) != padding) return false;
+    if (bytes > 0 && fwrite(data, 1, (size_t)bytes, out) != (size_t)bytes) return false;
+    *position = offset + bytes;
+    return true;
+}
+
+static uint32_t asset_add_string(asset_buffer* strings, const char* value)
+{
+    if (value == 0) return ASSET_NO_NAME;
+    return (uint32_t)asset_buffer_append(strings, value, strlen(value) + 1, 1);
+}
+
+#define ASSET_RECORD(buffer, offset, type, index) ((type*)((buffer).data + (offset)) + (index))
+
+bool asset_write(mdl_handle model, const char* path, asset_write_stats* stats)
+{
+    asset_write_stats local_stats;
+    if (stats == 0) stats = &local_stats;
+    os_memset(stats, 0, sizeof(asset_write_stats));
+
+    uint32_t children_count = 0, primitives_count = 0, attributes_count = 0, lods_count = 0;
+    for (int32_t i = 0; i < model->nodes_count; ++i)
+        children_count += (uint32_t)model->nodes[i].children_count;
+    for (int32_t i = 0; i < model->meshes_count; ++i) {
+        mdl_mesh const* mesh = model->meshes + i;
+        primitives_count += mesh->primitives_count;
+        for (uint32_t j = 0; j < mesh->primitives_count; ++j) {
+            attributes_count += (uint32_t)mesh->primitives[j].attributes_count;
+            lods_count += (uint32_t)mesh->primitives[j].lods_count;
+        }
+    }
+
+    if (asset_table_bytes(model, children_count, primitives_count, attributes_count, lods_count) > ASSET_MAXIMUM_TABLE_BYTES) {
+        fprintf(stderr, "- Asset tables exceed %llu bytes, model is too large to bake: %s\n",
+                (unsigned long long)ASSET_MAXIMUM_TABLE_BYTES, path);
+        return false;
+    }
+
+    asset_buffer file = {0};
+    asset_buffer strings = {0};
+
+    /*
+     * Tables.
+     */
+    asset_buffer_reserve(&file, sizeof(asset_header), ASSET_ALIGNMENT);
+    asset_header header;
+    os_memset(&header, 0, sizeof(header));
+    header.magic = ASSET_MAGIC;
+    header.version = ASSET_VERSION;
+    header.nodes_count = (uint32_t)model->nodes_count;
+    header.nodes_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(asset_node) * header.nodes_count, ASSET_ALIGNMENT);
+    header.children_count = children_count;
+    header.children_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(int32_t) * children_count, ASSET_ALIGNMENT);
+    header.meshes_count = (uint32_t)model->meshes_count;
+    header.meshes_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(asset_mesh) * header.meshes_count, ASSET_ALIGNMENT);
+    header.primitives_count = primitives_count;
+    header.primitives_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(asset_primitive) * primitives_count, ASSET_ALIGNMENT);
+    header.attributes_count = attributes_count;
+    header.attributes_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(asset_attribute) * attributes_count, ASSET_ALIGNMENT);
+    header.lods_count = lods_count;
+    header.lods_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(mdl_lod) * lods_count, ASSET_ALIGNMENT);
+    header.materials_count = (uint32_t)model->materials_count;
+    header.materials_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(asset_material) * header.materials_count, ASSET_ALIGNMENT);
+    header.textures_count = (uint32_t)model->textures_count;
+    header.textures_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(asset_texture) * header.textures_count, ASSET_ALIGNMENT);
+    header.cameras_count = (uint32_t)model->cameras_count;
+    header.cameras_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(asset_camera) * header.cameras_count, ASSET_ALIGNMENT);
+    header.lights_count = (uint32_t)model->lights_count;
+    header.lights_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(asset_light) * header.lights_count, ASSET_ALIGNMENT);
+    header.joints_count = (uint32_t)model->joints_count;
+    header.joints_offset = (uint32_t)asset_buffer_reserve(&file, sizeof(asset_joint) * header.joints_count, ASSET_ALIGNMENT);
+    header.name = asset_add_string(&strings, model->name);
+    header.geometry_hash = mdl_geometry_hash(model);
+
+    uint32_t children_cursor = 0;
+    for (int32_t i = 0; i < model->nodes_count; ++i) {
+        mdl_node const* node = model->nodes + i;
+        asset_node* record = ASSET_RECORD(file, header.nodes_offset, asset_node, i);
+        record->name = asset_add_string(&strings, node->name);
+        record->node_type = (uint32_t)node->node_type;
+        os_memcpy(record->local_pos, node->local_pos, sizeof(float) * 3);
+        os_memcpy(record->local_rot, node->local_rot, sizeof(float) * 4);
+        os_memcpy(record->local_scale, node->local_scale, sizeof(float) * 3);
+        record->mesh_index = node->mesh_index;
+        record->camera_index = node->camera_index;
+        record->light_index = node->light_index;
+        record->parent_id = node->parent_id;
+        record->children_start = children_cursor;
+        record->children_count = (uint32_t)node->children_count;
+        if (node->children_count > 0)
+            os_memcpy(ASSET_RECORD(file, header.children_offset, int32_t, children_cursor), node->children_id,
+                      sizeof(int32_t) * node->children_count);
+        children_cursor += (uint32_t)node->children_count;
+    }
+
+    uint32_t primitive_cursor = 0, attribute_cursor = 0, lod_cursor = 0;
+    for (int32_t i = 0; i < model->meshes_count; ++i) {
+        mdl_mesh const* mesh = model->meshes + i;
+        asset_mesh* record = ASSET_RECORD(file, header.meshes_offset, asset_mesh, i);
+        record->name = asset_add_string(&strings, mesh->name);
+        record->primitives_start = primitive_cursor;
+        record->primitives_count = mesh->primitives_count;
+
+        for (uint32_t j = 0; j < mesh->primitives_count; ++j) {
+            mdl_primitive const* primitive = mesh->primitives + j;
+            asset_primitive* prim = ASSET_RECORD(file, header.primitives_offset, asset_primitive, primitive_cursor++);
+            prim->primitive_type = (uint32_t)primitive->primitive_type;
+            prim->attributes_flag = (uint32_t)primitive->attributes_flag;
+            prim->attributes_start = attribute_cursor;
+            prim->attributes_count = (uint32_t)primitive->attributes_count;
+            prim->vertices_count = (uint32_t)primitive->vertices_count;
+            prim->vertex_stride = primitive->vertex_stride;
+            prim->indices_count = (uint32_t)primitive->indices_count;
+            prim->indices_total = (uint32_t)mdl_primitive_indices_total(primitive);
+            prim->material_id = primitive->material_id;
+            prim->lods_start = lod_cursor;
+            prim->lods_count = (uint32_t)primitive->lods_count;
+            prim->bounds_valid = primitive->bounds_valid ? 1 : 0;
+            os_memcpy(prim->bounds_min, primitive->bounds_min, sizeof(prim->bounds_min));
+            os_memcpy(prim->bounds_max, primitive->bounds_max, sizeof(prim->bounds_max));
+
+            for (int32_t k = 0; k < primitive->attributes_count; ++k) {
+                mdl_attribute const* attribute = primitive->attributes + k;
+                asset_attribute* attr = ASSET_RECORD(file, header.attributes_offset, asset_attribute, attribute_cursor++);
+                attr->type = (uint32_t)attribute->type;
+                attr->format = (uint32_t)attribute->format;
+                attr->offset = (uint32_t)attribute->offset;
+                attr->count = (uint32_t)attribute->count;
+                attr->element_size = (uint32_t)attribute->element_size;
+            }
+            if (primitive->lods_count > 0)
+                os_memcpy(ASSET_RECORD(file, header.lods_offset, mdl_lod, lod_cursor), primitive->lods,
+                          sizeof(mdl_lod) * primitive->lods_count);
+            lod_cursor += (uint32_t)primitive->lods_count;
+        }
+    }
+
+    for (int32_t i = 0; i < model->materials_count; ++i) {
+        mdl_material const* material = model->materials + i;
+        asset_material* record = ASSET_RECORD(file, header.materials_offset, asset_material, i);
+        record->name = asset_add_string(&strings, material->name);
+        record->valid = material->valid;
+        record->color_texture_id = material->color_texture_id;
+        os_memcpy(record->color_factor, material->color_factor, sizeof(float) * 4);
+        record->metallic_factor = material->metallic_factor;
+        record->roughness_factor = material->roughness_factor;
+    }
+
+    for (int32_t i = 0; i < model->cameras_count; ++i) {
+        mdl_camera const* camera = model->cameras + i;
+        asset_camera* record = ASSET_RECORD(file, header.cameras_offset, asset_camera, i);
+        record->name = asset_add_string(&strings, camera->name);
+        record->ortographic = camera->ortographic;
+        record->fov = camera->fov;
+        record->zfar = camera->zfar;
+        record->znear = camera->znear;
+        record->xmag = camera->xmag;
+        record->ymag = camera->ymag;
+    }
+
+    for (int32_t i = 0; i < model->lights_count; ++i) {
+        mdl_light const* light = model->lights + i;
+        asset_light* record = ASSET_RECORD(file, header.lights_offset, asset_light, i);
+        record->name = asset_add_string(&strings, light->name);
+        record->light_type = (uint32_t)light->light_type;
+        os_memcpy(record->color, light->color, sizeof(float) * 3);
+        record->intensity = light->intensity;
+    }
+
+    for (int32_t i = 0; i < model->joints_count; ++i) {
+        mdl_joint const* joint = model->joints + i;
+        asset_joint* record = ASSET_RECORD(file, header.joints_offset, asset_joint, i);
+        record->name = asset_add_string(&strings, joint->name);
+        record->joint_type = (uint32_t)joint->joint_type;
+        os_memcpy(record->axis, joint->axis, sizeof(float) * 3);
+        record->lower = joint->lower;
+        record->upper = joint->upper;
+        record->node_index = joint->node_index;
+        record->child_node_index = joint->child_node_index;
+    }
+
+    for (int32_t i = 0; i < model->textures_count; ++i)
+        ASSET_RECORD(file, header.textures_offset, asset_texture, i)->name = asset_add_string(&strings, model->textures[i].name);
+
+    header.strings_size = (uint32_t)strings.size;
+    header.strings_offset = (uint32_t)asset_buffer_append(&file, strings.data, strings.size, ASSET_ALIGNMENT);
+    if (strings.data != 0) OS_FREE(strings.data);
+
+    /*
+     * Payloads, placed after the tables and written straight from the model, so their size is not
+     * bound by a single allocation.
+     */
+    uint64_t cursor = file.size;
+    primitive_cursor = 0;
+    for (int32_t i = 0; i < model->meshes_count; ++i) {
+        mdl_mesh const* mesh = model->meshes + i;
+        for (uint32_t j = 0; j < mesh->primitives_count; ++j) {
+            mdl_primitive const* primitive = mesh->primitives + j;
+            uint64_t vertex_bytes = (uint64_t)primitive->vertex_stride * primitive->vertices_count;
+            uint64_t index_bytes = sizeof(uint32_t) * (uint64_t)mdl_primitive_indices_total(primitive);
+
+            asset_primitive* prim = ASSET_RECORD(file, header.primitives_offset, asset_primitive, primitive_cursor++);
+            prim->vertices_offset = asset_align(cursor);
+            prim->indices_offset = asset_align(prim->vertices_offset + vertex_bytes);
+            cursor = prim->indices_offset + index_bytes;
+
+            stats->vertex_bytes += vertex_bytes;
+            stats->index_bytes += sizeof(uint32_t) * (uint64_t)primitive->indices_count;
+            stats->lod_index_bytes += index_bytes - sizeof(uint32_t) * (uint64_t)primitive->indices_count;
+        }
+    }
+
+    for (int32_t i = 0; i < model->textures_count; ++i) {
+        mdl_texture const* texture = model->textures + i;
+        uint64_t data_size = texture->valid ? (uint64_t)texture->size : 0;
+
+        asset_texture* record = ASSET_RECORD(file, header.textures_offset, asset_texture, i);
+        record->data_offset = asset_align(cursor);
+        record->data_size = data_size;
+        cursor = record->data_offset + data_size;
+        record->valid = texture->valid;
+        record->width = texture->width;
+        record->height = texture->height;
+        record->channels = texture->channels;
+        record->format = (uint32_t)texture->format;
+        record->srgb = texture->srgb;
+        record->levels_count = texture->valid ? texture->levels_count : 0;
+        os_memcpy(record->level_offsets, texture->level_offsets, sizeof(record->level_offsets));
+        os_memcpy(record->level_sizes, texture->level_sizes, sizeof(record->level_sizes));
+        stats->texture_bytes += data_size;
+    }
+
+    header.file_size = cursor;
+    os_memcpy(file.data, &header, sizeof(header));
+    stats->file_bytes = cursor;
+
+    bool result = false;
+    FILE* out = fopen(path, "wb");
+    if (out == 0) {
+        fprintf(stderr, "- Asset file could not be created: %s\n", path);
+    } else {
+        uint64_t position = 0;
+        result = asset_write_at(out, &position, 0, file.data, file.size);
+        primitive_cursor = 0;
+        for (int32_t i = 0; i < model->meshes_count && result; ++i) {
+            mdl_mesh const* mesh = model->meshes + i;
+            for (uint32_t j = 0; j < mesh->primitives_count && result; ++j) {
+                mdl_primitive const* primitive = mesh->primitives + j;
+                asset_primitive const* prim = ASSET_RECORD(file, header.primitives_offset, asset_primitive, primitive_cursor++);
+                result = asset_write_at(out, &position, prim->vertices_offset, primitive->vertices,
+                                        (uint64_t)primitive->vertex_stride * primitive->vertices_count) &&
+                         asset_write_at(out, &position, prim->indices_offset, primitive->indices,
+                                        sizeof(uint32_t) * (uint64_t)mdl_primitive_indices_total(primitive));
+            }
+        }
+        for (int32_t i = 0; i < model->textures_count && result; ++i) {
+            asset_texture const* record = ASSET_RECORD(file, header.textures_offset, asset_texture, i);
+            result = asset_write_at(out, &position, record->data_offset, model->textures[i].buffer, record->data_size);
+        }
+        result = fclose(out) == 0 && result;
+        if (!result) fprintf(stderr, "- Asset file could not be written: %s\n", path);
+    }
+
+    OS_FREE(file.data);
+    return result;
+}
+
+static bool asset_range_valid(asset_header const* header, uint64_t offset, uint64_t bytes)
+{
+    return offset <= header->file_size && bytes <= header->file_size - offset;
+}
+
+static char* asset_string(uint8_t const* base, asset_header const* header, uint32_t offset)
+{
+    if (offset == ASSET_NO_NAME || offset >= header->strings_size) return 0;
+    return (char*)(base + header->strings_offset + offset);
+}
+
+#define ASSET_TABLE_VALID(header, name, type) \
+    asset_range_valid(header, (header)->name##_offset, (uint64_t)sizeof(type) * (header)->name##_count)
+
+mdl_handle asset_load(const char* path)
+{
+    printf("Loading asset %s\n", path != 0 ? path : "<null>");
+
+    uint64_t size = 0;
+    uint8_t const* base = path != 0 ? os_file_map(path, &size) : 0;
+    if (base == 0) {
+        fprintf(stderr, "- Asset file could not be opened: %s\n", path != 0 ? path : "<null>");
+        return 0;
+    }
+
+    asset_header const* header = (asset_header const*)base;
+    if (size < sizeof(asset_header) || header->magic != ASSET_MAGIC) {
+        fprintf(stderr, "- Not a baked asset: %s\n", path);
+        os_file_unmap((void*)base, size);
+        return 0;
+    }
+    if (header->version != ASSET_VERSION) {
+        fprintf(stderr, "- Asset version %u is not supported (expected %u), bake it again: %s\n",
+                header->version, ASSET_VERSION, path);
+        os_file_unmap((void*)base, size);
+        return 0;
+    }
+
+    bool valid = header->file_size == size &&
+                 ASSET_TABLE_VALID(header, nodes, asset_node) &&
+                 ASSET_TABLE_VALID(header, children, int32_t) &&
+                 ASSET_TABLE_VALID(header, meshes, asset_mesh) &&
+                 ASSET_TABLE_VALID(header, primitives, asset_primitive) &&
+                 ASSET_TABLE_VALID(header, attributes, asset_attribute) &&
+                 ASSET_TABLE_VALID(header, lods, mdl_lod) &&
+                 ASSET_TABLE_VALID(header, materials, asset_material) &&
+                 ASSET_TABLE_VALID(header, textures, asset_texture) &&
+                 ASSET_TABLE_VALID(header, cameras, asset_camera) &&
+                 ASSET_TABLE_VALID(header, lights, asset_light) &&
+                 ASSET_TABLE_VALID(header, joints, asset_joint) &&
+                 asset_range_valid(header, header->strings_offset, header->strings_size) &&
+                 (header->strings_size == 0 || base[header->strings_offset + header->strings_size - 1] == 0);
+
+    asset_node const* nodes = (asset_node const*)(base + header->nodes_offset);
+    asset_mesh const* meshes = (asset_mesh const*)(base + header->meshes_offset);
+    asset_primitive const* primitives = (asset_primitive const*)(base + header->primitives_offset);
+    asset_texture const* textures = (asset_texture const*)(base + header->textures_offset);
+
+    for (uint32_t i = 0; valid && i < header->nodes_count; ++i)
+        valid = (uint64_t)nodes[i].children_start + nodes[i].children_count <= header->children_count;
+    for (uint32_t i = 0; valid && i < header->meshes_count; ++i)
+        valid = (uint64_t)meshes[i].primitives_start + meshes[i].primitives_count <= header->primitives_count;
+    for (uint32_t i = 0; valid && i < header->primitives_count; ++i) {
+        asset_primitive const* prim = primitives + i;
+        valid = (uint64_t)prim->attributes_start + prim->attributes_count <= header->attributes_count &&
+                (uint64_t)prim->lods_start + prim->lods_count <= header->lods_count &&
+                prim->indices_count <= prim->indices_total &&
+                prim->vertices_count <= INT32_MAX && prim->indices_total <= INT32_MAX &&
+                prim->vertices_offset % sizeof(uint32_t) == 0 && prim->indices_offset % sizeof(uint32_t) == 0 &&
+                asset_range_valid(header, prim->vertices_offset, (uint64_t)prim->vertex_stride * prim->vertices_count) &&
+                asset_range_valid(header, prim->indices_offset, sizeof(uint32_t) * (uint64_t)prim->indices_total);
+    }
+    for (uint32_t i = 0; valid && i < header->textures_count; ++i) {
+        asset_texture const* texture = textures + i;
+        valid = asset_range_valid(header, texture->data_offset, texture->data_size) && texture->data_size <= INT32_MAX &&
+                texture->format <= MDL_TEXTURE_FORMAT_BC7 &&
+                texture->levels_count >= 0 && texture->levels_count <= MDL_MAXIMUM_TEXTURE_LEVELS;
+        for (int32_t k = 0; valid && k < texture->levels_count; ++k)
+            valid = (uint64_t)texture->level_offsets[k] + texture->level_sizes[k] <= texture->data_size;
+    }
+
+    if (!valid) {
+        fprintf(stderr, "- Asset file is truncated or corrupt: %s\n", path);
+        os_file_unmap((void*)base, size);
+        return 0;
+    }
+
+    mdl_handle handle = OS_MALLOC(sizeof(mdl_data));
+    os_memset(handle, 0, sizeof(mdl_data));
+    handle->backing = mdl_backing_create((void*)base, size);
+    handle->name = asset_string(base, header, header->name);
+    handle->geometry_hash = header->geometry_hash;
+
+    handle->nodes_count = (int32_t)header->nodes_count;
+    handle->nodes = OS_MALLOC(sizeof(mdl_node) * header->nodes_count);
+    int32_t const* children = (int32_t const*)(base + header->children_offset);
+    for (uint32_t i = 0; i < header->nodes_count; ++i) {
+        asset_node const* record = nodes + i;
+        mdl_node* node = handle->nodes + i;
+        node->node_type = (mdl_node_type)record->node_type;
+        node->name = asset_string(base, header, record->name);
+        os_memcpy(node->local_pos, record->local_pos, sizeof(float) * 3);
+        os_memcpy(node->local_rot, record->local_rot, sizeof(float) * 4);
+        os_memcpy(node->local_scale, record->local_scale, sizeof(float) * 3);
+        node->mesh_index = record->mesh_index;
+        node->camera_index = record->camera_index;
+        node->light_index = record->light_index;
+        node->parent_id = record->parent_id;
+        node->children_count = (int32_t)record->children_count;
+        node->children_id = record->children_count > 0 ? (int32_t*)(children + record->children_start) : 0;
+    }
+
+    asset_attribute const* attributes = (asset_attribute const*)(base + header->attributes_offset);
+    mdl_lod const* lods = (mdl_lod const*)(base + header->lods_offset);
+    handle->meshes_count = (int32_t)header->meshes_count;
+    handle->meshes = OS_MALLOC(sizeof(mdl_mesh) * header->meshes_count);
+    for (uint32_t i = 0; i < header->meshes_count; ++i) {
+        asset_mesh const* record = meshes + i;
+        mdl_mesh* mesh = handle->meshes + i;
+        mesh->name = asset_string(base, header, record->name);
+        mesh->primitives_count = record->primitives_count;
+        mesh->primitives = OS_MALLOC(sizeof(mdl_primitive) * record->primitives_count);
+
+        for (uint32_t j = 0; j < record->primitives_count; ++j) {
+            asset_primitive const* prim = primitives + record->primitives_start + j;
+            mdl_primitive* primitive = mesh->primitives + j;
+            os_memset(primitive, 0, sizeof(mdl_primitive));
+            primitive->primitive_type = (enum mdl_primitive_type)prim->primitive_type;
+            primitive->attributes_flag = (int32_t)prim->attributes_flag;
+            primitive->attributes_count = (int32_t)prim->attributes_count;
+            primitive->attributes = OS_MALLOC(sizeof(mdl_attribute) * prim->attributes_count);
+            for (uint32_t k = 0; k < prim->attributes_count; ++k) {
+                asset_attribute const* attr = attributes + prim->attributes_start + k;
+                primitive->attributes[k].type = (mdl_vertex_attribute_type)attr->type;
+                primitive->attributes[k].format = (mdl_attribute_format)attr->format;
+                primitive->attributes[k].offset = (int32_t)attr->offset;
+                primitive->attributes[k].count = (int32_t)attr->count;
+                primitive->attributes[k].element_size = (int32_t)attr->element_size;
+            }
+            primitive->vertices_count = (int32_t)prim->vertices_count;
+            primitive->vertex_stride = prim->vertex_stride;
+            primitive->vertices = (void*)(base + prim->vertices_offset);
+            primitive->indices_count = (int32_t)prim->indices_count;
+            primitive->indices = (uint32_t*)(base + prim->indices_offset);
+            primitive->material_id = prim->material_id;
+            primitive->lods_count = (int32_t)prim->lods_count;
+            primitive->lods = prim->lods_count > 0 ? (mdl_lod*)(lods + prim->lods_start) : 0;
+            primitive->bounds_valid = prim->bounds_valid != 0;
+            os_memcpy(primitive->bounds_min, prim->bounds_min, sizeof(primitive->bounds_min));
+            os_memcpy(primitive->bounds_max, prim->bounds_max, sizeof(primitive->bounds_max));
+        }
+    }
+
+    asset_material const* materials = (asset_material const*)(base + header->materials_offset);
+    handle->materials_count = (int32_t)header->materials_count;
+    handle->materials = OS_MALLOC(sizeof(mdl_material) * header->materials_count);
+    for (uint32_t i = 0; i < header->materials_count; ++i) {
+        mdl_material* material = handle->materials + i;
+        material->name = asset_string(base, header, materials[i].name);
+        material->valid = materials[i].valid != 0;
+        material->color_texture_id = materials[i].color_texture_id;
+        os_memcpy(material->color_factor, materials[i].color_factor, sizeof(float) * 4);
+        material->metallic_factor = materials[i].metallic_factor;
+        material->roughness_factor = materials[i].roughness_factor;
+    }
+
+    handle->textures_count = (int32_t)header->textures_count;
+    handle->textures = OS_MALLOC(sizeof(mdl_texture) * header->textures_count);
+    for (uint32_t i = 0; i < header->textures_count; ++i) {
+        mdl_texture* texture = handle->textures + i;
+        texture->name = asset_string(base, header, textures[i].name);
+        texture->buffer = textures[i].data_size > 0 ? (void*)(base + textures[i].data_offset) : 0;
+        texture->size = (int32_t)textures[i].data_size;
+        texture->width = textures[i].width;
+        texture->height = textures[i].height;
+        texture->channels = textures[i].channels;
+        texture->format = (mdl_texture_format)textures[i].format;
+        texture->srgb = textures[i].srgb != 0;
+        texture->levels_count = textures[i].levels_count;
+        os_memcpy(texture->level_offsets, textures[i].level_offsets, sizeof(texture->level_offsets));
+        os_memcpy(texture->level_sizes, textures[i].level_sizes, sizeof(texture->level_sizes));
+        texture->valid = textures[i].valid != 0 && texture->buffer != 0 && texture->levels_count > 0;
+    }
+
+    asset_camera const* cameras = (asset_camera const*)(base + header->cameras_offset);
+    handle->cameras_count = (int32_t)header->cameras_count;
+    handle->cameras = OS_MALLOC(sizeof(mdl_camera) * header->cameras_count);
+    for (uint32_t i = 0; i < header->cameras_count; ++i) {
+        mdl_camera* camera = handle->cameras + i;
+        camera->name = asset_string(base, header, cameras[i].name);
+        camera->ortographic = cameras[i].ortographic != 0;
+        camera->fov = cameras[i].fov;
+        camera->zfar = cameras[i].zfar;
+        camera->znear = cameras[i].znear;
+        camera->xmag = cameras[i].xmag;
+        camera->ymag = cameras[i].ymag;
+    }
+
+    asset_light const* lights = (asset_light const*)(base + header->lights_offset);
+    handle->lights_count = (int32_t)header->lights_count;
+    handle->lights = OS_MALLOC(sizeof(mdl_light) * header->lights_count);
+    for (uint32_t i = 0; i < header->lights_count; ++i) {
+        mdl_light* light = handle->lights + i;
+        light->name = asset_string(base, header, lights[i].name);
+        light->light_type = (mdl_light_type)lights[i].light_type;
+        os_memcpy(light->color, lights[i].color, sizeof(float) * 3);
+        light->intensity = lights[i].intensity;
+    }
+
+    asset_joint const* joints = (asset_joint const*)(base + header->joints_offset);
+    handle->joints_count = (int32_t)header->joints_count;
+    handle->joints = OS_MALLOC(sizeof(mdl_joint) * header->joints_count);
+    for (uint32_t i = 0; i < header->joints_count; ++i) {
+        mdl_joint* joint = handle->joints + i;
+        joint->name = asset_string(base, header, joints[i].name);
+        joint->joint_type = (mdl_joint_type)joints[i].joint_type;
+        os_memcpy(joint->axis, joints[i].axis, sizeof(float) * 3);
+        joint->lower = joints[i].lower;
+        joint->upper = joints[i].upper;
+        joint->node_index = joints[i].node_index;
+        joint->child_node_index = joints[i].child_node_index;
+    }
+
+    printf("- Mapped %u nodes, %u meshes, %u primitives, %u textures, %llu bytes\n",
+           header->nodes_count, header->meshes_count, header->primitives_count, header->textures_count,
+           (unsigned long long)size);
+    return handle;
+}
@@ -0,0 +1,53 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_ASSET_H
+#define IBCWEB_ASSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Model.h"
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+#define ASSET_MAGIC 0x41434249u /* "IBCA" */
+#define ASSET_VERSION 5
+#define ASSET_ALIGNMENT 16
+
+/*
+ * Baked model asset (.ibca).
+ *
+ * Layout: header, fixed size record tables, string table, then the vertex, index and texture
+ * payloads, each aligned to ASSET_ALIGNMENT. Records reference payloads by file offset and
+ * names by string table offset. Files are written in host byte order (little endian).
+ */
+
+typedef struct asset_write_stats{
+    uint64_t vertex_bytes;
+    uint64_t index_bytes;
+    uint64_t lod_index_bytes;
+    uint64_t texture_bytes;
+    uint64_t file_bytes;
+} asset_write_stats;
+
+/*
+ * Writes the model data as it is, quantized attributes and lod ranges included.
+ * Stats is optional.
+ */
+IBC_API bool asset_write(mdl_handle model, const char* path, asset_write_stats* stats);
+
+/*
+ * Maps a baked asset. Vertex, index and texture buffers, lod ranges, child lists and names
+ * point straight into the read only mapping, only the small per item structs are allocated.
+ * The mapping is released by mdl_unload.
+ */
+IBC_API mdl_handle asset_load(const char* path);
+
+#endif //IBCWEB_ASSET_H
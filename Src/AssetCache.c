@@ -0,0 +1,145 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "AssetCache.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "Allocator.h"
+
+#ifndef CORE_ASSERT
+#include "assert.h"
+#define CORE_ASSERT(e) assert(e)
+#endif
+
+typedef struct asset_cache_entry{
+    asset_cache_kind kind;
+    asset_cache_key key;
+    void* resource;
+    asset_cache_destroy_func destroy;
+    int64_t bytes;
+    int32_t references;
+} asset_cache_entry;
+
+static asset_cache_entry* cache_entries;
+static int32_t cache_entries_count;
+static int32_t cache_entries_capacity;
+static int32_t cache_hits;
+static int32_t cache_misses;
+static int32_t cache_collisions;
+static int64_t cache_shared_bytes;
+
+asset_cache_key asset_cache_key_begin()
+{
+    asset_cache_key key;
+    key.hash = 0xcbf29ce484222325ull;
+    key.check = 0x9e3779b97f4a7c15ull;
+    key.size = 0;
+    return key;
+}
+
+void asset_cache_key_add(asset_cache_key* key, void const* data, int64_t size)
+{
+    uint8_t const* bytes = data;
+    uint64_t hash = key->hash, check = key->check;
+    int64_t i = 0;
+    //fnv over words, the folded high half lets every bit reach the low ones
+    //check is a multiply-rotate hash, a collision of both needs two unrelated ones
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 32;
+        check += word * 0xc2b2ae3d27d4eb4full;
+        check = ((check << 31) | (check >> 33)) * 0x9e3779b97f4a7c15ull;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        check = (check ^ bytes[i]) * 0xff51afd7ed558ccdull;
+    }
+    key->hash = hash;
+    key->check = check;
+    key->size += size;
+}
+
+void asset_cache_key_add_string(asset_cache_key* key, const char* string)
+{
+    asset_cache_key_add(key, string, (int64_t)strlen(string));
+}
+
+void* asset_cache_acquire(asset_cache_kind kind, asset_cache_key const* key)
+{
+    for (int32_t i = 0; i < cache_entries_count; ++i) {
+        asset_cache_entry* entry = cache_entries + i;
+        if (entry->kind != kind || entry->key.hash != key->hash) continue;
+        if (entry->key.check != key->check || entry->key.size != key->size) {
+            //equal hashes of different content, build the resource again
+            cache_collisions++;
+            continue;
+        }
+        entry->references++;
+        cache_hits++;
+        cache_shared_bytes += entry->bytes;
+        return entry->resource;
+    }
+    cache_misses++;
+    return 0;
+}
+
+void* asset_cache_insert(asset_cache_kind kind, asset_cache_key const* key, void* resource, int64_t bytes,
+                         asset_cache_destroy_func destroy)
+{
+    if (resource == 0) return 0;
+    if (cache_entries_count == cache_entries_capacity) {
+        cache_entries_capacity = cache_entries_capacity > 0 ? cache_entries_capacity * 2 : 16;
+        cache_entries = OS_REALLOC(cache_entries, sizeof(asset_cache_entry) * cache_entries_capacity);
+    }
+    asset_cache_entry* entry = cache_entries + cache_entries_count++;
+    entry->kind = kind;
+    entry->key = *key;
+    entry->resource = resource;
+    entry->destroy = destroy;
+    entry->bytes = bytes;
+    entry->references = 1;
+    return resource;
+}
+
+void asset_cache_release(asset_cache_kind kind, void* resource)
+{
+    if (resource == 0) return;
+    for (int32_t i = 0; i < cache_entries_count; ++i) {
+        asset_cache_entry* entry = cache_entries + i;
+        if (entry->kind != kind || entry->resource != resource) continue;
+        if (--entry->references == 0) {
+            asset_cache_destroy_func destroy = entry->destroy;
+            *entry = cache_entries[--cache_entries_count];
+            if (destroy != 0)
+                destroy(resource);
+        }
+        if (cache_entries_count == 0) {
+            OS_FREE(cache_entries);
+            cache_entries = 0;
+            cache_entries_capacity = 0;
+        }
+        return;
+    }
+    CORE_ASSERT(0 == 1 && "Released asset is not cached");
+}
+
+void asset_cache_get_stats(asset_cache_stats* stats)
+{
+    os_memset(stats, 0, sizeof(asset_cache_stats));
+    stats->entries_count = cache_entries_count;
+    stats->hits = cache_hits;
+    stats->misses = cache_misses;
+    stats->collisions = cache_collisions;
+    stats->shared_bytes = cache_shared_bytes;
+    for (int32_t i = 0; i < cache_entries_count; ++i) {
+        stats->references_count += cache_entries[i].references;
+        stats->bytes += cache_entries[i].bytes;
+    }
+}
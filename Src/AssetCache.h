@@ -0,0 +1,82 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_ASSETCACHE_H
+#define IBCWEB_ASSETCACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+/*
+ * Reference counted gpu resources shared by every scene, keyed by their kind and the content they
+ * were built from.
+ *
+ * Keys carry two unrelated hashes of the content and its length, a hit needs all three to match,
+ * so two different sources are not mistaken for each other on a single 64 bit collision.
+ *
+ * Acquire before building a resource and insert it on a miss, the insert holds the first
+ * reference. Every acquire or insert is paired with a release, the last one destroys the resource.
+ * Only the thread owning the gl context may use the cache.
+ */
+
+typedef enum asset_cache_kind{
+    ASSET_CACHE_GEOMETRY = 0,
+    ASSET_CACHE_TEXTURES,
+    ASSET_CACHE_SKYBOX,
+    ASSET_CACHE_PREFILTERED_ENV,
+    ASSET_CACHE_BRDF_LUT,
+} asset_cache_kind;
+
+typedef void (*asset_cache_destroy_func)(void* resource);
+
+typedef struct asset_cache_key{
+    uint64_t hash;
+    uint64_t check;
+    //bytes of content added to the key
+    int64_t size;
+} asset_cache_key;
+
+typedef struct asset_cache_stats{
+    int32_t entries_count;
+    int32_t references_count;
+    //sizes as given on insert
+    int64_t bytes;
+    //sizes of the resources handed out again instead of being rebuilt
+    int64_t shared_bytes;
+    int32_t hits;
+    int32_t misses;
+    //hash matches rejected by the check hash or the content size
+    int32_t collisions;
+} asset_cache_stats;
+
+IBC_API asset_cache_key asset_cache_key_begin();
+/*
+ * Continues the key over size bytes of data.
+ */
+IBC_API void asset_cache_key_add(asset_cache_key* key, void const* data, int64_t size);
+IBC_API void asset_cache_key_add_string(asset_cache_key* key, const char* string);
+
+/*
+ * The cached resource with another reference, 0 on a miss.
+ */
+IBC_API void* asset_cache_acquire(asset_cache_kind kind, asset_cache_key const* key);
+/*
+ * Caches a resource built after a miss and returns it, bytes only feed the stats. Resources that
+ * failed to build (0) are not cached.
+ */
+IBC_API void* asset_cache_insert(asset_cache_kind kind, asset_cache_key const* key, void* resource, int64_t bytes,
+                                 asset_cache_destroy_func destroy);
+//releasing 0 does nothing, so resources that failed to build need no special case
+IBC_API void asset_cache_release(asset_cache_kind kind, void* resource);
+
+IBC_API void asset_cache_get_stats(asset_cache_stats* stats);
+
+#endif //IBCWEB_ASSETCACHE_H
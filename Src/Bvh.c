@@ -0,0 +1,275 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "Bvh.h"
+
+#include <stddef.h>
+
+#include "Allocator.h"
+
+typedef struct bvh_node{
+    float min[3];
+    //first item of a leaf, left child of an inner node, the right child follows it
+    int32_t first;
+    float max[3];
+    //0 for inner nodes
+    int32_t count;
+} bvh_node;
+
+typedef struct bvh{
+    bvh_node* nodes;
+    int32_t nodes_count;
+    int32_t* parents;
+
+    //item ids in leaf order
+    int32_t* items;
+    int32_t* item_leaf;
+    float* boxes;
+    int32_t items_count;
+
+    //traversal stack, queries are not reentrant
+    int32_t* stack;
+} bvh;
+
+static void bvh_leaf_bounds(bvh* handle, bvh_node* node)
+{
+    for (int32_t c = 0; c < 3; ++c) {
+        node->min[c] = 1e30f;
+        node->max[c] = -1e30f;
+    }
+    for (int32_t i = 0; i < node->count; ++i) {
+        float const* box = handle->boxes + (size_t)handle->items[node->first + i] * 6;
+        for (int32_t c = 0; c < 3; ++c) {
+            node->min[c] = box[c] < node->min[c] ? box[c] : node->min[c];
+            node->max[c] = box[3 + c] > node->max[c] ? box[3 + c] : node->max[c];
+        }
+    }
+}
+
+static void bvh_inner_bounds(bvh* handle, bvh_node* node)
+{
+    bvh_node const* left = handle->nodes + node->first;
+    bvh_node const* right = left + 1;
+    for (int32_t c = 0; c < 3; ++c) {
+        node->min[c] = left->min[c] < right->min[c] ? left->min[c] : right->min[c];
+        node->max[c] = left->max[c] > right->max[c] ? left->max[c] : right->max[c];
+    }
+}
+
+static bool bvh_ray_box(float const min[3], float const max[3], float const origin[3], float const inverse[3],
+                        float max_t, float* entry)
+{
+    float t0 = 0.0f, t1 = max_t;
+    for (int32_t c = 0; c < 3; ++c) {
+        float a = (min[c] - origin[c]) * inverse[c];
+        float b = (max[c] - origin[c]) * inverse[c];
+        if (a > b) {
+            float swap = a;
+            a = b;
+            b = swap;
+        }
+        t0 = a > t0 ? a : t0;
+        t1 = b < t1 ? b : t1;
+        if (t0 > t1) return false;
+    }
+    *entry = t0;
+    return true;
+}
+
+bvh_handle bvh_create(float const* boxes, int32_t count)
+{
+    bvh_handle handle = OS_MALLOC(sizeof(bvh));
+    os_memset(handle, 0, sizeof(bvh));
+    handle->items_count = count;
+    if (count <= 0) return handle;
+
+    int32_t nodes_capacity = count * 2 - 1;
+    handle->nodes = OS_MALLOC(sizeof(bvh_node) * nodes_capacity);
+    handle->parents = OS_MALLOC(sizeof(int32_t) * nodes_capacity);
+    handle->stack = OS_MALLOC(sizeof(int32_t) * (nodes_capacity + 1));
+    handle->items = OS_MALLOC(sizeof(int32_t) * count);
+    handle->item_leaf = OS_MALLOC(sizeof(int32_t) * count);
+    handle->boxes = OS_MALLOC(sizeof(float) * 6 * count);
+    os_memcpy(handle->boxes, boxes, (int32_t)(sizeof(float) * 6 * count));
+    for (int32_t i = 0; i < count; ++i)
+        handle->items[i] = i;
+
+    handle->nodes[0].first = 0;
+    handle->nodes[0].count = count;
+    handle->parents[0] = -1;
+    handle->nodes_count = 1;
+
+    //children are split off before their parent's bounds are known, so bounds are filled bottom up afterwards
+    for (int32_t n = 0; n < handle->nodes_count; ++n) {
+        bvh_node* node = handle->nodes + n;
+        if (node->count <= BVH_LEAF_SIZE) continue;
+
+        float low[3] = {1e30f, 1e30f, 1e30f}, high[3] = {-1e30f, -1e30f, -1e30f};
+        for (int32_t i = 0; i < node->count; ++i) {
+            float const* box = handle->boxes + (size_t)handle->items[node->first + i] * 6;
+            for (int32_t c = 0; c < 3; ++c) {
+                float center = (box[c] + box[3 + c]) * 0.5f;
+                low[c] = center < low[c] ? center : low[c];
+                high[c] = center > high[c] ? center : high[c];
+            }
+        }
+        int32_t axis = 0;
+        for (int32_t c = 1; c < 3; ++c)
+            if (high[c] - low[c] > high[axis] - low[axis]) axis = c;
+        float split = (low[axis] + high[axis]) * 0.5f;
+
+        int32_t* items = handle->items + node->first;
+        int32_t left_count = 0;
+        for (int32_t i = 0; i < node->count; ++i) {
+            float const* box = handle->boxes + (size_t)items[i] * 6;
+            if ((box[axis] + box[3 + axis]) * 0.5f < split) {
+                int32_t swap = items[i];
+                items[i] = items[left_count];
+                items[left_count++] = swap;
+            }
+        }
+        //all centers on one side, the split only has to separate the items
+        if (left_count == 0 || left_count == node->count)
+            left_count = node->count / 2;
+
+        int32_t left = handle->nodes_count;
+        handle->nodes[left].first = node->first;
+        handle->nodes[left].count = left_count;
+        handle->nodes[left + 1].first = node->first + left_count;
+        handle->nodes[left + 1].count = node->count - left_count;
+        handle->parents[left] = handle->parents[left + 1] = n;
+        handle->nodes_count += 2;
+
+        node->first = left;
+        node->count = 0;
+    }
+
+    for (int32_t n = handle->nodes_count - 1; n >= 0; --n) {
+        bvh_node* node = handle->nodes + n;
+        if (node->count > 0) {
+            bvh_leaf_bounds(handle, node);
+            for (int32_t i = 0; i < node->count; ++i)
+                handle->item_leaf[handle->items[node->first + i]] = n;
+        } else {
+            bvh_inner_bounds(handle, node);
+        }
+    }
+    return handle;
+}
+
+void bvh_destroy(bvh_handle handle)
+{
+    OS_FREE(handle->nodes);
+    OS_FREE(handle->parents);
+    OS_FREE(handle->stack);
+    OS_FREE(handle->items);
+    OS_FREE(handle->item_leaf);
+    OS_FREE(handle->boxes);
+    OS_FREE(handle);
+}
+
+void bvh_update_item(bvh_handle handle, int32_t item, float const min[3], float const max[3])
+{
+    if (item < 0 || item >= handle->items_count) return;
+    float* box = handle->boxes + (size_t)item * 6;
+    for (int32_t c = 0; c < 3; ++c) {
+        box[c] = min[c];
+        box[3 + c] = max[c];
+    }
+
+    int32_t n = handle->item_leaf[item];
+    bvh_leaf_bounds(handle, handle->nodes + n);
+    for (n = handle->parents[n]; n != -1; n = handle->parents[n])
+        bvh_inner_bounds(handle, handle->nodes + n);
+}
+
+int32_t bvh_raycast(bvh_handle handle, float const origin[3], float const direction[3], float max_t,
+                    bvh_ray_test test, void* user, float* t)
+{
+    if (handle->nodes_count == 0) return -1;
+
+    float inverse[3];
+    for (int32_t c = 0; c < 3; ++c)
+        inverse[c] = direction[c] != 0.0f ? 1.0f / direction[c] : (direction[c] < 0.0f ? -1e30f : 1e30f);
+
+    int32_t hit = -1;
+    float closest = max_t, entry;
+    int32_t stack_count = 0;
+    if (bvh_ray_box(handle->nodes[0].min, handle->nodes[0].max, origin, inverse, closest, &entry))
+        handle->stack[stack_count++] = 0;
+
+    while (stack_count > 0) {
+        bvh_node const* node = handle->nodes + handle->stack[--stack_count];
+        //the closest hit may have moved in front of the node since it was pushed
+        if (!bvh_ray_box(node->min, node->max, origin, inverse, closest, &entry)) continue;
+
+        if (node->count > 0) {
+            for (int32_t i = 0; i < node->count; ++i) {
+                int32_t item = handle->items[node->first + i];
+                float const* box = handle->boxes + (size_t)item * 6;
+                if (!bvh_ray_box(box, box + 3, origin, inverse, closest, &entry)) continue;
+                if (test == 0) {
+                    closest = entry;
+                    hit = item;
+                } else if (test(user, item, origin, direction, entry, &closest)) {
+                    hit = item;
+                }
+            }
+            continue;
+        }
+
+        float near_entry, far_entry;
+        bool near_hit = bvh_ray_box(handle->nodes[node->first].min, handle->nodes[node->first].max, origin, inverse, closest, &near_entry);
+        bool far_hit = bvh_ray_box(handle->nodes[node->first + 1].min, handle->nodes[node->first + 1].max, origin, inverse, closest, &far_entry);
+        int32_t near = node->first, far = node->first + 1;
+        if (near_hit && far_hit && far_entry < near_entry) {
+            near = node->first + 1;
+            far = node->first;
+        }
+        //the nearer child is pushed last so it is visited first
+        if (near_hit && far_hit) {
+            handle->stack[stack_count++] = far;
+            handle->stack[stack_count++] = near;
+        } else if (near_hit) {
+            handle->stack[stack_count++] = node->first;
+        } else if (far_hit) {
+            handle->stack[stack_count++] = node->first + 1;
+        }
+    }
+
+    if (hit != -1 && t != 0) *t = closest;
+    return hit;
+}
+
+int32_t bvh_query_aabb(bvh_handle handle, float const min[3], float const max[3], int32_t* items, int32_t capacity)
+{
+    if (handle->nodes_count == 0) return 0;
+
+    int32_t count = 0, stack_count = 0;
+    handle->stack[stack_count++] = 0;
+    while (stack_count > 0) {
+        bvh_node const* node = handle->nodes + handle->stack[--stack_count];
+        if (node->min[0] > max[0] || node->max[0] < min[0] || node->min[1] > max[1] || node->max[1] < min[1] ||
+            node->min[2] > max[2] || node->max[2] < min[2])
+            continue;
+
+        if (node->count == 0) {
+            handle->stack[stack_count++] = node->first;
+            handle->stack[stack_count++] = node->first + 1;
+            continue;
+        }
+        for (int32_t i = 0; i < node->count; ++i) {
+            int32_t item = handle->items[node->first + i];
+            float const* box = handle->boxes + (size_t)item * 6;
+            if (box[0] > max[0] || box[3] < min[0] || box[1] > max[1] || box[4] < min[1] || box[2] > max[2] || box[5] < min[2])
+                continue;
+            if (count < capacity)
+                items[count] = item;
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,58 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_BVH_H
+#define IBCWEB_BVH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+/*
+ * Bounding volume hierarchy over axis aligned boxes.
+ *
+ * Items are the indices of the boxes passed to create. Nodes split the centroid bounds at the middle
+ * of their longest axis and keep up to BVH_LEAF_SIZE items per leaf. Moving items refit only the
+ * path from their leaf to the root, the tree is never rebalanced, so rebuild after large changes.
+ */
+
+#define BVH_LEAF_SIZE 4
+
+typedef struct bvh* bvh_handle;
+
+/*
+ * Exact test of one item whose box the ray enters at entry. t is the closest hit found so far
+ * and is lowered on a hit.
+ */
+typedef bool (*bvh_ray_test)(void* user, int32_t item, float const origin[3], float const direction[3],
+                             float entry, float* t);
+
+/*
+ * Boxes hold min xyz followed by max xyz of every item.
+ */
+IBC_API bvh_handle bvh_create(float const* boxes, int32_t count);
+IBC_API void bvh_destroy(bvh_handle handle);
+
+IBC_API void bvh_update_item(bvh_handle handle, int32_t item, float const min[3], float const max[3]);
+
+/*
+ * Closest item whose test hits within max_t, -1 when nothing is hit. Nodes are visited front to back
+ * and skipped once they start behind the closest hit. Without a test the item boxes are the hits.
+ */
+IBC_API int32_t bvh_raycast(bvh_handle handle, float const origin[3], float const direction[3], float max_t,
+                            bvh_ray_test test, void* user, float* t);
+
+/*
+ * Items whose box overlaps the query box. Fills at most capacity items and returns the number of
+ * overlapping items, which may be larger.
+ */
+IBC_API int32_t bvh_query_aabb(bvh_handle handle, float const min[3], float const max[3], int32_t* items, int32_t capacity);
+
+#endif //IBCWEB_BVH_H
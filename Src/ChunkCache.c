@@ -0,0 +1,751 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "ChunkCache.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Allocator.h"
+#include "Asset.h"
+#include "GlMath.h"
+#include "Thread.h"
+
+#ifdef _WIN32
+#define CHUNK_CACHE_SEEK(file, offset) _fseeki64(file, (__int64)(offset), SEEK_SET)
+#else
+#define CHUNK_CACHE_SEEK(file, offset) fseeko(file, (off_t)(offset), SEEK_SET)
+#endif
+
+typedef struct chunk_cache_header{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t file_size;
+    uint64_t chunks_offset;
+    uint64_t primitives_offset;
+    uint32_t chunks_count;
+    uint32_t primitives_count;
+    uint32_t meshes_count;
+    uint32_t reserved;
+    //mdl_geometry_hash of the model the cache was written from
+    uint64_t geometry_hash;
+} chunk_cache_header;
+
+typedef enum chunk_cache_state{
+    CHUNK_CACHE_STATE_EVICTED = 0,
+    CHUNK_CACHE_STATE_QUEUED,
+    CHUNK_CACHE_STATE_LOADING,
+    //read, waiting for the next update to hand it to the renderer
+    CHUNK_CACHE_STATE_LOADED,
+    CHUNK_CACHE_STATE_RESIDENT,
+} chunk_cache_state;
+
+typedef struct chunk_cache_slot{
+    chunk_cache_state state;
+    void* payload;
+    //nearest distance requested since the last update
+    float requested;
+} chunk_cache_slot;
+
+typedef struct chunk_cache_rank{
+    float distance;
+    int32_t chunk_index;
+} chunk_cache_rank;
+
+typedef struct chunk_cache{
+    chunk_cache_chunk* chunks;
+    int32_t chunks_count;
+    chunk_cache_primitive* primitives;
+    int32_t primitives_count;
+    uint64_t geometry_hash;
+
+    //states, payloads and the queue are shared with the loader and guarded by the mutex
+    chunk_cache_slot* slots;
+    int32_t* queue;
+    int32_t queue_count;
+    int32_t queue_head;
+
+    //requesting thread only, the last ranking nearest first
+    chunk_cache_rank* ranks;
+    int32_t ranks_count;
+    bool* wanted;
+    bool requested;
+    int64_t budget_bytes;
+    int64_t staging_budget_bytes;
+    int64_t resident_bytes;
+    int64_t loaded_bytes;
+    int32_t loads;
+    int32_t evictions;
+
+    //loader only
+    FILE* file;
+
+    os_mutex_handle mutex;
+    //signaled when chunks are queued or the loader has to stop
+    os_condition_handle wake;
+    os_thread_handle thread;
+    volatile int32_t running;
+} chunk_cache;
+
+/*
+ * Writing.
+ */
+
+//a primitive with the world box of every node drawing it
+typedef struct chunk_cache_item{
+    int32_t mesh_index;
+    int32_t primitive_index;
+    int32_t chunk_index;
+    uint64_t bytes;
+    float min[3];
+    float max[3];
+} chunk_cache_item;
+
+typedef struct chunk_cache_build{
+    chunk_cache_item* items;
+    int32_t* scratch;
+    chunk_cache_chunk* chunks;
+    int32_t chunks_count;
+    int32_t chunks_capacity;
+    int64_t chunk_bytes;
+    int32_t depth;
+} chunk_cache_build;
+
+static uint64_t chunk_cache_align(uint64_t value)
+{
+    return (value + ASSET_ALIGNMENT - 1) & ~(uint64_t)(ASSET_ALIGNMENT - 1);
+}
+
+static uint64_t chunk_cache_primitive_bytes(mdl_primitive const* primitive, uint64_t* vertex_bytes, uint64_t* index_bytes)
+{
+    *vertex_bytes = (uint64_t)primitive->vertex_stride * primitive->vertices_count;
+    *index_bytes = sizeof(uint32_t) * (uint64_t)mdl_primitive_indices_total(primitive);
+    return chunk_cache_align(*vertex_bytes) + chunk_cache_align(*index_bytes);
+}
+
+static bool chunk_cache_primitive_bounds(mdl_primitive const* primitive, float low[3], float high[3])
+{
+    if (primitive->bounds_valid) {
+        os_memcpy(low, primitive->bounds_min, sizeof(float) * 3);
+        os_memcpy(high, primitive->bounds_max, sizeof(float) * 3);
+        return true;
+    }
+    for (int32_t a = 0; a < primitive->attributes_count; ++a) {
+        mdl_attribute const* attr = primitive->attributes + a;
+        if (attr->type != MDL_VERTEX_ATTRIBUTE_POSITION || attr->format != MDL_ATTRIBUTE_FORMAT_FLOAT32 || attr->count < 3)
+            continue;
+        if (primitive->vertices_count <= 0 || primitive->vertices == 0) return false;
+
+        for (int32_t v = 0; v < primitive->vertices_count; ++v) {
+            float const* p = (float const*)((uint8_t const*)primitive->vertices + (size_t)v * primitive->vertex_stride + attr->offset);
+            for (int32_t c = 0; c < 3; ++c) {
+                low[c] = v == 0 || p[c] < low[c] ? p[c] : low[c];
+                high[c] = v == 0 || p[c] > high[c] ? p[c] : high[c];
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+//world matrices of the node and its subtree, parents come first
+static void chunk_cache_world_build(mdl_data const* model, int32_t node_id, gl_mat const* parent, gl_mat* world)
+{
+    mdl_node const* node = model->nodes + node_id;
+    gl_vec3 position, scale;
+    gl_vec4 rotation;
+    os_memcpy(position.data, node->local_pos, sizeof(float) * 3);
+    os_memcpy(rotation.data, node->local_rot, sizeof(float) * 4);
+    os_memcpy(scale.data, node->local_scale, sizeof(float) * 3);
+    gl_mat local = gl_mat_mul(gl_mat_translate(position), gl_mat_mul(gl_mat_from_quaternion(rotation), gl_mat_scale(scale)));
+    world[node_id] = parent != 0 ? gl_mat_mul(*parent, local) : local;
+
+    for (int32_t i = 0; i < node->children_count; ++i)
+        chunk_cache_world_build(model, node->children_id[i], world + node_id, world);
+}
+
+static void chunk_cache_item_grow(chunk_cache_item* item, float const* m, float const low[3], float const high[3])
+{
+    float center[3], extent[3];
+    for (int32_t c = 0; c < 3; ++c) {
+        center[c] = (low[c] + high[c]) * 0.5f;
+        extent[c] = (high[c] - low[c]) * 0.5f;
+    }
+    for (int32_t r = 0; r < 3; ++r) {
+        float world_center = m[r * 4 + 0] * center[0] + m[r * 4 + 1] * center[1] + m[r * 4 + 2] * center[2] + m[r * 4 + 3];
+        float world_extent = fabsf(m[r * 4 + 0]) * extent[0] + fabsf(m[r * 4 + 1]) * extent[1] + fabsf(m[r * 4 + 2]) * extent[2];
+        item->min[r] = gl_min(item->min[r], world_center - world_extent);
+        item->max[r] = gl_max(item->max[r], world_center + world_extent);
+    }
+}
+
+static void chunk_cache_chunk_add(chunk_cache_build* build, int32_t const* items, int32_t count, int32_t depth)
+{
+    if (build->chunks_count == build->chunks_capacity) {
+        build->chunks_capacity = build->chunks_capacity > 0 ? build->chunks_capacity * 2 : 64;
+        build->chunks = OS_REALLOC(build->chunks, sizeof(chunk_cache_chunk) * build->chunks_capacity);
+    }
+    chunk_cache_chunk* chunk = build->chunks + build->chunks_count;
+    os_memset(chunk, 0, sizeof(chunk_cache_chunk));
+    chunk->depth = depth;
+    for (int32_t c = 0; c < 3; ++c) {
+        chunk->bounds_min[c] = FLT_MAX;
+        chunk->bounds_max[c] = -FLT_MAX;
+    }
+    for (int32_t i = 0; i < count; ++i) {
+        chunk_cache_item* item = build->items + items[i];
+        item->chunk_index = build->chunks_count;
+        for (int32_t c = 0; c < 3; ++c) {
+            chunk->bounds_min[c] = gl_min(chunk->bounds_min[c], item->min[c]);
+            chunk->bounds_max[c] = gl_max(chunk->bounds_max[c], item->max[c]);
+        }
+    }
+    build->chunks_count++;
+    build->depth = depth > build->depth ? depth : build->depth;
+}
+
+/*
+ * Loose octree cell at center with the given half size. While the cell holds more than a chunk,
+ * items go down to the octant of their center when they fit its loose box, twice the octant,
+ * so only the items larger than an octant stay behind. Items are reordered in place.
+ */
+static void chunk_cache_partition(chunk_cache_build* build, int32_t* items, int32_t count, float const center[3],
+                                  float half, int32_t depth)
+{
+    uint64_t bytes = 0;
+    for (int32_t i = 0; i < count; ++i)
+        bytes += build->items[items[i]].bytes;
+
+    int32_t kept = count;
+    if ((int64_t)bytes > build->chunk_bytes && depth < CHUNK_CACHE_MAXIMUM_DEPTH && count > 1) {
+        int32_t octant_counts[9] = {0};
+        int32_t* octants = build->scratch;
+        for (int32_t i = 0; i < count; ++i) {
+            chunk_cache_item const* item = build->items + items[i];
+            int32_t octant = 0;
+            for (int32_t c = 0; c < 3; ++c) {
+                float item_center = (item->min[c] + item->max[c]) * 0.5f;
+                if (item->max[c] - item->min[c] > half) octant = 8;
+                if (octant < 8 && item_center >= center[c]) octant |= 1 << c;
+            }
+            octants[i] = octant;
+            octant_counts[octant]++;
+        }
+
+        //stable counting sort, the items staying in the cell first
+        int32_t starts[9];
+        starts[8] = 0;
+        for (int32_t o = 0, start = octant_counts[8]; o < 8; ++o) {
+            starts[o] = start;
+            start += octant_counts[o];
+        }
+        int32_t* sorted = build->scratch + count;
+        for (int32_t i = 0; i < count; ++i)
+            sorted[starts[octants[i]]++] = items[i];
+        os_memcpy(items, sorted, (int32_t)sizeof(int32_t) * count);
+
+        kept = octant_counts[8];
+        int32_t* child_items = items + kept;
+        for (int32_t o = 0; o < 8; ++o) {
+            if (octant_counts[o] == 0) continue;
+            float child_center[3];
+            for (int32_t c = 0; c < 3; ++c)
+                child_center[c] = center[c] + ((o >> c) & 1 ? half : -half) * 0.5f;
+            chunk_cache_partition(build, child_items, octant_counts[o], child_center, half * 0.5f, depth + 1);
+            child_items += octant_counts[o];
+        }
+    }
+
+    if (kept > 0)
+        chunk_cache_chunk_add(build, items, kept, depth);
+}
+
+static bool chunk_cache_write_bytes(FILE* file, void const* data, uint64_t bytes, uint64_t* cursor)
+{
+    static uint8_t const zeros[ASSET_ALIGNMENT] = {0};
+    uint64_t padding = chunk_cache_align(*cursor) - *cursor;
+    bool result = fwrite(zeros, 1, (size_t)padding, file) == (size_t)padding;
+    if (bytes > 0)
+        result = fwrite(data, 1, (size_t)bytes, file) == (size_t)bytes && result;
+    *cursor += padding + bytes;
+    return result;
+}
+
+bool chunk_cache_write(mdl_handle model, const char* path, int64_t chunk_bytes, chunk_cache_write_stats* stats)
+{
+    chunk_cache_write_stats local_stats;
+    if (stats == 0) stats = &local_stats;
+    os_memset(stats, 0, sizeof(chunk_cache_write_stats));
+
+    gl_mat* world = OS_MALLOC(sizeof(gl_mat) * model->nodes_count + 1);
+    os_memset(world, 0, (int32_t)sizeof(gl_mat) * model->nodes_count);
+    for (int32_t i = 0; i < model->nodes_count; ++i) {
+        if (model->nodes[i].parent_id == -1)
+            chunk_cache_world_build(model, i, 0, world);
+    }
+
+    int32_t items_count = 0;
+    for (int32_t i = 0; i < model->meshes_count; ++i)
+        items_count += (int32_t)model->meshes[i].primitives_count;
+
+    chunk_cache_build build;
+    os_memset(&build, 0, sizeof(build));
+    build.chunk_bytes = chunk_bytes > 0 ? chunk_bytes : CHUNK_CACHE_DEFAULT_CHUNK_BYTES;
+    build.items = OS_MALLOC(sizeof(chunk_cache_item) * items_count + 1);
+    build.scratch = OS_MALLOC(sizeof(int32_t) * items_count * 2 + 1);
+    int32_t* items = OS_MALLOC(sizeof(int32_t) * items_count + 1);
+
+    //primitives of meshes no node draws get an empty box at the origin
+    float root_min[3] = {FLT_MAX, FLT_MAX, FLT_MAX}, root_max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (int32_t i = 0, item_index = 0; i < model->meshes_count; ++i) {
+        mdl_mesh const* mesh = model->meshes + i;
+        for (uint32_t j = 0; j < mesh->primitives_count; ++j, ++item_index) {
+            mdl_primitive const* primitive = mesh->primitives + j;
+            chunk_cache_item* item = build.items + item_index;
+            uint64_t vertex_bytes, index_bytes;
+            item->mesh_index = i;
+            item->primitive_index = (int32_t)j;
+            item->bytes = chunk_cache_primitive_bytes(primitive, &vertex_bytes, &index_bytes);
+            for (int32_t c = 0; c < 3; ++c) {
+                item->min[c] = FLT_MAX;
+                item->max[c] = -FLT_MAX;
+            }
+
+            float low[3] = {0.0f, 0.0f, 0.0f}, high[3] = {0.0f, 0.0f, 0.0f};
+            chunk_cache_primitive_bounds(primitive, low, high);
+            for (int32_t n = 0; n < model->nodes_count; ++n) {
+                if (model->nodes[n].mesh_index == i)
+                    chunk_cache_item_grow(item, world[n].data, low, high);
+            }
+            if (item->min[0] > item->max[0]) {
+                os_memset(item->min, 0, sizeof(item->min));
+                os_memset(item->max, 0, sizeof(item->max));
+            }
+            for (int32_t c = 0; c < 3; ++c) {
+                root_min[c] = gl_min(root_min[c], item->min[c]);
+                root_max[c] = gl_max(root_max[c], item->max[c]);
+            }
+            items[item_index] = item_index;
+        }
+    }
+
+    float center[3], half = 0.0f;
+    for (int32_t c = 0; c < 3; ++c) {
+        center[c] = items_count > 0 ? (root_min[c] + root_max[c]) * 0.5f : 0.0f;
+        half = items_count > 0 ? gl_max(half, (root_max[c] - root_min[c]) * 0.5f) : half;
+    }
+    chunk_cache_partition(&build, items, items_count, center, half, 0);
+
+    //primitives sorted by chunk, payload offsets relative to their chunk
+    chunk_cache_primitive* records = OS_MALLOC(sizeof(chunk_cache_primitive) * items_count + 1);
+    for (int32_t i = 0; i < items_count; ++i)
+        build.chunks[build.items[i].chunk_index].primitives_count++;
+    for (int32_t i = 0, start = 0; i < build.chunks_count; ++i) {
+        build.chunks[i].primitives_start = start;
+        start += build.chunks[i].primitives_count;
+        build.chunks[i].primitives_count = 0;
+    }
+    for (int32_t i = 0; i < items_count; ++i) {
+        chunk_cache_item const* item = build.items + i;
+        chunk_cache_chunk* chunk = build.chunks + item->chunk_index;
+        mdl_primitive const* primitive = model->meshes[item->mesh_index].primitives + item->primitive_index;
+        chunk_cache_primitive* record = records + chunk->primitives_start + chunk->primitives_count++;
+        uint64_t vertex_bytes, index_bytes;
+        chunk_cache_primitive_bytes(primitive, &vertex_bytes, &index_bytes);
+
+        os_memset(record, 0, sizeof(chunk_cache_primitive));
+        record->mesh_index = item->mesh_index;
+        record->primitive_index = item->primitive_index;
+        record->chunk_index = item->chunk_index;
+        record->vertices_count = primitive->vertices_count;
+        record->indices_total = mdl_primitive_indices_total(primitive);
+        record->vertex_stride = primitive->vertex_stride;
+        record->bounds_valid = chunk_cache_primitive_bounds(primitive, record->bounds_min, record->bounds_max);
+        record->vertices_offset = chunk->data_size;
+        record->indices_offset = chunk_cache_align(record->vertices_offset + vertex_bytes);
+        chunk->data_size = chunk_cache_align(record->indices_offset + index_bytes);
+    }
+
+    chunk_cache_header header;
+    os_memset(&header, 0, sizeof(header));
+    header.magic = CHUNK_CACHE_MAGIC;
+    header.version = CHUNK_CACHE_VERSION;
+    header.chunks_count = (uint32_t)build.chunks_count;
+    header.primitives_count = (uint32_t)items_count;
+    header.meshes_count = (uint32_t)model->meshes_count;
+    header.geometry_hash = mdl_geometry_hash(model);
+    header.chunks_offset = chunk_cache_align(sizeof(chunk_cache_header));
+    header.primitives_offset = chunk_cache_align(header.chunks_offset + sizeof(chunk_cache_chunk) * build.chunks_count);
+    uint64_t cursor = chunk_cache_align(header.primitives_offset + sizeof(chunk_cache_primitive) * items_count);
+    for (int32_t i = 0; i < build.chunks_count; ++i) {
+        chunk_cache_chunk* chunk = build.chunks + i;
+        chunk->data_offset = cursor;
+        cursor += chunk->data_size;
+        stats->payload_bytes += chunk->data_size;
+        stats->largest_chunk_bytes = chunk->data_size > stats->largest_chunk_bytes ? chunk->data_size : stats->largest_chunk_bytes;
+    }
+    header.file_size = cursor;
+    stats->chunks_count = build.chunks_count;
+    stats->depth = build.depth;
+    stats->file_bytes = header.file_size;
+
+    bool result = false;
+    FILE* out = 0;
+    if (stats->largest_chunk_bytes > CHUNK_CACHE_MAXIMUM_CHUNK_BYTES) {
+        fprintf(stderr, "- Chunk cache has a chunk of %llu bytes, more than the %llu a chunk may hold: %s\n",
+                (unsigned long long)stats->largest_chunk_bytes, (unsigned long long)CHUNK_CACHE_MAXIMUM_CHUNK_BYTES, path);
+    } else if ((out = fopen(path, "wb")) == 0) {
+        fprintf(stderr, "- Chunk cache could not be created: %s\n", path);
+    } else {
+        cursor = 0;
+        result = chunk_cache_write_bytes(out, &header, sizeof(header), &cursor);
+        result = chunk_cache_write_bytes(out, build.chunks, sizeof(chunk_cache_chunk) * build.chunks_count, &cursor) && result;
+        result = chunk_cache_write_bytes(out, records, sizeof(chunk_cache_primitive) * items_count, &cursor) && result;
+        for (int32_t i = 0; i < items_count && result; ++i) {
+            chunk_cache_primitive const* record = records + i;
+            mdl_primitive const* primitive = model->meshes[record->mesh_index].primitives + record->primitive_index;
+            uint64_t vertex_bytes, index_bytes;
+            chunk_cache_primitive_bytes(primitive, &vertex_bytes, &index_bytes);
+            result = chunk_cache_write_bytes(out, primitive->vertices, vertex_bytes, &cursor) && result;
+            result = chunk_cache_write_bytes(out, primitive->indices, index_bytes, &cursor) && result;
+        }
+        //the last payload ends aligned
+        result = chunk_cache_write_bytes(out, 0, 0, &cursor) && result;
+        result = fclose(out) == 0 && result;
+        if (!result) fprintf(stderr, "- Chunk cache could not be written: %s\n", path);
+    }
+
+    OS_FREE(records);
+    OS_FREE(items);
+    OS_FREE(build.scratch);
+    OS_FREE(build.items);
+    OS_FREE(build.chunks);
+    OS_FREE(world);
+    return result;
+}
+
+/*
+ * Streaming.
+ */
+
+static void chunk_cache_run(void* user_data)
+{
+    chunk_cache* handle = user_data;
+    for (;;) {
+        //blocks until update queues a chunk or close stops the loader
+        int32_t chunk_index = -1;
+        os_mutex_lock(handle->mutex);
+        while (chunk_index == -1 && os_atomic_load(&handle->running)) {
+            while (handle->queue_head < handle->queue_count) {
+                int32_t candidate = handle->queue[handle->queue_head++];
+                if (handle->slots[candidate].state != CHUNK_CACHE_STATE_QUEUED) continue;
+                handle->slots[candidate].state = CHUNK_CACHE_STATE_LOADING;
+                chunk_index = candidate;
+                break;
+            }
+            if (chunk_index == -1)
+                os_condition_wait(handle->wake, handle->mutex);
+        }
+        os_mutex_unlock(handle->mutex);
+        if (chunk_index == -1) break;
+
+        //sizes were checked against CHUNK_CACHE_MAXIMUM_CHUNK_BYTES on open
+        chunk_cache_chunk const* chunk = handle->chunks + chunk_index;
+        void* payload = OS_MALLOC((uint32_t)chunk->data_size + 1);
+        bool read = CHUNK_CACHE_SEEK(handle->file, chunk->data_offset) == 0 &&
+                    fread(payload, 1, (size_t)chunk->data_size, handle->file) == (size_t)chunk->data_size;
+        if (!read) {
+            fprintf(stderr, "- Chunk %i could not be read\n", chunk_index);
+            OS_FREE(payload);
+            payload = 0;
+        }
+
+        os_mutex_lock(handle->mutex);
+        handle->slots[chunk_index].payload = payload;
+        handle->slots[chunk_index].state = read ? CHUNK_CACHE_STATE_LOADED : CHUNK_CACHE_STATE_EVICTED;
+        os_mutex_unlock(handle->mutex);
+    }
+}
+
+static void* chunk_cache_read_table(FILE* file, uint64_t offset, uint64_t bytes)
+{
+    if (bytes > CHUNK_CACHE_MAXIMUM_CHUNK_BYTES) return 0;
+    void* table = OS_MALLOC((uint32_t)bytes + 1);
+    if (CHUNK_CACHE_SEEK(file, offset) != 0 || fread(table, 1, (size_t)bytes, file) != (size_t)bytes) {
+        OS_FREE(table);
+        return 0;
+    }
+    return table;
+}
+
+static bool chunk_cache_tables_valid(chunk_cache_header const* header, chunk_cache_chunk const* chunks,
+                                     chunk_cache_primitive const* primitives)
+{
+    for (uint32_t i = 0; i < header->chunks_count; ++i) {
+        chunk_cache_chunk const* chunk = chunks + i;
+        if (chunk->data_offset > header->file_size || chunk->data_size > header->file_size - chunk->data_offset ||
+            chunk->data_size > CHUNK_CACHE_MAXIMUM_CHUNK_BYTES || chunk->primitives_start < 0 || chunk->primitives_count < 0 ||
+            (uint32_t)chunk->primitives_start + (uint32_t)chunk->primitives_count > header->primitives_count)
+            return false;
+        for (int32_t j = 0; j < chunk->primitives_count; ++j) {
+            chunk_cache_primitive const* primitive = primitives + chunk->primitives_start + j;
+            uint64_t vertex_bytes = (uint64_t)primitive->vertex_stride * (uint64_t)primitive->vertices_count;
+            uint64_t index_bytes = sizeof(uint32_t) * (uint64_t)primitive->indices_total;
+            if (primitive->chunk_index != (int32_t)i || primitive->vertices_count < 0 || primitive->indices_total < 0 ||
+                primitive->vertices_offset > chunk->data_size || vertex_bytes > chunk->data_size - primitive->vertices_offset ||
+                primitive->indices_offset > chunk->data_size || index_bytes > chunk->data_size - primitive->indices_offset)
+                return false;
+        }
+    }
+    return true;
+}
+
+chunk_cache_handle chunk_cache_open(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == 0) return 0;
+
+    chunk_cache_header header;
+    if (fread(&header, 1, sizeof(header), file) != sizeof(header) || header.magic != CHUNK_CACHE_MAGIC ||
+        header.version != CHUNK_CACHE_VERSION) {
+        fprintf(stderr, "- Chunk cache is not valid: %s\n", path);
+        fclose(file);
+        return 0;
+    }
+
+    chunk_cache_chunk* chunks = chunk_cache_read_table(file, header.chunks_offset,
+                                                       (uint64_t)sizeof(chunk_cache_chunk) * header.chunks_count);
+    chunk_cache_primitive* primitives = chunk_cache_read_table(file, header.primitives_offset,
+                                                               (uint64_t)sizeof(chunk_cache_primitive) * header.primitives_count);
+    if (chunks == 0 || primitives == 0 || !chunk_cache_tables_valid(&header, chunks, primitives)) {
+        fprintf(stderr, "- Chunk cache is not valid: %s\n", path);
+        OS_FREE(chunks);
+        OS_FREE(primitives);
+        fclose(file);
+        return 0;
+    }
+
+    chunk_cache_handle handle = OS_MALLOC(sizeof(chunk_cache));
+    os_memset(handle, 0, sizeof(chunk_cache));
+    handle->file = file;
+    handle->chunks = chunks;
+    handle->chunks_count = (int32_t)header.chunks_count;
+    handle->primitives = primitives;
+    handle->primitives_count = (int32_t)header.primitives_count;
+    handle->geometry_hash = header.geometry_hash;
+    handle->budget_bytes = CHUNK_CACHE_DEFAULT_BUDGET;
+    handle->staging_budget_bytes = CHUNK_CACHE_DEFAULT_STAGING;
+
+    handle->slots = OS_MALLOC(sizeof(chunk_cache_slot) * handle->chunks_count + 1);
+    handle->queue = OS_MALLOC(sizeof(int32_t) * handle->chunks_count + 1);
+    handle->ranks = OS_MALLOC(sizeof(chunk_cache_rank) * handle->chunks_count + 1);
+    handle->wanted = OS_MALLOC(sizeof(bool) * handle->chunks_count + 1);
+    for (int32_t i = 0; i < handle->chunks_count; ++i) {
+        handle->slots[i].state = CHUNK_CACHE_STATE_EVICTED;
+        handle->slots[i].payload = 0;
+        handle->slots[i].requested = FLT_MAX;
+    }
+
+    handle->mutex = os_mutex_create();
+    handle->wake = os_condition_create();
+    handle->running = 1;
+    handle->thread = os_thread_create(chunk_cache_run, handle);
+    return handle;
+}
+
+void chunk_cache_close(chunk_cache_handle handle)
+{
+    os_mutex_lock(handle->mutex);
+    os_atomic_store(&handle->running, 0);
+    os_condition_broadcast(handle->wake);
+    os_mutex_unlock(handle->mutex);
+    os_thread_join(handle->thread);
+    os_condition_destroy(handle->wake);
+    os_mutex_destroy(handle->mutex);
+    for (int32_t i = 0; i < handle->chunks_count; ++i)
+        OS_FREE(handle->slots[i].payload);
+    fclose(handle->file);
+    OS_FREE(handle->chunks);
+    OS_FREE(handle->primitives);
+    OS_FREE(handle->slots);
+    OS_FREE(handle->queue);
+    OS_FREE(handle->ranks);
+    OS_FREE(handle->wanted);
+    OS_FREE(handle);
+}
+
+chunk_cache_chunk const* chunk_cache_get_chunks(chunk_cache_handle handle, int32_t* count)
+{
+    *count = handle->chunks_count;
+    return handle->chunks;
+}
+
+chunk_cache_primitive const* chunk_cache_get_primitives(chunk_cache_handle handle, int32_t* count)
+{
+    *count = handle->primitives_count;
+    return handle->primitives;
+}
+
+uint64_t chunk_cache_get_geometry_hash(chunk_cache_handle handle)
+{
+    return handle->geometry_hash;
+}
+
+void chunk_cache_request(chunk_cache_handle handle, int32_t chunk_index, float distance)
+{
+    chunk_cache_slot* slot = handle->slots + chunk_index;
+    slot->requested = distance < slot->requested ? distance : slot->requested;
+    handle->requested = true;
+}
+
+static int chunk_cache_rank_compare(void const* a, void const* b)
+{
+    chunk_cache_rank const* ra = a;
+    chunk_cache_rank const* rb = b;
+    if (ra->distance != rb->distance) return ra->distance < rb->distance ? -1 : 1;
+    return ra->chunk_index - rb->chunk_index;
+}
+
+static int64_t chunk_cache_size(chunk_cache_handle handle, int32_t chunk_index)
+{
+    return (int64_t)handle->chunks[chunk_index].data_size;
+}
+
+bool chunk_cache_update(chunk_cache_handle handle, chunk_cache_load_func load, chunk_cache_evict_func evict,
+                        void* user_data)
+{
+    bool changed = false;
+
+    //finished loads, nearest first, the loader never touches a loaded chunk again
+    int64_t delivered = 0;
+    for (int32_t i = 0; i < handle->ranks_count && delivered < CHUNK_CACHE_UPLOAD_PER_UPDATE; ++i) {
+        int32_t chunk_index = handle->ranks[i].chunk_index;
+        chunk_cache_slot* slot = handle->slots + chunk_index;
+        os_mutex_lock(handle->mutex);
+        void* payload = slot->state == CHUNK_CACHE_STATE_LOADED ? slot->payload : 0;
+        if (payload != 0) {
+            slot->payload = 0;
+            slot->state = CHUNK_CACHE_STATE_RESIDENT;
+        }
+        os_mutex_unlock(handle->mutex);
+        if (payload == 0) continue;
+
+        load(user_data, chunk_index, payload);
+        OS_FREE(payload);
+        delivered += chunk_cache_size(handle, chunk_index);
+        handle->resident_bytes += chunk_cache_size(handle, chunk_index);
+        handle->loaded_bytes += chunk_cache_size(handle, chunk_index);
+        handle->loads++;
+        changed = true;
+    }
+    if (!handle->requested) return changed;
+
+    //nearest chunks that fit the budget are wanted, chunks nobody asked for never are.
+    //The nearest one is wanted even when it alone is larger than the budget, it would never load otherwise.
+    handle->ranks_count = handle->chunks_count;
+    for (int32_t i = 0; i < handle->chunks_count; ++i) {
+        handle->ranks[i].distance = handle->slots[i].requested;
+        handle->ranks[i].chunk_index = i;
+        handle->slots[i].requested = FLT_MAX;
+    }
+    qsort(handle->ranks, handle->ranks_count, sizeof(chunk_cache_rank), chunk_cache_rank_compare);
+    handle->requested = false;
+
+    int64_t wanted_bytes = 0, missing_bytes = 0;
+    for (int32_t i = 0; i < handle->ranks_count; ++i) {
+        int32_t chunk_index = handle->ranks[i].chunk_index;
+        int64_t size = chunk_cache_size(handle, chunk_index);
+        bool wanted = handle->ranks[i].distance < FLT_MAX && (wanted_bytes + size <= handle->budget_bytes || i == 0);
+        handle->wanted[chunk_index] = wanted;
+        if (!wanted) continue;
+        wanted_bytes += size;
+        if (handle->slots[chunk_index].state != CHUNK_CACHE_STATE_RESIDENT)
+            missing_bytes += size;
+    }
+
+    //pending chunks that fell out of the wanted set are dropped, the one being read finishes first
+    os_mutex_lock(handle->mutex);
+    int64_t staging_bytes = 0;
+    for (int32_t i = 0; i < handle->chunks_count; ++i) {
+        chunk_cache_slot* slot = handle->slots + i;
+        if (!handle->wanted[i] && (slot->state == CHUNK_CACHE_STATE_QUEUED || slot->state == CHUNK_CACHE_STATE_LOADED)) {
+            OS_FREE(slot->payload);
+            slot->payload = 0;
+            slot->state = CHUNK_CACHE_STATE_EVICTED;
+        }
+        if (slot->state == CHUNK_CACHE_STATE_QUEUED || slot->state == CHUNK_CACHE_STATE_LOADING ||
+            slot->state == CHUNK_CACHE_STATE_LOADED)
+            staging_bytes += chunk_cache_size(handle, i);
+    }
+    os_mutex_unlock(handle->mutex);
+
+    //resident chunks are only evicted to make room, farthest first, so the set does not flicker at the edge
+    for (int32_t i = handle->ranks_count - 1; i >= 0 && handle->resident_bytes + missing_bytes > handle->budget_bytes; --i) {
+        int32_t chunk_index = handle->ranks[i].chunk_index;
+        if (handle->wanted[chunk_index] || handle->slots[chunk_index].state != CHUNK_CACHE_STATE_RESIDENT) continue;
+        handle->slots[chunk_index].state = CHUNK_CACHE_STATE_EVICTED;
+        handle->resident_bytes -= chunk_cache_size(handle, chunk_index);
+        handle->evictions++;
+        evict(user_data, chunk_index);
+        changed = true;
+    }
+
+    //wanted chunks in rank order, as many as the staging budget takes, at least one
+    os_mutex_lock(handle->mutex);
+    handle->queue_count = handle->queue_head = 0;
+    bool staging_full = false;
+    for (int32_t i = 0; i < handle->ranks_count; ++i) {
+        int32_t chunk_index = handle->ranks[i].chunk_index;
+        chunk_cache_slot* slot = handle->slots + chunk_index;
+        if (!handle->wanted[chunk_index]) continue;
+        if (slot->state == CHUNK_CACHE_STATE_QUEUED) {
+            handle->queue[handle->queue_count++] = chunk_index;
+        } else if (slot->state == CHUNK_CACHE_STATE_EVICTED && !staging_full) {
+            int64_t size = chunk_cache_size(handle, chunk_index);
+            staging_full = staging_bytes > 0 && staging_bytes + size > handle->staging_budget_bytes;
+            if (staging_full) continue;
+            slot->state = CHUNK_CACHE_STATE_QUEUED;
+            handle->queue[handle->queue_count++] = chunk_index;
+            staging_bytes += size;
+        }
+    }
+    if (handle->queue_count > 0)
+        os_condition_signal(handle->wake);
+    os_mutex_unlock(handle->mutex);
+    return changed;
+}
+
+void chunk_cache_set_budget(chunk_cache_handle handle, int64_t budget_bytes, int64_t staging_bytes)
+{
+    handle->budget_bytes = budget_bytes;
+    handle->staging_budget_bytes = staging_bytes;
+}
+
+void chunk_cache_get_stats(chunk_cache_handle handle, chunk_cache_stats* stats)
+{
+    os_memset(stats, 0, sizeof(chunk_cache_stats));
+    stats->chunks_count = handle->chunks_count;
+    stats->resident_bytes = handle->resident_bytes;
+    stats->budget_bytes = handle->budget_bytes;
+    stats->loaded_bytes = handle->loaded_bytes;
+    stats->loads = handle->loads;
+    stats->evictions = handle->evictions;
+
+    os_mutex_lock(handle->mutex);
+    for (int32_t i = 0; i < handle->chunks_count; ++i) {
+        chunk_cache_state state = handle->slots[i].state;
+        if (state == CHUNK_CACHE_STATE_RESIDENT) {
+            stats->resident_count++;
+        } else if (state != CHUNK_CACHE_STATE_EVICTED) {
+            stats->pending_count++;
+            stats->staging_bytes += chunk_cache_size(handle, i);
+        }
+    }
+    os_mutex_unlock(handle->mutex);
+}
@@ -0,0 +1,148 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_CHUNKCACHE_H
+#define IBCWEB_CHUNKCACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Model.h"
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+#define CHUNK_CACHE_MAGIC 0x4B434249u /* "IBCK" */
+#define CHUNK_CACHE_VERSION 2
+
+/*
+ * Chunked geometry cache (.ibcc), written next to a baked asset and streamed by the viewer.
+ *
+ * The model primitives are placed in a loose octree by the world box of all nodes drawing them,
+ * a cell is split while its primitives hold more than the chunk size. Every cell holding primitives
+ * becomes a chunk, their vertex and index payloads are stored back to back, so a chunk is read with
+ * a single request. Chunk boxes are taken at bake time, streaming suits geometry that stays in place.
+ *
+ * Layout: header, chunk table, primitive table sorted by chunk, then the chunk payloads, each
+ * aligned to ASSET_ALIGNMENT. Files are written in host byte order (little endian).
+ *
+ * At runtime a loader thread reads the chunks the renderer asks for. Each frame the renderer
+ * requests the distance every chunk is seen at, update then pages the nearest ones in and drops
+ * the farthest resident ones whenever the budget would be exceeded. Payloads waiting for the
+ * renderer are bounded by the staging budget. The nearest chunk is loaded even when it alone exceeds
+ * the budget. Only one thread may request and update.
+ *
+ * The header stores mdl_geometry_hash of the model it was written from, the viewer checks it against
+ * the hash of the asset, so a cache left over from an older bake is not used.
+ */
+
+#define CHUNK_CACHE_DEFAULT_CHUNK_BYTES (4ll * 1024 * 1024)
+#define CHUNK_CACHE_MAXIMUM_DEPTH 10
+#define CHUNK_CACHE_DEFAULT_BUDGET (512ll * 1024 * 1024)
+#define CHUNK_CACHE_DEFAULT_STAGING (64ll * 1024 * 1024)
+//payload handed to the renderer by a single update, the rest is delivered on the next frames
+#define CHUNK_CACHE_UPLOAD_PER_UPDATE (32ll * 1024 * 1024)
+//a payload is read into one allocation, writing fails and opening refuses larger chunks
+#define CHUNK_CACHE_MAXIMUM_CHUNK_BYTES 0x7fffffffull
+
+typedef struct chunk_cache* chunk_cache_handle;
+
+typedef struct chunk_cache_chunk{
+    //file offset and size of the payload
+    uint64_t data_offset;
+    uint64_t data_size;
+    //world box of the primitives placed in the chunk
+    float bounds_min[3];
+    float bounds_max[3];
+    int32_t depth;
+    int32_t primitives_start;
+    int32_t primitives_count;
+    int32_t reserved;
+} chunk_cache_chunk;
+
+typedef struct chunk_cache_primitive{
+    //offsets inside the chunk payload, indices hold the lod ranges too
+    uint64_t vertices_offset;
+    uint64_t indices_offset;
+    int32_t mesh_index;
+    int32_t primitive_index;
+    int32_t chunk_index;
+    int32_t vertices_count;
+    int32_t indices_total;
+    uint32_t vertex_stride;
+    //object space box of float positions
+    int32_t bounds_valid;
+    float bounds_min[3];
+    float bounds_max[3];
+    int32_t reserved;
+} chunk_cache_primitive;
+
+typedef struct chunk_cache_write_stats{
+    int32_t chunks_count;
+    int32_t depth;
+    uint64_t largest_chunk_bytes;
+    uint64_t payload_bytes;
+    uint64_t file_bytes;
+} chunk_cache_write_stats;
+
+typedef struct chunk_cache_stats{
+    int32_t chunks_count;
+    int32_t resident_count;
+    //queued, being read or waiting for the renderer
+    int32_t pending_count;
+    int64_t resident_bytes;
+    int64_t budget_bytes;
+    int64_t staging_bytes;
+    int64_t loaded_bytes;
+    int32_t loads;
+    int32_t evictions;
+} chunk_cache_stats;
+
+/*
+ * Called by update on the requesting thread. The payload is freed once load returns.
+ */
+typedef void (*chunk_cache_load_func)(void* user_data, int32_t chunk_index, void const* payload);
+typedef void (*chunk_cache_evict_func)(void* user_data, int32_t chunk_index);
+
+/*
+ * Partitions and writes the model geometry as it is, chunk_bytes <= 0 takes the default size.
+ * Stats is optional.
+ */
+IBC_API bool chunk_cache_write(mdl_handle model, const char* path, int64_t chunk_bytes, chunk_cache_write_stats* stats);
+
+/*
+ * Reads the tables and starts the loader, nothing is resident yet. Returns 0 when the file is
+ * missing or invalid.
+ */
+IBC_API chunk_cache_handle chunk_cache_open(const char* path);
+/*
+ * Stops the loader, payloads that were not delivered are dropped. Resident chunks are not evicted.
+ */
+IBC_API void chunk_cache_close(chunk_cache_handle handle);
+
+IBC_API chunk_cache_chunk const* chunk_cache_get_chunks(chunk_cache_handle handle, int32_t* count);
+IBC_API chunk_cache_primitive const* chunk_cache_get_primitives(chunk_cache_handle handle, int32_t* count);
+IBC_API uint64_t chunk_cache_get_geometry_hash(chunk_cache_handle handle);
+
+/*
+ * Distance the chunk is seen at this frame, several requests keep the nearest.
+ */
+IBC_API void chunk_cache_request(chunk_cache_handle handle, int32_t chunk_index, float distance);
+
+/*
+ * Delivers finished loads, then ranks the chunks requested since the last update, evicts to make
+ * room and queues the loads. Chunks that were not requested are never loaded. True when any chunk
+ * was loaded or evicted.
+ */
+IBC_API bool chunk_cache_update(chunk_cache_handle handle, chunk_cache_load_func load, chunk_cache_evict_func evict,
+                                void* user_data);
+
+IBC_API void chunk_cache_set_budget(chunk_cache_handle handle, int64_t budget_bytes, int64_t staging_bytes);
+IBC_API void chunk_cache_get_stats(chunk_cache_handle handle, chunk_cache_stats* stats);
+
+#endif //IBCWEB_CHUNKCACHE_H
@@ -6,6 +6,9 @@
 
 #include "Graphics.h"
 
+#include <stdio.h>
+#include <string.h>
+
 #ifndef CORE_ASSERT
 #include "assert.h"
 #define CORE_ASSERT(e) assert(e)
@@ -22,17 +25,59 @@
 
 #include "Allocator.h"
 
-#define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RG_RGTC2
+#define GL_COMPRESSED_RG_RGTC2 0x8DBD
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER 0x8A11
+#endif
+#ifndef GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+#define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#endif
+
 typedef void(*gfx_shader_recompile_callback)(gfx_shader_handle handle);
 
+//users hold the command index, so a reload only has to resolve the commands again
 typedef struct gfx_shader_uniform_command{
     char name[MAXIMUM_UNIFORM_NAME_LENGTH];
     gfx_type type;
-    int32_t * reference_index;
+    int32_t uniform; //index in the active uniforms, -1 when the program does not use it
 }gfx_pipeline_uniform_command;
 
+typedef struct gfx_shader_block_command{
+    char name[MAXIMUM_UNIFORM_NAME_LENGTH];
+    int32_t binding;
+} gfx_shader_block_command;
+
 typedef struct gfx_shader_attribute{
     int32_t id; //attribute id
     bool enabled; //whether attribute is enabled in shader program
@@ -66,9 +111,17 @@ typedef struct gfx_shader{
     int32_t pipeline_count;
     struct gfx_shader_uniform_command uniform_commands[MAXIMUM_UNIFORM_COMMANDS_PER_SHADER]; //active shader uniforms
     int32_t uniform_commands_count;
+    struct gfx_shader_block_command block_commands[MAXIMUM_UNIFORM_BLOCKS_PER_SHADER]; //uniform block bindings
+    int32_t block_commands_count;
 } gfx_shader;
 
 
+typedef struct gfx_shader_cache_entry{
+    uint64_t hash;
+    int32_t references;
+    gfx_shader_handle shader;
+} gfx_shader_cache_entry;
+
 typedef struct gfx_buffer{
     uint32_t id; //opengl index
     enum gfx_resource_status status;
@@ -79,6 +132,7 @@ typedef struct gfx_buffer{
 typedef struct gfx_pipeline_attr_command{
     char name[MAXIMUM_ATTRIBUTE_NAME_LENGTH];
     gfx_buffer_handle buffer;
+    gfx_attribute_format format;
     int32_t count;
     int32_t offset;
     int32_t stride;
@@ -110,6 +164,10 @@ typedef struct gfx_texture{
     gfx_texture_wrap_mode wrap;
     gfx_texture_type type;
     enum gfx_resource_status status;
+    int32_t levels_count;
+    //finest level with storage, levels before it were never uploaded or were released
+    int32_t base_level;
+    int64_t bytes;
 } gfx_texture;
 
 typedef struct gfx_texture_cubemap{
@@ -142,6 +200,11 @@ gfx_log_callback gfx_log;
 shader_change_callback shader_change;
 
 static char log_buffer[LOG_BUFFER_SIZE];
+static int64_t gfx_texture_total_bytes_count = 0;
+
+static gfx_shader_cache_entry* shader_cache = 0;
+static int32_t shader_cache_count = 0;
+static int32_t shader_cache_capacity = 0;
 
 
 #define SHADER_CHANGE_CALLBACK(shader) if(shader_change != 0) shader_change(shader);
@@ -189,6 +252,12 @@ bool gfx_init() {
 }
 
 void gfx_terminate() {
+    if (shader_cache_count != 0)
+        LOG_ERROR("%i cached shader programs were not released\n", shader_cache_count);
+    OS_FREE(shader_cache);
+    shader_cache = 0;
+    shader_cache_count = 0;
+    shader_cache_capacity = 0;
 }
 
 void gfx_log_callback_set(gfx_log_callback callback){
@@ -284,6 +353,8 @@ uint32_t gl_get_buffer_type(gfx_buffer_type type) {
             return GL_ARRAY_BUFFER;
         case GFX_BUFFER_INDEX:
             return GL_ELEMENT_ARRAY_BUFFER;
+        case GFX_BUFFER_UNIFORM:
+            return GL_UNIFORM_BUFFER;
         default:
             CORE_ASSERT(0 && "Invalid buffer type");
             return 0;
@@ -384,6 +455,20 @@ void gfx_shader_add_fs(gfx_shader_handle handle, const char* fs){
     }
 }
 
+static void gfx_shader_uniform_resolve(gfx_shader_handle handle, gfx_pipeline_uniform_command* command){
+    command->uniform = -1;
+    for (int32_t i = 0; i < handle->uniform_count; ++i) {
+        gfx_shader_uniform *uni = handle->uniforms + i;
+        if (strcmp(uni->name, command->name) == 0) {
+            CORE_ASSERT(uni->type == command->type);
+            command->uniform = i;
+            LOG("Uniform enabled, shader: %s, name: %s, type:%s\n", handle->name,
+                   command->name, gfx_get_type_char(uni->type));
+            return;
+        }
+    }
+}
+
 void gfx_shader_submit(gfx_shader_handle handle) {
     CORE_ASSERT(handle->status == GFX_RESOURCE_CREATED && "Shader submit failed");
 
@@ -396,6 +481,10 @@ void gfx_shader_submit(gfx_shader_handle handle) {
     GLenum attr_type;
     int32_t name_length;
     glGetProgramiv(handle->id, GL_ACTIVE_ATTRIBUTES, &handle->attr_count);
+    if (handle->attr_count > MAXIMUM_ATTRIBUTES_PER_SHADER) {
+        LOG_ERROR("Shader %s has %i attributes, only %i are used\n", handle->name, handle->attr_count, MAXIMUM_ATTRIBUTES_PER_SHADER);
+        handle->attr_count = MAXIMUM_ATTRIBUTES_PER_SHADER;
+    }
     for (int32_t i = 0; i < handle->attr_count; i++) {
         struct gfx_shader_attribute *attr = handle->attributes + i;
         glGetActiveAttrib(handle->id, (GLuint) i, MAXIMUM_ATTRIBUTE_NAME_LENGTH, &name_length, &attr->length,
@@ -412,7 +501,12 @@ void gfx_shader_submit(gfx_shader_handle handle) {
     }
 
     //store active uniforms
+    //members of uniform blocks are listed too, their location is -1
     glGetProgramiv(handle->id, GL_ACTIVE_UNIFORMS, &handle->uniform_count);
+    if (handle->uniform_count > MAXIMUM_UNIFORMS_PER_SHADER) {
+        LOG_ERROR("Shader %s has %i uniforms, only %i are used\n", handle->name, handle->uniform_count, MAXIMUM_UNIFORMS_PER_SHADER);
+        handle->uniform_count = MAXIMUM_UNIFORMS_PER_SHADER;
+    }
     for (int32_t i = 0; i < handle->uniform_count; i++) {
         struct gfx_shader_uniform *uniform = handle->uniforms + i;
         glGetActiveUniform(handle->id, (GLuint) i, MAXIMUM_UNIFORM_NAME_LENGTH, &name_length, &uniform->length,
@@ -440,14 +534,12 @@ void gfx_shader_submit(gfx_shader_handle handle) {
     }
 
     if (compiled) {
-        int32_t count = handle->uniform_commands_count;
-        gfx_pipeline_uniform_command commands[MAXIMUM_UNIFORM_COMMANDS_PER_SHADER];
-        os_memcpy(commands, handle->uniform_commands, sizeof(commands));
-
-        handle->uniform_commands_count = 0;
-        for (int32_t i = 0; i < count; ++i) {
-            struct gfx_shader_uniform_command cmd = commands[i];
-            gfx_shader_uniform_enable(handle, cmd.name, cmd.type, cmd.reference_index);
+        for (int32_t i = 0; i < handle->uniform_commands_count; ++i)
+            gfx_shader_uniform_resolve(handle, handle->uniform_commands + i);
+
+        for (int32_t i = 0; i < handle->block_commands_count; ++i) {
+            struct gfx_shader_block_command cmd = handle->block_commands[i];
+            gfx_shader_uniform_block_enable(handle, cmd.name, cmd.binding);
         }
     }
 
@@ -463,8 +555,8 @@ void gfx_shader_submit(gfx_shader_handle handle) {
 
         for (int32_t j = 0; j < commands_count; ++j) {
             struct gfx_pipeline_attr_command command = pip->attr_commands[j];
-            gfx_pipeline_attr_enable(pip, command.name, command.buffer, command.count, command.offset,
-                                     command.stride);
+            gfx_pipeline_attr_enable_format(pip, command.name, command.buffer, command.format, command.count,
+                                            command.offset, command.stride);
         }
 
         gfx_pipeline_submit(pip);
@@ -506,6 +598,85 @@ void gfx_shader_reload(gfx_shader_handle handle){
     LOG("Shader reloaded: %s\n", handle->name);
 }
 
+static uint64_t gfx_hash(uint64_t hash, const char* text) {
+    //fnv-1a, the terminator separates consecutive strings
+    if (text == 0) text = "";
+    do {
+        hash ^= (uint8_t)*text;
+        hash *= 0x100000001b3ull;
+    } while (*text++ != 0);
+    return hash;
+}
+
+static char* gfx_shader_source_with_defines(const char* source, const char* defines) {
+    size_t source_length = strlen(source), defines_length = strlen(defines);
+    char* result = OS_MALLOC((uint32_t)(source_length + defines_length + 1));
+
+    //the version directive has to stay first
+    size_t split = 0;
+    if (strncmp(source, "#version", 8) == 0) {
+        const char* line_end = strchr(source, '\n');
+        split = line_end != 0 ? (size_t)(line_end - source) + 1 : source_length;
+    }
+    os_memcpy(result, source, (int32_t)split);
+    os_memcpy(result + split, defines, (int32_t)defines_length);
+    os_memcpy(result + split + defines_length, source + split, (int32_t)(source_length - split + 1));
+    return result;
+}
+
+gfx_shader_handle gfx_shader_acquire(const char* name, const char* vs, const char* fs, const char* defines) {
+    uint64_t hash = gfx_hash(gfx_hash(gfx_hash(0xcbf29ce484222325ull, vs), fs), defines);
+    for (int32_t i = 0; i < shader_cache_count; ++i) {
+        if (shader_cache[i].hash == hash) {
+            shader_cache[i].references++;
+            LOG("Shader %s shared with %s\n", shader_cache[i].shader->name, name);
+            return shader_cache[i].shader;
+        }
+    }
+
+    gfx_shader_handle handle = gfx_shader_create(name);
+    if (defines != 0 && defines[0] != 0) {
+        char* vs_defines = gfx_shader_source_with_defines(vs, defines);
+        char* fs_defines = gfx_shader_source_with_defines(fs, defines);
+        gfx_shader_add_vs(handle, vs_defines);
+        gfx_shader_add_fs(handle, fs_defines);
+        OS_FREE(vs_defines);
+        OS_FREE(fs_defines);
+    } else {
+        gfx_shader_add_vs(handle, vs);
+        gfx_shader_add_fs(handle, fs);
+    }
+    gfx_shader_submit(handle);
+
+    if (shader_cache_count == shader_cache_capacity) {
+        shader_cache_capacity = shader_cache_capacity > 0 ? shader_cache_capacity * 2 : 8;
+        shader_cache = OS_REALLOC(shader_cache, sizeof(gfx_shader_cache_entry) * shader_cache_capacity);
+    }
+    shader_cache[shader_cache_count].hash = hash;
+    shader_cache[shader_cache_count].references = 1;
+    shader_cache[shader_cache_count].shader = handle;
+    shader_cache_count++;
+    return handle;
+}
+
+//uniform commands are shared by name and keep no pointers into the users, so a user only drops its reference
+void gfx_shader_release(gfx_shader_handle handle) {
+    for (int32_t i = 0; i < shader_cache_count; ++i) {
+        if (shader_cache[i].shader != handle) continue;
+        if (--shader_cache[i].references == 0) {
+            shader_cache[i] = shader_cache[shader_cache_count - 1];
+            shader_cache_count--;
+            gfx_shader_destroy(handle);
+        }
+        return;
+    }
+    CORE_ASSERT(0 == 1 && "Released shader is not cached");
+}
+
+int32_t gfx_shader_cache_count() {
+    return shader_cache_count;
+}
+
 void gfx_shader_status_change_callback_set(shader_change_callback callback) {
     shader_change = callback;
 }
@@ -567,6 +738,17 @@ void gfx_buffer_destroy(gfx_buffer_handle buffer) {
     OS_FREE(buffer);
 }
 
+void gfx_buffer_bind_uniform(gfx_buffer_handle handle, int32_t binding, int32_t offset, int32_t size) {
+    CORE_ASSERT(handle->status == GFX_RESOURCE_ACTIVE && handle->type == GFX_BUFFER_UNIFORM);
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, handle->id, offset, size);
+}
+
+int32_t gfx_uniform_buffer_alignment() {
+    int32_t alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment > 0 ? alignment : 256;
+}
+
 gfx_resource_status gfx_buffer_status(gfx_buffer_handle handle) {
     return handle->status;
 }
@@ -657,6 +839,24 @@ void gfx_draw_id(gfx_draw_type type, int32_t length)
     pass->draw_calls++;
 }
 
+void gfx_draw_id_range(gfx_draw_type type, int32_t start, int32_t length)
+{
+    CORE_ASSERT(draw_pass_count != 0 && "Drawing while no draw pass is active");
+
+    gfx_draw_pass *pass = &draw_pass_array[draw_pass_count - 1];
+    glDrawElements(type, length, GL_UNSIGNED_INT, (void const*)((size_t)start * sizeof(uint32_t)));
+    pass->draw_calls++;
+}
+
+void gfx_draw_id_instanced(gfx_draw_type type, int32_t start, int32_t length, int32_t instances)
+{
+    CORE_ASSERT(draw_pass_count != 0 && "Drawing while no draw pass is active");
+
+    gfx_draw_pass *pass = &draw_pass_array[draw_pass_count - 1];
+    glDrawElementsInstanced(type, length, GL_UNSIGNED_INT, (void const*)((size_t)start * sizeof(uint32_t)), instances);
+    pass->draw_calls++;
+}
+
 void gfx_viewport_set(int32_t width, int32_t height) {
     glViewport(0, 0, width, height);
 }
@@ -699,8 +899,25 @@ void gfx_pipeline_index_enable(gfx_pipeline_handle handle, gfx_buffer_handle buf
     LOG("Pipeline EBO set %s\n", handle->shader_handle->name);
 }
 
+static void gfx_attribute_format_gl(gfx_attribute_format format, GLenum* type, GLboolean* normalized) {
+    switch (format) {
+        case GFX_ATTRIBUTE_FORMAT_HALF: *type = GL_HALF_FLOAT; *normalized = GL_FALSE; break;
+        case GFX_ATTRIBUTE_FORMAT_SNORM16: *type = GL_SHORT; *normalized = GL_TRUE; break;
+        case GFX_ATTRIBUTE_FORMAT_UNORM16: *type = GL_UNSIGNED_SHORT; *normalized = GL_TRUE; break;
+        case GFX_ATTRIBUTE_FORMAT_SNORM8: *type = GL_BYTE; *normalized = GL_TRUE; break;
+        case GFX_ATTRIBUTE_FORMAT_UNORM8: *type = GL_UNSIGNED_BYTE; *normalized = GL_TRUE; break;
+        case GFX_ATTRIBUTE_FORMAT_FLOAT:
+        default: *type = GL_FLOAT; *normalized = GL_FALSE; break;
+    }
+}
+
 void gfx_pipeline_attr_enable(gfx_pipeline_handle handle, const char* name, gfx_buffer_handle buffer,
                               int32_t count, int32_t offset, int32_t stride) {
+    gfx_pipeline_attr_enable_format(handle, name, buffer, GFX_ATTRIBUTE_FORMAT_FLOAT, count, offset, stride);
+}
+
+void gfx_pipeline_attr_enable_format(gfx_pipeline_handle handle, const char* name, gfx_buffer_handle buffer,
+                                     gfx_attribute_format format, int32_t count, int32_t offset, int32_t stride) {
 
     CORE_ASSERT(handle->status == GFX_RESOURCE_CREATED);
     CORE_ASSERT(handle != 0 && "Attribute enable failed, null handle");
@@ -711,6 +928,7 @@ void gfx_pipeline_attr_enable(gfx_pipeline_handle handle, const char* name, gfx_
 
     os_memcpy(handle->attr_commands[handle->attrs_commands_count].name, name, strlen(name) + 1);
     handle->attr_commands[handle->attrs_commands_count].buffer = buffer;
+    handle->attr_commands[handle->attrs_commands_count].format = format;
     handle->attr_commands[handle->attrs_commands_count].count = count;
     handle->attr_commands[handle->attrs_commands_count].offset = offset;
     handle->attr_commands[handle->attrs_commands_count].stride = stride;
@@ -726,7 +944,10 @@ void gfx_pipeline_attr_enable(gfx_pipeline_handle handle, const char* name, gfx_
             glUseProgram(handle->shader_handle->id);
             glBindBuffer(GL_ARRAY_BUFFER, buffer->id);
             glEnableVertexAttribArray(attr.id);
-            glVertexAttribPointer(attr.id, count, GL_FLOAT, GL_FALSE, stride,
+            GLenum type;
+            GLboolean normalized;
+            gfx_attribute_format_gl(format, &type, &normalized);
+            glVertexAttribPointer(attr.id, count, type, normalized, stride,
                                   (const void *) offset);
             glBindBuffer(GL_ARRAY_BUFFER, 0);
             glBindVertexArray(0);
@@ -742,26 +963,51 @@ void gfx_pipeline_attr_enable(gfx_pipeline_handle handle, const char* name, gfx_
 void gfx_shader_uniform_enable(gfx_shader_handle handle, const char* name, gfx_type type, int32_t* uniform_index){
 
     CORE_ASSERT(handle->status == GFX_RESOURCE_ACTIVE);
-    CORE_ASSERT(handle->uniform_commands_count != MAXIMUM_UNIFORM_COMMANDS_PER_SHADER);
-
-    os_memcpy(handle->uniform_commands[handle->uniform_commands_count].name, name, strlen(name) + 1);
-    handle->uniform_commands[handle->uniform_commands_count].type = type;
-    handle->uniform_commands[handle->uniform_commands_count].reference_index = uniform_index;
-    handle->uniform_commands_count++;
 
-    for (int32_t i = 0; i < handle->uniform_count; ++i) {
-        gfx_shader_uniform *uni = handle->uniforms + i;
-        if (strcmp(uni->name, name) == 0) {
-            CORE_ASSERT(uni->type == type);
-            *uniform_index = i;
-            LOG("Uniform enabled, shader: %s, name: %s, type:%s\n", handle->name,
-                   name, gfx_get_type_char(uni->type));
+    //programs from the cache hand the same command to every user
+    int32_t command = 0;
+    while (command < handle->uniform_commands_count && strcmp(handle->uniform_commands[command].name, name) != 0)
+        command++;
+    if (command == handle->uniform_commands_count) {
+        if (handle->uniform_commands_count == MAXIMUM_UNIFORM_COMMANDS_PER_SHADER ||
+            strlen(name) >= MAXIMUM_UNIFORM_NAME_LENGTH) {
+            LOG_ERROR("Uniform could not be enabled, shader: %s, name: %s\n", handle->name, name);
+            *uniform_index = -1;
             return;
         }
+        os_memcpy(handle->uniform_commands[command].name, name, (int32_t)strlen(name) + 1);
+        handle->uniform_commands[command].type = type;
+        handle->uniform_commands_count++;
+        gfx_shader_uniform_resolve(handle, handle->uniform_commands + command);
     }
-    *uniform_index = -1;
+    CORE_ASSERT(handle->uniform_commands[command].type == type);
+    *uniform_index = command;
 }
 
+bool gfx_shader_uniform_block_enable(gfx_shader_handle handle, const char* name, int32_t binding){
+
+    CORE_ASSERT(handle->status == GFX_RESOURCE_ACTIVE);
+
+    //programs from the cache get the same block from every user
+    int32_t command = 0;
+    while (command < handle->block_commands_count && strcmp(handle->block_commands[command].name, name) != 0)
+        command++;
+    if (command == handle->block_commands_count) {
+        CORE_ASSERT(handle->block_commands_count != MAXIMUM_UNIFORM_BLOCKS_PER_SHADER);
+        os_memcpy(handle->block_commands[command].name, name, strlen(name) + 1);
+        handle->block_commands_count++;
+    }
+    handle->block_commands[command].binding = binding;
+
+    uint32_t index = glGetUniformBlockIndex(handle->id, name);
+    if (index == GL_INVALID_INDEX) {
+        LOG("Uniform block not found, shader: %s, name: %s\n", handle->name, name);
+        return false;
+    }
+    glUniformBlockBinding(handle->id, index, binding);
+    LOG("Uniform block enabled, shader: %s, name: %s, binding: %i\n", handle->name, name, binding);
+    return true;
+}
 
 void gfx_pipeline_use_depth_buffer(gfx_pipeline_handle handle, bool value) {
     handle->disable_depth_buffer = !value;
@@ -818,8 +1064,9 @@ void gfx_pipeline_destroy(gfx_pipeline_handle handle) {
 
 void gfx_shader_uniform_set(gfx_shader_handle handle, int32_t uniform_index, void* data) {
     if(handle->status == GFX_RESOURCE_ACTIVE) {
-        if (uniform_index >= 0 && uniform_index < handle->uniform_count) {
-            struct gfx_shader_uniform uni = handle->uniforms[uniform_index];
+        if (uniform_index >= 0 && uniform_index < handle->uniform_commands_count &&
+            handle->uniform_commands[uniform_index].uniform >= 0) {
+            struct gfx_shader_uniform uni = handle->uniforms[handle->uniform_commands[uniform_index].uniform];
             if (uni.uniform_setter != 0) {
                 uni.uniform_setter(uni.id, data);
             }
@@ -1014,7 +1261,124 @@ void gfx_texture_gl_get_type(enum gfx_texture_type type, int32_t* tex_type_src,
             *tex_type_dest = GL_DEPTH_STENCIL;
             *format = GL_UNSIGNED_INT_24_8;
             break;
+        //compressed types only use the internal format
+        case GFX_TEXTURE_TYPE_BC1:
+            *tex_type_src = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            *tex_type_dest = 0;
+            *format = 0;
+            break;
+        case GFX_TEXTURE_TYPE_BC1_SRGB:
+            *tex_type_src = GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+            *tex_type_dest = 0;
+            *format = 0;
+            break;
+        case GFX_TEXTURE_TYPE_BC3:
+            *tex_type_src = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            *tex_type_dest = 0;
+            *format = 0;
+            break;
+        case GFX_TEXTURE_TYPE_BC3_SRGB:
+            *tex_type_src = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+            *tex_type_dest = 0;
+            *format = 0;
+            break;
+        case GFX_TEXTURE_TYPE_BC5:
+            *tex_type_src = GL_COMPRESSED_RG_RGTC2;
+            *tex_type_dest = 0;
+            *format = 0;
+            break;
+        case GFX_TEXTURE_TYPE_BC7:
+            *tex_type_src = GL_COMPRESSED_RGBA_BPTC_UNORM;
+            *tex_type_dest = 0;
+            *format = 0;
+            break;
+        case GFX_TEXTURE_TYPE_BC7_SRGB:
+            *tex_type_src = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+            *tex_type_dest = 0;
+            *format = 0;
+            break;
+        case GFX_TEXTURE_TYPE_RGBA32F:
+            *tex_type_src = GL_RGBA32F;
+            *tex_type_dest = GL_RGBA;
+            *format = GL_FLOAT;
+            break;
+    }
+}
+
+bool gfx_texture_type_compressed(enum gfx_texture_type type){
+    return type >= GFX_TEXTURE_TYPE_BC1 && type <= GFX_TEXTURE_TYPE_BC7_SRGB;
+}
+
+static bool gfx_extension_supported(const char* name){
+    int32_t count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int32_t i = 0; i < count; ++i) {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (extension != 0 && strcmp(extension, name) == 0)
+            return true;
     }
+    return false;
+}
+
+bool gfx_texture_type_supported(enum gfx_texture_type type){
+    static int32_t s3tc = -1, s3tc_srgb = -1, bptc = -1, rgtc = -1;
+    switch (type) {
+        case GFX_TEXTURE_TYPE_BC1:
+        case GFX_TEXTURE_TYPE_BC3:
+            if (s3tc < 0) s3tc = gfx_extension_supported("GL_EXT_texture_compression_s3tc") ||
+                                 gfx_extension_supported("WEBGL_compressed_texture_s3tc");
+            return s3tc == 1;
+        case GFX_TEXTURE_TYPE_BC1_SRGB:
+        case GFX_TEXTURE_TYPE_BC3_SRGB:
+            if (s3tc_srgb < 0) s3tc_srgb = gfx_extension_supported("GL_EXT_texture_sRGB") ||
+                                           gfx_extension_supported("GL_EXT_texture_compression_s3tc_srgb") ||
+                                           gfx_extension_supported("WEBGL_compressed_texture_s3tc_srgb");
+            return s3tc_srgb == 1;
+        case GFX_TEXTURE_TYPE_BC7:
+        case GFX_TEXTURE_TYPE_BC7_SRGB:
+            if (bptc < 0) bptc = gfx_extension_supported("GL_ARB_texture_compression_bptc") ||
+                                 gfx_extension_supported("GL_EXT_texture_compression_bptc");
+            return bptc == 1;
+        case GFX_TEXTURE_TYPE_BC5:
+            //rgtc is core since gl 3.0, webgl2 exposes it as an extension
+#ifdef __EMSCRIPTEN__
+            if (rgtc < 0) rgtc = gfx_extension_supported("EXT_texture_compression_rgtc");
+#else
+            rgtc = 1;
+#endif
+            return rgtc == 1;
+        default:
+            return true;
+    }
+}
+
+static int32_t gfx_texture_compressed_size(enum gfx_texture_type type, int32_t width, int32_t height){
+    int32_t blocks = ((width + 3) / 4) * ((height + 3) / 4);
+    return type == GFX_TEXTURE_TYPE_BC1 || type == GFX_TEXTURE_TYPE_BC1_SRGB ? blocks * 8 : blocks * 16;
+}
+
+//driver side footprint estimate, the driver may pad rgb to rgba
+static int64_t gfx_texture_level_bytes(enum gfx_texture_type type, int32_t width, int32_t height){
+    if (gfx_texture_type_compressed(type))
+        return gfx_texture_compressed_size(type, width, height);
+
+    int64_t texel;
+    switch (type) {
+        case GFX_TEXTURE_TYPE_SRGB:
+        case GFX_TEXTURE_TYPE_RGB: texel = 3; break;
+        case GFX_TEXTURE_TYPE_RGB16: texel = 6; break;
+        case GFX_TEXTURE_TYPE_STENCIL: texel = 1; break;
+        case GFX_TEXTURE_TYPE_RGBA32F: texel = 16; break;
+        default: texel = 4; break;
+    }
+    return (int64_t)width * height * texel;
+}
+
+static int64_t gfx_texture_chain_bytes(enum gfx_texture_type type, int32_t width, int32_t height, int32_t levels_count){
+    int64_t bytes = 0;
+    for (int32_t i = 0; i < levels_count; ++i)
+        bytes += gfx_texture_level_bytes(type, width >> i > 0 ? width >> i : 1, height >> i > 0 ? height >> i : 1);
+    return bytes;
 }
 
 gfx_texture_handle gfx_texture_create(int32_t width, int32_t height, void* data, enum gfx_texture_type type, enum gfx_texture_filter_mode filter, enum gfx_texture_wrap_mode wrap){
@@ -1028,7 +1392,10 @@ gfx_texture_handle gfx_texture_create(int32_t width, int32_t height, void* data,
 
     int32_t tex_type_src, tex_type_dest, format;
     gfx_texture_gl_get_type(type, &tex_type_src, &tex_type_dest, &format);
-    glTexImage2D(GL_TEXTURE_2D, 0, tex_type_src, width, height, 0, tex_type_dest, format, data);
+    if (gfx_texture_type_compressed(type))
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, tex_type_src, width, height, 0, gfx_texture_compressed_size(type, width, height), data);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, tex_type_src, width, height, 0, tex_type_dest, format, data);
 
     gfx_texture_gl_apply_filter(filter, false);
     gfx_texture_gl_apply_wrap(wrap);
@@ -1043,9 +1410,163 @@ gfx_texture_handle gfx_texture_create(int32_t width, int32_t height, void* data,
     hndl->filter = filter;
     hndl->wrap = wrap;
     hndl->type = type;
+    hndl->levels_count = 1;
+    hndl->base_level = 0;
+    hndl->bytes = gfx_texture_level_bytes(type, width, height);
+    gfx_texture_total_bytes_count += hndl->bytes;
+    return hndl;
+}
+
+//uploads levels [first, end) of the bound texture, data 0 respecifies them empty so the driver can free them
+static void gfx_texture_gl_set_levels(gfx_texture_handle handle, int32_t first, int32_t end, void const* const* levels, int32_t const* sizes){
+    int32_t tex_type_src, tex_type_dest, format;
+    gfx_texture_gl_get_type(handle->type, &tex_type_src, &tex_type_dest, &format);
+    bool compressed = gfx_texture_type_compressed(handle->type);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int32_t i = first; i < end; ++i) {
+        int32_t level_width = levels != 0 ? (handle->width >> i > 0 ? handle->width >> i : 1) : 0;
+        int32_t level_height = levels != 0 ? (handle->height >> i > 0 ? handle->height >> i : 1) : 0;
+        void const* data = levels != 0 ? levels[i - first] : 0;
+        if (compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, tex_type_src, level_width, level_height, 0, levels != 0 ? sizes[i - first] : 0, data);
+        else
+            glTexImage2D(GL_TEXTURE_2D, i, tex_type_src, level_width, level_height, 0, tex_type_dest, format, data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+gfx_texture_handle gfx_texture_create_mips(int32_t width, int32_t height, int32_t levels_count, void const* const* levels, int32_t const* sizes, enum gfx_texture_type type, enum gfx_texture_filter_mode filter, enum gfx_texture_wrap_mode wrap){
+    return gfx_texture_create_partial(width, height, 0, levels_count, levels, sizes, type, filter, wrap);
+}
+
+gfx_texture_handle gfx_texture_create_partial(int32_t width, int32_t height, int32_t base_level, int32_t levels_count, void const* const* levels, int32_t const* sizes, enum gfx_texture_type type, enum gfx_texture_filter_mode filter, enum gfx_texture_wrap_mode wrap){
+
+    LOG("Texture created, width:%i, height:%i, levels:%i-%i \n", width, height, base_level, levels_count - 1);
+
+    gfx_texture_handle hndl = OS_MALLOC(sizeof(gfx_texture));
+    hndl->width = width;
+    hndl->height = height;
+    hndl->filter = filter;
+    hndl->wrap = wrap;
+    hndl->type = type;
+    hndl->levels_count = levels_count;
+    hndl->base_level = base_level;
+
+    glGenTextures(1, &hndl->id);
+    glBindTexture(GL_TEXTURE_2D, hndl->id);
+    gfx_texture_gl_set_levels(hndl, base_level, levels_count, levels, sizes);
+
+    //partial chains are complete from the base level up to the last level
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base_level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels_count - 1);
+    gfx_texture_gl_apply_filter(filter, levels_count > 1);
+    gfx_texture_gl_apply_wrap(wrap);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    hndl->bytes = gfx_texture_chain_bytes(type, width >> base_level > 0 ? width >> base_level : 1,
+                                          height >> base_level > 0 ? height >> base_level : 1, levels_count - base_level);
+    gfx_texture_total_bytes_count += hndl->bytes;
     return hndl;
 }
 
+void gfx_texture_set_base_level(gfx_texture_handle handle, int32_t base_level, void const* const* levels, int32_t const* sizes){
+    if (handle == 0 || base_level == handle->base_level || base_level < 0 || base_level >= handle->levels_count) return;
+
+    glBindTexture(GL_TEXTURE_2D, handle->id);
+    if (base_level < handle->base_level)
+        gfx_texture_gl_set_levels(handle, base_level, handle->base_level, levels, sizes);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base_level);
+    if (base_level > handle->base_level)
+        gfx_texture_gl_set_levels(handle, handle->base_level, base_level, 0, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    gfx_texture_total_bytes_count -= handle->bytes;
+    handle->base_level = base_level;
+    handle->bytes = gfx_texture_chain_bytes(handle->type, handle->width >> base_level > 0 ? handle->width >> base_level : 1,
+                                            handle->height >> base_level > 0 ? handle->height >> base_level : 1,
+                                            handle->levels_count - base_level);
+    gfx_texture_total_bytes_count += handle->bytes;
+}
+
+void gfx_texture_update(gfx_texture_handle handle, int32_t x, int32_t y, int32_t width, int32_t height, void const* data){
+    CORE_ASSERT(!gfx_texture_type_compressed(handle->type) && "Compressed textures can not be updated");
+    CORE_ASSERT(x >= 0 && y >= 0 && x + width <= handle->width && y + height <= handle->height);
+
+    int32_t tex_type_src, tex_type_dest, format;
+    gfx_texture_gl_get_type(handle->type, &tex_type_src, &tex_type_dest, &format);
+    glBindTexture(GL_TEXTURE_2D, handle->id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, tex_type_dest, format, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void gfx_texture_generate_mips(gfx_texture_handle handle){
+    if (handle == 0 || gfx_texture_type_compressed(handle->type)) return;
+
+    int32_t levels_count = 1, size = handle->width > handle->height ? handle->width : handle->height;
+    while (size > 1) {
+        size >>= 1;
+        levels_count++;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, handle->id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels_count - 1);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    gfx_texture_gl_apply_filter(handle->filter, levels_count > 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    gfx_texture_total_bytes_count -= handle->bytes;
+    handle->levels_count = levels_count;
+    handle->bytes = gfx_texture_chain_bytes(handle->type, handle->width, handle->height, levels_count);
+    gfx_texture_total_bytes_count += handle->bytes;
+}
+
+float gfx_texture_max_anisotropy(){
+    static float max_anisotropy = -1.0f;
+    if (max_anisotropy < 0.0f) {
+        max_anisotropy = 1.0f;
+        if (gfx_extension_supported("GL_EXT_texture_filter_anisotropic") ||
+            gfx_extension_supported("GL_ARB_texture_filter_anisotropic") ||
+            gfx_extension_supported("EXT_texture_filter_anisotropic")) {
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &max_anisotropy);
+        }
+    }
+    return max_anisotropy;
+}
+
+float gfx_texture_set_anisotropy(gfx_texture_handle handle, float anisotropy){
+    float max_anisotropy = gfx_texture_max_anisotropy();
+    if (handle == 0 || max_anisotropy <= 1.0f) return 1.0f;
+
+    anisotropy = anisotropy < 1.0f ? 1.0f : anisotropy > max_anisotropy ? max_anisotropy : anisotropy;
+    glBindTexture(GL_TEXTURE_2D, handle->id);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, anisotropy);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return anisotropy;
+}
+
+int32_t gfx_texture_get_width(gfx_texture_handle handle){
+    return handle->width;
+}
+
+int32_t gfx_texture_get_height(gfx_texture_handle handle){
+    return handle->height;
+}
+
+int32_t gfx_texture_get_levels(gfx_texture_handle handle){
+    return handle->levels_count;
+}
+
+int64_t gfx_texture_get_bytes(gfx_texture_handle handle){
+    return handle->bytes;
+}
+
+int64_t gfx_texture_total_bytes(){
+    return gfx_texture_total_bytes_count;
+}
+
 gfx_texture_handle gfx_texture_load(const char* path, enum gfx_texture_type type, enum gfx_texture_filter_mode filter, enum gfx_texture_wrap_mode wrap) {
 
     int32_t width, height, channels;
@@ -1209,6 +1730,7 @@ void gfx_texture_bind(gfx_texture_handle hndl, int32_t index) {
 void gfx_texture_destroy(gfx_texture_handle hndl) {
     if(hndl == 0) return;
     glDeleteTextures(1, &(hndl->id));
+    gfx_texture_total_bytes_count -= hndl->bytes;
     OS_FREE(hndl);
     LOGG("Texture destroyed\n");
 }
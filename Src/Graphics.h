@@ -23,6 +23,7 @@
 
 #define MAXIMUM_ATTRIBUTES_PER_SHADER 8
 #define MAXIMUM_UNIFORMS_PER_SHADER 32
+#define MAXIMUM_UNIFORM_BLOCKS_PER_SHADER 8
 
 #define MAXIMUM_ATTRIBUTE_COMMANDS_PER_PIPELINE 8
 #define MAXIMUM_UNIFORM_COMMANDS_PER_SHADER 32
@@ -36,6 +37,7 @@
 typedef enum gfx_buffer_type {
     GFX_BUFFER_VERTEX,
     GFX_BUFFER_INDEX,
+    GFX_BUFFER_UNIFORM,
 } gfx_buffer_type;
 
 typedef enum gfx_type{
@@ -80,6 +82,18 @@ typedef enum gfx_buffer_update_mode {
     GFX_BUFFER_UPDATE_STREAM_COPY,
 } gfx_buffer_update_mode;
 
+/*
+ * Component storage of a vertex attribute, the normalized formats are read as floats in the shader.
+ */
+typedef enum gfx_attribute_format{
+    GFX_ATTRIBUTE_FORMAT_FLOAT,
+    GFX_ATTRIBUTE_FORMAT_HALF,
+    GFX_ATTRIBUTE_FORMAT_SNORM16,
+    GFX_ATTRIBUTE_FORMAT_UNORM16,
+    GFX_ATTRIBUTE_FORMAT_SNORM8,
+    GFX_ATTRIBUTE_FORMAT_UNORM8,
+} gfx_attribute_format;
+
 typedef enum gfx_draw_type {
     GFX_POINTS = 0x0000,
     GFX_LINES = 0x0001,
@@ -99,7 +113,15 @@ typedef enum gfx_texture_type
     GFX_TEXTURE_TYPE_RGBA,
     GFX_TEXTURE_TYPE_DEPTH,
     GFX_TEXTURE_TYPE_STENCIL,
-    GFX_TEXTURE_TYPE_DEPTH_STENCIL
+    GFX_TEXTURE_TYPE_DEPTH_STENCIL,
+    GFX_TEXTURE_TYPE_BC1,
+    GFX_TEXTURE_TYPE_BC1_SRGB,
+    GFX_TEXTURE_TYPE_BC3,
+    GFX_TEXTURE_TYPE_BC3_SRGB,
+    GFX_TEXTURE_TYPE_BC5,
+    GFX_TEXTURE_TYPE_BC7,
+    GFX_TEXTURE_TYPE_BC7_SRGB,
+    GFX_TEXTURE_TYPE_RGBA32F
 } gfx_texture_type;
 
 typedef enum gfx_texture_wrap_mode{
@@ -166,14 +188,63 @@ IBC_API void gfx_shader_fs_get(gfx_shader_handle handle, char ** ptr);
 IBC_API void gfx_shader_vs_get(gfx_shader_handle handle, char ** ptr);
 IBC_API void gfx_shader_name_get(gfx_shader_handle handle, char ** ptr);
 
+/*
+ * Program cache keyed by the hash of both stages and the defines. Identical requests share one
+ * linked program, the last release destroys it. Defines (e.g. "#define HAS_SHADOWS\n") are
+ * inserted after the #version line of both stages.
+ */
+IBC_API gfx_shader_handle gfx_shader_acquire(const char* name, const char* vs, const char* fs, const char* defines);
+IBC_API void gfx_shader_release(gfx_shader_handle handle);
+IBC_API int32_t gfx_shader_cache_count();
+
 IBC_API gfx_buffer_handle gfx_buffer_create(enum gfx_buffer_type type, enum gfx_buffer_update_mode mode, void* data, int32_t size);
 IBC_API void gfx_buffer_update(gfx_buffer_handle handle, void* data, int32_t offset, int32_t size);
 IBC_API void gfx_buffer_destroy(gfx_buffer_handle handle);
+/*
+ * Binds a range of a uniform buffer to a block binding point, offsets must be multiples of
+ * gfx_uniform_buffer_alignment.
+ */
+IBC_API void gfx_buffer_bind_uniform(gfx_buffer_handle handle, int32_t binding, int32_t offset, int32_t size);
+IBC_API int32_t gfx_uniform_buffer_alignment();
 IBC_API gfx_resource_status gfx_buffer_status(gfx_buffer_handle handle);
 
 IBC_API gfx_texture_handle gfx_texture_load(const char* path, enum gfx_texture_type type, enum gfx_texture_filter_mode filter, enum gfx_texture_wrap_mode wrap);
 IBC_API gfx_texture_handle gfx_texture_load_hdr(const char* path, enum gfx_texture_filter_mode filter, enum gfx_texture_wrap_mode wrap);
 IBC_API gfx_texture_handle gfx_texture_create(int32_t width, int32_t height, void* data, enum gfx_texture_type type, enum gfx_texture_filter_mode filter, enum gfx_texture_wrap_mode wrap);
+/*
+ * Uploads a prebuilt mip chain, levels[0] is the full size image. Block compressed types take
+ * the byte size of every level, uncompressed types ignore sizes.
+ */
+IBC_API gfx_texture_handle gfx_texture_create_mips(int32_t width, int32_t height, int32_t levels_count, void const* const* levels, int32_t const* sizes, enum gfx_texture_type type, enum gfx_texture_filter_mode filter, enum gfx_texture_wrap_mode wrap);
+/*
+ * Chain of a width x height texture with only the levels from base_level on uploaded, levels[0] is
+ * base_level. Sampling starts at the base level, gfx_texture_set_base_level moves it later.
+ */
+IBC_API gfx_texture_handle gfx_texture_create_partial(int32_t width, int32_t height, int32_t base_level, int32_t levels_count, void const* const* levels, int32_t const* sizes, enum gfx_texture_type type, enum gfx_texture_filter_mode filter, enum gfx_texture_wrap_mode wrap);
+/*
+ * A finer base level uploads only the levels from base_level up to the old base, levels[0] is base_level.
+ * A coarser one releases the levels before it, levels is not read then. The other levels stay as they are.
+ */
+IBC_API void gfx_texture_set_base_level(gfx_texture_handle handle, int32_t base_level, void const* const* levels, int32_t const* sizes);
+/*
+ * Builds the full mip chain of level 0 on the gpu and switches to trilinear filtering.
+ */
+IBC_API void gfx_texture_generate_mips(gfx_texture_handle handle);
+//replaces a region of level 0, data is laid out like the texture type
+IBC_API void gfx_texture_update(gfx_texture_handle handle, int32_t x, int32_t y, int32_t width, int32_t height, void const* data);
+//returns the applied value, 1 when anisotropic filtering is not available
+IBC_API float gfx_texture_set_anisotropy(gfx_texture_handle handle, float anisotropy);
+IBC_API float gfx_texture_max_anisotropy();
+IBC_API int32_t gfx_texture_get_width(gfx_texture_handle handle);
+IBC_API int32_t gfx_texture_get_height(gfx_texture_handle handle);
+IBC_API int32_t gfx_texture_get_levels(gfx_texture_handle handle);
+//estimated gpu memory of all levels
+IBC_API int64_t gfx_texture_get_bytes(gfx_texture_handle handle);
+//all live 2d textures, render targets included
+IBC_API int64_t gfx_texture_total_bytes();
+IBC_API bool gfx_texture_type_compressed(enum gfx_texture_type type);
+//bc formats need s3tc/rgtc/bptc, missing on webgl and some mobile drivers
+IBC_API bool gfx_texture_type_supported(enum gfx_texture_type type);
 IBC_API int32_t gfx_texture_get_id(gfx_texture_handle handle);
 IBC_API void gfx_texture_bind(gfx_texture_handle handle, int32_t slot);
 IBC_API void gfx_texture_destroy(gfx_texture_handle handle);
@@ -192,6 +263,8 @@ IBC_API void gfx_viewport_set(int32_t width, int32_t height);
 
 IBC_API void gfx_draw(enum gfx_draw_type type, int32_t start, int32_t length);
 IBC_API void gfx_draw_id(enum gfx_draw_type type, int32_t length);
+IBC_API void gfx_draw_id_range(enum gfx_draw_type type, int32_t start, int32_t length);
+IBC_API void gfx_draw_id_instanced(enum gfx_draw_type type, int32_t start, int32_t length, int32_t instances);
 
 IBC_API void gfx_blend(enum gfx_blend_type src, enum gfx_blend_type dest);
 IBC_API void gfx_blend_enable(bool state);
@@ -202,6 +275,7 @@ IBC_API void gfx_wireframe_enable(bool state);
 IBC_API gfx_pipeline_handle gfx_pipeline_create(gfx_shader_handle handle);
 IBC_API void gfx_pipeline_index_enable(gfx_pipeline_handle handle, gfx_buffer_handle buffer);
 IBC_API void gfx_pipeline_attr_enable(gfx_pipeline_handle handle, const char* name, gfx_buffer_handle buffer, int32_t count, int32_t offset, int32_t stride);
+IBC_API void gfx_pipeline_attr_enable_format(gfx_pipeline_handle handle, const char* name, gfx_buffer_handle buffer, gfx_attribute_format format, int32_t count, int32_t offset, int32_t stride);
 IBC_API void gfx_pipeline_submit(gfx_pipeline_handle handle);
 IBC_API void gfx_pipeline_bind(gfx_pipeline_handle handle);
 IBC_API void gfx_pipeline_reload(gfx_pipeline_handle handle);
@@ -210,6 +284,10 @@ IBC_API void gfx_pipeline_use_depth_buffer(gfx_pipeline_handle handle, bool valu
 
 IBC_API void gfx_shader_uniform_enable(gfx_shader_handle handle, const char* name, gfx_type type, int32_t* uniform_index);
 IBC_API void gfx_shader_uniform_set(gfx_shader_handle handle, int32_t uniform_index, void* data);
+//connects a uniform block to a binding point, kept across shader reloads
+IBC_API bool gfx_shader_uniform_block_enable(gfx_shader_handle handle, const char* name, int32_t binding);
+//makes the program current so uniforms can be set without binding a pipeline
+IBC_API void gfx_shader_bind(gfx_shader_handle handle);
 
 IBC_API gfx_framebuffer_handle gfx_framebuffer_create(gfx_texture_handle color_texture, gfx_texture_handle depth_texture);
 IBC_API void gfx_framebuffer_destroy(gfx_framebuffer_handle handle);
@@ -31,10 +31,8 @@ void ground_renderer_init(ground_renderer* gr)
 
     void* vs = device_file_read_text("./Shaders/Lit.vs");
     void* fs = device_file_read_text("./Shaders/Lit.fs");
-    gr->shader = gfx_shader_create("Ground");
-    gfx_shader_add_vs(gr->shader, vs);
-    gfx_shader_add_fs(gr->shader, fs);
-    gfx_shader_submit(gr->shader);
+    //same sources as the scene materials, the program comes from the cache
+    gr->shader = gfx_shader_acquire("Ground", vs, fs, 0);
     OS_FREE(vs);
     OS_FREE(fs);
 
@@ -46,46 +44,34 @@ void ground_renderer_init(ground_renderer* gr)
     gfx_pipeline_index_enable(gr->pipeline, gr->ibuf);
     gfx_pipeline_submit(gr->pipeline);
 
-    gfx_shader_uniform_enable(gr->shader, MODEL_TRANSFORM_NAME,      GFX_TYPE_FLOAT_MAT_4, &gr->model_u);
-    gfx_shader_uniform_enable(gr->shader, PROJECTION_TRANSFORM_NAME, GFX_TYPE_FLOAT_MAT_4, &gr->proj_u);
-    gfx_shader_uniform_enable(gr->shader, VIEW_TRANSFORM_NAME,       GFX_TYPE_FLOAT_MAT_4, &gr->view_u);
-    gfx_shader_uniform_enable(gr->shader, VIEW_POSITION_NAME,        GFX_TYPE_FLOAT_VEC_3, &gr->viewpos_u);
-    gfx_shader_uniform_enable(gr->shader, "roughness",               GFX_TYPE_FLOAT_VEC_1, &gr->roughness_u);
-    gfx_shader_uniform_enable(gr->shader, "metallic",                GFX_TYPE_FLOAT_VEC_1, &gr->metallic_u);
-    gfx_shader_uniform_enable(gr->shader, "base_color",              GFX_TYPE_FLOAT_VEC_3, &gr->color_u);
-    gfx_shader_uniform_enable(gr->shader, "skybox",                  GFX_TYPE_SAMPLER_CUBE, &gr->skybox_u);
-    gfx_shader_uniform_enable(gr->shader, "exposure",                GFX_TYPE_FLOAT_VEC_1, &gr->exposure_u);
-    gfx_shader_uniform_enable(gr->shader, "shadow_map",              GFX_TYPE_SAMPLER_2D,  &gr->shadowmap_u);
-    gfx_shader_uniform_enable(gr->shader, "light_space",             GFX_TYPE_FLOAT_MAT_4, &gr->lightspace_u);
-    gfx_shader_uniform_enable(gr->shader, "brdf_lut",                GFX_TYPE_SAMPLER_2D,  &gr->brdf_lut_u);
-    gfx_shader_uniform_enable(gr->shader, "prefiltered_env",         GFX_TYPE_SAMPLER_CUBE, &gr->prefiltered_env_u);
+    gfx_shader_uniform_enable(gr->shader, INSTANCE_OFFSET_NAME, GFX_TYPE_INTEGER_VEC_1, &gr->instance_offset_u);
+    gfx_shader_uniform_enable(gr->shader, "material_index",     GFX_TYPE_INTEGER_VEC_1, &gr->material_index_u);
+    gfx_shader_uniform_enable(gr->shader, "has_vertex_color",   GFX_TYPE_INTEGER_VEC_1, &gr->has_vertex_color_u);
+    gfx_shader_uniform_block_enable(gr->shader, FRAME_BLOCK_NAME, FRAME_BLOCK_BINDING);
+    gfx_shader_uniform_block_enable(gr->shader, MATERIAL_BLOCK_NAME, MATERIAL_BLOCK_BINDING);
+
+    /* Single material at index 0: color, roughness 0.92, metallic 0, no texture */
+    lit_material_block* block = OS_MALLOC(sizeof(lit_material_block));
+    os_memset(block, 0, sizeof(lit_material_block));
+    block->color[0][0] = 0.50f;
+    block->color[0][1] = 0.50f;
+    block->color[0][2] = 0.48f;
+    block->color[0][3] = 1.0f;
+    block->params[0][0] = 0.92f;
+    gr->material_buf = gfx_buffer_create(GFX_BUFFER_UNIFORM, GFX_BUFFER_UPDATE_STATIC_DRAW, block, sizeof(lit_material_block));
+    OS_FREE(block);
 }
 
-void ground_renderer_render(ground_renderer* gr,
-                             float projection[16], float view[16], float view_pos[3],
-                             int32_t skybox_unit, float exposure,
-                             int32_t shadow_unit, float light_space[16],
-                             int32_t brdf_unit, int32_t prefilter_unit)
+void ground_renderer_render(ground_renderer* gr, int32_t instance_offset)
 {
-    static const float color[3]    = {0.50f, 0.50f, 0.48f};
-    static       float roughness   = 0.92f;
-    static       float metallic    = 0.0f;
-    gl_mat model = gl_mat_new_identity();
+    int32_t material_index = 0;
+    int32_t has_vertex_color = 0;
 
     gfx_pipeline_bind(gr->pipeline);
-    gfx_shader_uniform_set(gr->shader, gr->model_u,      model.data);
-    gfx_shader_uniform_set(gr->shader, gr->proj_u,       projection);
-    gfx_shader_uniform_set(gr->shader, gr->view_u,       view);
-    gfx_shader_uniform_set(gr->shader, gr->viewpos_u,    view_pos);
-    gfx_shader_uniform_set(gr->shader, gr->roughness_u,  &roughness);
-    gfx_shader_uniform_set(gr->shader, gr->metallic_u,   &metallic);
-    gfx_shader_uniform_set(gr->shader, gr->color_u,      (float*)color);
-    gfx_shader_uniform_set(gr->shader, gr->skybox_u,     &skybox_unit);
-    gfx_shader_uniform_set(gr->shader, gr->exposure_u,   &exposure);
-    gfx_shader_uniform_set(gr->shader, gr->shadowmap_u,  &shadow_unit);
-    gfx_shader_uniform_set(gr->shader, gr->lightspace_u, light_space);
-    gfx_shader_uniform_set(gr->shader, gr->brdf_lut_u,          &brdf_unit);
-    gfx_shader_uniform_set(gr->shader, gr->prefiltered_env_u,   &prefilter_unit);
+    gfx_buffer_bind_uniform(gr->material_buf, MATERIAL_BLOCK_BINDING, 0, sizeof(lit_material_block));
+    gfx_shader_uniform_set(gr->shader, gr->instance_offset_u,  &instance_offset);
+    gfx_shader_uniform_set(gr->shader, gr->material_index_u,   &material_index);
+    gfx_shader_uniform_set(gr->shader, gr->has_vertex_color_u, &has_vertex_color);
     gfx_draw_id(GFX_TRIANGLES, 6);
 }
 
@@ -94,5 +80,6 @@ void ground_renderer_destroy(ground_renderer* gr)
     gfx_pipeline_destroy(gr->pipeline);
     gfx_buffer_destroy(gr->vbuf);
     gfx_buffer_destroy(gr->ibuf);
-    gfx_shader_destroy(gr->shader);
+    gfx_buffer_destroy(gr->material_buf);
+    gfx_shader_release(gr->shader);
 }
@@ -15,26 +15,20 @@ typedef struct {
     gfx_pipeline_handle pipeline;
     gfx_buffer_handle   vbuf;
     gfx_buffer_handle   ibuf;
+    gfx_buffer_handle   material_buf;
 
-    int32_t model_u, proj_u, view_u, viewpos_u;
-    int32_t roughness_u, metallic_u, color_u;
-    int32_t skybox_u, exposure_u, shadowmap_u, lightspace_u, brdf_lut_u, prefiltered_env_u;
+    int32_t instance_offset_u, material_index_u, has_vertex_color_u;
 } ground_renderer;
 
 /* Allocate GPU resources (20×20 quad + Lit shader). */
 void ground_renderer_init(ground_renderer* gr);
 
-/* Draw the ground plane with current view/light state. */
-void ground_renderer_render(ground_renderer* gr,
-                             float projection[16],
-                             float view[16],
-                             float view_pos[3],
-                             int32_t skybox_unit,
-                             float   exposure,
-                             int32_t shadow_unit,
-                             float   light_space[16],
-                             int32_t brdf_unit,
-                             int32_t prefilter_unit);
+/*
+ * Draw the ground plane inside the scene Lit pass. The program is shared with the scene,
+ * so the frame block, sampler units and bound textures of that pass are reused.
+ * instance_offset is the slot of the scene instance texture holding the identity transform.
+ */
+void ground_renderer_render(ground_renderer* gr, int32_t instance_offset);
 
 /* Free all GPU resources. */
 void ground_renderer_destroy(ground_renderer* gr);
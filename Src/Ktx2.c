@@ -0,0 +1,161 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "Ktx2.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Allocator.h"
+
+#define KTX2_HEADER_SIZE 80
+#define KTX2_LEVEL_SIZE 24
+
+//vulkan formats
+#define KTX2_VK_R8G8B8A8_UNORM 37
+#define KTX2_VK_R8G8B8A8_SRGB 43
+#define KTX2_VK_BC1_RGB_UNORM 131
+#define KTX2_VK_BC1_RGB_SRGB 132
+#define KTX2_VK_BC1_RGBA_UNORM 133
+#define KTX2_VK_BC1_RGBA_SRGB 134
+#define KTX2_VK_BC3_UNORM 137
+#define KTX2_VK_BC3_SRGB 138
+#define KTX2_VK_BC5_UNORM 141
+#define KTX2_VK_BC7_UNORM 145
+#define KTX2_VK_BC7_SRGB 146
+
+static const uint8_t ktx2_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+static uint32_t ktx2_read_u32(uint8_t const* ptr)
+{
+    return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static uint64_t ktx2_read_u64(uint8_t const* ptr)
+{
+    return (uint64_t)ktx2_read_u32(ptr) | ((uint64_t)ktx2_read_u32(ptr + 4) << 32);
+}
+
+static bool ktx2_format(uint32_t vk_format, mdl_texture_format* format, bool* srgb)
+{
+    switch (vk_format) {
+        case KTX2_VK_R8G8B8A8_UNORM: *format = MDL_TEXTURE_FORMAT_RGBA8; *srgb = false; return true;
+        case KTX2_VK_R8G8B8A8_SRGB: *format = MDL_TEXTURE_FORMAT_RGBA8; *srgb = true; return true;
+        case KTX2_VK_BC1_RGB_UNORM:
+        case KTX2_VK_BC1_RGBA_UNORM: *format = MDL_TEXTURE_FORMAT_BC1; *srgb = false; return true;
+        case KTX2_VK_BC1_RGB_SRGB:
+        case KTX2_VK_BC1_RGBA_SRGB: *format = MDL_TEXTURE_FORMAT_BC1; *srgb = true; return true;
+        case KTX2_VK_BC3_UNORM: *format = MDL_TEXTURE_FORMAT_BC3; *srgb = false; return true;
+        case KTX2_VK_BC3_SRGB: *format = MDL_TEXTURE_FORMAT_BC3; *srgb = true; return true;
+        case KTX2_VK_BC5_UNORM: *format = MDL_TEXTURE_FORMAT_BC5; *srgb = false; return true;
+        case KTX2_VK_BC7_UNORM: *format = MDL_TEXTURE_FORMAT_BC7; *srgb = false; return true;
+        case KTX2_VK_BC7_SRGB: *format = MDL_TEXTURE_FORMAT_BC7; *srgb = true; return true;
+        default: return false;
+    }
+}
+
+static uint64_t ktx2_level_bytes(mdl_texture_format format, int32_t width, int32_t height)
+{
+    uint64_t blocks = (uint64_t)((width + 3) / 4) * (uint64_t)((height + 3) / 4);
+    switch (format) {
+        case MDL_TEXTURE_FORMAT_RGBA8: return (uint64_t)width * (uint64_t)height * 4;
+        case MDL_TEXTURE_FORMAT_BC1: return blocks * 8;
+        default: return blocks * 16;
+    }
+}
+
+bool ktx2_is_ktx2(void const* data, uint64_t size)
+{
+    return data != 0 && size >= sizeof(ktx2_identifier) && memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) == 0;
+}
+
+bool ktx2_parse(void const* data, uint64_t size, ktx2_image* image)
+{
+    os_memset(image, 0, sizeof(ktx2_image));
+    uint8_t const* bytes = data;
+
+    if (!ktx2_is_ktx2(data, size) || size < KTX2_HEADER_SIZE) {
+        fprintf(stderr, "- - Not a ktx2 file\n");
+        return false;
+    }
+
+    uint32_t vk_format = ktx2_read_u32(bytes + 12);
+    uint32_t width = ktx2_read_u32(bytes + 20);
+    uint32_t height = ktx2_read_u32(bytes + 24);
+    uint32_t depth = ktx2_read_u32(bytes + 28);
+    uint32_t layers = ktx2_read_u32(bytes + 32);
+    uint32_t faces = ktx2_read_u32(bytes + 36);
+    uint32_t levels = ktx2_read_u32(bytes + 40);
+    uint32_t supercompression = ktx2_read_u32(bytes + 44);
+
+    if (supercompression != 0) {
+        fprintf(stderr, "- - Ktx2 supercompression %u is not supported\n", supercompression);
+        return false;
+    }
+    if (depth > 1 || layers > 1 || faces != 1 || width == 0 || height == 0 || width > 65536 || height > 65536) {
+        fprintf(stderr, "- - Only 2d ktx2 textures are supported\n");
+        return false;
+    }
+    if (!ktx2_format(vk_format, &image->format, &image->srgb)) {
+        fprintf(stderr, "- - Ktx2 vulkan format %u is not supported\n", vk_format);
+        return false;
+    }
+
+    //zero levels asks the loader to generate mips, only the base level is stored
+    if (levels == 0) levels = 1;
+    if (levels > MDL_MAXIMUM_TEXTURE_LEVELS || size < KTX2_HEADER_SIZE + (uint64_t)levels * KTX2_LEVEL_SIZE) {
+        fprintf(stderr, "- - Ktx2 level index is invalid\n");
+        return false;
+    }
+
+    image->width = (int32_t)width;
+    image->height = (int32_t)height;
+    image->levels_count = (int32_t)levels;
+
+    for (uint32_t i = 0; i < levels; ++i) {
+        uint8_t const* entry = bytes + KTX2_HEADER_SIZE + i * KTX2_LEVEL_SIZE;
+        uint64_t offset = ktx2_read_u64(entry);
+        uint64_t length = ktx2_read_u64(entry + 8);
+        int32_t level_width = (int32_t)(width >> i) > 0 ? (int32_t)(width >> i) : 1;
+        int32_t level_height = (int32_t)(height >> i) > 0 ? (int32_t)(height >> i) : 1;
+
+        if (offset > size || length > size - offset || length < ktx2_level_bytes(image->format, level_width, level_height)) {
+            fprintf(stderr, "- - Ktx2 level %u is truncated\n", i);
+            return false;
+        }
+        image->levels[i] = bytes + offset;
+        image->level_sizes[i] = (uint32_t)ktx2_level_bytes(image->format, level_width, level_height);
+    }
+    return true;
+}
+
+bool ktx2_load_texture(void const* data, uint64_t size, mdl_texture* texture)
+{
+    ktx2_image image;
+    if (!ktx2_parse(data, size, &image))
+        return false;
+
+    uint32_t total = 0;
+    for (int32_t i = 0; i < image.levels_count; ++i) {
+        texture->level_offsets[i] = total;
+        texture->level_sizes[i] = image.level_sizes[i];
+        total += image.level_sizes[i];
+    }
+
+    texture->buffer = OS_MALLOC(total);
+    for (int32_t i = 0; i < image.levels_count; ++i)
+        os_memcpy((uint8_t*)texture->buffer + texture->level_offsets[i], image.levels[i], (int32_t)image.level_sizes[i]);
+
+    texture->size = (int32_t)total;
+    texture->width = image.width;
+    texture->height = image.height;
+    texture->channels = 4;
+    texture->format = image.format;
+    texture->srgb = image.srgb;
+    texture->levels_count = image.levels_count;
+    texture->valid = true;
+    return true;
+}
@@ -0,0 +1,48 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_KTX2_H
+#define IBCWEB_KTX2_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Model.h"
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+/*
+ * Khronos KTX2 texture container.
+ * Only plain 2d textures are read: bc1, bc3, bc5, bc7 and rgba8 vulkan formats with their mip chain,
+ * no supercompression (basis universal or zstd), no arrays, cubemaps or 3d textures.
+ */
+
+typedef struct ktx2_image{
+    mdl_texture_format format;
+    bool srgb;
+    int32_t width;
+    int32_t height;
+    int32_t levels_count;
+    uint8_t const* levels[MDL_MAXIMUM_TEXTURE_LEVELS];
+    uint32_t level_sizes[MDL_MAXIMUM_TEXTURE_LEVELS];
+} ktx2_image;
+
+IBC_API bool ktx2_is_ktx2(void const* data, uint64_t size);
+
+/*
+ * Validates the container, level pointers point into data.
+ */
+IBC_API bool ktx2_parse(void const* data, uint64_t size, ktx2_image* image);
+
+/*
+ * Parses and copies every level into an owned texture buffer.
+ */
+IBC_API bool ktx2_load_texture(void const* data, uint64_t size, mdl_texture* texture);
+
+#endif //IBCWEB_KTX2_H
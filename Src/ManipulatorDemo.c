@@ -27,7 +27,7 @@ static const float GRIP_CLOSED   = -0.031f;
 static const float GRIP_DELTA    = 0.055f;
 
 /* Ordered to match saved[] index → node pointer mapping in helpers */
-static const char* const NODE_NAMES[MANIPULATOR_NODE_COUNT] = {
+const char* const manipulator_demo_node_names[MANIPULATOR_NODE_COUNT] = {
     "NAUO2",      /* [0] carriage_x   */
     "NAUO2.001",  /* [1] lift_y       */
     "NAUO1.003",  /* [2] wrist        */
@@ -58,6 +58,56 @@ static scene_node* node_at(manipulator_demo* demo, int idx)
     return NULL;
 }
 
+/* Rig index of the node, its ancestors are added first; -1 when the rig is full. */
+static int rig_add(manipulator_demo* demo, scene_node* node)
+{
+    for (int i = 0; i < demo->rig_count; ++i)
+        if (demo->rig[i].node.internal == node->internal) return i;
+
+    int parent = -1;
+    scene_node parent_node;
+    if (scene_node_get_parent(demo->scene, node, &parent_node)) {
+        parent = rig_add(demo, &parent_node);
+        if (parent < 0) return -1;
+    }
+    if (demo->rig_count == MANIPULATOR_RIG_CAPACITY) {
+        fprintf(stderr, "ManipulatorDemo: node '%s' does not fit the rig\n", node->name ? node->name : "");
+        return -1;
+    }
+
+    manipulator_rig_node* rig = demo->rig + demo->rig_count;
+    rig->node   = *node;
+    rig->parent = parent;
+    scene_node_get_local_tr(demo->scene, node, rig->local_tr);
+    return demo->rig_count++;
+}
+
+static gl_mat rig_local(manipulator_demo* demo, int idx)
+{
+    return gl_mat_new_array(demo->rig[idx].local_tr);
+}
+
+static void rig_set_local(manipulator_demo* demo, int idx, gl_mat tr)
+{
+    memcpy(demo->rig[idx].local_tr, tr.data, sizeof(tr.data));
+}
+
+static gl_mat rig_world(manipulator_demo* demo, int idx)
+{
+    gl_mat world = rig_local(demo, idx);
+    for (int p = demo->rig[idx].parent; p != -1; p = demo->rig[p].parent)
+        world = gl_mat_mul(rig_local(demo, p), world);
+    return world;
+}
+
+static void rig_set_world(manipulator_demo* demo, int idx, gl_mat tr)
+{
+    int parent = demo->rig[idx].parent;
+    if (parent != -1)
+        tr = gl_mat_mul(gl_mat_inverse(rig_world(demo, parent)), tr);
+    rig_set_local(demo, idx, tr);
+}
+
 /* ---- Public API ---- */
 
 bool manipulator_demo_init(manipulator_demo* demo, scene_handle scene)
@@ -65,19 +115,24 @@ bool manipulator_demo_init(manipulator_demo* demo, scene_handle scene)
     memset(demo, 0, sizeof(*demo));
     demo->scene = scene;
 
-    if (!resolve_node(scene, NODE_NAMES[0], &demo->carriage_x))  return false;
-    if (!resolve_node(scene, NODE_NAMES[1], &demo->lift_y))       return false;
-    if (!resolve_node(scene, NODE_NAMES[2], &demo->wrist))        return false;
-    if (!resolve_node(scene, NODE_NAMES[3], &demo->finger_left))  return false;
-    if (!resolve_node(scene, NODE_NAMES[4], &demo->finger_right)) return false;
+    if (!resolve_node(scene, manipulator_demo_node_names[0], &demo->carriage_x))  return false;
+    if (!resolve_node(scene, manipulator_demo_node_names[1], &demo->lift_y))       return false;
+    if (!resolve_node(scene, manipulator_demo_node_names[2], &demo->wrist))        return false;
+    if (!resolve_node(scene, manipulator_demo_node_names[3], &demo->finger_left))  return false;
+    if (!resolve_node(scene, manipulator_demo_node_names[4], &demo->finger_right)) return false;
 
     /* Capture initial local transforms for reset */
     for (int i = 0; i < MANIPULATOR_NODE_COUNT; ++i) {
-        demo->saved[i].node_name = NODE_NAMES[i];
+        demo->saved[i].node_name = manipulator_demo_node_names[i];
         scene_node_get_local_tr(scene, node_at(demo, i), demo->saved[i].local_tr);
     }
     demo->transforms_captured = true;
 
+    for (int i = 0; i < MANIPULATOR_NODE_COUNT; ++i) {
+        demo->rig_index[i] = rig_add(demo, node_at(demo, i));
+        if (demo->rig_index[i] < 0) return false;
+    }
+
     demo->x_target    =  X_RAIL_EXTENT;
     demo->lift_target =  LIFT_TOP;
     demo->wrist_angle =  0.0f;
@@ -90,7 +145,7 @@ void manipulator_demo_reset(manipulator_demo* demo)
     if (!demo->transforms_captured) return;
 
     for (int i = 0; i < MANIPULATOR_NODE_COUNT; ++i)
-        scene_node_set_local_tr(demo->scene, node_at(demo, i), demo->saved[i].local_tr);
+        memcpy(demo->rig[demo->rig_index[i]].local_tr, demo->saved[i].local_tr, sizeof(demo->saved[i].local_tr));
 
     demo->x_target       =  X_RAIL_EXTENT;
     demo->lift_target    =  LIFT_TOP;
@@ -169,8 +224,7 @@ bool manipulator_demo_update(manipulator_demo* demo, float dt)
 
     /* Carriage X */
     {
-        gl_mat tr;
-        scene_node_get_world_tr(demo->scene, &demo->carriage_x, tr.data);
+        gl_mat tr = rig_world(demo, demo->rig_index[0]);
         gl_vec3 pos   = gl_mat_get_translation(tr);
         float   delta = demo->x_target - pos.x;
 
@@ -179,7 +233,7 @@ bool manipulator_demo_update(manipulator_demo* demo, float dt)
             float new_x = gl_clamp(pos.x + X_SPEED * dt * dir, -X_RAIL_EXTENT, X_RAIL_EXTENT);
             if (gl_abs(new_x - pos.x) > eps) {
                 tr = gl_mat_set_translation(tr, gl_vec3_new(new_x, pos.y, pos.z));
-                scene_node_set_world_tr(demo->scene, &demo->carriage_x, tr.data);
+                rig_set_world(demo, demo->rig_index[0], tr);
                 dirty = true;
             }
         }
@@ -187,8 +241,7 @@ bool manipulator_demo_update(manipulator_demo* demo, float dt)
 
     /* Lift Y */
     {
-        gl_mat tr;
-        scene_node_get_world_tr(demo->scene, &demo->lift_y, tr.data);
+        gl_mat tr = rig_world(demo, demo->rig_index[1]);
         gl_vec3 pos   = gl_mat_get_translation(tr);
         float   delta = demo->lift_target - pos.y;
 
@@ -197,7 +250,7 @@ bool manipulator_demo_update(manipulator_demo* demo, float dt)
             float new_y = gl_clamp(pos.y + LIFT_SPEED * dt * dir, LIFT_BOTTOM, LIFT_TOP);
             if (gl_abs(new_y - pos.y) > eps) {
                 tr = gl_mat_set_translation(tr, gl_vec3_new(pos.x, new_y, pos.z));
-                scene_node_set_world_tr(demo->scene, &demo->lift_y, tr.data);
+                rig_set_world(demo, demo->rig_index[1], tr);
                 dirty = true;
             }
         }
@@ -205,8 +258,7 @@ bool manipulator_demo_update(manipulator_demo* demo, float dt)
 
     /* Wrist rotation */
     {
-        gl_mat tr;
-        scene_node_get_world_tr(demo->scene, &demo->wrist, tr.data);
+        gl_mat tr = rig_world(demo, demo->rig_index[2]);
 
         if (demo->has_rot_target) {
             float delta = demo->rot_target - demo->wrist_angle;
@@ -216,7 +268,7 @@ bool manipulator_demo_update(manipulator_demo* demo, float dt)
                 demo->wrist_angle  = gl_clamp(demo->wrist_angle, -WRIST_LIMIT, WRIST_LIMIT);
                 gl_vec3 cur_pos = gl_mat_get_translation(tr);
                 gl_mat  new_tr  = gl_mat_set_translation(gl_mat_rotate_y(demo->wrist_angle), cur_pos);
-                scene_node_set_world_tr(demo->scene, &demo->wrist, new_tr.data);
+                rig_set_world(demo, demo->rig_index[2], new_tr);
                 dirty = true;
             }
         } else if (gl_abs(demo->wrist_rot_dir) > eps) {
@@ -224,16 +276,15 @@ bool manipulator_demo_update(manipulator_demo* demo, float dt)
             demo->wrist_angle  = gl_clamp(demo->wrist_angle, -WRIST_LIMIT, WRIST_LIMIT);
             gl_vec3 cur_pos = gl_mat_get_translation(tr);
             gl_mat  new_tr  = gl_mat_set_translation(gl_mat_rotate_y(demo->wrist_angle), cur_pos);
-            scene_node_set_world_tr(demo->scene, &demo->wrist, new_tr.data);
+            rig_set_world(demo, demo->rig_index[2], new_tr);
             dirty = true;
         }
     }
 
     /* Gripper fingers */
     if (demo->close_gripper || demo->open_gripper) {
-        gl_mat tr1, tr2;
-        scene_node_get_local_tr(demo->scene, &demo->finger_left,  tr1.data);
-        scene_node_get_local_tr(demo->scene, &demo->finger_right, tr2.data);
+        gl_mat tr1 = rig_local(demo, demo->rig_index[3]);
+        gl_mat tr2 = rig_local(demo, demo->rig_index[4]);
         gl_vec3 p1 = gl_mat_get_translation(tr1);
         gl_vec3 p2 = gl_mat_get_translation(tr2);
         float   dz = GRIP_SPEED * dt;
@@ -247,16 +298,26 @@ bool manipulator_demo_update(manipulator_demo* demo, float dt)
             p2.z = gl_clamp(p2.z + dz, GRIP_CLOSED, GRIP_CLOSED + GRIP_DELTA);
         }
 
-        scene_node_set_local_tr(demo->scene, &demo->finger_left,
-                                gl_mat_set_translation(tr1, p1).data);
-        scene_node_set_local_tr(demo->scene, &demo->finger_right,
-                                gl_mat_set_translation(tr2, p2).data);
+        rig_set_local(demo, demo->rig_index[3], gl_mat_set_translation(tr1, p1));
+        rig_set_local(demo, demo->rig_index[4], gl_mat_set_translation(tr2, p2));
         dirty = true;
     }
 
     return dirty;
 }
 
+void manipulator_demo_get_local_trs(manipulator_demo const* demo, float* local_trs)
+{
+    for (int i = 0; i < MANIPULATOR_NODE_COUNT; ++i)
+        memcpy(local_trs + i * 16, demo->rig[demo->rig_index[i]].local_tr, sizeof(float) * 16);
+}
+
+void manipulator_demo_apply(manipulator_demo* demo, float const* local_trs)
+{
+    for (int i = 0; i < MANIPULATOR_NODE_COUNT; ++i)
+        scene_node_set_local_tr(demo->scene, node_at(demo, i), (float*)(local_trs + i * 16));
+}
+
 /* ---- ImGui UI ---- */
 
 void manipulator_demo_draw_ui(manipulator_demo* demo)
@@ -11,12 +11,20 @@
 #include "Scene.h"
 
 #define MANIPULATOR_NODE_COUNT 5
+#define MANIPULATOR_RIG_CAPACITY 32
 
 typedef struct {
     const char* node_name;
     float       local_tr[16];
 } manipulator_saved_tr;
 
+/* Private copy of a moved node or one of its ancestors, the simulation never touches the scene. */
+typedef struct {
+    scene_node node;
+    int        parent;          /* rig index, -1 above a scene root   */
+    float      local_tr[16];
+} manipulator_rig_node;
+
 typedef struct manipulator_demo {
     scene_handle scene;
 
@@ -41,6 +49,11 @@ typedef struct manipulator_demo {
     manipulator_saved_tr saved[MANIPULATOR_NODE_COUNT];
     bool  transforms_captured;
 
+    /* Simulated transforms, parents before their children */
+    manipulator_rig_node rig[MANIPULATOR_RIG_CAPACITY];
+    int   rig_count;
+    int   rig_index[MANIPULATOR_NODE_COUNT];
+
     /* Autoplay sequencer */
     bool  autoplay;
     int   phase;
@@ -49,12 +62,21 @@ typedef struct manipulator_demo {
     float rot_target;
 } manipulator_demo;
 
-/* Resolve nodes from scene; returns false if any node is missing. */
+/* Nodes moved by the demo, their subtrees have to stay out of the static batches. */
+extern const char* const manipulator_demo_node_names[MANIPULATOR_NODE_COUNT];
+
+/* Resolve nodes from scene and copy them into the rig; returns false if any node is missing. */
 bool manipulator_demo_init(manipulator_demo* demo, scene_handle scene);
 
-/* Advance simulation one frame. Returns true if any node transform changed. */
+/* Advance simulation one step on the rig. Returns true if any node transform changed. */
 bool manipulator_demo_update(manipulator_demo* demo, float dt);
 
+/* Rig local transforms of the moved nodes, 16 floats each in manipulator_demo_node_names order. */
+void manipulator_demo_get_local_trs(manipulator_demo const* demo, float* local_trs);
+
+/* Write local transforms from manipulator_demo_get_local_trs into the scene. */
+void manipulator_demo_apply(manipulator_demo* demo, float const* local_trs);
+
 /* Draw ImGui controls panel section (call inside an igBegin/End block). */
 void manipulator_demo_draw_ui(manipulator_demo* demo);
 
@@ -0,0 +1,463 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "MeshOptimize.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "Allocator.h"
+
+#define MDL_OPTIMIZE_EMPTY_SLOT 0xffffffffu
+#define MDL_OPTIMIZE_LOD_GRID 128
+#define MDL_OPTIMIZE_LOD_MIN_GRID 4
+#define MDL_OPTIMIZE_LOD_MIN_TRIANGLES 8
+
+static int32_t mdl_optimize_next_fan(int32_t const* candidates, int32_t candidates_count, int32_t const* live,
+                                     int32_t const* timestamps, int32_t time,
+                                     int32_t const* dead_end, int32_t* dead_end_count,
+                                     int32_t* cursor, int32_t vertices_count)
+{
+    /*
+     * Prefer the candidate that is still in the cache after its remaining triangles are emitted,
+     * the oldest one first. Without such a candidate fall back to the dead end stack, then scan.
+     */
+    int32_t best = -1, best_priority = -1;
+    for (int32_t i = 0; i < candidates_count; ++i) {
+        int32_t v = candidates[i];
+        if (live[v] <= 0) continue;
+        int32_t priority = 0;
+        if (time - timestamps[v] + 2 * live[v] <= MDL_OPTIMIZE_CACHE_SIZE)
+            priority = time - timestamps[v];
+        if (priority > best_priority) {
+            best_priority = priority;
+            best = v;
+        }
+    }
+    if (best != -1) return best;
+
+    while (*dead_end_count > 0) {
+        int32_t v = dead_end[--(*dead_end_count)];
+        if (live[v] > 0) return v;
+    }
+    while (*cursor < vertices_count) {
+        if (live[*cursor] > 0) return *cursor;
+        (*cursor)++;
+    }
+    return -1;
+}
+
+void mdl_optimize_vertex_cache(uint32_t* indices, int32_t indices_count, int32_t vertices_count)
+{
+    int32_t triangles_count = indices_count / 3;
+    if (triangles_count < 2 || vertices_count <= 0) return;
+    for (int32_t i = 0; i < triangles_count * 3; ++i)
+        if (indices[i] >= (uint32_t)vertices_count) return;
+
+    //vertex to triangle adjacency, live holds the triangles not emitted yet
+    int32_t* live = OS_MALLOC(sizeof(int32_t) * vertices_count);
+    int32_t* offsets = OS_MALLOC(sizeof(int32_t) * (vertices_count + 1));
+    int32_t* fill = OS_MALLOC(sizeof(int32_t) * vertices_count);
+    int32_t* adjacency = OS_MALLOC(sizeof(int32_t) * triangles_count * 3);
+    os_memset(live, 0, sizeof(int32_t) * vertices_count);
+    for (int32_t i = 0; i < triangles_count * 3; ++i)
+        live[indices[i]]++;
+    offsets[0] = 0;
+    for (int32_t v = 0; v < vertices_count; ++v) {
+        offsets[v + 1] = offsets[v] + live[v];
+        fill[v] = offsets[v];
+    }
+    for (int32_t t = 0; t < triangles_count; ++t)
+        for (int32_t k = 0; k < 3; ++k)
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+
+    int32_t* timestamps = OS_MALLOC(sizeof(int32_t) * vertices_count);
+    os_memset(timestamps, 0, sizeof(int32_t) * vertices_count);
+    uint8_t* emitted = OS_MALLOC(triangles_count);
+    os_memset(emitted, 0, triangles_count);
+    int32_t* dead_end = OS_MALLOC(sizeof(int32_t) * triangles_count * 3);
+    int32_t* candidates = OS_MALLOC(sizeof(int32_t) * triangles_count * 3);
+    uint32_t* output = OS_MALLOC(sizeof(uint32_t) * triangles_count * 3);
+
+    int32_t dead_end_count = 0, output_count = 0, cursor = 0;
+    int32_t time = MDL_OPTIMIZE_CACHE_SIZE + 1;
+    int32_t fan = mdl_optimize_next_fan(0, 0, live, timestamps, time, dead_end, &dead_end_count, &cursor, vertices_count);
+
+    while (fan >= 0) {
+        int32_t candidates_count = 0;
+        for (int32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+            int32_t t = adjacency[a];
+            if (emitted[t]) continue;
+            emitted[t] = 1;
+            for (int32_t k = 0; k < 3; ++k) {
+                int32_t v = (int32_t)indices[t * 3 + k];
+                output[output_count++] = (uint32_t)v;
+                dead_end[dead_end_count++] = v;
+                candidates[candidates_count++] = v;
+                live[v]--;
+                if (time - timestamps[v] > MDL_OPTIMIZE_CACHE_SIZE)
+                    timestamps[v] = time++;
+            }
+        }
+        fan = mdl_optimize_next_fan(candidates, candidates_count, live, timestamps, time,
+                                    dead_end, &dead_end_count, &cursor, vertices_count);
+    }
+
+    os_memcpy(indices, output, sizeof(uint32_t) * output_count);
+
+    OS_FREE(output);
+    OS_FREE(candidates);
+    OS_FREE(dead_end);
+    OS_FREE(emitted);
+    OS_FREE(timestamps);
+    OS_FREE(adjacency);
+    OS_FREE(fill);
+    OS_FREE(offsets);
+    OS_FREE(live);
+}
+
+void mdl_optimize_primitive_cache(mdl_primitive* primitive)
+{
+    if (primitive->primitive_type != MDL_PRIMITIVE_TYPE_TRIANGLES) return;
+    mdl_optimize_vertex_cache(primitive->indices, primitive->indices_count, primitive->vertices_count);
+    for (int32_t i = 0; i < primitive->lods_count; ++i) {
+        mdl_lod* lod = primitive->lods + i;
+        mdl_optimize_vertex_cache(primitive->indices + lod->index_offset, (int32_t)lod->index_count, primitive->vertices_count);
+    }
+}
+
+void mdl_optimize_vertex_fetch(mdl_primitive* primitive)
+{
+    if (primitive->vertices_count <= 0) return;
+
+    int32_t* remap = OS_MALLOC(sizeof(int32_t) * primitive->vertices_count);
+    for (int32_t v = 0; v < primitive->vertices_count; ++v) remap[v] = -1;
+
+    int32_t total = mdl_primitive_indices_total(primitive);
+    int32_t next = 0;
+    for (int32_t i = 0; i < total; ++i) {
+        uint32_t v = primitive->indices[i];
+        if (v >= (uint32_t)primitive->vertices_count) {
+            OS_FREE(remap);
+            return;
+        }
+        if (remap[v] < 0) remap[v] = next++;
+    }
+    for (int32_t i = 0; i < total; ++i)
+        primitive->indices[i] = (uint32_t)remap[primitive->indices[i]];
+
+    uint32_t stride = primitive->vertex_stride;
+    char* vertices = OS_MALLOC(stride * next + 1);
+    for (int32_t v = 0; v < primitive->vertices_count; ++v) {
+        if (remap[v] < 0) continue;
+        os_memcpy(vertices + (size_t)remap[v] * stride, (char*)primitive->vertices + (size_t)v * stride, stride);
+    }
+
+    OS_FREE(primitive->vertices);
+    primitive->vertices = vertices;
+    primitive->vertices_count = next;
+    OS_FREE(remap);
+}
+
+static mdl_attribute* mdl_optimize_find_attribute(mdl_primitive* primitive, mdl_vertex_attribute_type type)
+{
+    for (int32_t i = 0; i < primitive->attributes_count; ++i) {
+        if (primitive->attributes[i].type == type)
+            return primitive->attributes + i;
+    }
+    return 0;
+}
+
+static float const* mdl_optimize_position(mdl_primitive const* primitive, mdl_attribute const* attribute, uint32_t v)
+{
+    return (float const*)((char const*)primitive->vertices + (size_t)v * primitive->vertex_stride + attribute->offset);
+}
+
+static bool mdl_optimize_keeps_facing(float const* a0, float const* b0, float const* c0,
+                                      float const* a1, float const* b1, float const* c1)
+{
+    float e0[3] = { b0[0] - a0[0], b0[1] - a0[1], b0[2] - a0[2] };
+    float e1[3] = { c0[0] - a0[0], c0[1] - a0[1], c0[2] - a0[2] };
+    float f0[3] = { b1[0] - a1[0], b1[1] - a1[1], b1[2] - a1[2] };
+    float f1[3] = { c1[0] - a1[0], c1[1] - a1[1], c1[2] - a1[2] };
+    float n0[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+    float n1[3] = { f0[1] * f1[2] - f0[2] * f1[1], f0[2] * f1[0] - f0[0] * f1[2], f0[0] * f1[1] - f0[1] * f1[0] };
+    return n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] > 0.0f;
+}
+
+int32_t mdl_optimize_lods(mdl_primitive* primitive, int32_t lods_max, float reduction)
+{
+    if (primitive->primitive_type != MDL_PRIMITIVE_TYPE_TRIANGLES || lods_max <= 0 || primitive->lods_count > 0)
+        return 0;
+
+    mdl_attribute* position = mdl_optimize_find_attribute(primitive, MDL_VERTEX_ATTRIBUTE_POSITION);
+    if (position == 0 || position->format != MDL_ATTRIBUTE_FORMAT_FLOAT32 || position->count < 3)
+        return 0;
+
+    int32_t vertices_count = primitive->vertices_count;
+    int32_t triangles_count = primitive->indices_count / 3;
+    if (vertices_count <= 0 || triangles_count < MDL_OPTIMIZE_LOD_MIN_TRIANGLES) return 0;
+
+    float min[3] = { INFINITY, INFINITY, INFINITY };
+    float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (int32_t v = 0; v < vertices_count; ++v) {
+        float const* p = mdl_optimize_position(primitive, position, v);
+        for (int32_t k = 0; k < 3; ++k) {
+            if (p[k] < min[k]) min[k] = p[k];
+            if (p[k] > max[k]) max[k] = p[k];
+        }
+    }
+    float extent = fmaxf(max[0] - min[0], fmaxf(max[1] - min[1], max[2] - min[2]));
+    if (!(extent > 0.0f) || !isfinite(extent)) return 0;
+
+    uint32_t capacity = 64;
+    while (capacity < (uint32_t)vertices_count * 2) capacity <<= 1;
+
+    uint32_t* table = OS_MALLOC(sizeof(uint32_t) * capacity);
+    int32_t* table_cell = OS_MALLOC(sizeof(int32_t) * capacity);
+    int32_t* cell_of = OS_MALLOC(sizeof(int32_t) * vertices_count);
+    float* cell_mean = OS_MALLOC(sizeof(float) * 4 * vertices_count);
+    int32_t* cell_vertex = OS_MALLOC(sizeof(int32_t) * vertices_count);
+    float* cell_distance = OS_MALLOC(sizeof(float) * vertices_count);
+    uint32_t* level = OS_MALLOC(sizeof(uint32_t) * triangles_count * 3);
+    mdl_lod* lods = OS_MALLOC(sizeof(mdl_lod) * lods_max);
+
+    int32_t lods_count = 0;
+    int32_t total = primitive->indices_count;
+    int32_t previous_triangles = triangles_count;
+
+    for (int32_t grid = MDL_OPTIMIZE_LOD_GRID; grid >= MDL_OPTIMIZE_LOD_MIN_GRID && lods_count < lods_max; grid /= 2) {
+        float cell = extent / (float)grid;
+
+        /*
+         * Vertex clustering.
+         * Every vertex falls into one grid cell, the vertex closest to the cell mean represents the whole cell.
+         */
+        os_memset(table, 0xff, sizeof(uint32_t) * capacity);
+        os_memset(cell_mean, 0, sizeof(float) * 4 * vertices_count);
+        int32_t cells_count = 0;
+        for (int32_t v = 0; v < vertices_count; ++v) {
+            float const* p = mdl_optimize_position(primitive, position, v);
+            uint32_t c[3];
+            for (int32_t k = 0; k < 3; ++k) {
+                int32_t ic = (int32_t)((p[k] - min[k]) / cell);
+                c[k] = (uint32_t)(ic < 0 ? 0 : ic >= grid ? grid - 1 : ic);
+            }
+            uint32_t key = c[0] + (uint32_t)grid * (c[1] + (uint32_t)grid * c[2]);
+            uint32_t slot = (key * 0x9e3779b1u) & (capacity - 1);
+            while (table[slot] != MDL_OPTIMIZE_EMPTY_SLOT && table[slot] != key)
+                slot = (slot + 1) & (capacity - 1);
+            if (table[slot] == MDL_OPTIMIZE_EMPTY_SLOT) {
+                table[slot] = key;
+                table_cell[slot] = cells_count++;
+            }
+            int32_t index = table_cell[slot];
+            cell_of[v] = index;
+            cell_mean[index * 4 + 0] += p[0];
+            cell_mean[index * 4 + 1] += p[1];
+            cell_mean[index * 4 + 2] += p[2];
+            cell_mean[index * 4 + 3] += 1.0f;
+        }
+        if (cells_count == vertices_count) continue;
+
+        for (int32_t c = 0; c < cells_count; ++c) {
+            cell_mean[c * 4 + 0] /= cell_mean[c * 4 + 3];
+            cell_mean[c * 4 + 1] /= cell_mean[c * 4 + 3];
+            cell_mean[c * 4 + 2] /= cell_mean[c * 4 + 3];
+            cell_vertex[c] = -1;
+            cell_distance[c] = INFINITY;
+        }
+        for (int32_t v = 0; v < vertices_count; ++v) {
+            float const* p = mdl_optimize_position(primitive, position, v);
+            float const* mean = cell_mean + cell_of[v] * 4;
+            float d = (p[0] - mean[0]) * (p[0] - mean[0]) + (p[1] - mean[1]) * (p[1] - mean[1]) + (p[2] - mean[2]) * (p[2] - mean[2]);
+            if (d < cell_distance[cell_of[v]]) {
+                cell_distance[cell_of[v]] = d;
+                cell_vertex[cell_of[v]] = v;
+            }
+        }
+
+        //rebuild from the full level, collapsed and flipped triangles are dropped
+        int32_t level_count = 0;
+        for (int32_t t = 0; t < triangles_count; ++t) {
+            uint32_t const* tri = primitive->indices + t * 3;
+            uint32_t a = (uint32_t)cell_vertex[cell_of[tri[0]]];
+            uint32_t b = (uint32_t)cell_vertex[cell_of[tri[1]]];
+            uint32_t c = (uint32_t)cell_vertex[cell_of[tri[2]]];
+            if (a == b || b == c || a == c) continue;
+            if (!mdl_optimize_keeps_facing(mdl_optimize_position(primitive, position, tri[0]),
+                                           mdl_optimize_position(primitive, position, tri[1]),
+                                           mdl_optimize_position(primitive, position, tri[2]),
+                                           mdl_optimize_position(primitive, position, a),
+                                           mdl_optimize_position(primitive, position, b),
+                                           mdl_optimize_position(primitive, position, c)))
+                continue;
+            level[level_count++] = a;
+            level[level_count++] = b;
+            level[level_count++] = c;
+        }
+
+        int32_t level_triangles = level_count / 3;
+        if (level_triangles < MDL_OPTIMIZE_LOD_MIN_TRIANGLES) break;
+        if ((float)level_triangles > reduction * (float)previous_triangles) continue;
+
+        primitive->indices = OS_REALLOC(primitive->indices, sizeof(uint32_t) * (total + level_count));
+        os_memcpy(primitive->indices + total, level, sizeof(uint32_t) * level_count);
+        lods[lods_count].index_offset = (uint32_t)total;
+        lods[lods_count].index_count = (uint32_t)level_count;
+        lods[lods_count].error = cell * 1.7320508f;
+        lods_count++;
+        total += level_count;
+        previous_triangles = level_triangles;
+    }
+
+    if (lods_count > 0) {
+        primitive->lods = OS_REALLOC(lods, sizeof(mdl_lod) * lods_count);
+        primitive->lods_count = lods_count;
+    } else {
+        OS_FREE(lods);
+    }
+
+    OS_FREE(level);
+    OS_FREE(cell_distance);
+    OS_FREE(cell_vertex);
+    OS_FREE(cell_mean);
+    OS_FREE(cell_of);
+    OS_FREE(table_cell);
+    OS_FREE(table);
+    return lods_count;
+}
+
+uint16_t mdl_float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t raw_exponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+    int32_t exponent = (int32_t)raw_exponent - 127 + 15;
+
+    if (raw_exponent == 0xffu) return (uint16_t)(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+    if (exponent >= 31) return (uint16_t)(sign | 0x7c00u);
+
+    if (exponent <= 0) {
+        //subnormal half, round to nearest even
+        if (exponent < -10) return (uint16_t)sign;
+        mantissa |= 0x800000u;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1u);
+        if (rest > halfway || (rest == halfway && (half & 1u))) half++;
+        return (uint16_t)(sign | half);
+    }
+
+    //a carry out of the mantissa correctly bumps the exponent
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) half++;
+    return (uint16_t)half;
+}
+
+static float mdl_optimize_clamp(float value, float low, float high)
+{
+    return value < low ? low : value > high ? high : value;
+}
+
+void mdl_optimize_quantize(mdl_primitive* primitive)
+{
+    if (primitive->vertices_count <= 0 || primitive->attributes_count <= 0) return;
+    for (int32_t i = 0; i < primitive->attributes_count; ++i) {
+        if (primitive->attributes[i].format != MDL_ATTRIBUTE_FORMAT_FLOAT32) return;
+    }
+
+    int32_t count = 0;
+    mdl_attribute* attributes = OS_MALLOC(sizeof(mdl_attribute) * primitive->attributes_count);
+    int32_t* source_offset = OS_MALLOC(sizeof(int32_t) * primitive->attributes_count);
+    uint32_t stride = 0;
+
+    for (int32_t i = 0; i < primitive->attributes_count; ++i) {
+        mdl_attribute const* src = primitive->attributes + i;
+        if (src->type == MDL_VERTEX_ATTRIBUTE_INVALID || src->count <= 0) continue;
+
+        mdl_attribute* dst = attributes + count;
+        *dst = *src;
+        source_offset[count] = src->offset;
+
+        switch (src->type) {
+            case MDL_VERTEX_ATTRIBUTE_NORMAL:
+            case MDL_VERTEX_ATTRIBUTE_TANGENT:
+                dst->format = MDL_ATTRIBUTE_FORMAT_SNORM16;
+                dst->element_size = 2;
+                break;
+            case MDL_VERTEX_ATTRIBUTE_UV: {
+                bool unit = true;
+                for (int32_t v = 0; v < primitive->vertices_count && unit; ++v) {
+                    float const* uv = (float const*)((char const*)primitive->vertices + (size_t)v * primitive->vertex_stride + src->offset);
+                    for (int32_t k = 0; k < src->count; ++k)
+                        if (!(uv[k] >= 0.0f && uv[k] <= 1.0f)) unit = false;
+                }
+                dst->format = unit ? MDL_ATTRIBUTE_FORMAT_UNORM16 : MDL_ATTRIBUTE_FORMAT_FLOAT16;
+                dst->element_size = 2;
+                break;
+            }
+            case MDL_VERTEX_ATTRIBUTE_COLOR:
+                dst->format = MDL_ATTRIBUTE_FORMAT_UNORM8;
+                dst->element_size = 1;
+                break;
+            default:
+                dst->format = MDL_ATTRIBUTE_FORMAT_FLOAT32;
+                dst->element_size = 4;
+                break;
+        }
+
+        dst->offset = (int32_t)stride;
+        stride += ((uint32_t)(dst->count * dst->element_size) + 3u) & ~3u;
+        count++;
+    }
+
+    char* vertices = OS_MALLOC(stride * primitive->vertices_count + 1);
+    os_memset(vertices, 0, stride * primitive->vertices_count + 1);
+
+    for (int32_t v = 0; v < primitive->vertices_count; ++v) {
+        char const* src_vertex = (char const*)primitive->vertices + (size_t)v * primitive->vertex_stride;
+        char* dst_vertex = vertices + (size_t)v * stride;
+
+        for (int32_t i = 0; i < count; ++i) {
+            mdl_attribute const* attribute = attributes + i;
+            float const* src = (float const*)(src_vertex + source_offset[i]);
+            void* dst = dst_vertex + attribute->offset;
+
+            for (int32_t k = 0; k < attribute->count; ++k) {
+                switch (attribute->format) {
+                    case MDL_ATTRIBUTE_FORMAT_SNORM16:
+                        ((int16_t*)dst)[k] = (int16_t)lrintf(mdl_optimize_clamp(src[k], -1.0f, 1.0f) * 32767.0f);
+                        break;
+                    case MDL_ATTRIBUTE_FORMAT_UNORM16:
+                        ((uint16_t*)dst)[k] = (uint16_t)lrintf(mdl_optimize_clamp(src[k], 0.0f, 1.0f) * 65535.0f);
+                        break;
+                    case MDL_ATTRIBUTE_FORMAT_FLOAT16:
+                        ((uint16_t*)dst)[k] = mdl_float_to_half(src[k]);
+                        break;
+                    case MDL_ATTRIBUTE_FORMAT_UNORM8:
+                        ((uint8_t*)dst)[k] = (uint8_t)lrintf(mdl_optimize_clamp(src[k], 0.0f, 1.0f) * 255.0f);
+                        break;
+                    default:
+                        ((float*)dst)[k] = src[k];
+                        break;
+                }
+            }
+        }
+    }
+
+    OS_FREE(primitive->vertices);
+    OS_FREE(primitive->attributes);
+    OS_FREE(source_offset);
+    primitive->vertices = vertices;
+    primitive->vertex_stride = stride;
+    primitive->attributes = attributes;
+    primitive->attributes_count = count;
+}
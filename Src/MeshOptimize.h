@@ -0,0 +1,60 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_MESHOPTIMIZE_H
+#define IBCWEB_MESHOPTIMIZE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Model.h"
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+#define MDL_OPTIMIZE_CACHE_SIZE 16
+
+/*
+ * Offline mesh processing used by the baker. Every function works on one primitive
+ * and only touches that primitive, so primitives can be processed on worker threads.
+ * Only triangle lists are processed, other primitive types are left untouched.
+ */
+
+/*
+ * Reorders triangles of one index range for the post transform vertex cache (tipsify).
+ */
+IBC_API void mdl_optimize_vertex_cache(uint32_t* indices, int32_t indices_count, int32_t vertices_count);
+
+/*
+ * Appends up to lods_max simplified levels after the full index range. Levels are built by vertex
+ * clustering on a shrinking grid and snap to existing vertices, so they share the vertex buffer.
+ * A level is kept only when it has at most reduction times the triangles of the previous one.
+ * Needs float positions, call before mdl_optimize_quantize. Returns the number of levels added.
+ */
+IBC_API int32_t mdl_optimize_lods(mdl_primitive* primitive, int32_t lods_max, float reduction);
+
+/*
+ * Cache optimizes the full level and every lod range.
+ */
+IBC_API void mdl_optimize_primitive_cache(mdl_primitive* primitive);
+
+/*
+ * Reorders vertices by first use in the index buffer and drops unreferenced ones.
+ */
+IBC_API void mdl_optimize_vertex_fetch(mdl_primitive* primitive);
+
+/*
+ * Repacks float attributes into compact formats. Positions stay float32, normals and tangents
+ * become snorm16, uvs unorm16 when they stay in [0, 1] and half floats otherwise, colors unorm8.
+ * Every attribute starts on a 4 byte boundary.
+ */
+IBC_API void mdl_optimize_quantize(mdl_primitive* primitive);
+
+IBC_API uint16_t mdl_float_to_half(float value);
+
+#endif //IBCWEB_MESHOPTIMIZE_H
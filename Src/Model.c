@@ -13,10 +13,15 @@
 
 #include "Allocator.h"
 #include "GlMath.h"
+#include "Stl.h"
+#include "Urdf.h"
+#include "Asset.h"
+#include "Ktx2.h"
 
 #define CGLTF_IMPLEMENTATION
 #include "cgltf.h"
 
+#define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #ifndef CORE_ASSERT
@@ -100,9 +105,193 @@ static bool mdl_read_entire_file(const char* path, void** out_buffer, size_t* ou
     return true;
 }
 
+static bool mdl_name_matches(const char* name, const char** patterns, int32_t count)
+{
+    if (name == 0 || patterns == 0) return false;
+    for (int32_t i = 0; i < count; ++i) {
+        const char* pattern = patterns[i];
+        if (pattern == 0) continue;
+        size_t len = strlen(pattern);
+        if (len > 0 && pattern[len - 1] == '*') {
+            if (strncmp(name, pattern, len - 1) == 0) return true;
+        } else if (strcmp(name, pattern) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Node states used while marking the reachable subgraph.
+ */
+#define MDL_NODE_UNVISITED 0
+#define MDL_NODE_DROPPED 1
+#define MDL_NODE_KEPT 2
+
+static void mdl_mark_node(cgltf_data* data, cgltf_node* cnode, bool included, mdl_load_options const* options, uint8_t* state)
+{
+    uint8_t* node_state = state + (cnode - data->nodes);
+    if (*node_state != MDL_NODE_UNVISITED) return;
+
+    //excluded subtrees are never walked
+    if (mdl_name_matches(cnode->name, options->exclude_nodes, options->exclude_nodes_count)) {
+        *node_state = MDL_NODE_DROPPED;
+        return;
+    }
+
+    if (!included)
+        included = mdl_name_matches(cnode->name, options->include_nodes, options->include_nodes_count);
+    *node_state = included ? MDL_NODE_KEPT : MDL_NODE_DROPPED;
+
+    for (cgltf_size i = 0; i < cnode->children_count; ++i)
+        mdl_mark_node(data, cnode->children[i], included, options, state);
+}
+
+static void mdl_fold_ancestors(cgltf_node const* cnode, mdl_node* node)
+{
+    /*
+     * The node was kept while its ancestors were filtered out, so it becomes a root.
+     * Their transforms are folded into its local trs to keep the world placement.
+     * Exact for uniform scales, which is what our exports use.
+     */
+    gl_vec3 pos = gl_vec3_new_arr(node->local_pos);
+    gl_vec4 rot = gl_vec4_new_arr(node->local_rot);
+    gl_vec3 scale = gl_vec3_new_arr(node->local_scale);
+
+    for (cgltf_node const* parent = cnode->parent; parent != 0; parent = parent->parent) {
+        gl_vec3 parent_pos = parent->has_translation ? gl_vec3_new_arr((float*)parent->translation) : gl_vec3_new(0, 0, 0);
+        gl_vec4 parent_rot = parent->has_rotation ? gl_vec4_new_arr((float*)parent->rotation) : gl_vec4_new(0, 0, 0, 1);
+        gl_vec3 parent_scale = parent->has_scale ? gl_vec3_new_arr((float*)parent->scale) : gl_vec3_new(1, 1, 1);
+
+        pos = gl_vec3_add(parent_pos, gl_quat_mul_vector(parent_rot, gl_vec3_mul(parent_scale, pos)));
+        rot = gl_quat_normalize(gl_quat_mul(parent_rot, rot));
+        scale = gl_vec3_mul(parent_scale, scale);
+    }
+
+    os_memcpy(node->local_pos, pos.data, sizeof(float) * 3);
+    os_memcpy(node->local_rot, rot.data, sizeof(float) * 4);
+    os_memcpy(node->local_scale, scale.data, sizeof(float) * 3);
+}
+
+static int32_t mdl_gpu_instances_count(cgltf_node const* cnode)
+{
+    if (!cnode->has_mesh_gpu_instancing || cnode->mesh == 0 || cnode->mesh_gpu_instancing.attributes_count == 0)
+        return 0;
+
+    cgltf_size count = cnode->mesh_gpu_instancing.attributes[0].data->count;
+    for (cgltf_size i = 1; i < cnode->mesh_gpu_instancing.attributes_count; ++i) {
+        if (cnode->mesh_gpu_instancing.attributes[i].data->count < count)
+            count = cnode->mesh_gpu_instancing.attributes[i].data->count;
+    }
+    return (int32_t)count;
+}
+
+/*
+ * EXT_mesh_gpu_instancing, every instance becomes a child node holding the mesh and the node
+ * itself no longer draws it. The scene batches nodes sharing a mesh into instanced draws again.
+ */
+static void mdl_load_gpu_instances(cgltf_node const* cnode, mdl_handle handle, int32_t node_index, int32_t* next_node, bool verbose)
+{
+    mdl_node *node = handle->nodes + node_index;
+    int32_t count = mdl_gpu_instances_count(cnode);
+
+    int32_t *children = OS_MALLOC(sizeof(int32_t) * (node->children_count + count));
+    if (node->children_count > 0)
+        os_memcpy(children, node->children_id, sizeof(int32_t) * node->children_count);
+    OS_FREE(node->children_id);
+    node->children_id = children;
+
+    for (int32_t i = 0; i < count; ++i) {
+        int32_t instance_index = (*next_node)++;
+        mdl_node *instance = handle->nodes + instance_index;
+        instance->mesh_index = node->mesh_index;
+        instance->light_index = instance->camera_index = -1;
+        instance->parent_id = node_index;
+
+        os_memcpy(instance->local_pos, gl_vec3_new(0,0,0).data, sizeof(float) * 3);
+        os_memcpy(instance->local_scale, gl_vec3_new(1,1,1).data, sizeof(float) * 3);
+        os_memcpy(instance->local_rot, gl_vec4_new(0,0,0,1).data, sizeof(float) * 4);
+        for (cgltf_size a = 0; a < cnode->mesh_gpu_instancing.attributes_count; ++a) {
+            cgltf_attribute const* attr = cnode->mesh_gpu_instancing.attributes + a;
+            if (attr->name == 0) continue;
+            if (strcmp(attr->name, "TRANSLATION") == 0)
+                cgltf_accessor_read_float(attr->data, i, instance->local_pos, 3);
+            else if (strcmp(attr->name, "ROTATION") == 0)
+                cgltf_accessor_read_float(attr->data, i, instance->local_rot, 4);
+            else if (strcmp(attr->name, "SCALE") == 0)
+                cgltf_accessor_read_float(attr->data, i, instance->local_scale, 3);
+        }
+        node->children_id[node->children_count++] = instance_index;
+    }
+
+    if (verbose) printf("- - - Gpu instances: %i\n", count);
+    node->mesh_index = -1;
+}
+
+static bool mdl_mark_reachable(cgltf_data* data, mdl_load_options const* options, uint8_t* state)
+{
+    bool included = options->include_nodes_count <= 0;
+
+    if (options->scene_index == MDL_SCENE_ALL || (options->scene_index == MDL_SCENE_DEFAULT && data->scenes_count == 0)) {
+        for (cgltf_size i = 0; i < data->nodes_count; ++i) {
+            if (data->nodes[i].parent == 0)
+                mdl_mark_node(data, data->nodes + i, included, options, state);
+        }
+        return true;
+    }
+
+    cgltf_scene* cscene = 0;
+    if (options->scene_index == MDL_SCENE_DEFAULT) {
+        cscene = data->scene != 0 ? data->scene : data->scenes;
+    } else if (options->scene_index >= 0 && (cgltf_size)options->scene_index < data->scenes_count) {
+        cscene = data->scenes + options->scene_index;
+    } else {
+        fprintf(stderr, "- Scene index %i is out of range, file has %llu scenes\n", options->scene_index, (unsigned long long)data->scenes_count);
+        return false;
+    }
+
+    printf("- Loading scene: %s\n", cscene->name != 0 ? cscene->name : "<unnamed>");
+    for (cgltf_size i = 0; i < cscene->nodes_count; ++i)
+        mdl_mark_node(data, cscene->nodes[i], included, options, state);
+    return true;
+}
+
+static bool mdl_has_extension(const char* path, const char* extension)
+{
+    size_t path_len = strlen(path);
+    size_t ext_len = strlen(extension);
+    if (path_len < ext_len) return false;
+    const char* tail = path + path_len - ext_len;
+    for (size_t i = 0; i < ext_len; ++i) {
+        char c = tail[i];
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        if (c != extension[i]) return false;
+    }
+    return true;
+}
+
+void mdl_load_options_default(mdl_load_options* options)
+{
+    os_memset(options, 0, sizeof(mdl_load_options));
+    options->scene_index = MDL_SCENE_ALL;
+}
+
 mdl_handle mdl_load(const char* path) {
+    mdl_load_options options;
+    mdl_load_options_default(&options);
+    return mdl_load_ex(path, &options);
+}
+
+mdl_handle mdl_load_ex(const char* path, mdl_load_options const* load_options) {
     bool verbose = false;
 
+    if (path != 0 && mdl_has_extension(path, ".urdf"))
+        return urdf_load(path);
+    if (path != 0 && mdl_has_extension(path, ".stl"))
+        return stl_load(path);
+    if (path != 0 && mdl_has_extension(path, ".ibca"))
+        return asset_load(path);
+
     printf("Loading model %s\n", path != 0 ? path : "<null>");
 
     void* buffer = 0;
@@ -139,9 +328,87 @@ mdl_handle mdl_load(const char* path) {
          */
     }
 
+    /*
+     * Selection of the reachable subgraph.
+     * Every cgltf array gets a remap table, -1 marks entries that are skipped.
+     */
+    size_t remap_count = data->nodes_count + data->meshes_count + data->materials_count +
+                         data->images_count + data->cameras_count + data->lights_count;
+    int32_t *remap = OS_MALLOC(sizeof(int32_t) * (remap_count + 1));
+    uint8_t *node_state = OS_MALLOC(data->nodes_count + 1);
+    os_memset(node_state, MDL_NODE_UNVISITED, data->nodes_count + 1);
+    for (size_t i = 0; i < remap_count; ++i) remap[i] = -1;
+
+    int32_t *node_map = remap;
+    int32_t *mesh_map = node_map + data->nodes_count;
+    int32_t *material_map = mesh_map + data->meshes_count;
+    int32_t *image_map = material_map + data->materials_count;
+    int32_t *camera_map = image_map + data->images_count;
+    int32_t *light_map = camera_map + data->cameras_count;
+
+    if (!mdl_mark_reachable(data, load_options, node_state)) {
+        OS_FREE(node_state);
+        OS_FREE(remap);
+        cgltf_free(data);
+        OS_FREE(buffer);
+        return 0;
+    }
+
+    int32_t nodes_count = 0, meshes_count = 0, materials_count = 0, images_count = 0, cameras_count = 0, lights_count = 0;
+    int32_t instance_nodes_count = 0;
+    for (cgltf_size i = 0; i < data->nodes_count; ++i) {
+        cgltf_node *cnode = data->nodes + i;
+        if (node_state[i] != MDL_NODE_KEPT) continue;
+        node_map[i] = nodes_count++;
+        instance_nodes_count += mdl_gpu_instances_count(cnode);
+        if (cnode->mesh != 0 && mesh_map[cnode->mesh - data->meshes] == -1)
+            mesh_map[cnode->mesh - data->meshes] = meshes_count++;
+        if (cnode->camera != 0 && camera_map[cnode->camera - data->cameras] == -1)
+            camera_map[cnode->camera - data->cameras] = cameras_count++;
+        if (cnode->light != 0 && light_map[cnode->light - data->lights] == -1)
+            light_map[cnode->light - data->lights] = lights_count++;
+    }
+    //mesh order follows the file, not the order of first reference
+    meshes_count = 0;
+    for (cgltf_size i = 0; i < data->meshes_count; ++i) {
+        if (mesh_map[i] == -1) continue;
+        mesh_map[i] = meshes_count++;
+        cgltf_mesh *cmesh = data->meshes + i;
+        for (cgltf_size j = 0; j < cmesh->primitives_count; ++j) {
+            cgltf_material *cmat = cmesh->primitives[j].material;
+            if (cmat != 0) material_map[cmat - data->materials] = 0;
+        }
+    }
+    for (cgltf_size i = 0; i < data->materials_count; ++i) {
+        if (material_map[i] == -1) continue;
+        material_map[i] = materials_count++;
+        cgltf_material *cmat = data->materials + i;
+        if (cmat->has_pbr_metallic_roughness && cmat->pbr_metallic_roughness.base_color_texture.texture != 0) {
+            cgltf_image *cimg = cmat->pbr_metallic_roughness.base_color_texture.texture->image;
+            if (cimg != 0) image_map[cimg - data->images] = 0;
+        }
+    }
+    for (cgltf_size i = 0; i < data->images_count; ++i) {
+        if (image_map[i] != -1) image_map[i] = images_count++;
+    }
+    cameras_count = 0;
+    for (cgltf_size i = 0; i < data->cameras_count; ++i) {
+        if (camera_map[i] != -1) camera_map[i] = cameras_count++;
+    }
+    lights_count = 0;
+    for (cgltf_size i = 0; i < data->lights_count; ++i) {
+        if (light_map[i] != -1) light_map[i] = lights_count++;
+    }
+
+    printf("- Selected nodes %i/%llu, meshes %i/%llu, materials %i/%llu, images %i/%llu\n",
+           nodes_count, (unsigned long long)data->nodes_count, meshes_count, (unsigned long long)data->meshes_count,
+           materials_count, (unsigned long long)data->materials_count, images_count, (unsigned long long)data->images_count);
+
     mdl_handle handle = OS_MALLOC(sizeof(mdl_data));
     if (handle == 0) {
         fprintf(stderr, "- Model allocation failed\n");
+        OS_FREE(node_state);
+        OS_FREE(remap);
         cgltf_free(data);
         OS_FREE(buffer);
         return 0;
@@ -149,23 +416,23 @@ mdl_handle mdl_load(const char* path) {
 
     os_memset(handle, 0, sizeof(mdl_data));
 
-    /*
-     * Loading of the scenes. Todo.
-     */
-
     /*
      * Loading of the nodes.
      */
 
-    if (verbose) printf("- Nodes count: %llu\n", (unsigned long long)data->nodes_count);
+    if (verbose) printf("- Nodes count: %i\n", nodes_count);
 
-    handle->nodes_count = data->nodes_count;
-    handle->nodes = OS_MALLOC(sizeof(struct mdl_node) * data->nodes_count);
-    os_memset(handle->nodes, 0, sizeof(struct mdl_node) * data->nodes_count);
+    //gpu instances follow the file nodes
+    int32_t next_instance_node = nodes_count;
+    nodes_count += instance_nodes_count;
+    handle->nodes_count = nodes_count;
+    handle->nodes = OS_MALLOC(sizeof(struct mdl_node) * nodes_count);
+    os_memset(handle->nodes, 0, sizeof(struct mdl_node) * nodes_count);
 
     for (int32_t i = 0; i < data->nodes_count; ++i) {
+        if (node_map[i] == -1) continue;
         cgltf_node *cnode = data->nodes + i;
-        mdl_node *node = handle->nodes + i;
+        mdl_node *node = handle->nodes + node_map[i];
         node->mesh_index = node->light_index = node->camera_index = -1;
         if (cnode->name != 0) {
             node->name = OS_MALLOC(strlen(cnode->name) + 1);
@@ -197,103 +464,66 @@ mdl_handle mdl_load(const char* path) {
             }
         }
 
-        //load children
+        //load children, skipping the filtered ones
         if (verbose) printf("- - - Children count: %llu\n", (unsigned long long)cnode->children_count);
-        node->children_count = cnode->children_count;
+        node->children_count = 0;
         if (cnode->children_count > 0) {
             node->children_id = OS_MALLOC(sizeof(uint32_t) * cnode->children_count);
             for (int32_t j = 0; j < cnode->children_count; ++j) {
                 cgltf_node *child_cnode = cnode->children[j];
-                int32_t child_index = -1;
-                for (int32_t k = 0; k < data->nodes_count; ++k) {
-                    if (data->nodes + k == child_cnode) {
-                        child_index = k;
-                        break;
-                    }
-                }
-                if (child_index == -1) {
-                    printf("- - - - Child node index could not be found!");
-                }
-                else {
-                    node->children_id[j] = child_index;
-                    if (verbose) printf("- - - - Added child: %s, index: %i\n", child_cnode->name != 0 ? child_cnode->name : "<unnamed>", child_index);
-                }
+                int32_t child_index = node_map[child_cnode - data->nodes];
+                if (child_index == -1) continue;
+                node->children_id[node->children_count++] = child_index;
+                if (verbose) printf("- - - - Added child: %s, index: %i\n", child_cnode->name != 0 ? child_cnode->name : "<unnamed>", child_index);
+            }
+            if (node->children_count == 0) {
+                OS_FREE(node->children_id);
+                node->children_id = 0;
             }
         }
 
         //update node parent index
-        node->parent_id = -1;
-        for (int32_t k = 0; k < data->nodes_count; ++k) {
-            if (data->nodes + k == cnode->parent) {
-                node->parent_id = k;
-                break;
-            }
-        }
+        node->parent_id = cnode->parent != 0 ? node_map[cnode->parent - data->nodes] : -1;
 
         if(node->parent_id != -1) {
-            printf("- - - - Parent index: %i, name: %s\n", node->parent_id, data->nodes[node->parent_id].name != 0 ? data->nodes[node->parent_id].name : "<unnamed>");
+            printf("- - - - Parent index: %i, name: %s\n", node->parent_id, cnode->parent->name != 0 ? cnode->parent->name : "<unnamed>");
+        } else if (cnode->parent != 0 && !cnode->has_matrix) {
+            mdl_fold_ancestors(cnode, node);
         }
 
         //associate node with mesh
         if (cnode->mesh) {
-            int32_t mesh_index = -1;
-            for (int32_t j = 0; j < data->meshes_count; ++j) {
-                if (data->meshes + j == cnode->mesh) {
-                    mesh_index = j;
-                    break;
-                }
-            }
-            if (mesh_index == -1) { printf("- - - Node mesh index could not be found!"); }
-            else {
-                node->mesh_index = mesh_index;
-                if (verbose) printf("- - - Node mesh: %s, index: %i\n", cnode->mesh->name != 0 ? cnode->mesh->name : "<unnamed>", mesh_index);
-            }
+            node->mesh_index = mesh_map[cnode->mesh - data->meshes];
+            if (verbose) printf("- - - Node mesh: %s, index: %i\n", cnode->mesh->name != 0 ? cnode->mesh->name : "<unnamed>", node->mesh_index);
+            if (mdl_gpu_instances_count(cnode) > 0)
+                mdl_load_gpu_instances(cnode, handle, node_map[i], &next_instance_node, verbose);
         }
 
         //associate node with camera
         if (cnode->camera) {
-            int32_t camera_index = -1;
-            for (int32_t j = 0; j < data->cameras_count; ++j) {
-                if (data->cameras + j == cnode->camera) {
-                    camera_index = j;
-                    break;
-                }
-            }
-            if (camera_index == -1) { printf("- - - Node camera index could not be found!"); }
-            else {
-                node->camera_index = camera_index;
-                if (verbose) printf("- - - Node camera: %s, index: %i\n", cnode->camera->name != 0 ? cnode->camera->name : "<unnamed>", camera_index);
-            }
+            node->camera_index = camera_map[cnode->camera - data->cameras];
+            if (verbose) printf("- - - Node camera: %s, index: %i\n", cnode->camera->name != 0 ? cnode->camera->name : "<unnamed>", node->camera_index);
         }
 
         //associate node with light
         if (cnode->light) {
-            int32_t light_index = -1;
-            for (int32_t j = 0; j < data->lights_count; ++j) {
-                if (data->lights + j == cnode->light) {
-                    light_index = j;
-                    break;
-                }
-            }
-            if (light_index == -1) { printf("- - - Node light index could not be found!"); }
-            else {
-                node->light_index = light_index;
-                if (verbose) printf("- - - Node light: %s, index: %i\n", cnode->light->name != 0 ? cnode->light->name : "<unnamed>", light_index);
-            }
+            node->light_index = light_map[cnode->light - data->lights];
+            if (verbose) printf("- - - Node light: %s, index: %i\n", cnode->light->name != 0 ? cnode->light->name : "<unnamed>", node->light_index);
         }
     }
 
     /*
      * Loading of the cameras.
      */
-    handle->cameras = OS_MALLOC(sizeof(struct mdl_camera) * data->cameras_count);
-    handle->cameras_count = data->cameras_count;
-    os_memset(handle->cameras, 0, sizeof(struct mdl_camera) * data->cameras_count);
-    if (verbose) printf("- Cameras count: %llu\n", (unsigned long long)data->cameras_count);
+    handle->cameras = OS_MALLOC(sizeof(struct mdl_camera) * cameras_count);
+    handle->cameras_count = cameras_count;
+    os_memset(handle->cameras, 0, sizeof(struct mdl_camera) * cameras_count);
+    if (verbose) printf("- Cameras count: %i\n", cameras_count);
 
     for (int32_t i = 0; i < data->cameras_count; ++i) {
+        if (camera_map[i] == -1) continue;
         struct cgltf_camera *ccamera = data->cameras + i;
-        struct mdl_camera *camera = handle->cameras + i;
+        struct mdl_camera *camera = handle->cameras + camera_map[i];
 
         if (ccamera->name != 0) {
             camera->name = OS_MALLOC(strlen(ccamera->name) + 1);
@@ -340,14 +570,15 @@ mdl_handle mdl_load(const char* path) {
     /*
      * Loading of the lights.
      */
-    handle->lights = OS_MALLOC(sizeof(struct mdl_light) * data->lights_count);
-    handle->lights_count = data->lights_count;
-    os_memset(handle->lights, 0, sizeof(struct mdl_light) * data->lights_count);
-    if (verbose) printf("- Lights count: %llu\n", (unsigned long long)data->lights_count);
+    handle->lights = OS_MALLOC(sizeof(struct mdl_light) * lights_count);
+    handle->lights_count = lights_count;
+    os_memset(handle->lights, 0, sizeof(struct mdl_light) * lights_count);
+    if (verbose) printf("- Lights count: %i\n", lights_count);
 
     for (int32_t i = 0; i < data->lights_count; ++i) {
+        if (light_map[i] == -1) continue;
         struct cgltf_light *clight = data->lights + i;
-        struct mdl_light *light = handle->lights + i;
+        struct mdl_light *light = handle->lights + light_map[i];
 
         if (clight->name != 0) {
             light->name = OS_MALLOC(strlen(clight->name) + 1);
@@ -389,14 +620,15 @@ mdl_handle mdl_load(const char* path) {
      * Loading of the meshes.
      */
 
-    handle->meshes = OS_MALLOC(sizeof(struct mdl_mesh) * data->meshes_count);
-    handle->meshes_count = data->meshes_count;
-    os_memset(handle->meshes, 0, sizeof(struct mdl_mesh) * data->meshes_count);
-    if (verbose) printf("- Meshes count: %llu\n", (unsigned long long)data->meshes_count);
+    handle->meshes = OS_MALLOC(sizeof(struct mdl_mesh) * meshes_count);
+    handle->meshes_count = meshes_count;
+    os_memset(handle->meshes, 0, sizeof(struct mdl_mesh) * meshes_count);
+    if (verbose) printf("- Meshes count: %i\n", meshes_count);
 
     for (int32_t i = 0; i < data->meshes_count; ++i) {
+        if (mesh_map[i] == -1) continue;
         cgltf_mesh *cmesh = data->meshes + i;
-        mdl_mesh *mesh = handle->meshes + i;
+        mdl_mesh *mesh = handle->meshes + mesh_map[i];
 
         if (cmesh->name != 0) {
             mesh->name = OS_MALLOC(strlen(cmesh->name) + 1);
@@ -500,6 +732,7 @@ mdl_handle mdl_load(const char* path) {
 
                 cgltf_accessor *attribute_accessor = cattribute->data;
                 attribute->offset = primitive->vertex_stride;
+                attribute->format = MDL_ATTRIBUTE_FORMAT_FLOAT32;
                 attribute->element_size = 4;
                 attribute->count = 0;
                 switch (attribute_accessor->type) {
@@ -524,6 +757,15 @@ mdl_handle mdl_load(const char* path) {
                         break;
                 }
 
+                //min/max of normalized integer positions are stored unnormalized, those are scanned instead
+                if (attribute->type == MDL_VERTEX_ATTRIBUTE_POSITION && attribute->count >= 3 &&
+                    attribute_accessor->has_min && attribute_accessor->has_max &&
+                    (attribute_accessor->component_type == cgltf_component_type_r_32f || !attribute_accessor->normalized)) {
+                    primitive->bounds_valid = true;
+                    os_memcpy(primitive->bounds_min, attribute_accessor->min, sizeof(float) * 3);
+                    os_memcpy(primitive->bounds_max, attribute_accessor->max, sizeof(float) * 3);
+                }
+
                 primitive->vertex_stride += attribute->element_size * attribute->count;
                 primitive->vertices_count = attribute_accessor->count;
                 if (verbose)
@@ -555,17 +797,7 @@ mdl_handle mdl_load(const char* path) {
             }
 
             //associate material
-            int32_t material_id = -1;
-            if (cprimitive->material != 0) {
-                for (int32_t k = 0; k < data->materials_count; ++k) {
-                    cgltf_material *mat = data->materials + k;
-                    if (mat == cprimitive->material) {
-                        material_id = k;
-                        break;
-                    }
-                }
-            }
-            primitive->material_id = material_id;
+            primitive->material_id = cprimitive->material != 0 ? material_map[cprimitive->material - data->materials] : -1;
 
             //Todo: material mappings?
         }
@@ -575,10 +807,10 @@ mdl_handle mdl_load(const char* path) {
     /*
      * Loading of the materials.
      */
-    handle->materials_count = data->materials_count > 0 ? data->materials_count : 1;
+    handle->materials_count = materials_count > 0 ? materials_count : 1;
     handle->materials = OS_MALLOC(sizeof(struct mdl_material) * handle->materials_count);
     os_memset(handle->materials, 0, sizeof(struct mdl_material) * handle->materials_count);
-    if (data->materials_count == 0) {
+    if (materials_count == 0) {
         mdl_material *mat = handle->materials;
         mat->valid = true;
         mat->color_texture_id = -1;
@@ -589,11 +821,12 @@ mdl_handle mdl_load(const char* path) {
         mat->roughness_factor = 0.6f;
         mat->metallic_factor = 0.0f;
     }
-    if (verbose) printf("- Materials count: %llu\n", (unsigned long long)data->materials_count);
+    if (verbose) printf("- Materials count: %i\n", materials_count);
 
     for (int32_t i = 0; i < data->materials_count; ++i) {
+        if (material_map[i] == -1) continue;
         cgltf_material *cmat = data->materials + i;
-        mdl_material *mat = handle->materials + i;
+        mdl_material *mat = handle->materials + material_map[i];
         mat->valid = false;
 
         if (cmat->name != 0) {
@@ -613,12 +846,7 @@ mdl_handle mdl_load(const char* path) {
             if (cmat->pbr_metallic_roughness.base_color_texture.texture != NULL) {
                 cgltf_image *cimg = cmat->pbr_metallic_roughness.base_color_texture.texture->image;
                 if (cimg != NULL) {
-                    for (int32_t k = 0; k < (int32_t)data->images_count; ++k) {
-                        if (data->images + k == cimg) {
-                            mat->color_texture_id = k;
-                            break;
-                        }
-                    }
+                    mat->color_texture_id = image_map[cimg - data->images];
                 }
             }
             mat->metallic_factor = cmat->pbr_metallic_roughness.metallic_factor;
@@ -641,10 +869,10 @@ mdl_handle mdl_load(const char* path) {
      * Loading of the textures (embedded images via buffer_view, or external URIs).
      * Must happen before cgltf_free() while buffer_view data is still valid.
      */
-    handle->textures_count = (int32_t)data->images_count;
-    if (data->images_count > 0) {
-        handle->textures = OS_MALLOC(sizeof(mdl_texture) * data->images_count);
-        os_memset(handle->textures, 0, sizeof(mdl_texture) * data->images_count);
+    handle->textures_count = images_count;
+    if (images_count > 0) {
+        handle->textures = OS_MALLOC(sizeof(mdl_texture) * images_count);
+        os_memset(handle->textures, 0, sizeof(mdl_texture) * images_count);
 
         /* Extract base directory from path for external URI resolution */
         char dir_buf[512];
@@ -661,24 +889,40 @@ mdl_handle mdl_load(const char* path) {
         }
 
         for (int32_t i = 0; i < (int32_t)data->images_count; ++i) {
+            if (image_map[i] == -1) continue;
             cgltf_image *cimg = data->images + i;
-            mdl_texture *tex  = handle->textures + i;
+            mdl_texture *tex  = handle->textures + image_map[i];
             tex->valid = false;
 
             int w = 0, h = 0, ch = 0;
             unsigned char *pixels = NULL;
 
+            bool ktx2 = (cimg->mime_type != NULL && strcmp(cimg->mime_type, "image/ktx2") == 0) ||
+                        (cimg->uri != NULL && mdl_has_extension(cimg->uri, ".ktx2"));
+
             if (cimg->buffer_view != NULL) {
                 /* Embedded image (base64-decoded or .glb buffer) */
                 unsigned char *src = (unsigned char *)cimg->buffer_view->buffer->data
                                      + cimg->buffer_view->offset;
-                pixels = stbi_load_from_memory(src, (int)cimg->buffer_view->size,
-                                               &w, &h, &ch, 4);
+                if (ktx2 || ktx2_is_ktx2(src, cimg->buffer_view->size))
+                    ktx2_load_texture(src, cimg->buffer_view->size, tex);
+                else
+                    pixels = stbi_load_from_memory(src, (int)cimg->buffer_view->size,
+                                                   &w, &h, &ch, 4);
             } else if (cimg->uri != NULL) {
                 /* External file URI — resolve relative to the .gltf directory */
                 char full_path[512];
                 snprintf(full_path, sizeof(full_path), "%s%s", dir_buf, cimg->uri);
-                pixels = stbi_load(full_path, &w, &h, &ch, 4);
+                if (ktx2) {
+                    uint64_t file_size = 0;
+                    void *file = os_file_map(full_path, &file_size);
+                    if (file != NULL) {
+                        ktx2_load_texture(file, file_size, tex);
+                        os_file_unmap(file, file_size);
+                    }
+                } else {
+                    pixels = stbi_load(full_path, &w, &h, &ch, 4);
+                }
             }
 
             if (pixels) {
@@ -689,82 +933,180 @@ mdl_handle mdl_load(const char* path) {
                 tex->buffer   = OS_MALLOC(tex->size);
                 os_memcpy(tex->buffer, pixels, tex->size);
                 stbi_image_free(pixels);
+                tex->format = MDL_TEXTURE_FORMAT_RGBA8;
+                tex->srgb = true;
+                tex->levels_count = 1;
+                tex->level_offsets[0] = 0;
+                tex->level_sizes[0] = (uint32_t)tex->size;
                 tex->valid = true;
                 printf("- Loaded image %i: %ix%i\n", i, w, h);
+            } else if (tex->valid) {
+                printf("- Loaded ktx2 image %i: %ix%i, %i levels\n", i, tex->width, tex->height, tex->levels_count);
             } else {
-                fprintf(stderr, "- Failed to load image %i: %s\n", i, stbi_failure_reason());
+                fprintf(stderr, "- Failed to load image %i: %s\n", i, ktx2 ? "ktx2 error" : stbi_failure_reason());
             }
         }
     }
 
+    OS_FREE(node_state);
+    OS_FREE(remap);
     OS_FREE(buffer);
     cgltf_free(data);
     return handle;
 }
 
+int32_t mdl_primitive_indices_total(mdl_primitive const* primitive)
+{
+    if (primitive->lods_count == 0) return primitive->indices_count;
+    mdl_lod const* last = primitive->lods + primitive->lods_count - 1;
+    return (int32_t)(last->index_offset + last->index_count);
+}
+
+static uint64_t mdl_hash_add(uint64_t hash, void const* data, uint64_t size)
+{
+    //fnv over words, the folded high half lets every bit reach the low ones
+    uint8_t const* bytes = data;
+    uint64_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+uint64_t mdl_geometry_hash(mdl_data const* model)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (int32_t i = 0; i < model->meshes_count; ++i) {
+        for (uint32_t j = 0; j < model->meshes[i].primitives_count; ++j) {
+            mdl_primitive const* primitive = model->meshes[i].primitives + j;
+            int32_t indices_total = mdl_primitive_indices_total(primitive);
+            int32_t layout[4] = { i, (int32_t)primitive->vertex_stride, primitive->vertices_count, indices_total };
+            hash = mdl_hash_add(hash, layout, sizeof(layout));
+            if (primitive->vertices != 0)
+                hash = mdl_hash_add(hash, primitive->vertices, (uint64_t)primitive->vertex_stride * (uint64_t)primitive->vertices_count);
+            if (primitive->indices != 0)
+                hash = mdl_hash_add(hash, primitive->indices, sizeof(uint32_t) * (uint64_t)indices_total);
+        }
+    }
+    return hash != 0 ? hash : 1;
+}
+
+mdl_backing* mdl_backing_create(void* base, uint64_t size)
+{
+    mdl_backing* backing = OS_MALLOC(sizeof(mdl_backing));
+    backing->base = base;
+    backing->size = size;
+    backing->references = 1;
+    return backing;
+}
+
+mdl_backing* mdl_backing_retain(mdl_backing* backing)
+{
+    if (backing != 0)
+        backing->references++;
+    return backing;
+}
+
+void mdl_backing_release(mdl_backing* backing)
+{
+    if (backing == 0 || --backing->references > 0)
+        return;
+    os_file_unmap(backing->base, backing->size);
+    OS_FREE(backing);
+}
+
+bool mdl_backing_contains(mdl_backing const* backing, void const* ptr)
+{
+    return backing != 0 && (char const*)ptr >= (char const*)backing->base &&
+           (char const*)ptr < (char const*)backing->base + backing->size;
+}
+
+static void mdl_free(mdl_handle data, void* ptr)
+{
+    //baked assets point names and buffers into the file mapping
+    if (mdl_backing_contains(data->backing, ptr))
+        return;
+    if (ptr != 0)
+        OS_FREE(ptr);
+}
+
+void mdl_primitive_release(mdl_handle handle, mdl_primitive* primitive)
+{
+    mdl_free(handle, primitive->vertices);
+    mdl_free(handle, primitive->indices);
+    primitive->vertices = 0;
+    primitive->indices = 0;
+}
+
 void mdl_unload(mdl_handle data) {
 
     for(int32_t i=0; i<data->nodes_count; ++i)
     {
         mdl_node* node = data->nodes + i;
-        OS_FREE(node->name);
-        if(node->children_id != 0)
-            OS_FREE(node->children_id);
+        mdl_free(data, node->name);
+        mdl_free(data, node->children_id);
     }
-    OS_FREE(data->nodes);
+    mdl_free(data, data->nodes);
 
     for(int32_t i=0; i<data->meshes_count; ++i)
     {
         mdl_mesh * mesh = data->meshes + i;
-        OS_FREE(mesh->name);
+        mdl_free(data, mesh->name);
 
         for(int32_t j=0; j<mesh->primitives_count; ++j)
         {
             mdl_primitive * primitive = mesh->primitives + j;
-            OS_FREE(primitive->attributes);
-            OS_FREE(primitive->indices);
-            OS_FREE(primitive->vertices);
+            mdl_free(data, primitive->attributes);
+            mdl_free(data, primitive->indices);
+            mdl_free(data, primitive->vertices);
+            mdl_free(data, primitive->lods);
         }
 
-        OS_FREE(mesh->primitives);
+        mdl_free(data, mesh->primitives);
     }
-    OS_FREE(data->meshes);
+    mdl_free(data, data->meshes);
 
     for(int32_t i=0; i<data->cameras_count; ++i) {
         struct mdl_camera *camera = data->cameras + i;
-        OS_FREE(camera->name);
+        mdl_free(data, camera->name);
 
     }
-    OS_FREE(data->cameras);
+    mdl_free(data, data->cameras);
 
 
     for(int32_t i=0; i<data->lights_count; ++i) {
         struct mdl_light *light = data->lights + i;
-        OS_FREE(light->name);
+        mdl_free(data, light->name);
 
     }
-
-    if(data->lights != 0)
-        OS_FREE(data->lights);
+    mdl_free(data, data->lights);
 
     for(int32_t i=0; i<data->materials_count; ++i) {
         mdl_material *material = data->materials + i;
-        OS_FREE(material->name);
+        mdl_free(data, material->name);
 
     }
-    OS_FREE(data->materials);
+    mdl_free(data, data->materials);
 
     for(int32_t i=0; i<data->textures_count; ++i) {
         mdl_texture *texture = data->textures + i;
-        OS_FREE(texture->name);
-        OS_FREE(texture->buffer);
+        mdl_free(data, texture->name);
+        mdl_free(data, texture->buffer);
     }
+    mdl_free(data, data->textures);
+
+    for(int32_t i=0; i<data->joints_count; ++i)
+        mdl_free(data, data->joints[i].name);
+    mdl_free(data, data->joints);
 
-    if(data->textures != 0)
-        OS_FREE(data->textures);
+    mdl_free(data, data->name);
 
-    if(data->name != 0)
-        OS_FREE(data->name);
+    mdl_backing_release(data->backing);
 
     OS_FREE(data);
 }
@@ -41,6 +41,15 @@ typedef enum mdl_light_type{
     MDL_LIGHT_INVALID
 } mdl_light_type;
 
+typedef enum mdl_joint_type{
+    MDL_JOINT_FIXED,
+    MDL_JOINT_REVOLUTE,
+    MDL_JOINT_CONTINUOUS,
+    MDL_JOINT_PRISMATIC,
+    MDL_JOINT_FLOATING,
+    MDL_JOINT_PLANAR,
+} mdl_joint_type;
+
 typedef enum mdl_vertex_attribute_type{
     MDL_VERTEX_ATTRIBUTE_INVALID = 0,
     MDL_VERTEX_ATTRIBUTE_POSITION = 0x1,
@@ -52,6 +61,33 @@ typedef enum mdl_vertex_attribute_type{
     MDL_VERTEX_ATTRIBUTE_JOINTS = 0x40,
 } mdl_vertex_attribute_type;
 
+/*
+ * Storage format of one attribute component. The loaders produce float32,
+ * the baker quantizes normals, tangents, uvs and colors. Normalized formats map to [-1,1] or [0,1].
+ */
+typedef enum mdl_attribute_format{
+    MDL_ATTRIBUTE_FORMAT_FLOAT32 = 0,
+    MDL_ATTRIBUTE_FORMAT_FLOAT16,
+    MDL_ATTRIBUTE_FORMAT_SNORM16,
+    MDL_ATTRIBUTE_FORMAT_UNORM16,
+    MDL_ATTRIBUTE_FORMAT_SNORM8,
+    MDL_ATTRIBUTE_FORMAT_UNORM8,
+} mdl_attribute_format;
+
+#define MDL_MAXIMUM_TEXTURE_LEVELS 16
+
+/*
+ * Pixel storage of a texture. Block compressed formats store 4x4 texel blocks,
+ * 8 bytes per block for bc1, 16 bytes for bc3, bc5 and bc7.
+ */
+typedef enum mdl_texture_format{
+    MDL_TEXTURE_FORMAT_RGBA8,
+    MDL_TEXTURE_FORMAT_BC1,
+    MDL_TEXTURE_FORMAT_BC3,
+    MDL_TEXTURE_FORMAT_BC5,
+    MDL_TEXTURE_FORMAT_BC7,
+} mdl_texture_format;
+
 typedef struct mdl_texture{
     char *name;
     void * buffer;
@@ -61,6 +97,14 @@ typedef struct mdl_texture{
     int32_t height;
     int32_t channels;
     bool valid;
+
+    //mip levels are stored back to back in buffer, level 0 is the full size image
+    mdl_texture_format format;
+    //color is srgb encoded, linear data (normal maps, masks) is not
+    bool srgb;
+    int32_t levels_count;
+    uint32_t level_offsets[MDL_MAXIMUM_TEXTURE_LEVELS];
+    uint32_t level_sizes[MDL_MAXIMUM_TEXTURE_LEVELS];
 } mdl_texture;
 
 typedef struct mdl_material {
@@ -89,11 +133,22 @@ typedef struct mdl_camera{
 
 typedef struct mdl_attribute{
     mdl_vertex_attribute_type type;
+    mdl_attribute_format format;
     int32_t offset;
     int32_t count;
     int32_t element_size;
 } mdl_attribute;
 
+/*
+ * Simplified level of detail, a range of the primitive index buffer drawn with the same vertices.
+ * Error is the object space distance the simplification may move a surface by.
+ */
+typedef struct mdl_lod{
+    uint32_t index_offset;
+    uint32_t index_count;
+    float error;
+} mdl_lod;
+
 typedef struct mdl_primitive {
     enum mdl_primitive_type primitive_type;
 
@@ -109,8 +164,18 @@ typedef struct mdl_primitive {
 
     uint32_t vertex_stride;
     int32_t material_id;
+
+    //levels stored after the full index range in the same index array, sorted by increasing error
+    int32_t lods_count;
+    mdl_lod *lods;
+
+    //object space box of the positions when the file stores it (gltf accessor min/max), unset otherwise
+    bool bounds_valid;
+    float bounds_min[3];
+    float bounds_max[3];
 }mdl_primitive;
 
+
 typedef struct mdl_mesh
 {
     char* name;
@@ -139,6 +204,32 @@ typedef struct mdl_node{
     int32_t parent_id;
 } mdl_node;
 
+/*
+ * Kinematic joint, only filled by the urdf importer.
+ * The joint origin is the local trs of the joint node, the child link node sits
+ * under it with an identity transform, so the joint is driven through the child link local trs.
+ */
+typedef struct mdl_joint{
+    char* name;
+    mdl_joint_type joint_type;
+    float axis[3];
+    float lower, upper;
+
+    int32_t node_index;
+    int32_t child_node_index;
+} mdl_joint;
+
+/*
+ * File mapping of a baked asset. The model holds one reference, readers that keep pointing into the
+ * mapping after the model is unloaded (texture streamer) take their own. Not thread safe, retain and
+ * release from the thread that loads the models.
+ */
+typedef struct mdl_backing{
+    void* base;
+    uint64_t size;
+    int32_t references;
+} mdl_backing;
+
 typedef struct mdl_data{
 
     char * name;
@@ -160,11 +251,73 @@ typedef struct mdl_data{
 
     int32_t lights_count;
     mdl_light *lights;
+
+    int32_t joints_count;
+    mdl_joint *joints;
+
+    //mapped baked asset, buffers and names pointing inside it are not freed one by one
+    mdl_backing *backing;
+
+    //mdl_geometry_hash as stored by a baked asset, 0 when the model was not loaded from one
+    uint64_t geometry_hash;
 } mdl_data;
 
 typedef struct mdl_data* mdl_handle;
 
+/*
+ * Scene selection for mdl_load_ex. Non-negative values pick a glTF scene by index.
+ */
+#define MDL_SCENE_ALL -1        /* every node in the file (mdl_load behaviour) */
+#define MDL_SCENE_DEFAULT -2    /* the file's default scene, or the first scene */
+
+typedef struct mdl_load_options{
+    int32_t scene_index;
+
+    /*
+     * Node name filters, applied to whole subtrees. A trailing '*' matches by prefix.
+     * With include names set, only the matching subtrees are kept; excluded subtrees
+     * are always dropped. Meshes, materials and images referenced only from dropped
+     * nodes are never converted or decoded.
+     */
+    const char** include_nodes;
+    int32_t include_nodes_count;
+    const char** exclude_nodes;
+    int32_t exclude_nodes_count;
+} mdl_load_options;
+
+IBC_API void mdl_load_options_default(mdl_load_options* options);
+
+/*
+ * Loads .gltf/.glb files, .urdf robot descriptions, binary .stl meshes and baked .ibca assets.
+ * Scene selection and node filters only apply to gltf.
+ */
 IBC_API mdl_handle mdl_load(const char* path);
+IBC_API mdl_handle mdl_load_ex(const char* path, mdl_load_options const* options);
 IBC_API void mdl_unload(mdl_handle handle);
 
+/*
+ * Index count of the full level plus every lod range.
+ */
+IBC_API int32_t mdl_primitive_indices_total(mdl_primitive const* primitive);
+
+/*
+ * Hash of the layout, vertices and indices of every primitive, never 0. Files derived from the same
+ * geometry (asset, chunk cache) store it to find out they still belong together.
+ */
+IBC_API uint64_t mdl_geometry_hash(mdl_data const* model);
+
+/*
+ * Frees the vertices and indices of a primitive once they are uploaded, the rest of the model stays
+ * usable and unload skips them. Data mapped from a baked asset is left to unload.
+ */
+IBC_API void mdl_primitive_release(mdl_handle handle, mdl_primitive* primitive);
+
+/*
+ * Takes ownership of a file mapping with one reference. Retain passes 0 through, the last release unmaps.
+ */
+IBC_API mdl_backing* mdl_backing_create(void* base, uint64_t size);
+IBC_API mdl_backing* mdl_backing_retain(mdl_backing* backing);
+IBC_API void mdl_backing_release(mdl_backing* backing);
+IBC_API bool mdl_backing_contains(mdl_backing const* backing, void const* ptr);
+
 #endif //IBCWEB_MODEL_H
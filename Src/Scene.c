@@ -17,9 +17,15 @@
 #include "GroundRenderer.h"
 #include "BrdfLut.h"
 #include "PrefilterEnv.h"
+#include "TextureStreamer.h"
+#include "Bvh.h"
+#include "AssetCache.h"
+#include "ChunkCache.h"
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
 
 #ifdef __EMSCRIPTEN__
 #include <GL/gl.h>
@@ -27,12 +33,24 @@
 #include <GL/gl3w.h>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SCENE_SSE 1
+#endif
+
+#define SCENE_DEFAULT_ANISOTROPY 8.0f
+//vertex bytes of one geometry buffer, larger primitives get a buffer of their own
+#define SCENE_GEOMETRY_BUFFER_BYTES (64ll * 1024 * 1024)
+//512x512 rgb16, only reported to the asset cache
+#define SCENE_BRDF_LUT_BYTES (512ll * 512 * 6)
+//chunks outside the view count as this much farther away, so the ones in view are paged in first
+#define SCENE_CHUNK_HIDDEN_DISTANCE_SCALE 4.0f
+//the coarsest baked lod that moves the surface by less than this many pixels is drawn
+#define SCENE_LOD_PIXEL_ERROR 1.0f
+
 typedef struct scene_internal_node {
     char* name;
 
-    gl_mat world_tr;
-    gl_mat local_tr;
-
     int32_t local_id;
     int32_t parent_id;
 
@@ -41,11 +59,18 @@ typedef struct scene_internal_node {
     int32_t mesh_index;
     int32_t camera_index;
     int32_t light_index;
-} scene_internal_node;
 
-typedef struct scene_internal_texture{
-    gfx_texture_handle texture_handle;
-} scene_internal_texture;
+    //mesh merged into a static batch at load, the node no longer draws it
+    bool baked;
+    //the node or a descendant is baked, moving it would leave the batch behind
+    bool holds_baked;
+
+    //position in the node order, the subtree is order_index up to subtree_end
+    int32_t order_index;
+    int32_t subtree_end;
+    //local transform changed, the world matrices of the subtree are stale
+    bool dirty;
+} scene_internal_node;
 
 typedef struct scene_internal_pbr_material{
     bool valid;
@@ -56,44 +81,236 @@ typedef struct scene_internal_pbr_material{
     int32_t rough_texture_id;
     float roughness_factor;
 
-    int32_t model_uniform;
-    int32_t projection_uniform;
-    int32_t view_uniform;
-    int32_t view_position_uniform;
-    int32_t rougness_uniform;
-    int32_t metallic_uniform;
-    int32_t color_uniform;
+    //entry in the material block table, identical materials share one
+    int32_t block_index;
+} scene_internal_pbr_material;
+
+/*
+ * The Lit program shared by every material. Frame constants and the material table live in
+ * uniform buffers, a draw only sets its model matrix, material index and vertex color flag.
+ */
+typedef struct scene_internal_lit_program{
+    gfx_shader_handle shader;
+
+    gfx_buffer_handle frame_buffer;
+    gfx_buffer_handle material_buffer;
+    int32_t material_blocks_count;
+    int32_t unique_materials_count;
+
+    int32_t transforms_uniform;
+    int32_t instances_uniform;
+    int32_t instance_offset_uniform;
+    int32_t material_index_uniform;
+    int32_t has_vertex_color_uniform;
     int32_t skybox_uniform;
-    int32_t exposure_uniform;
     int32_t shadow_map_uniform;
-    int32_t light_space_uniform;
     int32_t brdf_lut_uniform;
     int32_t prefiltered_env_uniform;
     int32_t base_color_tex_uniform;
-    int32_t has_color_tex_uniform;
-    int32_t has_vertex_color_uniform;
+} scene_internal_lit_program;
 
-    gfx_shader_handle shader;
-} scene_internal_pbr_material;
+/*
+ * World matrices of all nodes in one rgba32f texture, the draws fetch theirs by node index.
+ * The cpu copy is the scene's only world transform array, the hierarchy update writes into it.
+ * Moved nodes widen the dirty range, which is uploaded before the next pass.
+ */
+typedef struct scene_internal_transforms{
+    gfx_texture_handle texture;
+    //world matrices in node order (the order_index of a node), the ground plane uses the last entry
+    float* data;
+    int32_t count;
+    int32_t rows;
+    int32_t dirty_begin;
+    int32_t dirty_end;
+} scene_internal_transforms;
 
-typedef struct scene_internal_mesh_primitive{
+/*
+ * A node drawing a primitive, the box is the primitive box in world space.
+ * Refreshed when transforms change.
+ */
+typedef struct scene_internal_instance{
+    //order_index of the node
+    int32_t transform_index;
+    int32_t mesh_index;
+    int32_t primitive_index;
+    float bounds_center[3];
+    float bounds_extent[3];
+} scene_internal_instance;
+
+/*
+ * Transform indices of the instances that passed culling in the current pass, 4 per rgba32f texel.
+ * Webgl has no base instance, so every draw reads its range from instance_offset on.
+ */
+typedef struct scene_internal_visible_instances{
+    gfx_texture_handle texture;
+    float* data;
+    int32_t rows;
+} scene_internal_visible_instances;
+
+/*
+ * Static primitives with the same vertex layout, packed into one vertex and one index buffer and
+ * drawn through the same lit, shadow and highlight pipelines. Indices are rebased on upload,
+ * so the draws only differ by their index range.
+ */
+//gpu copy of a geometry, shared by every scene built from the same primitives
+typedef struct scene_internal_geometry_buffers{
+    gfx_buffer_handle vertex_buffer;
+    gfx_buffer_handle index_buffer;
+} scene_internal_geometry_buffers;
+
+typedef struct scene_internal_geometry{
+    mdl_attribute* attributes;
+    int32_t attributes_count;
+    uint32_t vertex_stride;
+
+    int32_t vertices_count;
     int32_t indices_count;
-    int32_t material_id;
 
-    gfx_pipeline_handle pipeline_handle;
+    //chunk the geometry is paged in with, -1 when it is uploaded with the scene
+    int32_t chunk_index;
+    //owned by the asset cache, or by the scene for chunk geometries, the handles are copied out of it.
+    //Chunk geometries have no buffers and pipelines while their chunk is not resident.
+    scene_internal_geometry_buffers* buffers;
+    gfx_buffer_handle vertex_buffer;
+    gfx_buffer_handle index_buffer;
+    gfx_pipeline_handle pipeline;
+    //created by the first shadow or highlight draw of the geometry, 0 until then
     gfx_pipeline_handle shadow_pipeline;
     gfx_pipeline_handle highlight_pipeline;
-    gfx_buffer_handle buffer_handle;
-    gfx_buffer_handle index_handle;
+} scene_internal_geometry;
+
+/*
+ * Render queue entry, one per primitive and pass, instanced over every node holding the mesh.
+ * Items are sorted by key, from the top bits:
+ * pass(2) | program(2) | geometry(16) | material(16) | texture(16) | depth(12)
+ */
+typedef struct scene_internal_draw_item{
+    uint64_t key;
+    gfx_pipeline_handle pipeline;
+    int32_t material_id;
+    int32_t mesh_index;
+    int32_t primitive_index;
+    int32_t first_index;
+    int32_t indices_count;
+    gfx_draw_type draw_type;
+    bool has_vertex_color;
+    //false while the chunk of a streamed primitive is paged out, culling skips the item
+    bool resident;
+
+    //range of the instance array, shared by the shadow and lit item of a primitive
+    int32_t instances_begin;
+    int32_t instances_count;
+
+    //filled by culling for the current pass
+    int32_t visible_begin;
+    int32_t visible_count;
+    float screen_size;
+    //level of detail for the nearest visible instance, 0 draws the full index range
+    int32_t lod;
+} scene_internal_draw_item;
+
+/*
+ * Side planes of a view volume in structure of arrays form, ax/ay/az hold the absolute normals.
+ * Near and far are left out, depth clamping still draws what lies beyond them.
+ */
+typedef struct scene_internal_frustum{
+    float x[4], y[4], z[4], w[4];
+    float ax[4], ay[4], az[4];
+} scene_internal_frustum;
+
+typedef struct scene_internal_name_entry{
+    const char* name;
+    int32_t node_id;
+} scene_internal_name_entry;
+
+#define SCENE_NAME_EMPTY_SLOT -1
+
+/*
+ * A node primitive in the picking hierarchy, baked nodes keep theirs, batches are left out.
+ */
+typedef struct scene_internal_pick_item{
+    int32_t node_id;
+    int32_t mesh_index;
+    int32_t primitive_index;
+} scene_internal_pick_item;
+
+/*
+ * Edits since the consumers last cleared the journal, every node and material is listed once.
+ * The bounds cover the moved instances before and after the move. Instance boxes follow the listed
+ * nodes from bounds_cursor on, so only moved instances are refreshed.
+ */
+typedef struct scene_internal_journal{
+    uint32_t flags;
+    int32_t* nodes;
+    int32_t nodes_count;
+    bool* node_listed;
+    int32_t* materials;
+    int32_t materials_count;
+    bool* material_listed;
+
+    bool bounds_valid;
+    float bounds_min[3];
+    float bounds_max[3];
+    int32_t bounds_cursor;
+    int32_t pick_cursor;
+
+    //open transactions, material tables are rebuilt when the last one ends
+    int32_t transactions;
+    bool materials_dirty;
+} scene_internal_journal;
+
+#define SCENE_DRAW_PASS_SHADOW 0ull
+#define SCENE_DRAW_PASS_LIT 1ull
+#define SCENE_DRAW_KEY_DEPTH_MASK 0xFFFull
+
+typedef struct scene_internal_mesh_primitive{
+    int32_t indices_count;
+    int32_t material_id;
+
+    //location inside the geometry buffers
+    int32_t geometry_index;
+    //held by the chunk cache, the geometry is paged in with its chunk
+    bool streamed;
+    int32_t first_vertex;
+    int32_t first_index;
+    //baked levels of detail, index offsets are relative to first_index
+    mdl_lod* lods;
+    int32_t lods_count;
+
+    //range of a baked primitive inside its static batch, the outline of the node draws it
+    int32_t baked_batch;
+    int32_t baked_first_index;
+    int32_t baked_indices_count;
 
     gfx_draw_type draw_type;
     bool has_vertex_color;
+
+    //object space bounds of float positions
+    bool bounds_valid;
+    gl_vec3 bounds_min;
+    gl_vec3 bounds_max;
+
+    //cpu triangles for picking, kept when the scene is created with pick_triangles
+    float* pick_positions;
+    uint32_t* pick_indices;
+    int32_t pick_indices_count;
+    //built by the first ray that reaches the primitive box
+    bvh_handle triangles_bvh;
 } scene_internal_mesh_primitive;
 
 typedef struct scene_internal_mesh{
-    int32_t node_index;
+    //nodes holding the mesh, drawn as instances of each primitive
+    int32_t* node_ids;
+    int32_t nodes_count;
     int32_t primitives_count;
     scene_internal_mesh_primitive* primitives;
+    //only drawn through the static batches, its primitives get no geometry of their own
+    bool baked;
+
+    //object space bounds of float positions
+    bool bounds_valid;
+    gl_vec3 bounds_min;
+    gl_vec3 bounds_max;
 } scene_internal_mesh;
 
 typedef struct scene_internal_light{
@@ -116,9 +333,38 @@ typedef struct scene_internal_camera{
 } scene_internal_camera;
 
 
+/*
+ * Single allocation holding everything sized by the model. Blocks are 8 byte aligned, matrix blocks
+ * start on a cache line, an arena without a base only measures and hands out null blocks.
+ */
+#define SCENE_ARENA_ALIGNMENT 64
+
+typedef struct scene_internal_arena{
+    uint8_t* base;
+    size_t used;
+} scene_internal_arena;
+
 typedef struct scene_internal_data{
+    //allocation the arena was aligned inside, the handle heads the arena
+    void* arena_memory;
+
     uint32_t meshes_count;
     scene_internal_mesh* meshes;
+    //arena blocks the meshes take their primitives and node ids from
+    scene_internal_mesh_primitive* mesh_primitives;
+    uint32_t mesh_primitives_count;
+    mdl_lod* mesh_lods;
+    int32_t mesh_lods_count;
+    int32_t* mesh_node_ids;
+    scene_internal_geometry* geometries;
+    int32_t geometries_count;
+    int32_t geometries_capacity;
+    //geometry chunks streamed from disk, geometries of chunk i from chunk_geometries[i] up to chunk_geometries[i + 1]
+    chunk_cache_handle chunks;
+    int32_t* chunk_geometries;
+    //world space batches of the baked nodes, the last meshes of the array
+    int32_t static_batches_count;
+    int32_t static_nodes_count;
 
     uint32_t root_nodes_count;
     scene_internal_node** root_nodes;
@@ -128,139 +374,1776 @@ typedef struct scene_internal_data{
 
     uint32_t nodes_count;
     scene_internal_node* nodes;
+    //arena block the nodes take their children from
+    int32_t* children_ids;
+    //node names interned in one pool, the table maps a name to the first node holding it
+    char* names;
+    int32_t* name_table;
+    uint32_t name_table_capacity;
+    //named nodes sorted by name, nodes sharing a prefix form one range
+    scene_internal_name_entry* sorted_names;
+    int32_t sorted_names_count;
+    //local transforms in node order like the world matrices, the update streams through both
+    gl_mat* local_trs;
+    //node ids with every parent before its children, the world update walks it forward
+    int32_t* node_order;
+    //order index of the parent of every order index, -1 for roots
+    int32_t* order_parents;
+    //order range holding all dirty subtrees, empty when the world matrices are current
+    int32_t dirty_order_begin;
+    int32_t dirty_order_end;
+    scene_internal_transforms transforms;
 
     uint32_t materials_count;
     scene_internal_pbr_material* materials;
+    scene_internal_lit_program lit;
+
+    //shadow items first, then the lit ones, rebuilt when materials change
+    scene_internal_draw_item* draw_items;
+    int32_t draw_items_count;
+    int32_t shadow_items_count;
+    bool draw_items_dirty;
+    bool draw_items_bounds_dirty;
+    scene_internal_instance* instances;
+    int32_t instances_count;
+    //instances of each transform index (node order), node_instances_begin[i] up to node_instances_begin[i + 1]
+    int32_t* node_instances;
+    int32_t* node_instances_begin;
+    scene_internal_journal journal;
+
+    //picking hierarchy, built by the first query and refitted from the journal
+    bool pick_triangles;
+    bvh_handle pick_bvh;
+    scene_internal_pick_item* pick_items;
+    int32_t pick_items_count;
+    int32_t* node_pick_begin;
+    int32_t* pick_results;
+    //query stamps per node, a node is reported once per query
+    uint32_t* node_marks;
+    uint32_t node_mark;
+    scene_internal_visible_instances visible;
+    scene_draw_stats draw_stats;
+
+    //texture ids are model texture indices
+    uint32_t textures_count;
+    texture_streamer_handle texture_streamer;
+    float texture_anisotropy;
+
+    uint32_t cameras_count;
+    scene_internal_camera* cameras;
+
+    uint32_t lights_count;
+    scene_internal_light* lights;
+
+    int32_t active_camera_node;
+
+    skybox_handle skybox;
+    bool skybox_enabled;
+    bool skybox_render;
+    bool plane_render;
+
+    shadow_renderer shadow;
+    ground_renderer ground;
+    gfx_texture_handle brdf_lut;
+    uint32_t prefiltered_env_id;   /* raw GL cubemap — 0 when no skybox */
+
+    /* Selection + highlight */
+    int32_t selected_node_id;
+    gfx_shader_handle highlight_shader;
+    int32_t hl_model_u, hl_view_u, hl_proj_u, hl_color_u, hl_scale_u;
+} scene_internal_data;
+
+static gfx_attribute_format scene_attribute_format(mdl_attribute_format format) {
+    switch (format) {
+        case MDL_ATTRIBUTE_FORMAT_FLOAT16: return GFX_ATTRIBUTE_FORMAT_HALF;
+        case MDL_ATTRIBUTE_FORMAT_SNORM16: return GFX_ATTRIBUTE_FORMAT_SNORM16;
+        case MDL_ATTRIBUTE_FORMAT_UNORM16: return GFX_ATTRIBUTE_FORMAT_UNORM16;
+        case MDL_ATTRIBUTE_FORMAT_SNORM8: return GFX_ATTRIBUTE_FORMAT_SNORM8;
+        case MDL_ATTRIBUTE_FORMAT_UNORM8: return GFX_ATTRIBUTE_FORMAT_UNORM8;
+        case MDL_ATTRIBUTE_FORMAT_FLOAT32:
+        default: return GFX_ATTRIBUTE_FORMAT_FLOAT;
+    }
+}
+
+//the texture says whether it is srgb (ktx2 carries it per file), bc5 holds two linear channels (normal maps)
+static gfx_texture_type scene_texture_type(mdl_texture const* texture) {
+    switch (texture->format) {
+        case MDL_TEXTURE_FORMAT_BC1: return texture->srgb ? GFX_TEXTURE_TYPE_BC1_SRGB : GFX_TEXTURE_TYPE_BC1;
+        case MDL_TEXTURE_FORMAT_BC3: return texture->srgb ? GFX_TEXTURE_TYPE_BC3_SRGB : GFX_TEXTURE_TYPE_BC3;
+        case MDL_TEXTURE_FORMAT_BC5: return GFX_TEXTURE_TYPE_BC5;
+        case MDL_TEXTURE_FORMAT_BC7: return texture->srgb ? GFX_TEXTURE_TYPE_BC7_SRGB : GFX_TEXTURE_TYPE_BC7;
+        case MDL_TEXTURE_FORMAT_RGBA8:
+        default: return texture->srgb ? GFX_TEXTURE_TYPE_SRGBA : GFX_TEXTURE_TYPE_RGBA;
+    }
+}
+
+static void* scene_arena_take_aligned(scene_internal_arena* arena, size_t size, size_t alignment) {
+    arena->used = (arena->used + alignment - 1) & ~(alignment - 1);
+    void* block = arena->base != 0 ? arena->base + arena->used : 0;
+    arena->used += (size + 7) & ~(size_t)7;
+    return block;
+}
+
+static void* scene_arena_take(scene_internal_arena* arena, size_t size) {
+    return scene_arena_take_aligned(arena, size, 8);
+}
+
+static gl_mat* scene_world_tr(scene_handle handle, int32_t node_id) {
+    return (gl_mat*)(handle->transforms.data + (size_t)handle->nodes[node_id].order_index * 16);
+}
+
+static gl_mat* scene_local_tr(scene_handle handle, int32_t node_id) {
+    return handle->local_trs + handle->nodes[node_id].order_index;
+}
+
+static void scene_primitive_bounds_set(scene_internal_mesh* mesh, scene_internal_mesh_primitive* result,
+                                       float const low[3], float const high[3]) {
+    result->bounds_valid = true;
+    result->bounds_min = gl_vec3_new(low[0], low[1], low[2]);
+    result->bounds_max = gl_vec3_new(high[0], high[1], high[2]);
+    if (!mesh->bounds_valid) {
+        mesh->bounds_min = result->bounds_min;
+        mesh->bounds_max = result->bounds_max;
+        mesh->bounds_valid = true;
+    }
+    for (int32_t c = 0; c < 3; ++c) {
+        mesh->bounds_min.data[c] = gl_min(mesh->bounds_min.data[c], low[c]);
+        mesh->bounds_max.data[c] = gl_max(mesh->bounds_max.data[c], high[c]);
+    }
+}
+
+/*
+ * Box of the position stream, the vertices_count > 0 positions start offset bytes into each vertex.
+ */
+static void scene_positions_bounds(uint8_t const* vertices, int32_t vertices_count, uint32_t stride, int32_t offset,
+                                   float low[3], float high[3]) {
+#ifdef SCENE_SSE
+    //a 4 float load may read past the last vertex, that one is gathered lane by lane
+    int32_t loadable = offset + 4 * (int32_t)sizeof(float) <= (int32_t)stride ? vertices_count : vertices_count - 1;
+    float const* first = (float const*)(vertices + offset);
+    __m128 min = _mm_setr_ps(first[0], first[1], first[2], 0.0f), max = min;
+    for (int32_t v = 0; v < vertices_count; ++v) {
+        float const* p = (float const*)(vertices + (size_t)v * stride + offset);
+        __m128 position = v < loadable ? _mm_loadu_ps(p) : _mm_setr_ps(p[0], p[1], p[2], 0.0f);
+        min = _mm_min_ps(min, position);
+        max = _mm_max_ps(max, position);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, min);
+    os_memcpy(low, lanes, sizeof(float) * 3);
+    _mm_storeu_ps(lanes, max);
+    os_memcpy(high, lanes, sizeof(float) * 3);
+#else
+    os_memcpy(low, vertices + offset, sizeof(float) * 3);
+    os_memcpy(high, vertices + offset, sizeof(float) * 3);
+    for (int32_t v = 1; v < vertices_count; ++v) {
+        float const* p = (float const*)(vertices + (size_t)v * stride + offset);
+        for (int32_t c = 0; c < 3; ++c) {
+            low[c] = p[c] < low[c] ? p[c] : low[c];
+            high[c] = p[c] > high[c] ? p[c] : high[c];
+        }
+    }
+#endif
+}
+
+//the box stored with the model when there is one, otherwise a scan of the positions (static batches)
+static void scene_primitive_bounds(scene_internal_mesh* mesh, scene_internal_mesh_primitive* result, mdl_primitive const* primitive) {
+    if (primitive->bounds_valid) {
+        scene_primitive_bounds_set(mesh, result, primitive->bounds_min, primitive->bounds_max);
+        return;
+    }
+    for (int32_t a = 0; a < primitive->attributes_count; ++a) {
+        mdl_attribute const* attr = primitive->attributes + a;
+        if (attr->type != MDL_VERTEX_ATTRIBUTE_POSITION || attr->format != MDL_ATTRIBUTE_FORMAT_FLOAT32 || attr->count < 3)
+            continue;
+        if (primitive->vertices_count <= 0 || primitive->vertices == 0) return;
+
+        float low[3], high[3];
+        scene_positions_bounds(primitive->vertices, primitive->vertices_count, primitive->vertex_stride, attr->offset,
+                               low, high);
+        scene_primitive_bounds_set(mesh, result, low, high);
+        return;
+    }
+}
+
+/*
+ * Diameter in pixels of the mesh bounding sphere, the texel density a material on it needs.
+ */
+static float scene_mesh_screen_size(scene_internal_mesh const* mesh, gl_mat const* world, float const* projection,
+                                    gl_vec3 view_pos, float viewport_height) {
+    if (!mesh->bounds_valid) return viewport_height;
+
+    gl_vec3 center = gl_vec3_new((mesh->bounds_min.x + mesh->bounds_max.x) * 0.5f,
+                                 (mesh->bounds_min.y + mesh->bounds_max.y) * 0.5f,
+                                 (mesh->bounds_min.z + mesh->bounds_max.z) * 0.5f);
+    float radius = gl_vec3_norm(gl_vec3_sub(mesh->bounds_max, center));
+    float scale = 0.0f;
+    for (int32_t c = 0; c < 3; ++c) {
+        gl_vec4 axis = gl_mat_column_get(world, c);
+        scale = gl_max(scale, gl_vec_norm(axis.data, 3));
+    }
+    radius *= scale;
+
+    //projection[5] is the vertical focal scale, projection[15] is 1 for ortographic cameras
+    float pixels = radius * projection[5] * viewport_height;
+    if (projection[15] == 0.0f) {
+        float distance = gl_vec3_norm(gl_vec3_sub(gl_mat_mul_vec(*world, center), view_pos));
+        pixels /= gl_max(distance, radius);
+    }
+    return pixels;
+}
+
+/*
+ * Pixels an object space unit of the instance covers at its distance, lod errors are scaled by it.
+ */
+static float scene_lod_pixels(gl_mat const* world, gl_vec3 center, float const* projection, gl_vec3 view_pos,
+                              float viewport_height) {
+    float scale = 0.0f;
+    for (int32_t c = 0; c < 3; ++c) {
+        gl_vec4 axis = gl_mat_column_get(world, c);
+        scale = gl_max(scale, gl_vec_norm(axis.data, 3));
+    }
+    float pixels = scale * projection[5] * viewport_height * 0.5f;
+    if (projection[15] == 0.0f)
+        pixels /= gl_max(gl_vec3_norm(gl_vec3_sub(center, view_pos)), 1e-4f);
+    return pixels;
+}
+
+static const char* scene_attribute_name(mdl_vertex_attribute_type type) {
+    switch (type) {
+        case MDL_VERTEX_ATTRIBUTE_POSITION: return ATTR_POSITION_NAME;
+        case MDL_VERTEX_ATTRIBUTE_UV: return ATTR_UV_NAME;
+        case MDL_VERTEX_ATTRIBUTE_NORMAL: return ATTR_NORMAL_NAME;
+        case MDL_VERTEX_ATTRIBUTE_COLOR: return ATTR_COLOR_NAME;
+        case MDL_VERTEX_ATTRIBUTE_TANGENT: return ATTR_TANGENT_NAME;
+        case MDL_VERTEX_ATTRIBUTE_INVALID:
+        default: return 0;
+    }
+}
+
+/*
+ * Vertex array over a geometry's buffers binding the attributes in the mask. Primitives sharing
+ * a geometry share its pipelines, the geometry already groups equal buffers and layouts.
+ */
+static gfx_pipeline_handle scene_geometry_pipeline_create(scene_internal_geometry const* geometry, gfx_shader_handle shader,
+                                                          uint32_t attributes_mask) {
+    gfx_pipeline_handle pipeline = gfx_pipeline_create(shader);
+    for (int32_t i = 0; i < geometry->attributes_count; ++i) {
+        mdl_attribute const* attr = geometry->attributes + i;
+        const char *attribute_name = scene_attribute_name(attr->type);
+        if (attribute_name == 0 || (attr->type & attributes_mask) == 0) continue;
+
+        gfx_pipeline_attr_enable_format(pipeline, attribute_name, geometry->vertex_buffer,
+                                        scene_attribute_format(attr->format), attr->count, attr->offset,
+                                        geometry->vertex_stride);
+    }
+    gfx_pipeline_index_enable(pipeline, geometry->index_buffer);
+    gfx_pipeline_submit(pipeline);
+    return pipeline;
+}
+
+//shadow pipelines read the position only
+static gfx_pipeline_handle scene_geometry_shadow_pipeline(scene_handle handle, scene_internal_geometry* geometry) {
+    if (geometry->shadow_pipeline == 0)
+        geometry->shadow_pipeline = scene_geometry_pipeline_create(geometry, handle->shadow.shader, MDL_VERTEX_ATTRIBUTE_POSITION);
+    return geometry->shadow_pipeline;
+}
+
+//the outline extrudes positions along the normals
+static gfx_pipeline_handle scene_geometry_highlight_pipeline(scene_handle handle, scene_internal_geometry* geometry) {
+    if (geometry->highlight_pipeline == 0)
+        geometry->highlight_pipeline = scene_geometry_pipeline_create(geometry, handle->highlight_shader,
+                                                                      MDL_VERTEX_ATTRIBUTE_POSITION | MDL_VERTEX_ATTRIBUTE_NORMAL);
+    return geometry->highlight_pipeline;
+}
+
+static void scene_geometry_pipelines_destroy(scene_internal_geometry* geometry) {
+    if (geometry->pipeline != 0)
+        gfx_pipeline_destroy(geometry->pipeline);
+    if (geometry->shadow_pipeline != 0)
+        gfx_pipeline_destroy(geometry->shadow_pipeline);
+    if (geometry->highlight_pipeline != 0)
+        gfx_pipeline_destroy(geometry->highlight_pipeline);
+    geometry->pipeline = geometry->shadow_pipeline = geometry->highlight_pipeline = 0;
+}
+
+//chunk primitives are only drawn while their chunk is paged in
+static bool scene_primitive_resident(scene_handle handle, scene_internal_mesh_primitive const* primitive) {
+    return primitive->geometry_index != -1 && handle->geometries[primitive->geometry_index].vertex_buffer != 0;
+}
+
+static bool scene_layout_equal(mdl_attribute const* attributes, int32_t attributes_count, uint32_t vertex_stride,
+                               mdl_primitive const* primitive) {
+    if (vertex_stride != primitive->vertex_stride || attributes_count != primitive->attributes_count)
+        return false;
+    for (int32_t i = 0; i < primitive->attributes_count; ++i) {
+        mdl_attribute const* a = attributes + i;
+        mdl_attribute const* b = primitive->attributes + i;
+        if (a->type != b->type || a->format != b->format || a->offset != b->offset || a->count != b->count)
+            return false;
+    }
+    return true;
+}
+
+static bool scene_geometry_layout_equal(scene_internal_geometry const* geometry, mdl_primitive const* primitive) {
+    return scene_layout_equal(geometry->attributes, geometry->attributes_count, geometry->vertex_stride, primitive);
+}
+
+/*
+ * Places the primitive in the first geometry of its chunk with its layout and room for its vertices, or starts
+ * a new one. Chunks are assigned one after another, so the search starts at the first geometry of the chunk.
+ * Only sizes are counted here, scene_geometry_upload fills the buffers.
+ */
+static void scene_geometry_assign(scene_handle handle, mdl_primitive const* primitive, scene_internal_mesh_primitive* result,
+                                  int32_t chunk_index) {
+    int64_t bytes = (int64_t)primitive->vertex_stride * primitive->vertices_count;
+    int32_t index = chunk_index != -1 ? handle->chunk_geometries[chunk_index] : 0;
+    for (; index < handle->geometries_count; ++index) {
+        scene_internal_geometry const* geometry = handle->geometries + index;
+        if (geometry->chunk_index == chunk_index && scene_geometry_layout_equal(geometry, primitive) &&
+            (int64_t)geometry->vertex_stride * geometry->vertices_count + bytes <= SCENE_GEOMETRY_BUFFER_BYTES)
+            break;
+    }
+
+    if (index == handle->geometries_count) {
+        if (handle->geometries_count == handle->geometries_capacity) {
+            handle->geometries_capacity = handle->geometries_capacity > 0 ? handle->geometries_capacity * 2 : 8;
+            handle->geometries = OS_REALLOC(handle->geometries, sizeof(scene_internal_geometry) * handle->geometries_capacity);
+        }
+        scene_internal_geometry* geometry = handle->geometries + handle->geometries_count++;
+        os_memset(geometry, 0, sizeof(scene_internal_geometry));
+        geometry->chunk_index = chunk_index;
+        geometry->vertex_stride = primitive->vertex_stride;
+        geometry->attributes_count = primitive->attributes_count;
+        geometry->attributes = OS_MALLOC(sizeof(mdl_attribute) * (primitive->attributes_count + 1));
+        os_memcpy(geometry->attributes, primitive->attributes, sizeof(mdl_attribute) * primitive->attributes_count);
+    }
+
+    scene_internal_geometry* geometry = handle->geometries + index;
+    result->geometry_index = index;
+    result->first_vertex = geometry->vertices_count;
+    result->first_index = geometry->indices_count;
+    geometry->vertices_count += primitive->vertices_count;
+    geometry->indices_count += mdl_primitive_indices_total(primitive);
+}
+
+//empty buffers sized for every primitive of the geometry
+static scene_internal_geometry_buffers* scene_geometry_buffers_create(scene_internal_geometry const* geometry) {
+    scene_internal_geometry_buffers* buffers = OS_MALLOC(sizeof(scene_internal_geometry_buffers));
+    buffers->vertex_buffer = gfx_buffer_create(GFX_BUFFER_VERTEX, GFX_BUFFER_UPDATE_STATIC_DRAW, 0,
+                                               (int32_t)(geometry->vertex_stride * geometry->vertices_count));
+    buffers->index_buffer = gfx_buffer_create(GFX_BUFFER_INDEX, GFX_BUFFER_UPDATE_STATIC_DRAW, 0,
+                                              (int32_t)(sizeof(uint32_t) * geometry->indices_count));
+    return buffers;
+}
+
+/*
+ * Writes a primitive at its place in the geometry buffers, indices get the first vertex of the primitive
+ * added in a scratch array that grows to the largest primitive.
+ */
+static void scene_geometry_write(scene_internal_geometry const* geometry, scene_internal_mesh_primitive const* primitive,
+                                 void const* vertices, int32_t vertices_count, uint32_t const* indices, int32_t indices_total,
+                                 uint32_t** scratch, int32_t* scratch_capacity) {
+    if (indices_total > *scratch_capacity) {
+        *scratch_capacity = indices_total;
+        *scratch = OS_REALLOC(*scratch, sizeof(uint32_t) * *scratch_capacity);
+    }
+    for (int32_t k = 0; k < indices_total; ++k)
+        (*scratch)[k] = indices[k] + (uint32_t)primitive->first_vertex;
+
+    gfx_buffer_update(geometry->vertex_buffer, (void*)vertices, (int32_t)(geometry->vertex_stride * primitive->first_vertex),
+                      (int32_t)(geometry->vertex_stride * vertices_count));
+    gfx_buffer_update(geometry->index_buffer, *scratch, (int32_t)(sizeof(uint32_t) * primitive->first_index),
+                      (int32_t)(sizeof(uint32_t) * indices_total));
+}
+
+static void scene_geometry_buffers_destroy(void* resource) {
+    scene_internal_geometry_buffers* buffers = resource;
+    gfx_buffer_destroy(buffers->vertex_buffer);
+    gfx_buffer_destroy(buffers->index_buffer);
+    OS_FREE(buffers);
+}
+
+static mdl_primitive* scene_source_primitive(mdl_data* model, mdl_primitive* batches, uint32_t mesh_index, int32_t primitive_index) {
+    return (int32_t)mesh_index < model->meshes_count ? model->meshes[mesh_index].primitives + primitive_index :
+           batches + (mesh_index - model->meshes_count);
+}
+
+//layout and the source data of every primitive in buffer order, equal keys mean equal buffers
+static asset_cache_key scene_geometry_key(scene_handle handle, mdl_data* model, mdl_primitive* batches, int32_t geometry_index) {
+    scene_internal_geometry const* geometry = handle->geometries + geometry_index;
+    asset_cache_key key = asset_cache_key_begin();
+    asset_cache_key_add(&key, &geometry->vertex_stride, sizeof(geometry->vertex_stride));
+    for (int32_t a = 0; a < geometry->attributes_count; ++a) {
+        mdl_attribute const* attr = geometry->attributes + a;
+        int32_t layout[4] = {(int32_t)attr->type, (int32_t)attr->format, (int32_t)attr->count, (int32_t)attr->offset};
+        asset_cache_key_add(&key, layout, sizeof(layout));
+    }
+    for (uint32_t i = 0; i < handle->meshes_count; ++i) {
+        scene_internal_mesh const* mesh = handle->meshes + i;
+        for (int32_t j = 0; j < mesh->primitives_count; ++j) {
+            if (mesh->primitives[j].geometry_index != geometry_index) continue;
+            mdl_primitive const* m_primitive = scene_source_primitive(model, batches, i, j);
+            asset_cache_key_add(&key, &mesh->primitives[j].first_vertex, sizeof(mesh->primitives[j].first_vertex));
+            asset_cache_key_add(&key, m_primitive->vertices, (int64_t)geometry->vertex_stride * m_primitive->vertices_count);
+            asset_cache_key_add(&key, m_primitive->indices, (int64_t)sizeof(uint32_t) * mdl_primitive_indices_total(m_primitive));
+        }
+    }
+    return key;
+}
+
+/*
+ * Writes the primitives straight from their source into the geometry buffers. Baked lod ranges stay behind
+ * the full level of each primitive, culling picks the one drawn. Buffers another scene already built from the same data are shared
+ * through the asset cache instead. The static batches come after the model meshes and are freed once
+ * written, model primitives only when the model geometry is consumed. Chunk geometries are left to
+ * scene_chunk_load.
+ */
+static void scene_geometry_upload(scene_handle handle, mdl_data* model, mdl_primitive* batches, bool consume_model) {
+    uint32_t* indices = 0;
+    int32_t indices_capacity = 0;
+    for (int32_t g = 0; g < handle->geometries_count; ++g) {
+        scene_internal_geometry* geometry = handle->geometries + g;
+        if (geometry->chunk_index != -1) continue;
+        asset_cache_key key = scene_geometry_key(handle, model, batches, g);
+        geometry->buffers = asset_cache_acquire(ASSET_CACHE_GEOMETRY, &key);
+        bool upload = geometry->buffers == 0;
+        if (upload) {
+            int64_t bytes = (int64_t)geometry->vertex_stride * geometry->vertices_count + (int64_t)sizeof(uint32_t) * geometry->indices_count;
+            geometry->buffers = scene_geometry_buffers_create(geometry);
+            asset_cache_insert(ASSET_CACHE_GEOMETRY, &key, geometry->buffers, bytes, scene_geometry_buffers_destroy);
+        }
+        geometry->vertex_buffer = geometry->buffers->vertex_buffer;
+        geometry->index_buffer = geometry->buffers->index_buffer;
+
+        for (uint32_t i = 0; i < handle->meshes_count; ++i) {
+            scene_internal_mesh const* mesh = handle->meshes + i;
+            bool batch = (int32_t)i >= model->meshes_count;
+            for (int32_t j = 0; j < mesh->primitives_count; ++j) {
+                scene_internal_mesh_primitive const* primitive = mesh->primitives + j;
+                mdl_primitive* m_primitive = scene_source_primitive(model, batches, i, j);
+                if (primitive->geometry_index != g) continue;
+
+                if (upload)
+                    scene_geometry_write(geometry, primitive, m_primitive->vertices, m_primitive->vertices_count,
+                                         m_primitive->indices, mdl_primitive_indices_total(m_primitive), &indices, &indices_capacity);
+
+                if (batch) {
+                    OS_FREE(m_primitive->vertices);
+                    OS_FREE(m_primitive->indices);
+                    m_primitive->vertices = 0;
+                    m_primitive->indices = 0;
+                } else if (consume_model) {
+                    mdl_primitive_release(model, m_primitive);
+                }
+            }
+        }
+
+        geometry->pipeline = scene_geometry_pipeline_create(geometry, handle->lit.shader, ~0u);
+    }
+    OS_FREE(indices);
+
+    for (int32_t i = 0; i < model->meshes_count && consume_model; ++i) {
+        if (!handle->meshes[i].baked) continue;
+        for (int32_t j = 0; j < handle->meshes[i].primitives_count; ++j)
+            mdl_primitive_release(model, model->meshes[i].primitives + j);
+    }
+}
+
+static bool scene_name_matches(const char* name, const char* pattern) {
+    size_t length = strlen(pattern);
+    if (length > 0 && pattern[length - 1] == '*')
+        return strncmp(name, pattern, length - 1) == 0;
+    return strcmp(name, pattern) == 0;
+}
+
+/*
+ * Only triangles with float positions, normals and tangents can be moved to world space in place.
+ */
+static bool scene_static_bakeable(mdl_primitive const* primitive) {
+    if (primitive->primitive_type != MDL_PRIMITIVE_TYPE_TRIANGLES || primitive->vertices_count <= 0)
+        return false;
+
+    bool has_position = false;
+    for (int32_t i = 0; i < primitive->attributes_count; ++i) {
+        mdl_attribute const* attr = primitive->attributes + i;
+        bool is_float = attr->format == MDL_ATTRIBUTE_FORMAT_FLOAT32;
+        if (attr->type == MDL_VERTEX_ATTRIBUTE_POSITION) {
+            if (!is_float || attr->count < 3) return false;
+            has_position = true;
+        } else if (attr->type == MDL_VERTEX_ATTRIBUTE_NORMAL) {
+            if (!is_float || attr->count != 3) return false;
+        } else if (attr->type == MDL_VERTEX_ATTRIBUTE_TANGENT) {
+            if (!is_float || attr->count != 4) return false;
+        }
+    }
+    return has_position;
+}
+
+static void scene_static_transform(float* v, float const* m, bool point, bool normalize) {
+    float x = v[0], y = v[1], z = v[2];
+    for (int32_t r = 0; r < 3; ++r)
+        v[r] = m[r * 4 + 0] * x + m[r * 4 + 1] * y + m[r * 4 + 2] * z + (point ? m[r * 4 + 3] : 0.0f);
+    if (normalize) {
+        float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length > 0.0f) {
+            v[0] /= length;
+            v[1] /= length;
+            v[2] /= length;
+        }
+    }
+}
+
+/*
+ * Appends a world space copy of the primitive to the batch.
+ * Mirrored nodes get their triangles and tangent handedness flipped to keep the winding.
+ */
+static void scene_static_append(mdl_primitive* batch, mdl_primitive const* source, gl_mat const* world) {
+    gl_mat normal_tr = gl_mat_transpose(gl_mat_inverse(*world));
+    bool mirrored = gl_mat_det(*world) < 0.0f;
+    uint32_t stride = source->vertex_stride;
+    int32_t first_vertex = batch->vertices_count;
+
+    batch->vertices = OS_REALLOC(batch->vertices, stride * (batch->vertices_count + source->vertices_count));
+    uint8_t* vertices = (uint8_t*)batch->vertices + (size_t)stride * first_vertex;
+    os_memcpy(vertices, source->vertices, (int32_t)(stride * source->vertices_count));
+    for (int32_t v = 0; v < source->vertices_count; ++v) {
+        for (int32_t a = 0; a < source->attributes_count; ++a) {
+            mdl_attribute const* attr = source->attributes + a;
+            float* value = (float*)(vertices + (size_t)v * stride + attr->offset);
+            if (attr->type == MDL_VERTEX_ATTRIBUTE_POSITION) {
+                scene_static_transform(value, world->data, true, false);
+            } else if (attr->type == MDL_VERTEX_ATTRIBUTE_NORMAL) {
+                scene_static_transform(value, normal_tr.data, false, true);
+            } else if (attr->type == MDL_VERTEX_ATTRIBUTE_TANGENT) {
+                scene_static_transform(value, world->data, false, true);
+                if (mirrored) value[3] = -value[3];
+            }
+        }
+    }
+
+    batch->indices = OS_REALLOC(batch->indices, sizeof(uint32_t) * (batch->indices_count + source->indices_count));
+    uint32_t* indices = batch->indices + batch->indices_count;
+    for (int32_t i = 0; i + 2 < source->indices_count; i += 3) {
+        indices[i + 0] = source->indices[i + 0] + (uint32_t)first_vertex;
+        indices[i + 1] = source->indices[mirrored ? i + 2 : i + 1] + (uint32_t)first_vertex;
+        indices[i + 2] = source->indices[mirrored ? i + 1 : i + 2] + (uint32_t)first_vertex;
+    }
+    batch->vertices_count += source->vertices_count;
+    batch->indices_count += source->indices_count / 3 * 3;
+}
+
+/*
+ * Merges the meshes of every node outside the dynamic subtrees into world space batches, one per
+ * material and vertex layout. Nodes whose mesh has a primitive that can't be baked stay dynamic,
+ * so do meshes drawn by several nodes, they are already drawn as instances of a single copy.
+ * Baked meshes are marked and keep no geometry. Returns the batches, their attributes point into
+ * the model.
+ */
+static mdl_primitive* scene_static_bake(scene_handle handle, mdl_data const* model, scene_desc const* desc, int32_t* batches_count) {
+    mdl_primitive* batches = 0;
+    int32_t count = 0, capacity = 0;
+
+    int32_t* mesh_nodes = OS_MALLOC(sizeof(int32_t) * (model->meshes_count + 1));
+    os_memset(mesh_nodes, 0, (int32_t)sizeof(int32_t) * (model->meshes_count + 1));
+    for (uint32_t i = 0; i < handle->nodes_count; ++i) {
+        if (handle->nodes[i].mesh_index != -1)
+            mesh_nodes[handle->nodes[i].mesh_index]++;
+    }
+
+    for (uint32_t i = 0; i < handle->nodes_count; ++i) {
+        scene_internal_node* node = handle->nodes + i;
+        if (node->mesh_index == -1 || mesh_nodes[node->mesh_index] > 1) continue;
+
+        bool dynamic = false;
+        for (scene_internal_node const* n = node; n != 0 && !dynamic; n = n->parent_id != -1 ? handle->nodes + n->parent_id : 0) {
+            for (int32_t d = 0; d < desc->dynamic_nodes_count && !dynamic; ++d)
+                dynamic = n->name != 0 && scene_name_matches(n->name, desc->dynamic_nodes[d]);
+        }
+        mdl_mesh const* m_mesh = model->meshes + node->mesh_index;
+        for (uint32_t j = 0; j < m_mesh->primitives_count && !dynamic; ++j)
+            dynamic = !scene_static_bakeable(m_mesh->primitives + j);
+        if (dynamic) continue;
+
+        scene_internal_mesh* mesh = handle->meshes + node->mesh_index;
+        for (uint32_t j = 0; j < m_mesh->primitives_count; ++j) {
+            mdl_primitive const* source = m_mesh->primitives + j;
+            int32_t b = 0;
+            for (; b < count; ++b) {
+                mdl_primitive const* batch = batches + b;
+                if (batch->material_id == source->material_id &&
+                    scene_layout_equal(batch->attributes, batch->attributes_count, batch->vertex_stride, source) &&
+                    (int64_t)batch->vertex_stride * (batch->vertices_count + source->vertices_count) <= SCENE_GEOMETRY_BUFFER_BYTES)
+                    break;
+            }
+            if (b == count) {
+                if (count == capacity) {
+                    capacity = capacity > 0 ? capacity * 2 : 8;
+                    batches = OS_REALLOC(batches, sizeof(mdl_primitive) * capacity);
+                }
+                mdl_primitive* batch = batches + count++;
+                os_memset(batch, 0, sizeof(mdl_primitive));
+                batch->primitive_type = MDL_PRIMITIVE_TYPE_TRIANGLES;
+                batch->attributes_flag = source->attributes_flag;
+                batch->attributes_count = source->attributes_count;
+                batch->attributes = source->attributes;
+                batch->vertex_stride = source->vertex_stride;
+                batch->material_id = source->material_id;
+            }
+            mesh->primitives[j].baked_batch = b;
+            mesh->primitives[j].baked_first_index = batches[b].indices_count;
+            scene_static_append(batches + b, source, scene_world_tr(handle, (int32_t)i));
+            mesh->primitives[j].baked_indices_count = batches[b].indices_count - mesh->primitives[j].baked_first_index;
+        }
+        mesh->baked = true;
+        node->baked = true;
+        for (scene_internal_node* n = node; n != 0; n = n->parent_id != -1 ? handle->nodes + n->parent_id : 0)
+            n->holds_baked = true;
+        handle->static_nodes_count++;
+    }
+    OS_FREE(mesh_nodes);
+
+    *batches_count = count;
+    return batches;
+}
+
+/*
+ * Lists the nodes drawing each mesh in slices of the arena node id block, baked nodes are left out.
+ * A static batch is drawn once at the identity transform that follows the node transforms.
+ */
+static void scene_mesh_nodes_build(scene_handle handle) {
+    int32_t model_meshes_count = (int32_t)handle->meshes_count - handle->static_batches_count;
+    for (uint32_t i = 0; i < handle->meshes_count; ++i)
+        handle->meshes[i].nodes_count = 0;
+    for (uint32_t i = 0; i < handle->nodes_count; ++i) {
+        if (handle->nodes[i].mesh_index != -1 && !handle->nodes[i].baked)
+            handle->meshes[handle->nodes[i].mesh_index].nodes_count++;
+    }
+
+    int32_t* node_ids = handle->mesh_node_ids;
+    for (uint32_t i = 0; i < handle->meshes_count; ++i) {
+        scene_internal_mesh *mesh = handle->meshes + i;
+        mesh->node_ids = node_ids;
+        node_ids += (int32_t)i >= model_meshes_count ? 1 : mesh->nodes_count;
+        if ((int32_t)i >= model_meshes_count) {
+            mesh->node_ids[0] = (int32_t)handle->nodes_count;
+            mesh->nodes_count = 1;
+        } else {
+            mesh->nodes_count = 0;
+        }
+    }
+    for (uint32_t i = 0; i < handle->nodes_count; ++i) {
+        scene_internal_node const* node = handle->nodes + i;
+        if (node->mesh_index != -1 && !node->baked) {
+            scene_internal_mesh *mesh = handle->meshes + node->mesh_index;
+            mesh->node_ids[mesh->nodes_count++] = (int32_t)i;
+        }
+    }
+}
+
+/*
+ * Float positions and the full index level of a triangle list, other primitives are picked by their box.
+ */
+static void scene_primitive_pick_copy(scene_internal_mesh_primitive* result, mdl_primitive const* primitive) {
+    if (primitive->primitive_type != MDL_PRIMITIVE_TYPE_TRIANGLES || primitive->indices_count < 3) return;
+    for (int32_t a = 0; a < primitive->attributes_count; ++a) {
+        mdl_attribute const* attr = primitive->attributes + a;
+        if (attr->type != MDL_VERTEX_ATTRIBUTE_POSITION || attr->format != MDL_ATTRIBUTE_FORMAT_FLOAT32 || attr->count < 3)
+            continue;
+
+        result->pick_positions = OS_MALLOC(sizeof(float) * 3 * primitive->vertices_count);
+        for (int32_t v = 0; v < primitive->vertices_count; ++v) {
+            float const* p = (float const*)((uint8_t const*)primitive->vertices + (size_t)v * primitive->vertex_stride + attr->offset);
+            os_memcpy(result->pick_positions + (size_t)v * 3, p, sizeof(float) * 3);
+        }
+        result->pick_indices_count = primitive->indices_count - primitive->indices_count % 3;
+        result->pick_indices = OS_MALLOC(sizeof(uint32_t) * result->pick_indices_count);
+        os_memcpy(result->pick_indices, primitive->indices, (int32_t)(sizeof(uint32_t) * result->pick_indices_count));
+        return;
+    }
+}
+
+scene_internal_mesh_primitive scene_new_primitive(mdl_primitive primitive) {
+    scene_internal_mesh_primitive result = {0};
+
+    switch (primitive.primitive_type) {
+
+        case MDL_PRIMITIVE_TYPE_POINTS: result.draw_type = GFX_POINTS;break;
+        case MDL_PRIMITIVE_TYPE_LINES: result.draw_type = GFX_LINES;break;
+        case MDL_PRIMITIVE_TYPE_LINE_LOOP: result.draw_type = GFX_LINE_LOOP;break;
+        case MDL_PRIMITIVE_TYPE_LINE_STRIP: result.draw_type = GFX_LINE_STRIP;break;
+        case MDL_PRIMITIVE_TYPE_TRIANGLES: result.draw_type = GFX_TRIANGLES;break;
+        case MDL_PRIMITIVE_TYPE_TRIANGLE_STRIP: result.draw_type = GFX_TRIANGLE_STRIP;break;
+        case MDL_PRIMITIVE_TYPE_TRIANGLE_FAN: result.draw_type = GFX_TRIANGLE_FAN;break;
+    }
+
+    result.draw_type = (uint32_t)primitive.primitive_type;
+    result.geometry_index = -1;
+    result.baked_batch = -1;
+    result.indices_count = primitive.indices_count;
+    result.material_id = primitive.material_id;
+    result.has_vertex_color = (primitive.attributes_flag & MDL_VERTEX_ATTRIBUTE_COLOR) != 0;
+    return result;
+}
+
+/*
+ * Fills the material block table with one entry per distinct material and uploads it.
+ * Needs the texture streamer, materials without a usable texture don't sample one.
+ * Called again whenever a material is edited, an edit may split or merge entries.
+ */
+static void scene_material_blocks_build(scene_handle handle) {
+    scene_internal_lit_program* lit = &handle->lit;
+    int32_t capacity = handle->materials_count > 0 ? (int32_t)handle->materials_count : 1;
+    float (*colors)[4] = OS_MALLOC(sizeof(float) * 4 * capacity);
+    float (*params)[4] = OS_MALLOC(sizeof(float) * 4 * capacity);
+    int32_t* textures = OS_MALLOC(sizeof(int32_t) * capacity);
+    int32_t count = 0;
+
+    for (uint32_t i = 0; i < handle->materials_count; ++i) {
+        scene_internal_pbr_material *mat = handle->materials + i;
+
+        //unsupported materials get the default model material instead of whatever was drawn before
+        if (!mat->valid) {
+            mat->color_factor[0] = mat->color_factor[1] = mat->color_factor[2] = 0.8f;
+            mat->color_factor[3] = 1.0f;
+            mat->roughness_factor = 0.6f;
+            mat->metallic_factor = 0.0f;
+            mat->color_texture_id = -1;
+            mat->valid = true;
+        }
+        if (texture_streamer_get(handle->texture_streamer, mat->color_texture_id) == 0)
+            mat->color_texture_id = -1;
+
+        float color[4] = {mat->color_factor[0], mat->color_factor[1], mat->color_factor[2], mat->color_factor[3]};
+        float param[4] = {mat->roughness_factor, mat->metallic_factor, mat->color_texture_id != -1 ? 1.0f : 0.0f, 0.0f};
+
+        int32_t index = 0;
+        while (index < count && (textures[index] != mat->color_texture_id ||
+                                 memcmp(colors[index], color, sizeof(color)) != 0 ||
+                                 memcmp(params[index], param, sizeof(param)) != 0))
+            index++;
+        if (index == count) {
+            os_memcpy(colors[count], color, sizeof(color));
+            os_memcpy(params[count], param, sizeof(param));
+            textures[count] = mat->color_texture_id;
+            count++;
+        }
+        mat->block_index = index;
+    }
+
+    lit->unique_materials_count = count;
+    lit->material_blocks_count = count > 0 ? (count + MATERIAL_BLOCK_SIZE - 1) / MATERIAL_BLOCK_SIZE : 1;
+    lit_material_block* blocks = OS_MALLOC(sizeof(lit_material_block) * lit->material_blocks_count);
+    os_memset(blocks, 0, sizeof(lit_material_block) * lit->material_blocks_count);
+    for (int32_t i = 0; i < count; ++i) {
+        lit_material_block* block = blocks + i / MATERIAL_BLOCK_SIZE;
+        os_memcpy(block->color[i % MATERIAL_BLOCK_SIZE], colors[i], sizeof(float) * 4);
+        os_memcpy(block->params[i % MATERIAL_BLOCK_SIZE], params[i], sizeof(float) * 4);
+    }
+
+    //blocks are 8 KB apart, a multiple of any uniform buffer offset alignment
+    if (lit->material_buffer != 0)
+        gfx_buffer_destroy(lit->material_buffer);
+    lit->material_buffer = gfx_buffer_create(GFX_BUFFER_UNIFORM, GFX_BUFFER_UPDATE_STATIC_DRAW, blocks,
+                                             sizeof(lit_material_block) * lit->material_blocks_count);
+
+    OS_FREE(blocks);
+    OS_FREE(colors);
+    OS_FREE(params);
+    OS_FREE(textures);
+}
+
+static void scene_transforms_mark(scene_handle handle, int32_t begin, int32_t end) {
+    scene_internal_transforms* transforms = &handle->transforms;
+    if (transforms->dirty_begin == transforms->dirty_end) {
+        transforms->dirty_begin = begin;
+        transforms->dirty_end = end;
+    } else {
+        transforms->dirty_begin = begin < transforms->dirty_begin ? begin : transforms->dirty_begin;
+        transforms->dirty_end = end > transforms->dirty_end ? end : transforms->dirty_end;
+    }
+}
+
+/*
+ * World transform storage comes zeroed from the arena, the ground plane entry is set before the
+ * hierarchy is first updated.
+ */
+static void scene_transforms_alloc(scene_handle handle) {
+    scene_internal_transforms* transforms = &handle->transforms;
+    gl_mat identity = gl_mat_new_identity();
+    os_memcpy(transforms->data + (size_t)(transforms->count - 1) * 16, identity.data, sizeof(gl_mat));
+}
+
+static void scene_transforms_create(scene_handle handle) {
+    scene_internal_transforms* transforms = &handle->transforms;
+    transforms->texture = gfx_texture_create(TRANSFORMS_PER_ROW * 4, transforms->rows, 0, GFX_TEXTURE_TYPE_RGBA32F,
+                                             GFX_TEXTURE_FILTER_NEAREST, GFX_TEXTURE_WRAP_CLAMP);
+    scene_transforms_mark(handle, 0, transforms->count);
+}
+
+/*
+ * result = a * b of row major matrices, result must not alias a or b.
+ * Each result row is a sum of the rows of b scaled by one row of a.
+ * b and result are 16 byte aligned, both come from aligned arena blocks.
+ */
+static void scene_mat_mul(float const* a, float const* b, float* result) {
+#ifdef SCENE_SSE
+    __m128 b0 = _mm_load_ps(b);
+    __m128 b1 = _mm_load_ps(b + 4);
+    __m128 b2 = _mm_load_ps(b + 8);
+    __m128 b3 = _mm_load_ps(b + 12);
+    for (int32_t r = 0; r < 4; ++r) {
+        __m128 row = _mm_mul_ps(_mm_set1_ps(a[r * 4 + 0]), b0);
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[r * 4 + 1]), b1));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[r * 4 + 2]), b2));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[r * 4 + 3]), b3));
+        _mm_store_ps(result + r * 4, row);
+    }
+#else
+    for (int32_t r = 0; r < 4; ++r) {
+        for (int32_t c = 0; c < 4; ++c) {
+            result[r * 4 + c] = a[r * 4 + 0] * b[c] + a[r * 4 + 1] * b[4 + c] +
+                                a[r * 4 + 2] * b[8 + c] + a[r * 4 + 3] * b[12 + c];
+        }
+    }
+#endif
+}
+
+static uint32_t scene_name_hash(const char* name) {
+    //fnv-1a
+    uint32_t hash = 0x811c9dc5u;
+    for (; *name != 0; ++name) {
+        hash ^= (uint8_t)*name;
+        hash *= 0x01000193u;
+    }
+    return hash;
+}
+
+static int scene_name_entry_compare(void const* a, void const* b) {
+    scene_internal_name_entry const* entry_a = a;
+    scene_internal_name_entry const* entry_b = b;
+    int result = strcmp(entry_a->name, entry_b->name);
+    if (result != 0) return result;
+    return entry_a->node_id < entry_b->node_id ? -1 : entry_a->node_id > entry_b->node_id ? 1 : 0;
+}
+
+/*
+ * Interns the model node names and builds both name indices, the pool and tables are arena blocks.
+ * Open addressing table keyed by the name hash, equal names share the string of the first node.
+ */
+static void scene_node_names_build(scene_handle handle, mdl_data const* model) {
+    uint32_t capacity = handle->name_table_capacity;
+    for (uint32_t i = 0; i < capacity; ++i)
+        handle->name_table[i] = SCENE_NAME_EMPTY_SLOT;
+    handle->sorted_names_count = 0;
+
+    size_t pool_used = 0;
+    for (uint32_t i = 0; i < handle->nodes_count; ++i) {
+        scene_internal_node* node = handle->nodes + i;
+        const char* name = model->nodes[i].name;
+        node->name = 0;
+        if (name == 0) continue;
+
+        uint32_t slot = scene_name_hash(name) & (capacity - 1);
+        while (handle->name_table[slot] != SCENE_NAME_EMPTY_SLOT) {
+            if (strcmp(handle->nodes[handle->name_table[slot]].name, name) == 0) {
+                node->name = handle->nodes[handle->name_table[slot]].name;
+                break;
+            }
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (node->name == 0) {
+            size_t length = strlen(name) + 1;
+            node->name = handle->names + pool_used;
+            os_memcpy(node->name, name, (int32_t)length);
+            pool_used += length;
+            handle->name_table[slot] = (int32_t)i;
+        }
+
+        scene_internal_name_entry* entry = handle->sorted_names + handle->sorted_names_count++;
+        entry->name = node->name;
+        entry->node_id = (int32_t)i;
+    }
+
+    qsort(handle->sorted_names, handle->sorted_names_count, sizeof(scene_internal_name_entry), scene_name_entry_compare);
+}
+
+/*
+ * Depth first order of the node tree, a node's subtree is the contiguous range after it.
+ * Transforms are stored in this order, so the local ones filled by node id are moved to their slots.
+ */
+static void scene_node_order_build(scene_handle handle) {
+    int32_t count = (int32_t)handle->nodes_count;
+    int32_t* stack = OS_MALLOC(sizeof(int32_t) * (count > 0 ? count : 1));
+
+    int32_t ordered = 0;
+    for (uint32_t r = 0; r < handle->root_nodes_count; ++r) {
+        int32_t stack_count = 0;
+        stack[stack_count++] = handle->root_nodes[r]->local_id;
+        while (stack_count > 0) {
+            int32_t id = stack[--stack_count];
+            scene_internal_node* node = handle->nodes + id;
+            node->order_index = ordered;
+            handle->node_order[ordered++] = id;
+            //reversed so the children keep their order
+            for (int32_t c = node->children_count - 1; c >= 0 && stack_count < count; --c)
+                stack[stack_count++] = node->children_id[c];
+        }
+    }
+    OS_FREE(stack);
+
+    gl_mat* locals = OS_MALLOC(sizeof(gl_mat) * (count > 0 ? count : 1));
+    os_memcpy(locals, handle->local_trs, (int32_t)sizeof(gl_mat) * count);
+    for (int32_t i = 0; i < ordered; ++i) {
+        int32_t id = handle->node_order[i];
+        int32_t parent_id = handle->nodes[id].parent_id;
+        handle->local_trs[i] = locals[id];
+        handle->order_parents[i] = parent_id != -1 ? handle->nodes[parent_id].order_index : -1;
+    }
+    OS_FREE(locals);
+
+    //children come after their parent, so walking backwards finishes every subtree before its root
+    for (int32_t i = ordered - 1; i >= 0; --i) {
+        scene_internal_node* node = handle->nodes + handle->node_order[i];
+        node->subtree_end = i + 1;
+        for (int32_t c = 0; c < node->children_count; ++c) {
+            int32_t end = handle->nodes[node->children_id[c]].subtree_end;
+            node->subtree_end = end > node->subtree_end ? end : node->subtree_end;
+        }
+    }
+}
+
+static void scene_node_mark_dirty(scene_handle handle, scene_internal_node* node) {
+    node->dirty = true;
+    if (handle->dirty_order_begin == handle->dirty_order_end) {
+        handle->dirty_order_begin = node->order_index;
+        handle->dirty_order_end = node->subtree_end;
+    } else {
+        handle->dirty_order_begin = node->order_index < handle->dirty_order_begin ? node->order_index : handle->dirty_order_begin;
+        handle->dirty_order_end = node->subtree_end > handle->dirty_order_end ? node->subtree_end : handle->dirty_order_end;
+    }
+}
+
+static void scene_journal_node(scene_handle handle, int32_t node_id) {
+    scene_internal_journal* journal = &handle->journal;
+    journal->flags |= SCENE_CHANGE_TRANSFORMS;
+    if (journal->node_listed[node_id]) return;
+    journal->node_listed[node_id] = true;
+    journal->nodes[journal->nodes_count++] = node_id;
+}
+
+static void scene_journal_material(scene_handle handle, int32_t material_id) {
+    scene_internal_journal* journal = &handle->journal;
+    journal->flags |= SCENE_CHANGE_MATERIALS;
+    if (journal->material_listed[material_id]) return;
+    journal->material_listed[material_id] = true;
+    journal->materials[journal->materials_count++] = material_id;
+}
+
+static void scene_journal_bounds(scene_internal_journal* journal, float const center[3], float const extent[3]) {
+    for (int32_t c = 0; c < 3; ++c) {
+        float low = center[c] - extent[c], high = center[c] + extent[c];
+        journal->bounds_min[c] = journal->bounds_valid && journal->bounds_min[c] < low ? journal->bounds_min[c] : low;
+        journal->bounds_max[c] = journal->bounds_valid && journal->bounds_max[c] > high ? journal->bounds_max[c] : high;
+    }
+    journal->bounds_valid = true;
+}
+
+/*
+ * Single forward pass over the dirty order range. Nodes inside a dirty subtree take their parent's
+ * world matrix, which is already current, so every matrix is computed once per update. Matrices are
+ * stored in the same order, the pass and the uploaded range are contiguous.
+ */
+static void scene_world_update(scene_handle handle) {
+    if (handle->dirty_order_begin == handle->dirty_order_end) return;
+
+    float* world = handle->transforms.data;
+    float const* local = handle->local_trs->data;
+    int32_t subtree_end = handle->dirty_order_begin;
+    int32_t changed_begin = (int32_t)handle->nodes_count, changed_end = 0;
+    for (int32_t i = handle->dirty_order_begin; i < handle->dirty_order_end; ++i) {
+        int32_t id = handle->node_order[i];
+        scene_internal_node* node = handle->nodes + id;
+        if (node->dirty) {
+            node->dirty = false;
+            subtree_end = node->subtree_end > subtree_end ? node->subtree_end : subtree_end;
+        }
+        if (i >= subtree_end) continue;
+
+        int32_t parent = handle->order_parents[i];
+        if (parent != -1)
+            scene_mat_mul(world + (size_t)parent * 16, local + (size_t)i * 16, world + (size_t)i * 16);
+        else
+            os_memcpy(world + (size_t)i * 16, local + (size_t)i * 16, sizeof(gl_mat));
+        changed_begin = i < changed_begin ? i : changed_begin;
+        changed_end = i + 1;
+        scene_journal_node(handle, id);
+    }
+    handle->dirty_order_begin = handle->dirty_order_end = 0;
+    if (changed_begin < changed_end)
+        scene_transforms_mark(handle, changed_begin, changed_end);
+}
+
+/*
+ * Uploads the matrices changed since the last pass, a range inside one row only sends its texels.
+ */
+static void scene_transforms_upload(scene_handle handle) {
+    scene_internal_transforms* transforms = &handle->transforms;
+    if (transforms->dirty_begin == transforms->dirty_end) return;
+
+    int32_t row_begin = transforms->dirty_begin / TRANSFORMS_PER_ROW;
+    int32_t row_end = (transforms->dirty_end - 1) / TRANSFORMS_PER_ROW + 1;
+    if (row_end - row_begin == 1) {
+        int32_t x = transforms->dirty_begin % TRANSFORMS_PER_ROW;
+        gfx_texture_update(transforms->texture, x * 4, row_begin, (transforms->dirty_end - transforms->dirty_begin) * 4, 1,
+                           transforms->data + (size_t)transforms->dirty_begin * 16);
+    } else {
+        gfx_texture_update(transforms->texture, 0, row_begin, TRANSFORMS_PER_ROW * 4, row_end - row_begin,
+                           transforms->data + (size_t)row_begin * TRANSFORMS_PER_ROW * 16);
+    }
+    transforms->dirty_begin = transforms->dirty_end = 0;
+}
+
+static uint64_t scene_draw_key(uint64_t pass, uint64_t program, uint64_t geometry, uint64_t material, uint64_t texture) {
+    return pass << 62 | (program & 0x3ull) << 60 | (geometry & 0xFFFFull) << 44 | (material & 0xFFFFull) << 28 |
+           (texture & 0xFFFFull) << 12;
+}
+
+static int scene_draw_item_compare(void const* a, void const* b) {
+    uint64_t key_a = ((scene_internal_draw_item const*)a)->key;
+    uint64_t key_b = ((scene_internal_draw_item const*)b)->key;
+    return key_a < key_b ? -1 : key_a > key_b ? 1 : 0;
+}
+
+static void scene_visible_instances_reserve(scene_handle handle, int32_t count) {
+    scene_internal_visible_instances* visible = &handle->visible;
+    int32_t rows = (count + INSTANCES_PER_ROW - 1) / INSTANCES_PER_ROW;
+    if (rows <= visible->rows) return;
+
+    if (visible->texture != 0)
+        gfx_texture_destroy(visible->texture);
+    OS_FREE(visible->data);
+    visible->rows = rows;
+    visible->data = OS_MALLOC(sizeof(float) * INSTANCES_PER_ROW * rows);
+    os_memset(visible->data, 0, sizeof(float) * INSTANCES_PER_ROW * rows);
+    visible->texture = gfx_texture_create(INSTANCES_PER_ROW / 4, rows, 0, GFX_TEXTURE_TYPE_RGBA32F,
+                                          GFX_TEXTURE_FILTER_NEAREST, GFX_TEXTURE_WRAP_CLAMP);
+}
+
+static void scene_visible_instances_upload(scene_handle handle, int32_t count) {
+    scene_internal_visible_instances* visible = &handle->visible;
+    int32_t texels = (count + 3) / 4;
+    if (texels <= 0) return;
+    if (texels <= INSTANCES_PER_ROW / 4) {
+        gfx_texture_update(visible->texture, 0, 0, texels, 1, visible->data);
+    } else {
+        int32_t rows = (count + INSTANCES_PER_ROW - 1) / INSTANCES_PER_ROW;
+        gfx_texture_update(visible->texture, 0, 0, INSTANCES_PER_ROW / 4, rows, visible->data);
+    }
+}
+
+/*
+ * Flattens all primitives with a geometry into the shadow and lit queues and sorts them by state.
+ * A primitive gets one item per pass whatever the number of nodes sharing its mesh. Streamed primitives
+ * are in the queue while their chunk is out too, paging only flips their residency.
+ * Depth bits stay 0 here, every view fills them in before sorting its range again.
+ */
+static void scene_draw_items_build(scene_handle handle) {
+    int32_t primitives_count = 0, instances_count = 0;
+    for (uint32_t i = 0; i < handle->meshes_count; ++i) {
+        scene_internal_mesh const* mesh = handle->meshes + i;
+        for (int32_t j = 0; j < mesh->primitives_count && mesh->nodes_count > 0; ++j) {
+            if (mesh->primitives[j].geometry_index == -1) continue;
+            primitives_count++;
+            instances_count += mesh->nodes_count;
+        }
+    }
+
+    OS_FREE(handle->draw_items);
+    handle->draw_items = OS_MALLOC(sizeof(scene_internal_draw_item) * (primitives_count * 2 + 1));
+    handle->draw_items_count = 0;
+    OS_FREE(handle->instances);
+    handle->instances = OS_MALLOC(sizeof(scene_internal_instance) * (instances_count + 1));
+    handle->instances_count = instances_count;
+
+    for (int32_t pass = 0; pass < 2; ++pass) {
+        int32_t instances_begin = 0;
+        for (uint32_t i = 0; i < handle->meshes_count; ++i) {
+            scene_internal_mesh *mesh = handle->meshes + i;
+            if (mesh->nodes_count == 0) continue;
+            for (int32_t j = 0; j < mesh->primitives_count; ++j) {
+                scene_internal_mesh_primitive *primitive = mesh->primitives + j;
+                if (primitive->geometry_index == -1) continue;
+                scene_internal_pbr_material *mat = handle->materials + primitive->material_id;
+                scene_internal_draw_item *item = handle->draw_items + handle->draw_items_count++;
+
+                item->instances_begin = instances_begin;
+                item->instances_count = mesh->nodes_count;
+                if (pass == SCENE_DRAW_PASS_SHADOW) {
+                    for (int32_t k = 0; k < mesh->nodes_count; ++k) {
+                        scene_internal_instance* instance = handle->instances + instances_begin + k;
+                        instance->transform_index = handle->nodes[mesh->node_ids[k]].order_index;
+                        instance->mesh_index = (int32_t)i;
+                        instance->primitive_index = j;
+                    }
+                }
+                instances_begin += mesh->nodes_count;
+
+                scene_internal_geometry const* geometry = handle->geometries + primitive->geometry_index;
+                //0 for a shadow pipeline that was never drawn, the shadow pass creates it
+                item->pipeline = pass == SCENE_DRAW_PASS_SHADOW ? geometry->shadow_pipeline : geometry->pipeline;
+                item->first_index = primitive->first_index;
+                item->material_id = primitive->material_id;
+                item->mesh_index = (int32_t)i;
+                item->primitive_index = j;
+                item->indices_count = primitive->indices_count;
+                item->draw_type = primitive->draw_type;
+                item->has_vertex_color = primitive->has_vertex_color;
+                item->resident = scene_primitive_resident(handle, primitive);
+                item->key = pass == SCENE_DRAW_PASS_SHADOW ?
+                            scene_draw_key(SCENE_DRAW_PASS_SHADOW, 0, (uint64_t)primitive->geometry_index, 0, 0) :
+                            scene_draw_key(SCENE_DRAW_PASS_LIT, 1, (uint64_t)primitive->geometry_index,
+                                           (uint64_t)mat->block_index, (uint64_t)(mat->color_texture_id + 1));
+            }
+        }
+    }
+    handle->shadow_items_count = primitives_count;
+
+    //counting sort of the instances by transform index
+    int32_t transforms_count = handle->transforms.count;
+    OS_FREE(handle->node_instances);
+    OS_FREE(handle->node_instances_begin);
+    handle->node_instances = OS_MALLOC(sizeof(int32_t) * (instances_count + 1));
+    handle->node_instances_begin = OS_MALLOC(sizeof(int32_t) * (transforms_count + 1));
+    os_memset(handle->node_instances_begin, 0, sizeof(int32_t) * (transforms_count + 1));
+    for (int32_t i = 0; i < instances_count; ++i)
+        handle->node_instances_begin[handle->instances[i].transform_index + 1]++;
+    for (int32_t i = 0; i < transforms_count; ++i)
+        handle->node_instances_begin[i + 1] += handle->node_instances_begin[i];
+    for (int32_t i = 0; i < instances_count; ++i)
+        handle->node_instances[handle->node_instances_begin[handle->instances[i].transform_index]++] = i;
+    for (int32_t i = transforms_count; i > 0; --i)
+        handle->node_instances_begin[i] = handle->node_instances_begin[i - 1];
+    handle->node_instances_begin[0] = 0;
+
+    qsort(handle->draw_items, handle->draw_items_count, sizeof(scene_internal_draw_item), scene_draw_item_compare);
+    handle->draw_items_dirty = false;
+    handle->draw_items_bounds_dirty = true;
+
+    //the lit pass puts the ground transform in front of its instances
+    scene_visible_instances_reserve(handle, instances_count + 1);
+}
+
+/*
+ * World box of an instance from its primitive box, the extent goes through the absolute matrix.
+ * Primitives without float positions get a box that is never culled.
+ */
+static void scene_primitive_world_box(scene_internal_mesh_primitive const* primitive, float const* m,
+                                      float world_center[3], float world_extent[3]) {
+    if (!primitive->bounds_valid) {
+        for (int32_t r = 0; r < 3; ++r) {
+            world_center[r] = m[r * 4 + 3];
+            world_extent[r] = 1e30f;
+        }
+        return;
+    }
+
+    float center[3], extent[3];
+    for (int32_t c = 0; c < 3; ++c) {
+        center[c] = (primitive->bounds_min.data[c] + primitive->bounds_max.data[c]) * 0.5f;
+        extent[c] = (primitive->bounds_max.data[c] - primitive->bounds_min.data[c]) * 0.5f;
+    }
+    for (int32_t r = 0; r < 3; ++r) {
+        world_center[r] = m[r * 4 + 0] * center[0] + m[r * 4 + 1] * center[1] + m[r * 4 + 2] * center[2] + m[r * 4 + 3];
+        world_extent[r] = fabsf(m[r * 4 + 0]) * extent[0] + fabsf(m[r * 4 + 1]) * extent[1] + fabsf(m[r * 4 + 2]) * extent[2];
+    }
+}
+
+static void scene_instance_bounds_update(scene_handle handle, scene_internal_instance* instance) {
+    scene_internal_mesh_primitive const* primitive = handle->meshes[instance->mesh_index].primitives + instance->primitive_index;
+    float const* m = handle->transforms.data + (size_t)instance->transform_index * 16;
+    scene_primitive_world_box(primitive, m, instance->bounds_center, instance->bounds_extent);
+}
+
+/*
+ * Refreshes the boxes of the instances moved since the last call and adds their old and new box
+ * to the journal. A rebuilt queue recomputes every box, the old boxes are gone then.
+ */
+static void scene_draw_items_bounds_update(scene_handle handle) {
+    scene_internal_journal* journal = &handle->journal;
+    bool rebuilt = handle->draw_items_bounds_dirty;
+    if (rebuilt) {
+        for (int32_t i = 0; i < handle->instances_count; ++i)
+            scene_instance_bounds_update(handle, handle->instances + i);
+        handle->draw_items_bounds_dirty = false;
+    }
+
+    for (; journal->bounds_cursor < journal->nodes_count; ++journal->bounds_cursor) {
+        int32_t slot = handle->nodes[journal->nodes[journal->bounds_cursor]].order_index;
+        for (int32_t k = handle->node_instances_begin[slot]; k < handle->node_instances_begin[slot + 1]; ++k) {
+            scene_internal_instance* instance = handle->instances + handle->node_instances[k];
+            if (!rebuilt) {
+                scene_journal_bounds(journal, instance->bounds_center, instance->bounds_extent);
+                scene_instance_bounds_update(handle, instance);
+            }
+            scene_journal_bounds(journal, instance->bounds_center, instance->bounds_extent);
+            journal->flags |= SCENE_CHANGE_GEOMETRY;
+        }
+    }
+}
+
+static void scene_pick_item_box(scene_handle handle, scene_internal_pick_item const* item, float min[3], float max[3]) {
+    scene_internal_mesh_primitive const* primitive = handle->meshes[item->mesh_index].primitives + item->primitive_index;
+    float center[3], extent[3];
+    scene_primitive_world_box(primitive, scene_world_tr(handle, item->node_id)->data, center, extent);
+    for (int32_t c = 0; c < 3; ++c) {
+        min[c] = center[c] - extent[c];
+        max[c] = center[c] + extent[c];
+    }
+}
+
+/*
+ * Builds the picking hierarchy on first use, afterwards refits the items of the nodes the journal
+ * listed since the last call. Primitives without float positions have no box and are not pickable.
+ */
+static void scene_pick_update(scene_handle handle) {
+    scene_internal_journal* journal = &handle->journal;
+    scene_world_update(handle);
+
+    if (handle->pick_bvh != 0) {
+        for (; journal->pick_cursor < journal->nodes_count; ++journal->pick_cursor) {
+            int32_t id = journal->nodes[journal->pick_cursor];
+            for (int32_t k = handle->node_pick_begin[id]; k < handle->node_pick_begin[id + 1]; ++k) {
+                float min[3], max[3];
+                scene_pick_item_box(handle, handle->pick_items + k, min, max);
+                bvh_update_item(handle->pick_bvh, k, min, max);
+            }
+        }
+        return;
+    }
+
+    int32_t count = 0;
+    for (uint32_t i = 0; i < handle->nodes_count; ++i) {
+        int32_t mesh_index = handle->nodes[i].mesh_index;
+        if (mesh_index < 0) continue;
+        for (int32_t j = 0; j < handle->meshes[mesh_index].primitives_count; ++j)
+            count += handle->meshes[mesh_index].primitives[j].bounds_valid ? 1 : 0;
+    }
+
+    handle->pick_items = OS_MALLOC(sizeof(scene_internal_pick_item) * (count + 1));
+    handle->pick_results = OS_MALLOC(sizeof(int32_t) * (count + 1));
+    handle->node_pick_begin = OS_MALLOC(sizeof(int32_t) * (handle->nodes_count + 1));
+    handle->node_marks = OS_MALLOC(sizeof(uint32_t) * (handle->nodes_count + 1));
+    os_memset(handle->node_marks, 0, sizeof(uint32_t) * (handle->nodes_count + 1));
+    float* boxes = OS_MALLOC(sizeof(float) * 6 * (count + 1));
+
+    //items are grouped by node, so a moved node refits one range
+    handle->pick_items_count = 0;
+    for (uint32_t i = 0; i < handle->nodes_count; ++i) {
+        handle->node_pick_begin[i] = handle->pick_items_count;
+        int32_t mesh_index = handle->nodes[i].mesh_index;
+        if (mesh_index < 0) continue;
+        for (int32_t j = 0; j < handle->meshes[mesh_index].primitives_count; ++j) {
+            if (!handle->meshes[mesh_index].primitives[j].bounds_valid) continue;
+            scene_internal_pick_item* item = handle->pick_items + handle->pick_items_count;
+            item->node_id = (int32_t)i;
+            item->mesh_index = mesh_index;
+            item->primitive_index = j;
+            float* box = boxes + (size_t)handle->pick_items_count * 6;
+            scene_pick_item_box(handle, item, box, box + 3);
+            handle->pick_items_count++;
+        }
+    }
+    handle->node_pick_begin[handle->nodes_count] = handle->pick_items_count;
+
+    handle->pick_bvh = bvh_create(boxes, handle->pick_items_count);
+    OS_FREE(boxes);
+    journal->pick_cursor = journal->nodes_count;
+}
+
+//moller-trumbore, both faces count
+static bool scene_triangle_ray_test(void* user, int32_t item, float const origin[3], float const direction[3],
+                                    float entry, float* t) {
+    scene_internal_mesh_primitive const* primitive = user;
+    float const* p0 = primitive->pick_positions + (size_t)primitive->pick_indices[item * 3 + 0] * 3;
+    float const* p1 = primitive->pick_positions + (size_t)primitive->pick_indices[item * 3 + 1] * 3;
+    float const* p2 = primitive->pick_positions + (size_t)primitive->pick_indices[item * 3 + 2] * 3;
+
+    float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    float p[3] = {direction[1] * e2[2] - direction[2] * e2[1], direction[2] * e2[0] - direction[0] * e2[2],
+                  direction[0] * e2[1] - direction[1] * e2[0]};
+    float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (fabsf(det) < 1e-12f) return false;
+
+    float inverse = 1.0f / det;
+    float s[3] = {origin[0] - p0[0], origin[1] - p0[1], origin[2] - p0[2]};
+    float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+    if (u < 0.0f || u > 1.0f) return false;
+
+    float q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+    float v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse;
+    if (v < 0.0f || u + v > 1.0f) return false;
+
+    float distance = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+    if (distance < 0.0f || distance >= *t) return false;
+    *t = distance;
+    return true;
+}
+
+/*
+ * Box hit refined by the primitive triangles when they were kept. The ray goes to object space
+ * without normalizing, so distances stay in units of the world direction.
+ */
+static bool scene_pick_ray_test(void* user, int32_t item, float const origin[3], float const direction[3],
+                                float entry, float* t) {
+    scene_handle handle = user;
+    scene_internal_pick_item const* pick = handle->pick_items + item;
+    scene_internal_mesh_primitive* primitive = handle->meshes[pick->mesh_index].primitives + pick->primitive_index;
+    if (primitive->pick_indices == 0) {
+        *t = entry;
+        return true;
+    }
+
+    if (primitive->triangles_bvh == 0) {
+        int32_t triangles_count = primitive->pick_indices_count / 3;
+        float* boxes = OS_MALLOC(sizeof(float) * 6 * (triangles_count + 1));
+        for (int32_t i = 0; i < triangles_count; ++i) {
+            float* box = boxes + (size_t)i * 6;
+            for (int32_t c = 0; c < 3; ++c) {
+                box[c] = 1e30f;
+                box[3 + c] = -1e30f;
+            }
+            for (int32_t k = 0; k < 3; ++k) {
+                float const* position = primitive->pick_positions + (size_t)primitive->pick_indices[i * 3 + k] * 3;
+                for (int32_t c = 0; c < 3; ++c) {
+                    box[c] = position[c] < box[c] ? position[c] : box[c];
+                    box[3 + c] = position[c] > box[3 + c] ? position[c] : box[3 + c];
+                }
+            }
+        }
+        primitive->triangles_bvh = bvh_create(boxes, triangles_count);
+        OS_FREE(boxes);
+    }
+
+    gl_mat inverse = gl_mat_inverse(*scene_world_tr(handle, pick->node_id));
+    float const* m = inverse.data;
+    float local_origin[3], local_direction[3];
+    for (int32_t r = 0; r < 3; ++r) {
+        local_origin[r] = m[r * 4 + 0] * origin[0] + m[r * 4 + 1] * origin[1] + m[r * 4 + 2] * origin[2] + m[r * 4 + 3];
+        local_direction[r] = m[r * 4 + 0] * direction[0] + m[r * 4 + 1] * direction[1] + m[r * 4 + 2] * direction[2];
+    }
+    return bvh_raycast(primitive->triangles_bvh, local_origin, local_direction, *t, scene_triangle_ray_test, primitive, t) != -1;
+}
+
+//gribb/hartmann planes of a row major view projection matrix: w + x, w - x, w + y, w - y
+static void scene_frustum_from_matrix(float const* m, scene_internal_frustum* frustum) {
+    for (int32_t i = 0; i < 4; ++i) {
+        float sign = (i & 1) ? -1.0f : 1.0f;
+        int32_t row = i / 2;
+        frustum->x[i] = m[12] + sign * m[row * 4 + 0];
+        frustum->y[i] = m[13] + sign * m[row * 4 + 1];
+        frustum->z[i] = m[14] + sign * m[row * 4 + 2];
+        frustum->w[i] = m[15] + sign * m[row * 4 + 3];
+        frustum->ax[i] = fabsf(frustum->x[i]);
+        frustum->ay[i] = fabsf(frustum->y[i]);
+        frustum->az[i] = fabsf(frustum->z[i]);
+    }
+}
 
-    uint32_t textures_count;
-    scene_internal_texture* textures;
+/*
+ * False when the box lies fully behind one of the planes, all four planes are tested at once.
+ */
+static bool scene_frustum_test(scene_internal_frustum const* frustum, float const center[3], float const extent[3]) {
+#ifdef SCENE_SSE
+    __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(frustum->x), _mm_set1_ps(center[0])),
+                                            _mm_mul_ps(_mm_loadu_ps(frustum->y), _mm_set1_ps(center[1]))),
+                                 _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(frustum->z), _mm_set1_ps(center[2])),
+                                            _mm_loadu_ps(frustum->w)));
+    __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(frustum->ax), _mm_set1_ps(extent[0])),
+                                          _mm_mul_ps(_mm_loadu_ps(frustum->ay), _mm_set1_ps(extent[1]))),
+                               _mm_mul_ps(_mm_loadu_ps(frustum->az), _mm_set1_ps(extent[2])));
+    return _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps())) == 0;
+#else
+    for (int32_t i = 0; i < 4; ++i) {
+        float distance = frustum->x[i] * center[0] + frustum->y[i] * center[1] + frustum->z[i] * center[2] + frustum->w[i];
+        float radius = frustum->ax[i] * extent[0] + frustum->ay[i] * extent[1] + frustum->az[i] * extent[2];
+        if (distance + radius < 0.0f) return false;
+    }
+    return true;
+#endif
+}
 
-    uint32_t cameras_count;
-    scene_internal_camera* cameras;
+/*
+ * Culls the instances of the queue range [begin, end) and packs the visible transform indices from slot first on.
+ * Lit views (projection set) also get the distance of the nearest instance as depth bits, front to back
+ * inside equal state, and the largest screen size of the textured meshes. Returns the slots in use.
+ */
+static int32_t scene_draw_items_cull(scene_handle handle, int32_t begin, int32_t end, int32_t first,
+                                     scene_internal_frustum const* frustum, float const* projection,
+                                     gl_vec3 view_pos, float viewport_height, int32_t* culled) {
+    float* visible = handle->visible.data;
+    int32_t count = first;
+    for (int32_t i = begin; i < end; ++i) {
+        scene_internal_draw_item *item = handle->draw_items + i;
+        scene_internal_mesh const* mesh = handle->meshes + item->mesh_index;
+        scene_internal_mesh_primitive const* primitive = mesh->primitives + item->primitive_index;
+        bool textured = projection != 0 && handle->materials[item->material_id].color_texture_id != -1;
+        bool lods = projection != 0 && primitive->lods_count > 0;
+        float nearest = 3.4e38f;
+        float lod_pixels = 0.0f;
+
+        item->visible_begin = count;
+        item->visible_count = 0;
+        item->screen_size = 0.0f;
+        item->lod = 0;
+        if (!item->resident) continue;
+        for (int32_t k = 0; k < item->instances_count; ++k) {
+            scene_internal_instance const* instance = handle->instances + item->instances_begin + k;
+            if (!scene_frustum_test(frustum, instance->bounds_center, instance->bounds_extent)) {
+                (*culled)++;
+                continue;
+            }
+            visible[count++] = (float)instance->transform_index;
+            if (projection == 0) continue;
+
+            gl_vec3 center = gl_vec3_new(instance->bounds_center[0], instance->bounds_center[1], instance->bounds_center[2]);
+            nearest = gl_min(nearest, gl_vec3_norm(gl_vec3_sub(center, view_pos)));
+            gl_mat const* world = (gl_mat const*)(handle->transforms.data + (size_t)instance->transform_index * 16);
+            if (textured)
+                item->screen_size = gl_max(item->screen_size, scene_mesh_screen_size(mesh, world, projection, view_pos, viewport_height));
+            if (lods)
+                lod_pixels = gl_max(lod_pixels, scene_lod_pixels(world, center, projection, view_pos, viewport_height));
+        }
+        item->visible_count = count - item->visible_begin;
+
+        //levels are sorted by error, every instance is drawn at the level its nearest one allows
+        while (lods && item->lod < primitive->lods_count &&
+               primitive->lods[item->lod].error * lod_pixels <= SCENE_LOD_PIXEL_ERROR)
+            item->lod++;
+
+        //positive floats keep their order as integers, exponent and 3 mantissa bits are enough
+        if (projection != 0) {
+            uint32_t bits;
+            os_memcpy(&bits, &nearest, sizeof(bits));
+            item->key = (item->key & ~SCENE_DRAW_KEY_DEPTH_MASK) | (uint64_t)(bits >> 20);
+        }
+    }
+    return count;
+}
 
-    uint32_t lights_count;
-    scene_internal_light* lights;
+static void scene_texture_destroy(void* resource) {
+    gfx_texture_destroy(resource);
+}
 
-    int32_t active_camera_node;
+static void scene_texture_streamer_destroy(void* resource) {
+    texture_streamer_destroy(resource);
+}
 
-    skybox_handle skybox;
-    bool skybox_enabled;
-    bool skybox_render;
-    bool plane_render;
+static void scene_skybox_destroy(void* resource) {
+    skybox_destroy(resource);
+}
 
-    shadow_renderer shadow;
-    ground_renderer ground;
-    gfx_texture_handle brdf_lut;
-    uint32_t prefiltered_env_id;   /* raw GL cubemap — 0 when no skybox */
+static void scene_prefiltered_env_destroy(void* resource) {
+    prefilter_env_destroy((uint32_t)(uintptr_t)resource);
+}
 
-    /* Selection + highlight */
-    int32_t selected_node_id;
-    gfx_shader_handle highlight_shader;
-    int32_t hl_model_u, hl_view_u, hl_proj_u, hl_color_u, hl_scale_u;
-} scene_internal_data;
+//images with their formats and level layout, scenes with equal keys can share a streamer
+static asset_cache_key scene_textures_key(mdl_data const* model) {
+    asset_cache_key key = asset_cache_key_begin();
+    asset_cache_key_add(&key, &model->textures_count, sizeof(model->textures_count));
+    for (int32_t i = 0; i < model->textures_count; ++i) {
+        mdl_texture const* texture = model->textures + i;
+        int32_t header[5] = {(int32_t)texture->valid, (int32_t)texture->format, texture->width, texture->height, texture->levels_count};
+        asset_cache_key_add(&key, header, sizeof(header));
+        if (texture->valid)
+            asset_cache_key_add(&key, texture->buffer, (int64_t)texture->size);
+    }
+    return key;
+}
 
-scene_internal_mesh_primitive scene_new_primitive(gfx_shader_handle shader, gfx_shader_handle shadow_shader, mdl_primitive primitive) {
-    scene_internal_mesh_primitive result = {0};
-    result.buffer_handle = gfx_buffer_create(GFX_BUFFER_VERTEX, GFX_BUFFER_UPDATE_STATIC_DRAW, primitive.vertices,
-                                             primitive.vertex_stride * primitive.vertices_count);
+/*
+ * Skybox and prefiltered environment of a path, shared with every scene showing the same one.
+ * Exposure lives in the skybox, so such scenes share it too.
+ */
+static void scene_environment_acquire(scene_handle handle, const char* path) {
+    asset_cache_key key = asset_cache_key_begin();
+    asset_cache_key_add_string(&key, path);
+    handle->skybox = asset_cache_acquire(ASSET_CACHE_SKYBOX, &key);
+    if (handle->skybox == 0)
+        handle->skybox = asset_cache_insert(ASSET_CACHE_SKYBOX, &key, skybox_load(path), 0, scene_skybox_destroy);
+    handle->skybox_enabled = handle->skybox != 0;
+    if (!handle->skybox_enabled) return;
+
+    handle->prefiltered_env_id = (uint32_t)(uintptr_t)asset_cache_acquire(ASSET_CACHE_PREFILTERED_ENV, &key);
+    if (handle->prefiltered_env_id == 0) {
+        handle->prefiltered_env_id = prefilter_env_generate(skybox_get_cubemap_id(handle->skybox));
+        if (handle->prefiltered_env_id != 0)
+            asset_cache_insert(ASSET_CACHE_PREFILTERED_ENV, &key, (void*)(uintptr_t)handle->prefiltered_env_id, 0,
+                               scene_prefiltered_env_destroy);
+    }
+}
 
-    switch (primitive.primitive_type) {
+static void scene_environment_release(scene_handle handle) {
+    if (handle->skybox_enabled)
+        asset_cache_release(ASSET_CACHE_SKYBOX, handle->skybox);
+    if (handle->prefiltered_env_id != 0)
+        asset_cache_release(ASSET_CACHE_PREFILTERED_ENV, (void*)(uintptr_t)handle->prefiltered_env_id);
+    handle->skybox = 0;
+    handle->skybox_enabled = false;
+    handle->prefiltered_env_id = 0;
+}
 
-        case MDL_PRIMITIVE_TYPE_POINTS: result.draw_type = GFX_POINTS;break;
-        case MDL_PRIMITIVE_TYPE_LINES: result.draw_type = GFX_LINES;break;
-        case MDL_PRIMITIVE_TYPE_LINE_LOOP: result.draw_type = GFX_LINE_LOOP;break;
-        case MDL_PRIMITIVE_TYPE_LINE_STRIP: result.draw_type = GFX_LINE_STRIP;break;
-        case MDL_PRIMITIVE_TYPE_TRIANGLES: result.draw_type = GFX_TRIANGLES;break;
-        case MDL_PRIMITIVE_TYPE_TRIANGLE_STRIP: result.draw_type = GFX_TRIANGLE_STRIP;break;
-        case MDL_PRIMITIVE_TYPE_TRIANGLE_FAN: result.draw_type = GFX_TRIANGLE_FAN;break;
+/*
+ * A chunk cache is written from the baked model, it is only used when it was written from the same
+ * geometry and every primitive it holds has the layout of the model primitive. Baked assets carry
+ * the hash, other models are hashed here. Primitives the cache leaves out are uploaded with the scene.
+ */
+static bool scene_chunks_match(chunk_cache_handle chunks, mdl_data const* model) {
+    uint64_t hash = model->geometry_hash != 0 ? model->geometry_hash : mdl_geometry_hash(model);
+    if (chunk_cache_get_geometry_hash(chunks) != hash)
+        return false;
+
+    int32_t count;
+    chunk_cache_primitive const* records = chunk_cache_get_primitives(chunks, &count);
+    for (int32_t i = 0; i < count; ++i) {
+        chunk_cache_primitive const* record = records + i;
+        if (record->mesh_index < 0 || record->mesh_index >= model->meshes_count || record->primitive_index < 0 ||
+            (uint32_t)record->primitive_index >= model->meshes[record->mesh_index].primitives_count)
+            return false;
+        mdl_primitive const* primitive = model->meshes[record->mesh_index].primitives + record->primitive_index;
+        if (record->vertices_count != primitive->vertices_count || record->vertex_stride != primitive->vertex_stride ||
+            record->indices_total != mdl_primitive_indices_total(primitive))
+            return false;
     }
+    return true;
+}
 
-    result.draw_type = (uint32_t)primitive.primitive_type;
-    result.pipeline_handle = gfx_pipeline_create(shader);
+/*
+ * Places the chunk primitives chunk by chunk, so the geometries of a chunk form one range. Their boxes come
+ * from the cache, the model geometry of a streamed primitive is never read and is freed right away when consumed.
+ */
+static void scene_chunks_assign(scene_handle handle, mdl_data* model, bool consume_model) {
+    int32_t chunks_count, records_count;
+    chunk_cache_chunk const* chunks = chunk_cache_get_chunks(handle->chunks, &chunks_count);
+    chunk_cache_primitive const* records = chunk_cache_get_primitives(handle->chunks, &records_count);
+    handle->chunk_geometries = OS_MALLOC(sizeof(int32_t) * (chunks_count + 1));
+    for (int32_t c = 0; c < chunks_count; ++c) {
+        handle->chunk_geometries[c] = handle->geometries_count;
+        for (int32_t r = chunks[c].primitives_start; r < chunks[c].primitives_start + chunks[c].primitives_count; ++r) {
+            chunk_cache_primitive const* record = records + r;
+            scene_internal_mesh* mesh = handle->meshes + record->mesh_index;
+            scene_internal_mesh_primitive* primitive = mesh->primitives + record->primitive_index;
+            mdl_primitive* m_primitive = model->meshes[record->mesh_index].primitives + record->primitive_index;
+            primitive->streamed = true;
+            scene_geometry_assign(handle, m_primitive, primitive, c);
+            if (record->bounds_valid)
+                scene_primitive_bounds_set(mesh, primitive, record->bounds_min, record->bounds_max);
+            if (consume_model)
+                mdl_primitive_release(model, m_primitive);
+        }
+    }
+    handle->chunk_geometries[chunks_count] = handle->geometries_count;
+}
 
-    for (int32_t i = 0; i < primitive.attributes_count; ++i) {
+/*
+ * The items of the chunk primitives stay in the queue, only their residency and pipelines are refreshed.
+ * Views and shadows see the box change.
+ */
+static void scene_chunk_changed(scene_handle handle, int32_t chunk_index) {
+    int32_t begin = handle->chunk_geometries[chunk_index], end = handle->chunk_geometries[chunk_index + 1];
+    for (int32_t i = 0; i < handle->draw_items_count; ++i) {
+        scene_internal_draw_item* item = handle->draw_items + i;
+        int32_t geometry_index = handle->meshes[item->mesh_index].primitives[item->primitive_index].geometry_index;
+        if (geometry_index < begin || geometry_index >= end) continue;
+        scene_internal_geometry const* geometry = handle->geometries + geometry_index;
+        item->resident = geometry->vertex_buffer != 0;
+        //0 for the shadow pipeline, the shadow pass creates it
+        item->pipeline = i < handle->shadow_items_count ? geometry->shadow_pipeline : geometry->pipeline;
+    }
 
-        const char *attribute_name = 0;
-        switch (primitive.attributes[i].type) {
+    int32_t count;
+    chunk_cache_chunk const* chunk = chunk_cache_get_chunks(handle->chunks, &count) + chunk_index;
+    float center[3], extent[3];
+    for (int32_t c = 0; c < 3; ++c) {
+        center[c] = (chunk->bounds_min[c] + chunk->bounds_max[c]) * 0.5f;
+        extent[c] = (chunk->bounds_max[c] - chunk->bounds_min[c]) * 0.5f;
+    }
+    scene_journal_bounds(&handle->journal, center, extent);
+    handle->journal.flags |= SCENE_CHANGE_GEOMETRY;
+}
 
-            case MDL_VERTEX_ATTRIBUTE_INVALID:
-                attribute_name = 0;
-                break;
-            case MDL_VERTEX_ATTRIBUTE_POSITION:
-                attribute_name = ATTR_POSITION_NAME;
-                break;
-            case MDL_VERTEX_ATTRIBUTE_UV:
-                attribute_name = ATTR_UV_NAME;
-                break;
-            case MDL_VERTEX_ATTRIBUTE_NORMAL:
-                attribute_name = ATTR_NORMAL_NAME;
-                break;
-            case MDL_VERTEX_ATTRIBUTE_COLOR:
-                attribute_name = ATTR_COLOR_NAME;
-                break;
-            case MDL_VERTEX_ATTRIBUTE_TANGENT:
-                attribute_name = ATTR_TANGENT_NAME;
-                break;
-            default:
-                attribute_name = 0;
-        }
+/*
+ * Uploads the geometries of a chunk the cache paged in, the payload holds the primitives back to back.
+ */
+static void scene_chunk_load(void* user_data, int32_t chunk_index, void const* payload) {
+    scene_handle handle = user_data;
+    int32_t chunks_count, records_count;
+    chunk_cache_chunk const* chunk = chunk_cache_get_chunks(handle->chunks, &chunks_count) + chunk_index;
+    chunk_cache_primitive const* records = chunk_cache_get_primitives(handle->chunks, &records_count);
+    int32_t begin = handle->chunk_geometries[chunk_index], end = handle->chunk_geometries[chunk_index + 1];
+
+    for (int32_t g = begin; g < end; ++g) {
+        scene_internal_geometry* geometry = handle->geometries + g;
+        geometry->buffers = scene_geometry_buffers_create(geometry);
+        geometry->vertex_buffer = geometry->buffers->vertex_buffer;
+        geometry->index_buffer = geometry->buffers->index_buffer;
+    }
 
-        if (attribute_name != 0) {
-            gfx_pipeline_attr_enable(result.pipeline_handle, attribute_name, result.buffer_handle,
-                                     primitive.attributes[i].count, primitive.attributes[i].offset,
-                                     primitive.vertex_stride);
-        }
+    uint32_t* indices = 0;
+    int32_t indices_capacity = 0;
+    uint8_t const* data = payload;
+    for (int32_t r = chunk->primitives_start; r < chunk->primitives_start + chunk->primitives_count; ++r) {
+        chunk_cache_primitive const* record = records + r;
+        scene_internal_mesh_primitive const* primitive = handle->meshes[record->mesh_index].primitives + record->primitive_index;
+        scene_geometry_write(handle->geometries + primitive->geometry_index, primitive, data + record->vertices_offset,
+                             record->vertices_count, (uint32_t const*)(data + record->indices_offset), record->indices_total,
+                             &indices, &indices_capacity);
     }
+    OS_FREE(indices);
 
-    gfx_buffer_handle index_handle = gfx_buffer_create(GFX_BUFFER_INDEX, GFX_BUFFER_UPDATE_STATIC_DRAW, primitive.indices,
-                                                       primitive.indices_count * sizeof(uint32_t));
+    for (int32_t g = begin; g < end; ++g)
+        handle->geometries[g].pipeline = scene_geometry_pipeline_create(handle->geometries + g, handle->lit.shader, ~0u);
+    scene_chunk_changed(handle, chunk_index);
+}
 
-    gfx_pipeline_index_enable(result.pipeline_handle, index_handle);
-    gfx_pipeline_submit(result.pipeline_handle);
+static void scene_chunk_evict(void* user_data, int32_t chunk_index) {
+    scene_handle handle = user_data;
+    for (int32_t g = handle->chunk_geometries[chunk_index]; g < handle->chunk_geometries[chunk_index + 1]; ++g) {
+        scene_internal_geometry* geometry = handle->geometries + g;
+        scene_geometry_pipelines_destroy(geometry);
+        scene_geometry_buffers_destroy(geometry->buffers);
+        geometry->buffers = 0;
+        geometry->vertex_buffer = geometry->index_buffer = 0;
+    }
+    scene_chunk_changed(handle, chunk_index);
+}
 
-    /* Shadow pipeline — position attribute only */
-    result.shadow_pipeline = gfx_pipeline_create(shadow_shader);
-    for (int32_t i = 0; i < primitive.attributes_count; ++i) {
-        if (primitive.attributes[i].type == MDL_VERTEX_ATTRIBUTE_POSITION) {
-            gfx_pipeline_attr_enable(result.shadow_pipeline, ATTR_POSITION_NAME, result.buffer_handle,
-                                     primitive.attributes[i].count, primitive.attributes[i].offset,
-                                     primitive.vertex_stride);
-            break;
+/*
+ * Distance every chunk is seen at from the view. Chunks outside the frustum count as farther away, so the ones
+ * in view are paged in first while the ones right around the camera still stay.
+ */
+static void scene_chunks_request(scene_handle handle, scene_internal_frustum const* frustum, gl_vec3 view_pos) {
+    int32_t count;
+    chunk_cache_chunk const* chunks = chunk_cache_get_chunks(handle->chunks, &count);
+    for (int32_t i = 0; i < count; ++i) {
+        float center[3], extent[3], distance = 0.0f;
+        for (int32_t c = 0; c < 3; ++c) {
+            center[c] = (chunks[i].bounds_min[c] + chunks[i].bounds_max[c]) * 0.5f;
+            extent[c] = (chunks[i].bounds_max[c] - chunks[i].bounds_min[c]) * 0.5f;
+            float outside = fabsf(view_pos.data[c] - center[c]) - extent[c];
+            distance += outside > 0.0f ? outside * outside : 0.0f;
         }
+        distance = sqrtf(distance);
+        if (!scene_frustum_test(frustum, center, extent))
+            distance *= SCENE_CHUNK_HIDDEN_DISTANCE_SCALE;
+        chunk_cache_request(handle->chunks, i, distance);
     }
-    gfx_pipeline_index_enable(result.shadow_pipeline, index_handle);
-    gfx_pipeline_submit(result.shadow_pipeline);
+}
 
-    result.indices_count = primitive.indices_count;
-    result.index_handle = index_handle;
-    result.material_id = primitive.material_id;
-    result.has_vertex_color = (primitive.attributes_flag & MDL_VERTEX_ATTRIBUTE_COLOR) != 0;
-    return result;
+/*
+ * Assigns the arena blocks of everything the model sizes up front. Static batches are not known
+ * before baking, each baked primitive can open at most one, so that bounds their meshes.
+ */
+static void scene_arena_layout(scene_handle handle, scene_internal_arena* arena, mdl_data const* model, bool bake_static) {
+    uint32_t primitives_count = 0, batches_capacity = 0, children_count = 0, root_nodes_count = 0, named_count = 0;
+    uint32_t lods_count = 0;
+    size_t names_size = 1;
+    for (uint32_t i = 0; i < model->meshes_count; ++i) {
+        primitives_count += model->meshes[i].primitives_count;
+        for (uint32_t j = 0; j < model->meshes[i].primitives_count; ++j)
+            lods_count += (uint32_t)model->meshes[i].primitives[j].lods_count;
+    }
+    for (uint32_t i = 0; i < model->nodes_count; ++i) {
+        mdl_node const* m_node = model->nodes + i;
+        if (bake_static && m_node->mesh_index != -1)
+            batches_capacity += model->meshes[m_node->mesh_index].primitives_count;
+        children_count += m_node->children_count;
+        if (m_node->parent_id == -1)
+            root_nodes_count++;
+        if (m_node->name != 0) {
+            names_size += strlen(m_node->name) + 1;
+            named_count++;
+        }
+    }
+    uint32_t name_table_capacity = 16;
+    while (name_table_capacity < named_count * 2) name_table_capacity <<= 1;
+
+    handle->lights = scene_arena_take(arena, sizeof(scene_internal_light) * model->lights_count);
+    handle->cameras = scene_arena_take(arena, sizeof(scene_internal_camera) * model->cameras_count);
+    handle->materials = scene_arena_take(arena, sizeof(scene_internal_pbr_material) * model->materials_count);
+    handle->meshes = scene_arena_take(arena, sizeof(scene_internal_mesh) * (model->meshes_count + batches_capacity));
+    handle->mesh_primitives = scene_arena_take(arena, sizeof(scene_internal_mesh_primitive) * (primitives_count + batches_capacity));
+    handle->mesh_node_ids = scene_arena_take(arena, sizeof(int32_t) * (model->nodes_count + batches_capacity));
+    handle->mesh_lods = scene_arena_take(arena, sizeof(mdl_lod) * lods_count);
+
+    handle->nodes = scene_arena_take(arena, sizeof(scene_internal_node) * model->nodes_count);
+    handle->local_trs = scene_arena_take_aligned(arena, sizeof(gl_mat) * model->nodes_count, SCENE_ARENA_ALIGNMENT);
+    handle->children_ids = scene_arena_take(arena, sizeof(int32_t) * children_count);
+    handle->root_nodes = scene_arena_take(arena, sizeof(scene_internal_node*) * root_nodes_count);
+    handle->node_order = scene_arena_take(arena, sizeof(int32_t) * model->nodes_count);
+    handle->order_parents = scene_arena_take(arena, sizeof(int32_t) * model->nodes_count);
+
+    handle->names = scene_arena_take(arena, names_size);
+    handle->name_table_capacity = name_table_capacity;
+    handle->name_table = scene_arena_take(arena, sizeof(int32_t) * name_table_capacity);
+    handle->sorted_names = scene_arena_take(arena, sizeof(scene_internal_name_entry) * named_count);
+
+    handle->journal.nodes = scene_arena_take(arena, sizeof(int32_t) * (model->nodes_count + 1));
+    handle->journal.node_listed = scene_arena_take(arena, sizeof(bool) * (model->nodes_count + 1));
+    handle->journal.materials = scene_arena_take(arena, sizeof(int32_t) * (model->materials_count + 1));
+    handle->journal.material_listed = scene_arena_take(arena, sizeof(bool) * (model->materials_count + 1));
+
+    //world matrices of every node and the ground plane, padded to whole texture rows
+    handle->transforms.count = (int32_t)model->nodes_count + 1;
+    handle->transforms.rows = (handle->transforms.count + TRANSFORMS_PER_ROW - 1) / TRANSFORMS_PER_ROW;
+    handle->transforms.data = scene_arena_take_aligned(arena, sizeof(float) * 16 * TRANSFORMS_PER_ROW * handle->transforms.rows,
+                                                       SCENE_ARENA_ALIGNMENT);
 }
 
 scene_handle scene_new(scene_desc const* desc) {
     mdl_data* model = desc->model;
+    bool verbose = false;
+
+    //a chunk cache written from another model is left out, the geometry is then uploaded whole
+    chunk_cache_handle chunks = desc->chunks_path != 0 ? chunk_cache_open(desc->chunks_path) : 0;
+    if (chunks != 0 && !scene_chunks_match(chunks, model)) {
+        if (verbose) printf("- Chunk cache does not match the model: %s\n", desc->chunks_path);
+        chunk_cache_close(chunks);
+        chunks = 0;
+    }
+    bool bake_static = desc->bake_static && chunks == 0;
 
-    //create scene structure
-    scene_handle handle = OS_MALLOC(sizeof(struct scene_internal_data));
-    os_memset(handle, 0, sizeof(scene_internal_data));
+    //create scene structure, measured on a scratch handle first, the handle heads its own arena
+    scene_internal_data scratch;
+    scene_internal_arena arena = {0};
+    scene_arena_take(&arena, sizeof(scene_internal_data));
+    scene_arena_layout(&scratch, &arena, model, bake_static);
+
+    size_t arena_size = arena.used;
+    void* arena_memory = OS_MALLOC((uint32_t)(arena_size + SCENE_ARENA_ALIGNMENT - 1));
+    arena.base = (uint8_t*)(((uintptr_t)arena_memory + SCENE_ARENA_ALIGNMENT - 1) & ~(uintptr_t)(SCENE_ARENA_ALIGNMENT - 1));
+    arena.used = 0;
+    os_memset(arena.base, 0, (int32_t)arena_size);
+    scene_handle handle = scene_arena_take(&arena, sizeof(scene_internal_data));
+    scene_arena_layout(handle, &arena, model, bake_static);
+    handle->arena_memory = arena_memory;
+    handle->chunks = chunks;
 
 
     handle->skybox_enabled = desc->skybox.path != 0;
     handle->skybox_render = desc->skybox.render;
     handle->plane_render = true;
+    handle->texture_anisotropy = SCENE_DEFAULT_ANISOTROPY;
     handle->prefiltered_env_id = 0;
-    if(desc->skybox.path != 0) {
-        handle->skybox = skybox_load(desc->skybox.path);
-        handle->prefiltered_env_id = prefilter_env_generate(skybox_get_cubemap_id(handle->skybox));
-    }
+    if(desc->skybox.path != 0)
+        scene_environment_acquire(handle, desc->skybox.path);
 
     /*
      * Loading of the lights.
      */
 
     handle->lights_count = model->lights_count;
-    handle->lights = OS_MALLOC(sizeof(struct scene_internal_light) * model->lights_count);
     for(int32_t i=0; i<handle->lights_count; ++i) {
         scene_internal_light *light = handle->lights + i;
         mdl_light *m_light = model->lights + i;
@@ -278,7 +2161,6 @@ scene_handle scene_new(scene_desc const* desc) {
     device_window_dimensions_get(&w, &h);
 
     handle->cameras_count = model->cameras_count;
-    handle->cameras = OS_MALLOC(sizeof(struct scene_internal_camera) * model->cameras_count);
 
     for (uint32_t i = 0; i < handle->cameras_count; ++i) {
         struct scene_internal_camera *camera = handle->cameras + i;
@@ -305,81 +2187,68 @@ scene_handle scene_new(scene_desc const* desc) {
      * Loading of the materials.
      */
     handle->materials_count = model->materials_count;
-    handle->materials = OS_MALLOC(sizeof(struct scene_internal_pbr_material) * model->materials_count);
 
     void* fs = device_file_read_text("./Shaders/Lit.fs");
     void* vs = device_file_read_text("./Shaders/Lit.vs");
+    scene_internal_lit_program* lit = &handle->lit;
+    lit->shader = gfx_shader_acquire("Lit", vs, fs, 0);
+    OS_FREE(vs);
+    OS_FREE(fs);
+
+    gfx_shader_uniform_enable(lit->shader, TRANSFORMS_NAME,      GFX_TYPE_SAMPLER_2D,    &lit->transforms_uniform);
+    gfx_shader_uniform_enable(lit->shader, INSTANCES_NAME,       GFX_TYPE_SAMPLER_2D,    &lit->instances_uniform);
+    gfx_shader_uniform_enable(lit->shader, INSTANCE_OFFSET_NAME, GFX_TYPE_INTEGER_VEC_1, &lit->instance_offset_uniform);
+    gfx_shader_uniform_enable(lit->shader, "material_index",     GFX_TYPE_INTEGER_VEC_1, &lit->material_index_uniform);
+    gfx_shader_uniform_enable(lit->shader, "has_vertex_color",   GFX_TYPE_INTEGER_VEC_1, &lit->has_vertex_color_uniform);
+    gfx_shader_uniform_enable(lit->shader, "skybox",             GFX_TYPE_SAMPLER_CUBE, &lit->skybox_uniform);
+    gfx_shader_uniform_enable(lit->shader, "shadow_map",         GFX_TYPE_SAMPLER_2D,  &lit->shadow_map_uniform);
+    gfx_shader_uniform_enable(lit->shader, "brdf_lut",           GFX_TYPE_SAMPLER_2D,  &lit->brdf_lut_uniform);
+    gfx_shader_uniform_enable(lit->shader, "prefiltered_env",    GFX_TYPE_SAMPLER_CUBE, &lit->prefiltered_env_uniform);
+    gfx_shader_uniform_enable(lit->shader, "base_color_texture", GFX_TYPE_SAMPLER_2D,  &lit->base_color_tex_uniform);
+    gfx_shader_uniform_block_enable(lit->shader, FRAME_BLOCK_NAME, FRAME_BLOCK_BINDING);
+    gfx_shader_uniform_block_enable(lit->shader, MATERIAL_BLOCK_NAME, MATERIAL_BLOCK_BINDING);
 
     for (uint32_t i = 0; i < model->materials_count; ++i) {
         struct scene_internal_pbr_material *mat = handle->materials + i;
         struct mdl_material *m_mat = model->materials + i;
 
-        mat->shader = gfx_shader_create("Lit");
-        gfx_shader_add_fs(mat->shader, fs);
-        gfx_shader_add_vs(mat->shader, vs);
-        gfx_shader_submit(mat->shader);
-
         mat->roughness_factor = m_mat->roughness_factor ;
         mat->metallic_factor = m_mat->metallic_factor;
         os_memcpy(mat->color_factor, m_mat->color_factor, sizeof(float) * 4);
         mat->valid = m_mat->valid;
         mat->color_texture_id = m_mat->color_texture_id;
-
-        gfx_shader_uniform_enable(mat->shader, MODEL_TRANSFORM_NAME, GFX_TYPE_FLOAT_MAT_4, &mat->model_uniform );
-        gfx_shader_uniform_enable(mat->shader, PROJECTION_TRANSFORM_NAME, GFX_TYPE_FLOAT_MAT_4, &mat->projection_uniform );
-        gfx_shader_uniform_enable(mat->shader, VIEW_TRANSFORM_NAME, GFX_TYPE_FLOAT_MAT_4, &mat->view_uniform );
-        gfx_shader_uniform_enable(mat->shader, VIEW_POSITION_NAME, GFX_TYPE_FLOAT_VEC_3, &mat->view_position_uniform );
-        gfx_shader_uniform_enable(mat->shader, "roughness", GFX_TYPE_FLOAT_VEC_1, &mat->rougness_uniform );
-        gfx_shader_uniform_enable(mat->shader, "metallic", GFX_TYPE_FLOAT_VEC_1, &mat->metallic_uniform );
-        gfx_shader_uniform_enable(mat->shader, "base_color", GFX_TYPE_FLOAT_VEC_3, &mat->color_uniform);
-        gfx_shader_uniform_enable(mat->shader, "skybox", GFX_TYPE_SAMPLER_CUBE, &mat->skybox_uniform);
-        gfx_shader_uniform_enable(mat->shader, "exposure", GFX_TYPE_FLOAT_VEC_1, &mat->exposure_uniform);
-
     }
-    OS_FREE(vs);
-    OS_FREE(fs);
 
     /*
-     * Upload GLTF images to GPU as sRGBA textures.
+     * Hand GLTF images to the texture streamer, only the coarse mips are uploaded here.
+     * Color maps are sRGB, levels of baked assets stay in the mapping, other sources are copied.
+     * Scenes with the same images share one streamer and with it the budget and residency.
      */
     handle->textures_count = (uint32_t)model->textures_count;
-    if (model->textures_count > 0) {
-        handle->textures = OS_MALLOC(sizeof(scene_internal_texture) * model->textures_count);
+    asset_cache_key textures_key = scene_textures_key(model);
+    handle->texture_streamer = asset_cache_acquire(ASSET_CACHE_TEXTURES, &textures_key);
+    if (handle->texture_streamer == 0) {
+        int64_t textures_bytes = 0;
+        texture_streamer_handle streamer = texture_streamer_create(TEXTURE_STREAMER_DEFAULT_BUDGET);
+        texture_streamer_set_anisotropy(streamer, handle->texture_anisotropy);
         for (int32_t i = 0; i < model->textures_count; ++i) {
             mdl_texture *src = model->textures + i;
-            handle->textures[i].texture_handle = 0;
-            if (src->valid) {
-                handle->textures[i].texture_handle = gfx_texture_create(
-                    src->width, src->height, src->buffer,
-                    GFX_TEXTURE_TYPE_SRGBA,
-                    GFX_TEXTURE_FILTER_LINEAR,
-                    GFX_TEXTURE_WRAP_REPEAT);
-            }
+            texture_streamer_add(streamer, src, model->backing, scene_texture_type(src));
+            textures_bytes += src->valid ? src->size : 0;
         }
+        handle->texture_streamer = asset_cache_insert(ASSET_CACHE_TEXTURES, &textures_key, streamer, textures_bytes,
+                                                      scene_texture_streamer_destroy);
     }
 
-    /* Register texture + vertex-color uniforms for every Lit material shader */
-    for (uint32_t i = 0; i < handle->materials_count; ++i) {
-        scene_internal_pbr_material *mat = handle->materials + i;
-        gfx_shader_uniform_enable(mat->shader, "base_color_texture", GFX_TYPE_SAMPLER_2D,    &mat->base_color_tex_uniform);
-        gfx_shader_uniform_enable(mat->shader, "has_color_texture",  GFX_TYPE_INTEGER_VEC_1, &mat->has_color_tex_uniform);
-        gfx_shader_uniform_enable(mat->shader, "has_vertex_color",   GFX_TYPE_INTEGER_VEC_1, &mat->has_vertex_color_uniform);
-    }
+    handle->lit.frame_buffer = gfx_buffer_create(GFX_BUFFER_UNIFORM, GFX_BUFFER_UPDATE_DYNAMIC_DRAW, 0,
+                                                 sizeof(lit_frame_block));
+    scene_material_blocks_build(handle);
 
     /*
      * Shadow renderer — owns depth FBO + shader + light-space matrix.
      */
     shadow_renderer_init(&handle->shadow);
 
-    /* Register shadow + BRDF LUT uniforms in every Lit material */
-    for (uint32_t i = 0; i < handle->materials_count; ++i) {
-        scene_internal_pbr_material *mat = handle->materials + i;
-        gfx_shader_uniform_enable(mat->shader, "shadow_map",       GFX_TYPE_SAMPLER_2D,  &mat->shadow_map_uniform);
-        gfx_shader_uniform_enable(mat->shader, "light_space",      GFX_TYPE_FLOAT_MAT_4, &mat->light_space_uniform);
-        gfx_shader_uniform_enable(mat->shader, "brdf_lut",         GFX_TYPE_SAMPLER_2D,  &mat->brdf_lut_uniform);
-        gfx_shader_uniform_enable(mat->shader, "prefiltered_env",  GFX_TYPE_SAMPLER_CUBE, &mat->prefiltered_env_uniform);
-    }
-
     /*
      * Ground renderer — owns 20x20 quad + Lit shader instance.
      */
@@ -388,25 +2257,51 @@ scene_handle scene_new(scene_desc const* desc) {
     /*
      * BRDF integration LUT — generated once via a GPU render pass.
      */
-    handle->brdf_lut = brdf_lut_generate();
+    asset_cache_key brdf_key = asset_cache_key_begin();
+    asset_cache_key_add_string(&brdf_key, "BrdfLut");
+    handle->brdf_lut = asset_cache_acquire(ASSET_CACHE_BRDF_LUT, &brdf_key);
+    if (handle->brdf_lut == 0)
+        handle->brdf_lut = asset_cache_insert(ASSET_CACHE_BRDF_LUT, &brdf_key, brdf_lut_generate(), SCENE_BRDF_LUT_BYTES,
+                                              scene_texture_destroy);
 
     /*
-     * Loading of the meshes.
+     * Loading of the meshes. Primitives held by the chunk cache come first and stay on disk
+     * until their chunk is paged in.
      */
 
     handle->meshes_count = model->meshes_count;
-    handle->meshes = OS_MALLOC(sizeof(struct scene_internal_mesh) * model->meshes_count);
-
     for (uint32_t i = 0; i < handle->meshes_count; ++i) {
         scene_internal_mesh* mesh = handle->meshes + i;
         mdl_mesh* m_mesh = model->meshes + i;
         mesh->primitives_count = m_mesh->primitives_count;
-        mesh->primitives = OS_MALLOC(sizeof(scene_internal_mesh_primitive) * m_mesh->primitives_count);
+        mesh->primitives = handle->mesh_primitives + handle->mesh_primitives_count;
+        handle->mesh_primitives_count += m_mesh->primitives_count;
         for (uint32_t j = 0; j < m_mesh->primitives_count; ++j) {
             if(m_mesh->primitives[j].material_id < 0 || m_mesh->primitives[j].material_id >= handle->materials_count)
                 m_mesh->primitives[j].material_id = 0;
-
-            mesh->primitives[j] = scene_new_primitive(handle->materials[m_mesh->primitives[j].material_id].shader, handle->shadow.shader, m_mesh->primitives[j]);
+            mesh->primitives[j] = scene_new_primitive(m_mesh->primitives[j]);
+            if (m_mesh->primitives[j].lods_count > 0) {
+                mesh->primitives[j].lods = handle->mesh_lods + handle->mesh_lods_count;
+                mesh->primitives[j].lods_count = m_mesh->primitives[j].lods_count;
+                os_memcpy(mesh->primitives[j].lods, m_mesh->primitives[j].lods, (int32_t)sizeof(mdl_lod) * m_mesh->primitives[j].lods_count);
+                handle->mesh_lods_count += m_mesh->primitives[j].lods_count;
+            }
+        }
+    }
+    if (handle->chunks != 0) {
+        scene_chunks_assign(handle, model, desc->consume_geometry);
+        chunk_cache_stats chunk_stats;
+        chunk_cache_get_stats(handle->chunks, &chunk_stats);
+        if (verbose) printf("- Geometry chunks: %i\n", chunk_stats.chunks_count);
+    }
+    for (uint32_t i = 0; i < handle->meshes_count; ++i) {
+        scene_internal_mesh* mesh = handle->meshes + i;
+        mdl_mesh* m_mesh = model->meshes + i;
+        for (uint32_t j = 0; j < m_mesh->primitives_count; ++j) {
+            if (mesh->primitives[j].streamed) continue;
+            scene_primitive_bounds(mesh, mesh->primitives + j, m_mesh->primitives + j);
+            if (desc->pick_triangles)
+                scene_primitive_pick_copy(mesh->primitives + j, m_mesh->primitives + j);
         }
     }
 
@@ -415,21 +2310,15 @@ scene_handle scene_new(scene_desc const* desc) {
      */
 
     handle->nodes_count = model->nodes_count;
-    handle->nodes = OS_MALLOC(sizeof(struct scene_internal_node) * model->nodes_count);
     handle->active_camera_node = -1;
-    int32_t root_nodes_count = 0, leaf_nodes_count = 0;
+    int32_t root_nodes_count = 0, leaf_nodes_count = 0, children_used = 0;
     for (uint32_t i = 0; i < handle->nodes_count; ++i) {
 
         scene_internal_node *node = handle->nodes + i;
         mdl_node *m_node = model->nodes + i;
         node->children_count = m_node->children_count;
-        node->children_id = OS_MALLOC(sizeof(int32_t) * m_node->children_count);
-        if (m_node->name != 0) {
-            node->name = OS_MALLOC(sizeof(char) * (strlen(m_node->name) + 1));
-            os_memcpy(node->name, m_node->name, sizeof(char) * (strlen(m_node->name) + 1));
-        } else {
-            node->name = 0;
-        }
+        node->children_id = handle->children_ids + children_used;
+        children_used += m_node->children_count;
         node->parent_id = m_node->parent_id;
         node->local_id = i;
 
@@ -445,9 +2334,14 @@ scene_handle scene_new(scene_desc const* desc) {
         gl_mat rot = gl_mat_from_quaternion(localRot);
         gl_mat scale = gl_mat_scale(localScale);
 
-        node->local_tr = gl_mat_mul(pos, gl_mat_mul(rot, scale));
+        //by node id until the node order moves them to their slots
+        handle->local_trs[i] = gl_mat_mul(pos, gl_mat_mul(rot, scale));
 
         node->mesh_index = m_node->mesh_index;
+        node->baked = false;
+        node->holds_baked = false;
+        node->dirty = false;
+        node->order_index = node->subtree_end = 0;
         node->camera_index = m_node->camera_index;
         node->light_index = m_node->light_index;
 
@@ -457,9 +2351,6 @@ scene_handle scene_new(scene_desc const* desc) {
         if(node->children_count <= 0)
             leaf_nodes_count++;
 
-        if(node->mesh_index != -1)
-            handle->meshes[node->mesh_index].node_index = i;
-
         if(node->camera_index != -1)
             handle->cameras[node->camera_index].node_index = i;
 
@@ -472,7 +2363,8 @@ scene_handle scene_new(scene_desc const* desc) {
         os_memcpy(node->children_id, m_node->children_id, sizeof(int32_t) * m_node->children_count);
     }
 
-    handle->root_nodes = OS_MALLOC(sizeof(void*) * root_nodes_count);
+    scene_node_names_build(handle, model);
+
     handle->root_nodes_count = root_nodes_count;
     for(int32_t i=0, count=0; i<handle->nodes_count; ++i) {
         scene_internal_node *node = handle->nodes + i;
@@ -486,16 +2378,44 @@ scene_handle scene_new(scene_desc const* desc) {
      * Update scene graph.
      */
 
-    for(int32_t i=0; i<handle->nodes_count; ++i) {
-        scene_internal_node* cur_node = handle->nodes + i;
-        gl_mat world_tr = cur_node->local_tr;
-        while (cur_node->parent_id != -1) {
-            cur_node = handle->nodes + cur_node->parent_id;
-            world_tr = gl_mat_mul(cur_node->local_tr, world_tr);
+    scene_transforms_alloc(handle);
+    scene_node_order_build(handle);
+    for (uint32_t i = 0; i < handle->root_nodes_count; ++i)
+        scene_node_mark_dirty(handle, handle->root_nodes[i]);
+    scene_world_update(handle);
+
+    /*
+     * Static batches, appended to the meshes with a single primitive each. Geometry is assigned once
+     * the meshes left to the batches are known.
+     */
+    mdl_primitive* batches = 0;
+    if (bake_static)
+        batches = scene_static_bake(handle, model, desc, &handle->static_batches_count);
+    for (int32_t i = 0; i < model->meshes_count; ++i) {
+        scene_internal_mesh* mesh = handle->meshes + i;
+        if (mesh->baked) continue;
+        for (int32_t j = 0; j < mesh->primitives_count; ++j) {
+            if (!mesh->primitives[j].streamed)
+                scene_geometry_assign(handle, model->meshes[i].primitives + j, mesh->primitives + j, -1);
+        }
+    }
+    if (bake_static) {
+        for (int32_t i = 0; i < handle->static_batches_count; ++i) {
+            scene_internal_mesh* mesh = handle->meshes + handle->meshes_count++;
+            mesh->primitives_count = 1;
+            mesh->primitives = handle->mesh_primitives + handle->mesh_primitives_count++;
+            mesh->primitives[0] = scene_new_primitive(batches[i]);
+            scene_geometry_assign(handle, batches + i, mesh->primitives, -1);
+            scene_primitive_bounds(mesh, mesh->primitives, batches + i);
         }
-        cur_node = handle->nodes + i;
-        cur_node->world_tr = world_tr;
+        if (verbose) printf("- Static batches: %i, baked nodes: %i\n", handle->static_batches_count, handle->static_nodes_count);
     }
+    scene_mesh_nodes_build(handle);
+    scene_geometry_upload(handle, model, batches, desc->consume_geometry);
+    OS_FREE(batches);
+    scene_transforms_create(handle);
+
+    scene_draw_items_build(handle);
 
     /*
      * Highlight shader — inverted-hull outline for selected node.
@@ -504,10 +2424,7 @@ scene_handle scene_new(scene_desc const* desc) {
     {
         void* hl_vs = device_file_read_text("./Shaders/Highlight.vs");
         void* hl_fs = device_file_read_text("./Shaders/Highlight.fs");
-        handle->highlight_shader = gfx_shader_create("Highlight");
-        gfx_shader_add_vs(handle->highlight_shader, hl_vs);
-        gfx_shader_add_fs(handle->highlight_shader, hl_fs);
-        gfx_shader_submit(handle->highlight_shader);
+        handle->highlight_shader = gfx_shader_acquire("Highlight", hl_vs, hl_fs, 0);
         OS_FREE(hl_vs);
         OS_FREE(hl_fs);
 
@@ -516,32 +2433,10 @@ scene_handle scene_new(scene_desc const* desc) {
         gfx_shader_uniform_enable(handle->highlight_shader, "projection",    GFX_TYPE_FLOAT_MAT_4, &handle->hl_proj_u);
         gfx_shader_uniform_enable(handle->highlight_shader, "outline_scale", GFX_TYPE_FLOAT_VEC_1, &handle->hl_scale_u);
         gfx_shader_uniform_enable(handle->highlight_shader, "outline_color", GFX_TYPE_FLOAT_VEC_4, &handle->hl_color_u);
-
-        /* Build a highlight pipeline for each mesh primitive (pos + normal only). */
-        for (uint32_t mi = 0; mi < handle->meshes_count; ++mi) {
-            scene_internal_mesh *mesh = handle->meshes + mi;
-            mdl_mesh *m_mesh = model->meshes + mi;
-            for (uint32_t pi = 0; pi < (uint32_t)mesh->primitives_count; ++pi) {
-                scene_internal_mesh_primitive *prim = mesh->primitives + pi;
-                prim->highlight_pipeline = gfx_pipeline_create(handle->highlight_shader);
-                for (int32_t ai = 0; ai < m_mesh->primitives[pi].attributes_count; ++ai) {
-                    mdl_attribute *attr = m_mesh->primitives[pi].attributes + ai;
-                    if (attr->type == MDL_VERTEX_ATTRIBUTE_POSITION) {
-                        gfx_pipeline_attr_enable(prim->highlight_pipeline, ATTR_POSITION_NAME,
-                            prim->buffer_handle, attr->count, attr->offset,
-                            m_mesh->primitives[pi].vertex_stride);
-                    } else if (attr->type == MDL_VERTEX_ATTRIBUTE_NORMAL) {
-                        gfx_pipeline_attr_enable(prim->highlight_pipeline, ATTR_NORMAL_NAME,
-                            prim->buffer_handle, attr->count, attr->offset,
-                            m_mesh->primitives[pi].vertex_stride);
-                    }
-                }
-                gfx_pipeline_index_enable(prim->highlight_pipeline, prim->index_handle);
-                gfx_pipeline_submit(prim->highlight_pipeline);
-            }
-        }
     }
 
+    //loading is not a change the consumers have to redo work for
+    scene_clear_changes(handle);
     return handle;
 }
 
@@ -553,16 +2448,46 @@ void scene_shadow_pass(scene_handle handle) {
                    GFX_PASS_ACTION_CLEAR_DEPTH, black);
     gfx_viewport_set(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
 
-    for (int32_t i = 0; i < handle->meshes_count; ++i) {
-        scene_internal_mesh *mesh      = handle->meshes + i;
-        scene_internal_node  mesh_node = handle->nodes[mesh->node_index];
-        for (int32_t j = 0; j < mesh->primitives_count; ++j) {
-            scene_internal_mesh_primitive *prim = mesh->primitives + j;
-            gfx_pipeline_bind(prim->shadow_pipeline);
-            gfx_shader_uniform_set(sr->shader, sr->model_uniform, mesh_node.world_tr.data);
-            gfx_shader_uniform_set(sr->shader, sr->ls_uniform,    sr->light_space.data);
-            gfx_draw_id(prim->draw_type, prim->indices_count);
+    scene_world_update(handle);
+    if (handle->draw_items_dirty)
+        scene_draw_items_build(handle);
+    scene_draw_items_bounds_update(handle);
+
+    scene_internal_frustum frustum;
+    scene_frustum_from_matrix(sr->light_space.data, &frustum);
+    scene_draw_stats* stats = &handle->draw_stats;
+    stats->shadow_culled = stats->shadow_draw_calls = 0;
+    stats->shadow_drawn = scene_draw_items_cull(handle, 0, handle->shadow_items_count, 0, &frustum, 0,
+                                                gl_vec3_new(0, 0, 0), 0.0f, &stats->shadow_culled);
+
+    int32_t transforms_unit = 5;
+    int32_t instances_unit = 6;
+    scene_transforms_upload(handle);
+    scene_visible_instances_upload(handle, stats->shadow_drawn);
+    gfx_texture_bind(handle->transforms.texture, transforms_unit);
+    gfx_texture_bind(handle->visible.texture, instances_unit);
+    gfx_shader_bind(sr->shader);
+    gfx_shader_uniform_set(sr->shader, sr->ls_uniform, sr->light_space.data);
+    gfx_shader_uniform_set(sr->shader, sr->transforms_uniform, &transforms_unit);
+    gfx_shader_uniform_set(sr->shader, sr->instances_uniform, &instances_unit);
+
+    gfx_pipeline_handle bound_pipeline = 0;
+    stats->shadow_pipeline_binds = 0;
+    for (int32_t i = 0; i < handle->shadow_items_count; ++i) {
+        scene_internal_draw_item* item = handle->draw_items + i;
+        if (item->visible_count == 0) continue;
+        if (item->pipeline == 0) {
+            scene_internal_mesh_primitive const* primitive = handle->meshes[item->mesh_index].primitives + item->primitive_index;
+            item->pipeline = scene_geometry_shadow_pipeline(handle, handle->geometries + primitive->geometry_index);
         }
+        if (item->pipeline != bound_pipeline) {
+            gfx_pipeline_bind(item->pipeline);
+            bound_pipeline = item->pipeline;
+            stats->shadow_pipeline_binds++;
+        }
+        gfx_shader_uniform_set(sr->shader, sr->instance_offset_uniform, (void*)&item->visible_begin);
+        gfx_draw_id_instanced(item->draw_type, item->first_index, item->indices_count, item->visible_count);
+        stats->shadow_draw_calls++;
     }
 
     gfx_end_pass();
@@ -574,11 +2499,12 @@ void scene_draw(scene_handle handle) {
         return;
     }
 
+    scene_world_update(handle);
     scene_internal_node *camera_node = handle->nodes + (handle->active_camera_node);
     scene_camera camera;
     scene_node node;
     scene_camera_get_at(handle, camera_node->camera_index, &node, &camera);
-    scene_draw_with_camera(handle, camera.projection, camera_node->world_tr.data, true, false);
+    scene_draw_with_camera(handle, camera.projection, scene_world_tr(handle, handle->active_camera_node)->data, true, false);
 }
 
 void scene_draw_with_camera(scene_handle handle, float projection[16], float tr[16], bool draw_skybox, bool wireframe){
@@ -591,12 +2517,16 @@ void scene_draw_with_camera(scene_handle handle, float projection[16], float tr[
     int32_t shadow_unit    = 1;   /* shadow depth        */
     int32_t brdf_unit      = 2;   /* BRDF LUT            */
     int32_t prefilter_unit = 3;   /* prefiltered env IBL */
+    int32_t transforms_unit = 5;  /* world matrices      */
+    int32_t instances_unit = 6;   /* visible instances   */
     float exposure = handle->skybox_enabled ? skybox_get_exposure(handle->skybox) : 1.0f;
     if(handle->skybox_enabled) {
         skybox_bind(handle->skybox);  /* binds cubemap to unit 0 */
     }
     gfx_texture_bind(handle->shadow.depth_tex, shadow_unit);
     gfx_texture_bind(handle->brdf_lut,         brdf_unit);
+    scene_transforms_upload(handle);
+    gfx_texture_bind(handle->transforms.texture, transforms_unit);
     if (handle->prefiltered_env_id) {
         prefilter_env_bind(handle->prefiltered_env_id, prefilter_unit);
     }
@@ -607,60 +2537,108 @@ void scene_draw_with_camera(scene_handle handle, float projection[16], float tr[
 
     gfx_wireframe_enable(wireframe);
 
-    for (int32_t i = 0; i < handle->meshes_count; ++i) {
-        scene_internal_mesh *mesh = handle->meshes + i;
-        for (int32_t j = 0; j < mesh->primitives_count; ++j) {
+    /* Frame block and sampler units, constant for the whole pass */
+    scene_internal_lit_program const* lit = &handle->lit;
+    lit_frame_block frame;
+    os_memcpy(frame.projection, projection, sizeof(frame.projection));
+    os_memcpy(frame.view, view.data, sizeof(frame.view));
+    os_memcpy(frame.light_space, handle->shadow.light_space.data, sizeof(frame.light_space));
+    os_memcpy(frame.view_position, view_pos.data, sizeof(frame.view_position));
+    frame.exposure = exposure;
+    gfx_buffer_update(lit->frame_buffer, &frame, 0, sizeof(lit_frame_block));
+    gfx_buffer_bind_uniform(lit->frame_buffer, FRAME_BLOCK_BINDING, 0, sizeof(lit_frame_block));
+
+    int32_t base_color_unit = 4;
+    gfx_shader_bind(lit->shader);
+    gfx_shader_uniform_set(lit->shader, lit->skybox_uniform,          &texture_unit);
+    gfx_shader_uniform_set(lit->shader, lit->shadow_map_uniform,      &shadow_unit);
+    gfx_shader_uniform_set(lit->shader, lit->brdf_lut_uniform,        &brdf_unit);
+    gfx_shader_uniform_set(lit->shader, lit->prefiltered_env_uniform, &prefilter_unit);
+    gfx_shader_uniform_set(lit->shader, lit->base_color_tex_uniform,  &base_color_unit);
+    gfx_shader_uniform_set(lit->shader, lit->transforms_uniform,      &transforms_unit);
+    gfx_shader_uniform_set(lit->shader, lit->instances_uniform,       &instances_unit);
+
+    int32_t viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    scene_world_update(handle);
+    if (handle->draw_items_dirty)
+        scene_draw_items_build(handle);
+    scene_draw_items_bounds_update(handle);
+
+    //slot 0 holds the ground transform, the lit items follow
+    scene_internal_frustum frustum;
+    gl_mat view_projection = gl_mat_mul(gl_mat_new_array(projection), view);
+    scene_frustum_from_matrix(view_projection.data, &frustum);
+    if (handle->chunks != 0)
+        scene_chunks_request(handle, &frustum, view_pos);
+    scene_draw_stats* stats = &handle->draw_stats;
+    stats->culled = stats->draw_calls = 0;
+    handle->visible.data[0] = (float)(handle->transforms.count - 1);
+    int32_t visible_count = scene_draw_items_cull(handle, handle->shadow_items_count, handle->draw_items_count, 1, &frustum,
+                                                  projection, view_pos, (float)viewport[3], &stats->culled);
+    stats->drawn = visible_count - 1;
+    qsort(handle->draw_items + handle->shadow_items_count, handle->draw_items_count - handle->shadow_items_count,
+          sizeof(scene_internal_draw_item), scene_draw_item_compare);
+    scene_visible_instances_upload(handle, visible_count);
+    gfx_texture_bind(handle->visible.texture, instances_unit);
+
+    /* Sorted queue, state is only touched when it differs from the previous item */
+    gfx_pipeline_handle bound_pipeline = 0;
+    stats->pipeline_binds = 0;
+    int32_t bound_block = -1;
+    int32_t bound_material = -1;
+    int32_t bound_vertex_color = -1;
+    for (int32_t i = handle->shadow_items_count; i < handle->draw_items_count; ++i) {
+        scene_internal_draw_item const* item = handle->draw_items + i;
+        if (item->visible_count == 0) continue;
+
+        scene_internal_pbr_material *mat = handle->materials + item->material_id;
+        if (item->pipeline != bound_pipeline) {
+            gfx_pipeline_bind(item->pipeline);
+            bound_pipeline = item->pipeline;
+            stats->pipeline_binds++;
+        }
 
-            scene_internal_mesh_primitive *primitive = mesh->primitives + j;
-            gfx_pipeline_bind(primitive->pipeline_handle);
-            scene_internal_pbr_material *mat = handle->materials + primitive->material_id;
-
-            if (primitive->material_id != -1 && mat->valid) {
-
-                scene_internal_node mesh_node = handle->nodes[mesh->node_index];
-
-                gfx_shader_uniform_set(mat->shader, mat->view_position_uniform, view_pos.data);
-                gfx_shader_uniform_set(mat->shader, mat->model_uniform, mesh_node.world_tr.data);
-                gfx_shader_uniform_set(mat->shader, mat->view_uniform, view.data);
-                gfx_shader_uniform_set(mat->shader, mat->projection_uniform, projection);
-                gfx_shader_uniform_set(mat->shader, mat->color_uniform, mat->color_factor);
-                gfx_shader_uniform_set(mat->shader, mat->rougness_uniform, &mat->roughness_factor);
-                gfx_shader_uniform_set(mat->shader, mat->metallic_uniform, &mat->metallic_factor);
-                gfx_shader_uniform_set(mat->shader, mat->skybox_uniform, &texture_unit);
-                gfx_shader_uniform_set(mat->shader, mat->exposure_uniform, &exposure);
-                gfx_shader_uniform_set(mat->shader, mat->shadow_map_uniform,  &shadow_unit);
-                gfx_shader_uniform_set(mat->shader, mat->light_space_uniform, handle->shadow.light_space.data);
-                gfx_shader_uniform_set(mat->shader, mat->brdf_lut_uniform,           &brdf_unit);
-                gfx_shader_uniform_set(mat->shader, mat->prefiltered_env_uniform, &prefilter_unit);
-
-                /* Base color texture (unit 4) */
-                int32_t base_color_unit = 4;
-                int32_t has_color_tex   = 0;
-                if (mat->color_texture_id >= 0 &&
-                    mat->color_texture_id < (int32_t)handle->textures_count &&
-                    handle->textures[mat->color_texture_id].texture_handle != 0) {
-                    gfx_texture_bind(handle->textures[mat->color_texture_id].texture_handle,
-                                     base_color_unit);
-                    has_color_tex = 1;
-                }
-                int32_t has_vtx_col = primitive->has_vertex_color ? 1 : 0;
-                gfx_shader_uniform_set(mat->shader, mat->base_color_tex_uniform,    &base_color_unit);
-                gfx_shader_uniform_set(mat->shader, mat->has_color_tex_uniform,     &has_color_tex);
-                gfx_shader_uniform_set(mat->shader, mat->has_vertex_color_uniform,  &has_vtx_col);
+        int32_t block = mat->block_index / MATERIAL_BLOCK_SIZE;
+        if (block != bound_block) {
+            gfx_buffer_bind_uniform(lit->material_buffer, MATERIAL_BLOCK_BINDING,
+                                    block * (int32_t)sizeof(lit_material_block), sizeof(lit_material_block));
+            bound_block = block;
+        }
 
-            }
+        /* Base color texture (unit 4), rebound only when the material changes */
+        if (mat->block_index != bound_material) {
+            int32_t material_index = mat->block_index % MATERIAL_BLOCK_SIZE;
+            gfx_shader_uniform_set(lit->shader, lit->material_index_uniform, &material_index);
+            gfx_texture_handle color_texture = texture_streamer_get(handle->texture_streamer, mat->color_texture_id);
+            if (color_texture != 0)
+                gfx_texture_bind(color_texture, base_color_unit);
+            bound_material = mat->block_index;
+        }
+        if (mat->color_texture_id != -1)
+            texture_streamer_request(handle->texture_streamer, mat->color_texture_id, item->screen_size);
+
+        int32_t has_vtx_col = item->has_vertex_color ? 1 : 0;
+        if (has_vtx_col != bound_vertex_color) {
+            gfx_shader_uniform_set(lit->shader, lit->has_vertex_color_uniform, &has_vtx_col);
+            bound_vertex_color = has_vtx_col;
+        }
+        gfx_shader_uniform_set(lit->shader, lit->instance_offset_uniform, (void*)&item->visible_begin);
 
-            gfx_draw_id(primitive->draw_type, primitive->indices_count);
+        if (item->lod > 0) {
+            mdl_lod const* lod = handle->meshes[item->mesh_index].primitives[item->primitive_index].lods + item->lod - 1;
+            gfx_draw_id_instanced(item->draw_type, item->first_index + (int32_t)lod->index_offset, (int32_t)lod->index_count,
+                                  item->visible_count);
+        } else {
+            gfx_draw_id_instanced(item->draw_type, item->first_index, item->indices_count, item->visible_count);
         }
+        stats->draw_calls++;
     }
 
-    /* Ground plane */
+    /* Ground plane, same program with its own material block */
     if (handle->plane_render) {
-        ground_renderer_render(&handle->ground,
-                               projection, view.data, view_pos.data,
-                               texture_unit, exposure,
-                               shadow_unit, handle->shadow.light_space.data,
-                               brdf_unit, prefilter_unit);
+        ground_renderer_render(&handle->ground, 0);
     }
 
     gfx_wireframe_enable(false);
@@ -672,16 +2650,26 @@ void scene_draw_with_camera(scene_handle handle, float projection[16], float tr[
             scene_internal_mesh *mesh = &handle->meshes[sel->mesh_index];
             float outline_scale = 0.025f;
             float outline_color[4] = {1.0f, 0.55f, 0.05f, 1.0f};
+            //baked meshes are outlined from their range in the static batch, already in world space
+            int32_t model_meshes_count = (int32_t)handle->meshes_count - handle->static_batches_count;
+            gl_mat identity = gl_mat_new_identity();
             glCullFace(GL_FRONT);
             for (int32_t j = 0; j < mesh->primitives_count; ++j) {
                 scene_internal_mesh_primitive *prim = &mesh->primitives[j];
-                gfx_pipeline_bind(prim->highlight_pipeline);
-                gfx_shader_uniform_set(handle->highlight_shader, handle->hl_model_u, sel->world_tr.data);
+                scene_internal_mesh_primitive const* drawn = mesh->baked ?
+                        handle->meshes[model_meshes_count + prim->baked_batch].primitives : prim;
+                if (!scene_primitive_resident(handle, drawn)) continue;
+                gfx_pipeline_bind(scene_geometry_highlight_pipeline(handle, handle->geometries + drawn->geometry_index));
+                gfx_shader_uniform_set(handle->highlight_shader, handle->hl_model_u,
+                                       mesh->baked ? identity.data : scene_world_tr(handle, handle->selected_node_id)->data);
                 gfx_shader_uniform_set(handle->highlight_shader, handle->hl_view_u,  view.data);
                 gfx_shader_uniform_set(handle->highlight_shader, handle->hl_proj_u,  projection);
                 gfx_shader_uniform_set(handle->highlight_shader, handle->hl_scale_u, &outline_scale);
                 gfx_shader_uniform_set(handle->highlight_shader, handle->hl_color_u, outline_color);
-                gfx_draw_id(prim->draw_type, prim->indices_count);
+                if (mesh->baked)
+                    gfx_draw_id_range(drawn->draw_type, drawn->first_index + prim->baked_first_index, prim->baked_indices_count);
+                else
+                    gfx_draw_id_range(prim->draw_type, prim->first_index, prim->indices_count);
             }
             glCullFace(GL_BACK);
         }
@@ -699,21 +2687,10 @@ void scene_set_skybox_render(scene_handle handle, bool render) {
 void scene_set_skybox_path(scene_handle handle, const char* path) {
     float exposure = scene_get_skybox_exposure(handle);
 
-    if (handle->skybox_enabled) {
-        skybox_destroy(handle->skybox);
-        handle->skybox = 0;
-        handle->skybox_enabled = false;
-    }
-    if (handle->prefiltered_env_id) {
-        prefilter_env_destroy(handle->prefiltered_env_id);
-        handle->prefiltered_env_id = 0;
-    }
-
+    scene_environment_release(handle);
     if (path != 0 && path[0] != '\0') {
-        handle->skybox = skybox_load(path);
+        scene_environment_acquire(handle, path);
         skybox_set_exposure(handle->skybox, gl_clamp(exposure, 0.1f, 5.0f));
-        handle->skybox_enabled = true;
-        handle->prefiltered_env_id = prefilter_env_generate(skybox_get_cubemap_id(handle->skybox));
     }
 }
 
@@ -740,74 +2717,105 @@ void scene_set_plane_render(scene_handle handle, bool render) {
 }
 
 void scene_delete(scene_handle handle) {
-    for(int32_t i=0; i<handle->textures_count; ++i)
-        gfx_texture_destroy(handle->textures[i].texture_handle);
-    if(handle->textures != 0)
-        OS_FREE(handle->textures);
-
-    if(handle->cameras != 0)
-        OS_FREE(handle->cameras);
-    if(handle->lights != 0)
-        OS_FREE(handle->lights);
+    asset_cache_release(ASSET_CACHE_TEXTURES, handle->texture_streamer);
+
     for(int32_t i=0; i<handle->meshes_count; ++i)
     {
         scene_internal_mesh * mesh = handle->meshes + i;
-        for(int32_t j=0; j<mesh->primitives_count; ++j)
-        {
-            scene_internal_mesh_primitive* primitive = mesh->primitives + j;
-            gfx_buffer_destroy(primitive->buffer_handle);
-            gfx_buffer_destroy(primitive->index_handle);
-            gfx_pipeline_destroy(primitive->pipeline_handle);
-            gfx_pipeline_destroy(primitive->shadow_pipeline);
-            gfx_pipeline_destroy(primitive->highlight_pipeline);
+        for (int32_t j = 0; j < mesh->primitives_count; ++j) {
+            OS_FREE(mesh->primitives[j].pick_positions);
+            OS_FREE(mesh->primitives[j].pick_indices);
+            if (mesh->primitives[j].triangles_bvh != 0)
+                bvh_destroy(mesh->primitives[j].triangles_bvh);
         }
-        OS_FREE(mesh->primitives);
     }
-
-    if(handle->materials != 0) {
-        for (int32_t i = 0; i < handle->materials_count; ++i) {
-            gfx_shader_destroy(handle->materials[i].shader);
-        }
-        OS_FREE(handle->materials);
+    //the loader is stopped before the chunk geometries go, resident ones are freed with the rest
+    if (handle->chunks != 0)
+        chunk_cache_close(handle->chunks);
+    OS_FREE(handle->chunk_geometries);
+    for (int32_t i = 0; i < handle->geometries_count; ++i) {
+        scene_internal_geometry* geometry = handle->geometries + i;
+        if (geometry->chunk_index == -1)
+            asset_cache_release(ASSET_CACHE_GEOMETRY, geometry->buffers);
+        else if (geometry->buffers != 0)
+            scene_geometry_buffers_destroy(geometry->buffers);
+        scene_geometry_pipelines_destroy(geometry);
+        OS_FREE(geometry->attributes);
     }
+    OS_FREE(handle->geometries);
 
-    OS_FREE(handle->meshes);
-
-    for(int32_t i=0; i<handle->nodes_count; ++i)
-    {
-        scene_internal_node * node = handle->nodes + i;
-        OS_FREE(node->children_id);
-        OS_FREE(node->name);
-    }
+    gfx_buffer_destroy(handle->lit.frame_buffer);
+    gfx_buffer_destroy(handle->lit.material_buffer);
+    gfx_shader_release(handle->lit.shader);
 
-    if(handle->skybox_enabled)
-        skybox_destroy(handle->skybox);
+    scene_environment_release(handle);
 
     shadow_renderer_destroy(&handle->shadow);
     ground_renderer_destroy(&handle->ground);
-    gfx_texture_destroy(handle->brdf_lut);
-    if (handle->prefiltered_env_id)
-        prefilter_env_destroy(handle->prefiltered_env_id);
+    asset_cache_release(ASSET_CACHE_BRDF_LUT, handle->brdf_lut);
     if (handle->highlight_shader)
-        gfx_shader_destroy(handle->highlight_shader);
-
-    OS_FREE(handle->root_nodes);
-    OS_FREE(handle->nodes);
-    OS_FREE(handle);
+        gfx_shader_release(handle->highlight_shader);
+
+    OS_FREE(handle->draw_items);
+    OS_FREE(handle->instances);
+    OS_FREE(handle->node_instances);
+    OS_FREE(handle->node_instances_begin);
+    if (handle->pick_bvh != 0)
+        bvh_destroy(handle->pick_bvh);
+    OS_FREE(handle->pick_items);
+    OS_FREE(handle->pick_results);
+    OS_FREE(handle->node_pick_begin);
+    OS_FREE(handle->node_marks);
+    gfx_texture_destroy(handle->visible.texture);
+    OS_FREE(handle->visible.data);
+    gfx_texture_destroy(handle->transforms.texture);
+    //the handle heads the arena, freeing it releases every model sized block
+    OS_FREE(handle->arena_memory);
 }
 
 bool scene_node_get(scene_handle handle, const char *name, scene_node * out_node) {
     os_memset(out_node, 0, sizeof(scene_node));
-    for(int32_t i=0; i<handle->nodes_count; ++i) {
-        if (handle->nodes[i].name == 0) continue;
-        if (strcmp(handle->nodes[i].name, name) == 0) {
-            scene_node_get_at(handle, i, out_node);
+    uint32_t mask = handle->name_table_capacity - 1;
+    for (uint32_t slot = scene_name_hash(name) & mask; handle->name_table[slot] != SCENE_NAME_EMPTY_SLOT; slot = (slot + 1) & mask) {
+        int32_t id = handle->name_table[slot];
+        if (strcmp(handle->nodes[id].name, name) == 0) {
+            scene_node_get_at(handle, id, out_node);
             return true;
         }
     }
     return false;
 }
 
+int32_t scene_node_find_prefix(scene_handle handle, const char* prefix, scene_node* out_nodes, int32_t capacity) {
+    size_t length = strlen(prefix);
+
+    //first name not below the prefix
+    int32_t low = 0, high = handle->sorted_names_count;
+    while (low < high) {
+        int32_t middle = low + (high - low) / 2;
+        if (strncmp(handle->sorted_names[middle].name, prefix, length) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    int32_t begin = low;
+
+    //first name above every name with the prefix
+    high = handle->sorted_names_count;
+    while (low < high) {
+        int32_t middle = low + (high - low) / 2;
+        if (strncmp(handle->sorted_names[middle].name, prefix, length) <= 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    int32_t count = low - begin;
+    for (int32_t i = 0; i < count && i < capacity; ++i)
+        scene_node_get_at(handle, handle->sorted_names[begin + i].node_id, out_nodes + i);
+    return count;
+}
+
 void scene_node_set_camera(scene_handle handle, scene_node* node, scene_camera* camera_data) {
     scene_internal_node *node_int = (scene_internal_node *) node->internal;
     struct scene_internal_camera *camera = handle->cameras + node_int->camera_index;
@@ -844,7 +2852,95 @@ void scene_camera_count(scene_handle handle, int32_t* count){
 }
 
 void scene_mesh_count(scene_handle handle, int32_t* count){
-    *count = handle->meshes_count;
+    *count = (int32_t)handle->meshes_count - handle->static_batches_count;
+}
+
+void scene_static_stats(scene_handle handle, int32_t* batches_count, int32_t* nodes_count){
+    *batches_count = handle->static_batches_count;
+    *nodes_count = handle->static_nodes_count;
+}
+
+void scene_get_draw_stats(scene_handle handle, scene_draw_stats* stats){
+    *stats = handle->draw_stats;
+}
+
+void scene_material_count(scene_handle handle, int32_t* count, int32_t* unique_count){
+    *count = (int32_t)handle->materials_count;
+    *unique_count = handle->lit.unique_materials_count;
+}
+
+void scene_texture_count(scene_handle handle, int32_t* count){
+    *count = (int32_t)handle->textures_count;
+}
+
+void scene_texture_get_at(scene_handle handle, int32_t index, scene_texture* texture){
+    os_memset(texture, 0, sizeof(scene_texture));
+    gfx_texture_handle gfx_handle = texture_streamer_get(handle->texture_streamer, index);
+    texture->resident = gfx_handle != 0;
+    if (gfx_handle == 0) return;
+
+    texture->width = gfx_texture_get_width(gfx_handle);
+    texture->height = gfx_texture_get_height(gfx_handle);
+    texture->levels = gfx_texture_get_levels(gfx_handle);
+    texture->bytes = gfx_texture_get_bytes(gfx_handle);
+}
+
+int64_t scene_texture_bytes(scene_handle handle){
+    texture_streamer_stats stats;
+    texture_streamer_get_stats(handle->texture_streamer, &stats);
+    return stats.resident_bytes;
+}
+
+void scene_texture_streaming_stats(scene_handle handle, scene_texture_streaming* streaming){
+    texture_streamer_stats stats;
+    texture_streamer_get_stats(handle->texture_streamer, &stats);
+    streaming->resident_bytes = stats.resident_bytes;
+    streaming->budget_bytes = stats.budget_bytes;
+    streaming->uploaded_bytes = stats.uploaded_bytes;
+    streaming->resident_levels = stats.resident_levels;
+    streaming->total_levels = stats.total_levels;
+    streaming->evictions = stats.evictions;
+}
+
+void scene_set_texture_budget(scene_handle handle, int64_t budget_bytes){
+    texture_streamer_set_budget(handle->texture_streamer, budget_bytes);
+}
+
+bool scene_update_streaming(scene_handle handle){
+    bool changed = texture_streamer_update(handle->texture_streamer);
+    if (handle->chunks != 0)
+        changed |= chunk_cache_update(handle->chunks, scene_chunk_load, scene_chunk_evict, handle);
+    return changed;
+}
+
+void scene_chunk_streaming_stats(scene_handle handle, scene_chunk_streaming* streaming){
+    os_memset(streaming, 0, sizeof(scene_chunk_streaming));
+    if (handle->chunks == 0) return;
+
+    chunk_cache_stats stats;
+    chunk_cache_get_stats(handle->chunks, &stats);
+    streaming->chunks_count = stats.chunks_count;
+    streaming->resident_count = stats.resident_count;
+    streaming->pending_count = stats.pending_count;
+    streaming->resident_bytes = stats.resident_bytes;
+    streaming->budget_bytes = stats.budget_bytes;
+    streaming->staging_bytes = stats.staging_bytes;
+    streaming->loads = stats.loads;
+    streaming->evictions = stats.evictions;
+}
+
+void scene_set_chunk_budget(scene_handle handle, int64_t budget_bytes, int64_t staging_bytes){
+    if (handle->chunks != 0)
+        chunk_cache_set_budget(handle->chunks, budget_bytes, staging_bytes);
+}
+
+float scene_get_texture_anisotropy(scene_handle handle){
+    return handle->texture_anisotropy;
+}
+
+void scene_set_texture_anisotropy(scene_handle handle, float anisotropy){
+    texture_streamer_set_anisotropy(handle->texture_streamer, anisotropy);
+    handle->texture_anisotropy = gl_clamp(anisotropy, 1.0f, gfx_texture_max_anisotropy());
 }
 
 void scene_node_get_at(scene_handle handle, int32_t i, scene_node *out_node){
@@ -855,76 +2951,41 @@ void scene_node_get_at(scene_handle handle, int32_t i, scene_node *out_node){
 
 void scene_node_get_world_tr(scene_handle handle, scene_node* node, float* tr){
     scene_internal_node *node_int = (scene_internal_node *) node->internal;
-    os_memcpy(tr, node_int->world_tr.data, sizeof(gl_mat));
+    scene_world_update(handle);
+    os_memcpy(tr, scene_world_tr(handle, node_int->local_id)->data, sizeof(gl_mat));
+}
+
+//baked nodes are drawn from the static batches, moving them would only move their picking and bounds
+static bool scene_node_movable(scene_internal_node const* node) {
+    if (!node->holds_baked) return true;
+    printf("- Baked node can't be moved: %s\n", node->name != 0 ? node->name : "<unnamed>");
+    return false;
 }
 
 void scene_node_set_world_tr(scene_handle handle, scene_node* node, float* tr){
     scene_internal_node *node_int = (scene_internal_node *) node->internal;
-    scene_internal_node *cur_node = node_int;
-
-    if (cur_node->parent_id >= 0) {
-        cur_node = node_int;
+    if (!scene_node_movable(node_int)) return;
 
-        gl_mat local_tr = GL_MAT_IDENTITY;
-        while (cur_node->parent_id != -1) {
-            local_tr = gl_mat_mul((handle->nodes + cur_node->parent_id)->local_tr, local_tr);
-            cur_node = handle->nodes + cur_node->parent_id;
-        }
-        node_int->local_tr = gl_mat_mul(gl_mat_inverse(local_tr), gl_mat_new_array(tr));
+    if (node_int->parent_id >= 0) {
+        scene_world_update(handle);
+        gl_mat parent_tr = *scene_world_tr(handle, node_int->parent_id);
+        *scene_local_tr(handle, node_int->local_id) = gl_mat_mul(gl_mat_inverse(parent_tr), gl_mat_new_array(tr));
     } else {
-        os_memcpy(node_int->world_tr.data, tr, sizeof(float) * 16);
-    }
-
-    for(int32_t i=0; i<handle->nodes_count; ++i) {
-        cur_node = handle->nodes + i;
-
-        while (cur_node->parent_id != -1 && cur_node != node_int) {
-            cur_node = handle->nodes + cur_node->parent_id;
-        }
-
-        if (cur_node != node_int)
-            continue;
-
-        cur_node = handle->nodes + i;
-        gl_mat world_tr = cur_node->local_tr;
-        while (cur_node->parent_id != -1) {
-            cur_node = handle->nodes + cur_node->parent_id;
-            world_tr = gl_mat_mul(cur_node->local_tr, world_tr);
-        }
-        cur_node = handle->nodes + i;
-        cur_node->world_tr = world_tr;
+        os_memcpy(scene_local_tr(handle, node_int->local_id)->data, tr, sizeof(float) * 16);
     }
+    scene_node_mark_dirty(handle, node_int);
 }
 
 void scene_node_get_local_tr(scene_handle handle, scene_node* node, float* tr){
     scene_internal_node *node_int = (scene_internal_node *) node->internal;
-    os_memcpy(tr, node_int->local_tr.data, sizeof(gl_mat));
+    os_memcpy(tr, scene_local_tr(handle, node_int->local_id)->data, sizeof(gl_mat));
 }
 
 void scene_node_set_local_tr(scene_handle handle, scene_node* node, float* tr){
     scene_internal_node *node_int = (scene_internal_node *) node->internal;
-    os_memcpy(node_int->local_tr.data, tr, sizeof(float) * 16);
-
-    scene_internal_node *cur_node = node_int;
-    for(int32_t i=0; i<handle->nodes_count; ++i) {
-        cur_node = handle->nodes + i;
-
-        while (cur_node->parent_id != -1 && cur_node != node_int) {
-            cur_node = handle->nodes + cur_node->parent_id;
-        }
-
-        if (cur_node != node_int)
-            continue;
-
-        cur_node = handle->nodes + i;
-        gl_mat world_tr = cur_node->local_tr;
-        while (cur_node->parent_id != -1) {
-            cur_node = handle->nodes + cur_node->parent_id;
-            world_tr = gl_mat_mul(cur_node->local_tr, world_tr);
-        }
-        cur_node = handle->nodes + i;
-        cur_node->world_tr = world_tr;
-    }
+    if (!scene_node_movable(node_int)) return;
+    os_memcpy(scene_local_tr(handle, node_int->local_id)->data, tr, sizeof(float) * 16);
+    scene_node_mark_dirty(handle, node_int);
 }
 
 void scene_node_root_count(scene_handle handle, int32_t *count) {
@@ -940,6 +3001,13 @@ void scene_node_children_get_at(scene_handle handle, int32_t index, struct scene
     scene_node_get_at(handle, handle->nodes[*(node_int->children_id + index)].local_id, node);
 }
 
+bool scene_node_get_parent(scene_handle handle, scene_node* node, scene_node* parent) {
+    scene_internal_node *node_int = (scene_internal_node *) node->internal;
+    if (node_int->parent_id < 0) return false;
+    scene_node_get_at(handle, node_int->parent_id, parent);
+    return true;
+}
+
 void scene_camera_get_at(scene_handle handle, int32_t index, struct scene_node *node, struct scene_camera *camera_data) {
     scene_internal_camera *int_camera = handle->cameras + index;
     scene_node_get_at(handle, int_camera->node_index, node);
@@ -1006,4 +3074,117 @@ void scene_node_set_material(scene_handle handle, scene_node* node, int32_t mat_
     if (color) os_memcpy(mat->color_factor, color, sizeof(float) * 4);
     mat->metallic_factor  = metallic;
     mat->roughness_factor = roughness;
+    scene_journal_material(handle, mid);
+    if (handle->journal.transactions > 0) {
+        handle->journal.materials_dirty = true;
+        return;
+    }
+    scene_material_blocks_build(handle);
+    handle->draw_items_dirty = true;
+}
+
+/* ---- Change journal ---- */
+
+void scene_begin_changes(scene_handle handle) {
+    handle->journal.transactions++;
+}
+
+void scene_end_changes(scene_handle handle) {
+    scene_internal_journal* journal = &handle->journal;
+    if (journal->transactions == 0 || --journal->transactions > 0) return;
+
+    scene_world_update(handle);
+    if (journal->materials_dirty) {
+        scene_material_blocks_build(handle);
+        handle->draw_items_dirty = true;
+        journal->materials_dirty = false;
+    }
+}
+
+void scene_get_changes(scene_handle handle, scene_changes* changes) {
+    scene_internal_journal* journal = &handle->journal;
+    scene_world_update(handle);
+    if (handle->draw_items_dirty)
+        scene_draw_items_build(handle);
+    scene_draw_items_bounds_update(handle);
+
+    os_memset(changes, 0, sizeof(scene_changes));
+    changes->flags = journal->flags;
+    changes->nodes = journal->nodes;
+    changes->nodes_count = journal->nodes_count;
+    changes->materials = journal->materials;
+    changes->materials_count = journal->materials_count;
+    if (!journal->bounds_valid) return;
+
+    float center[3], extent[3];
+    for (int32_t c = 0; c < 3; ++c) {
+        changes->bounds_min[c] = journal->bounds_min[c];
+        changes->bounds_max[c] = journal->bounds_max[c];
+        center[c] = (journal->bounds_min[c] + journal->bounds_max[c]) * 0.5f;
+        extent[c] = (journal->bounds_max[c] - journal->bounds_min[c]) * 0.5f;
+    }
+    scene_internal_frustum frustum;
+    scene_frustum_from_matrix(handle->shadow.light_space.data, &frustum);
+    if (scene_frustum_test(&frustum, center, extent))
+        changes->flags |= SCENE_CHANGE_SHADOWS;
+}
+
+void scene_clear_changes(scene_handle handle) {
+    scene_internal_journal* journal = &handle->journal;
+    //instance boxes still follow the listed nodes, unless the queue is rebuilt anyway
+    if (!handle->draw_items_dirty)
+        scene_draw_items_bounds_update(handle);
+    if (handle->pick_bvh != 0)
+        scene_pick_update(handle);
+
+    for (int32_t i = 0; i < journal->nodes_count; ++i)
+        journal->node_listed[journal->nodes[i]] = false;
+    for (int32_t i = 0; i < journal->materials_count; ++i)
+        journal->material_listed[journal->materials[i]] = false;
+    journal->flags = 0;
+    journal->nodes_count = 0;
+    journal->materials_count = 0;
+    journal->bounds_valid = false;
+    journal->bounds_cursor = 0;
+    journal->pick_cursor = 0;
+}
+
+/* ---- Spatial queries ---- */
+
+bool scene_raycast(scene_handle handle, float const origin[3], float const direction[3], float max_distance,
+                   scene_ray_hit* hit) {
+    os_memset(hit, 0, sizeof(scene_ray_hit));
+    scene_pick_update(handle);
+
+    float distance = max_distance;
+    int32_t item = bvh_raycast(handle->pick_bvh, origin, direction, max_distance, scene_pick_ray_test, handle, &distance);
+    if (item == -1) return false;
+
+    scene_internal_pick_item const* pick = handle->pick_items + item;
+    scene_node_get_at(handle, pick->node_id, &hit->node);
+    hit->primitive_index = pick->primitive_index;
+    hit->distance = distance;
+    for (int32_t c = 0; c < 3; ++c)
+        hit->position[c] = origin[c] + direction[c] * distance;
+    return true;
+}
+
+int32_t scene_query_aabb(scene_handle handle, float const min[3], float const max[3], scene_node* out_nodes, int32_t capacity) {
+    scene_pick_update(handle);
+    int32_t items_count = bvh_query_aabb(handle->pick_bvh, min, max, handle->pick_results, handle->pick_items_count);
+
+    if (++handle->node_mark == 0) {
+        os_memset(handle->node_marks, 0, sizeof(uint32_t) * (handle->nodes_count + 1));
+        handle->node_mark = 1;
+    }
+    int32_t count = 0;
+    for (int32_t i = 0; i < items_count; ++i) {
+        int32_t id = handle->pick_items[handle->pick_results[i]].node_id;
+        if (handle->node_marks[id] == handle->node_mark) continue;
+        handle->node_marks[id] = handle->node_mark;
+        if (count < capacity)
+            scene_node_get_at(handle, id, out_nodes + count);
+        count++;
+    }
+    return count;
 }
@@ -23,6 +23,37 @@ typedef struct scene_skybox {
 typedef struct scene_desc{
     scene_skybox skybox;
     void* model;
+
+    /*
+     * Static baking. Every mesh node outside the dynamic subtrees is moved to world space once and
+     * merged per material into a few batches, only dynamic nodes are drawn per node. Meshes drawn by
+     * several nodes stay instanced. Names are matched like the mdl_load_options filters, a trailing
+     * '*' matches by prefix. Transforms set on baked nodes or their ancestors are ignored.
+     */
+    bool bake_static;
+    const char* const* dynamic_nodes;
+    int32_t dynamic_nodes_count;
+
+    /*
+     * Keeps a cpu copy of triangle positions and indices, so rays hit the triangles of a mesh
+     * instead of its box.
+     */
+    bool pick_triangles;
+
+    /*
+     * Frees the vertices and indices of every model primitive as soon as it is on the gpu, so the
+     * model and the gpu copy of a primitive are not both held for the whole load. The model must
+     * still be unloaded afterwards, it only loses its geometry.
+     */
+    bool consume_geometry;
+
+    /*
+     * Chunk cache written by ibc-bake --chunks for the same baked model. The geometry it holds stays
+     * on disk, the chunks near the views are paged in and out within the chunk budget. Streamed
+     * primitives are neither baked static nor picked by their triangles. A missing cache or one
+     * that does not match the model is left out.
+     */
+    const char* chunks_path;
 } scene_desc;
 
 typedef struct scene_node {
@@ -43,6 +74,70 @@ typedef struct scene_mesh{
     int32_t vertex_buffer_id;
 } scene_mesh;
 
+typedef struct scene_texture{
+    bool resident;
+    int32_t width;
+    int32_t height;
+    int32_t levels;
+    int64_t bytes;
+} scene_texture;
+
+typedef struct scene_texture_streaming{
+    int64_t resident_bytes;
+    int64_t budget_bytes;
+    int64_t uploaded_bytes;
+    int32_t resident_levels;
+    int32_t total_levels;
+    int32_t evictions;
+} scene_texture_streaming;
+
+typedef struct scene_chunk_streaming{
+    int32_t chunks_count;
+    int32_t resident_count;
+    int32_t pending_count;
+    int64_t resident_bytes;
+    int64_t budget_bytes;
+    int64_t staging_bytes;
+    int32_t loads;
+    int32_t evictions;
+} scene_chunk_streaming;
+
+//instances of the last lit view and the last shadow pass, culled ones were outside the frustum
+typedef struct scene_draw_stats{
+    int32_t drawn;
+    int32_t culled;
+    int32_t draw_calls;
+    int32_t pipeline_binds;
+    int32_t shadow_drawn;
+    int32_t shadow_culled;
+    int32_t shadow_draw_calls;
+    int32_t shadow_pipeline_binds;
+} scene_draw_stats;
+
+typedef enum scene_change_flags{
+    SCENE_CHANGE_TRANSFORMS = 1 << 0,   //world transform of a listed node changed
+    SCENE_CHANGE_GEOMETRY = 1 << 1,     //a drawn instance moved or a chunk was paged, bounds hold the boxes
+    SCENE_CHANGE_MATERIALS = 1 << 2,
+    SCENE_CHANGE_SHADOWS = 1 << 3,      //the moved boxes reach into the shadow map
+} scene_change_flags;
+
+typedef struct scene_changes{
+    uint32_t flags;
+    int32_t const* nodes;
+    int32_t nodes_count;
+    int32_t const* materials;
+    int32_t materials_count;
+    float bounds_min[3];
+    float bounds_max[3];
+} scene_changes;
+
+typedef struct scene_ray_hit{
+    scene_node node;
+    int32_t primitive_index;
+    //along the ray, in units of its direction
+    float distance;
+    float position[3];
+} scene_ray_hit;
 
 typedef struct scene_internal_data* scene_handle;
 
@@ -71,11 +166,40 @@ IBC_API void scene_node_root_count(scene_handle handle, int32_t* count);
 IBC_API void scene_node_children_count(scene_handle handle, scene_node* node, int32_t* count);
 IBC_API void scene_camera_count(scene_handle handle, int32_t* count);
 IBC_API void scene_mesh_count(scene_handle handle, int32_t* count);
+IBC_API void scene_static_stats(scene_handle handle, int32_t* batches_count, int32_t* nodes_count);
+IBC_API void scene_texture_count(scene_handle handle, int32_t* count);
+IBC_API void scene_get_draw_stats(scene_handle handle, scene_draw_stats* stats);
+//model materials and the distinct entries of the material uniform block they map to
+IBC_API void scene_material_count(scene_handle handle, int32_t* count, int32_t* unique_count);
+IBC_API void scene_texture_get_at(scene_handle handle, int32_t index, scene_texture* texture);
+//gpu memory of the model textures, mip levels included
+IBC_API int64_t scene_texture_bytes(scene_handle handle);
+IBC_API void scene_texture_streaming_stats(scene_handle handle, scene_texture_streaming* streaming);
+IBC_API void scene_set_texture_budget(scene_handle handle, int64_t budget_bytes);
+/*
+ * Raises or drops texture mips from the sizes requested by the last draws and pages geometry chunks
+ * in and out around the last views, call once per frame, true when views need to be redrawn.
+ */
+IBC_API bool scene_update_streaming(scene_handle handle);
+//all zero for scenes without a chunk cache
+IBC_API void scene_chunk_streaming_stats(scene_handle handle, scene_chunk_streaming* streaming);
+IBC_API void scene_set_chunk_budget(scene_handle handle, int64_t budget_bytes, int64_t staging_bytes);
+IBC_API float scene_get_texture_anisotropy(scene_handle handle);
+IBC_API void scene_set_texture_anisotropy(scene_handle handle, float anisotropy);
 
 IBC_API bool scene_node_get(scene_handle handle, const char* name, struct scene_node* node);
+/*
+ * Nodes whose name starts with prefix, in name order. Fills at most capacity nodes and
+ * returns the number of matches, which may be larger.
+ */
+IBC_API int32_t scene_node_find_prefix(scene_handle handle, const char* prefix, struct scene_node* nodes, int32_t capacity);
 IBC_API void scene_node_get_at(scene_handle handle, int32_t index, struct scene_node *node);
 IBC_API void scene_node_root_get_at(scene_handle handle, int32_t index, struct scene_node* node);
 IBC_API void scene_node_children_get_at(scene_handle handle, int32_t index, struct scene_node* parent_node, scene_node* node);
+/*
+ * False for root nodes, the parent is left untouched then.
+ */
+IBC_API bool scene_node_get_parent(scene_handle handle, scene_node* node, scene_node* parent);
 
 IBC_API void scene_camera_get_at(scene_handle handle, int32_t index, struct scene_node* node, struct scene_camera* camera_data);
 IBC_API void scene_camera_set(scene_handle handle, scene_node* node, scene_camera* camera_data);
@@ -96,4 +220,26 @@ IBC_API void    scene_node_get_material(scene_handle handle, scene_node* node, i
 IBC_API void    scene_node_set_material(scene_handle handle, scene_node* node, int32_t mat_idx,
                                         float color[4], float metallic, float roughness);
 
+/*
+ * Change journal.
+ *
+ * Transform and material edits are recorded until the journal is cleared, so consumers only redo
+ * the work the changes touch. Edits between begin and end form one transaction, the hierarchy and
+ * the material tables are updated once when the outermost transaction ends.
+ */
+IBC_API void scene_begin_changes(scene_handle handle);
+IBC_API void scene_end_changes(scene_handle handle);
+/* Pointers stay valid until the journal is cleared. */
+IBC_API void scene_get_changes(scene_handle handle, scene_changes* changes);
+IBC_API void scene_clear_changes(scene_handle handle);
+
+/*
+ * Spatial queries over the world boxes of the node primitives, the hierarchy is built by the first
+ * query and follows moved nodes through the change journal. Baked nodes stay pickable.
+ */
+IBC_API bool scene_raycast(scene_handle handle, float const origin[3], float const direction[3], float max_distance,
+                           scene_ray_hit* hit);
+/* Fills at most capacity nodes and returns the number of nodes overlapping the box. */
+IBC_API int32_t scene_query_aabb(scene_handle handle, float const min[3], float const max[3], scene_node* nodes, int32_t capacity);
+
 #endif //IBCWEB_SCENE_H
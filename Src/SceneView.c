@@ -370,6 +370,28 @@ void scene_view_get_size(scene_view_handle handle, int32_t* width, int32_t* heig
     *height = handle->height;
 }
 
+static gl_vec3 scene_view_unproject(gl_mat const* inverse, float x, float y, float z) {
+    float ndc[4] = {x, y, z, 1.0f};
+    float result[4];
+    for (int32_t r = 0; r < 4; ++r)
+        result[r] = gl_vec_dot(gl_mat_row_get(inverse, r).data, ndc, 4);
+    return gl_vec3_new(result[0] / result[3], result[1] / result[3], result[2] / result[3]);
+}
+
+void scene_view_get_ray(scene_view_handle handle, float x, float y, float origin[3], float direction[3]) {
+    gl_mat tr = gl_mat_set_translation(handle->controller.rotation, handle->controller.position);
+    gl_mat view_projection = gl_mat_mul(handle->controller.projection, gl_mat_inverse(tr));
+    gl_mat inverse = gl_mat_inverse(view_projection);
+
+    float ndc_x = 2.0f * x / (float)handle->width - 1.0f;
+    float ndc_y = 1.0f - 2.0f * y / (float)handle->height;
+    gl_vec3 near_point = scene_view_unproject(&inverse, ndc_x, ndc_y, -1.0f);
+    gl_vec3 far_point = scene_view_unproject(&inverse, ndc_x, ndc_y, 1.0f);
+    gl_vec3 forward = gl_vec3_normalize(gl_vec3_sub(far_point, near_point));
+    os_memcpy(origin, near_point.data, sizeof(float) * 3);
+    os_memcpy(direction, forward.data, sizeof(float) * 3);
+}
+
 scene_view_type scene_view_get_type(scene_view_handle handle) {
     return handle->view_type;
 }
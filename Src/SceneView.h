@@ -53,6 +53,8 @@ IBC_API void scene_view_set_wireframe(scene_view_handle handle, bool enabled);
 IBC_API void scene_view_destroy(scene_view_handle handle);
 IBC_API void scene_view_flag_dirty(scene_view_handle handle);
 IBC_API void scene_view_get_size(scene_view_handle handle, int32_t* width, int32_t* height);
+/* World ray through a pixel of the view, x and y from the top left corner. */
+IBC_API void scene_view_get_ray(scene_view_handle handle, float x, float y, float origin[3], float direction[3]);
 IBC_API char const* scene_view_get_name(scene_view_handle handle);
 
 #endif //IBCWEB_SCENEVIEW_H
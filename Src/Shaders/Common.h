@@ -20,4 +20,38 @@
 #define VIEW_POSITION_NAME "view_position"
 #define SHADER_VERSION #version 330\n
 
+//world matrix texture of Lit.vs and Shadow.vs, a matrix is 4 rgba32f texels holding its rows
+#define TRANSFORMS_NAME "transforms"
+#define TRANSFORMS_PER_ROW 256
+
+//transform indices of the instances drawn in a pass, 4 per rgba32f texel, a draw reads instance_offset + gl_InstanceID
+#define INSTANCES_NAME "instances"
+#define INSTANCE_OFFSET_NAME "instance_offset"
+#define INSTANCES_PER_ROW 4096
+
+/*
+ * Uniform blocks of Lit.vs/Lit.fs, the structs mirror their std140 layout.
+ * Matrices are stored row major like gl_mat.
+ */
+#define FRAME_BLOCK_NAME "frame_block"
+#define FRAME_BLOCK_BINDING 0
+#define MATERIAL_BLOCK_NAME "material_block"
+#define MATERIAL_BLOCK_BINDING 1
+//materials visible to one draw, larger tables bind the block range that holds the material
+#define MATERIAL_BLOCK_SIZE 256
+
+typedef struct lit_frame_block{
+    float projection[16];
+    float view[16];
+    float light_space[16];
+    float view_position[3];
+    float exposure;
+} lit_frame_block;
+
+typedef struct lit_material_block{
+    float color[MATERIAL_BLOCK_SIZE][4];
+    //roughness, metallic, has color texture, unused
+    float params[MATERIAL_BLOCK_SIZE][4];
+} lit_material_block;
+
 #endif //IBCWEB_COMMON_H
@@ -22,7 +22,9 @@ void shadow_renderer_init(shadow_renderer* sr)
     OS_FREE(vs);
     OS_FREE(fs);
 
-    gfx_shader_uniform_enable(sr->shader, MODEL_TRANSFORM_NAME, GFX_TYPE_FLOAT_MAT_4, &sr->model_uniform);
+    gfx_shader_uniform_enable(sr->shader, TRANSFORMS_NAME,      GFX_TYPE_SAMPLER_2D,    &sr->transforms_uniform);
+    gfx_shader_uniform_enable(sr->shader, INSTANCES_NAME,       GFX_TYPE_SAMPLER_2D,    &sr->instances_uniform);
+    gfx_shader_uniform_enable(sr->shader, INSTANCE_OFFSET_NAME, GFX_TYPE_INTEGER_VEC_1, &sr->instance_offset_uniform);
     gfx_shader_uniform_enable(sr->shader, "light_space",        GFX_TYPE_FLOAT_MAT_4, &sr->ls_uniform);
 
     /* Depth texture + depth-only FBO */
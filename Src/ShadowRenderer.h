@@ -18,7 +18,9 @@ typedef struct {
     gfx_texture_handle     depth_tex;
     gfx_framebuffer_handle fbo;
     gl_mat                 light_space;
-    int32_t                model_uniform;
+    int32_t                transforms_uniform;
+    int32_t                instances_uniform;
+    int32_t                instance_offset_uniform;
     int32_t                ls_uniform;
 } shadow_renderer;
 
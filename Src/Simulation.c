@@ -0,0 +1,151 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "Simulation.h"
+
+#include <stddef.h>
+
+#include "Allocator.h"
+#include "Thread.h"
+
+//the middle slot index carries this bit while the renderer has not taken it yet
+#define SIMULATION_SLOT_FRESH 4
+#define SIMULATION_SLOT_MASK 3
+
+typedef struct simulation_snapshot{
+    double time;
+    float* local_trs;
+} simulation_snapshot;
+
+typedef struct simulation{
+    simulation_step_func step;
+    void* user_data;
+    int32_t floats_count;
+    double step_seconds;
+
+    //the simulation owns the back slot, the renderer the front one, the middle one is swapped by both
+    simulation_snapshot slots[3];
+    int32_t back;
+    int32_t front;
+    volatile int32_t middle;
+
+    //renderer side, the snapshot before the front one and the transforms returned last
+    float* previous;
+    float* output;
+
+    os_mutex_handle mutex;
+    os_thread_handle thread;
+    volatile int32_t running;
+} simulation;
+
+static int32_t simulation_exchange(volatile int32_t* value, int32_t new_value)
+{
+    int32_t old;
+    do {
+        old = os_atomic_load(value);
+    } while (!os_atomic_cas(value, old, new_value));
+    return old;
+}
+
+static void simulation_run(void* user_data)
+{
+    simulation* handle = user_data;
+    double next = os_timer_seconds();
+    while (os_atomic_load(&handle->running)) {
+        double now = os_timer_seconds();
+        if (now < next) {
+            os_sleep_seconds(next - now);
+            continue;
+        }
+
+        simulation_snapshot* snapshot = handle->slots + handle->back;
+        os_mutex_lock(handle->mutex);
+        handle->step(handle->user_data, (float)handle->step_seconds, snapshot->local_trs);
+        os_mutex_unlock(handle->mutex);
+        snapshot->time = os_timer_seconds();
+        handle->back = simulation_exchange(&handle->middle, handle->back | SIMULATION_SLOT_FRESH) & SIMULATION_SLOT_MASK;
+
+        next += handle->step_seconds;
+        if (now - next > handle->step_seconds * SIMULATION_MAXIMUM_CATCHUP_STEPS)
+            next = now;
+    }
+}
+
+simulation_handle simulation_create(int32_t nodes_count, float rate, simulation_step_func step, void* user_data,
+                                    float const* initial_trs)
+{
+    simulation_handle handle = OS_MALLOC(sizeof(simulation));
+    os_memset(handle, 0, sizeof(simulation));
+    handle->step = step;
+    handle->user_data = user_data;
+    handle->floats_count = nodes_count * 16;
+    handle->step_seconds = 1.0 / (rate > 0.0f ? rate : SIMULATION_DEFAULT_RATE);
+
+    int32_t bytes = (int32_t)sizeof(float) * handle->floats_count;
+    double now = os_timer_seconds();
+    for (int32_t i = 0; i < 3; ++i) {
+        handle->slots[i].time = now;
+        handle->slots[i].local_trs = OS_MALLOC(bytes + 1);
+        os_memcpy(handle->slots[i].local_trs, initial_trs, bytes);
+    }
+    handle->previous = OS_MALLOC(bytes + 1);
+    handle->output = OS_MALLOC(bytes + 1);
+    os_memcpy(handle->previous, initial_trs, bytes);
+    os_memcpy(handle->output, initial_trs, bytes);
+    handle->back = 0;
+    handle->middle = 1;
+    handle->front = 2;
+
+    handle->mutex = os_mutex_create();
+    handle->running = 1;
+    handle->thread = os_thread_create(simulation_run, handle);
+    return handle;
+}
+
+void simulation_destroy(simulation_handle handle)
+{
+    os_atomic_store(&handle->running, 0);
+    os_thread_join(handle->thread);
+    os_mutex_destroy(handle->mutex);
+    for (int32_t i = 0; i < 3; ++i)
+        OS_FREE(handle->slots[i].local_trs);
+    OS_FREE(handle->previous);
+    OS_FREE(handle->output);
+    OS_FREE(handle);
+}
+
+bool simulation_read(simulation_handle handle, float* local_trs)
+{
+    if (os_atomic_load(&handle->middle) & SIMULATION_SLOT_FRESH) {
+        os_memcpy(handle->previous, handle->slots[handle->front].local_trs, (int32_t)sizeof(float) * handle->floats_count);
+        handle->front = simulation_exchange(&handle->middle, handle->front) & SIMULATION_SLOT_MASK;
+    }
+
+    simulation_snapshot const* newest = handle->slots + handle->front;
+    float alpha = (float)((os_timer_seconds() - newest->time) / handle->step_seconds);
+    alpha = alpha < 0.0f ? 0.0f : alpha > 1.0f ? 1.0f : alpha;
+
+    //a step moves the nodes a little, blending the matrix elements keeps them close enough to rigid
+    bool changed = false;
+    for (int32_t i = 0; i < handle->floats_count; ++i) {
+        float value = handle->previous[i] + (newest->local_trs[i] - handle->previous[i]) * alpha;
+        changed |= value != handle->output[i];
+        handle->output[i] = value;
+    }
+
+    os_memcpy(local_trs, handle->output, (int32_t)sizeof(float) * handle->floats_count);
+    return changed;
+}
+
+void simulation_lock(simulation_handle handle)
+{
+    os_mutex_lock(handle->mutex);
+}
+
+void simulation_unlock(simulation_handle handle)
+{
+    os_mutex_unlock(handle->mutex);
+}
@@ -0,0 +1,58 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_SIMULATION_H
+#define IBCWEB_SIMULATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+/*
+ * Fixed rate simulation on its own thread.
+ *
+ * Every step writes the local transforms of the simulated nodes into a snapshot. Snapshots pass
+ * through a lock free triple buffer: the simulation always has a free slot to write into and the
+ * renderer always takes the newest complete one, neither ever waits for the other. The renderer
+ * blends from the previous snapshot to the newest over one step, so motion stays smooth at any
+ * frame rate at the cost of one step of latency.
+ *
+ * The step runs with the simulation lock held, anything else touching the state the step reads
+ * has to take the lock too.
+ */
+
+#define SIMULATION_DEFAULT_RATE 120.0f
+//steps replayed at most after a stall, a longer gap is dropped instead of simulated in a burst
+#define SIMULATION_MAXIMUM_CATCHUP_STEPS 4
+
+typedef struct simulation* simulation_handle;
+
+/*
+ * Advances the user state by dt and writes all 16 floats of every node transform, the snapshot
+ * may hold the transforms of an older step.
+ */
+typedef void (*simulation_step_func)(void* user_data, float dt, float* local_trs);
+
+/*
+ * Initial transforms hold 16 floats per node, they fill every snapshot until the first step.
+ */
+IBC_API simulation_handle simulation_create(int32_t nodes_count, float rate, simulation_step_func step, void* user_data,
+                                            float const* initial_trs);
+IBC_API void simulation_destroy(simulation_handle handle);
+
+/*
+ * Blended transforms for now, false when they equal the ones returned last so nothing has to be applied.
+ */
+IBC_API bool simulation_read(simulation_handle handle, float* local_trs);
+
+IBC_API void simulation_lock(simulation_handle handle);
+IBC_API void simulation_unlock(simulation_handle handle);
+
+#endif //IBCWEB_SIMULATION_H
@@ -0,0 +1,245 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "Stl.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "Allocator.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define STL_SSE 1
+#endif
+
+#define STL_HEADER_SIZE 84
+#define STL_TRIANGLE_SIZE 50
+#define STL_TRIANGLE_FLOATS 12
+#define STL_VERTEX_FLOATS 6
+#define STL_EMPTY_SLOT 0xffffffffu
+#define STL_NORMAL_QUANTIZATION 1023.0f
+
+static void stl_copy_triangles(uint8_t const* src, uint32_t count, float const scale[3], float* dst)
+{
+    /*
+     * Each 50 byte record is normal, 3 vertices and a 2 byte attribute, so records are never 4 byte aligned.
+     * The first 48 bytes are moved with three unaligned loads and scaled on the way:
+     * n0 n1 n2 v0x | v0y v0z v1x v1y | v1z v2x v2y v2z
+     */
+#ifdef STL_SSE
+    __m128 scale_a = _mm_setr_ps(1.0f, 1.0f, 1.0f, scale[0]);
+    __m128 scale_b = _mm_setr_ps(scale[1], scale[2], scale[0], scale[1]);
+    __m128 scale_c = _mm_setr_ps(scale[2], scale[0], scale[1], scale[2]);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        float const* record = (float const*)(src + (size_t)i * STL_TRIANGLE_SIZE);
+        float* out = dst + (size_t)i * STL_TRIANGLE_FLOATS;
+        _mm_storeu_ps(out + 0, _mm_mul_ps(_mm_loadu_ps(record + 0), scale_a));
+        _mm_storeu_ps(out + 4, _mm_mul_ps(_mm_loadu_ps(record + 4), scale_b));
+        _mm_storeu_ps(out + 8, _mm_mul_ps(_mm_loadu_ps(record + 8), scale_c));
+    }
+#else
+    for (uint32_t i = 0; i < count; ++i) {
+        float* out = dst + (size_t)i * STL_TRIANGLE_FLOATS;
+        memcpy(out, src + (size_t)i * STL_TRIANGLE_SIZE, sizeof(float) * STL_TRIANGLE_FLOATS);
+        for (int32_t k = 3; k < STL_TRIANGLE_FLOATS; ++k)
+            out[k] *= scale[k % 3];
+    }
+#endif
+}
+
+static uint32_t stl_hash(float const* position, int16_t const* normal)
+{
+    uint32_t bits[3];
+    memcpy(bits, position, sizeof(bits));
+    uint32_t h = bits[0] * 0x9e3779b1u;
+    h = (h ^ (h >> 15)) + bits[1] * 0x85ebca77u;
+    h = (h ^ (h >> 13)) + bits[2] * 0xc2b2ae3du;
+    h = (h ^ (h >> 16)) + (uint32_t)(uint16_t)normal[0] * 0x27d4eb2fu;
+    h = (h ^ (h >> 15)) + (uint32_t)(uint16_t)normal[1] * 0x165667b1u;
+    h = (h ^ (h >> 13)) + (uint32_t)(uint16_t)normal[2];
+    return h ^ (h >> 16);
+}
+
+bool stl_load_primitive(const char* path, float const scale[3], mdl_primitive* primitive)
+{
+    os_memset(primitive, 0, sizeof(mdl_primitive));
+
+    uint64_t size = 0;
+    uint8_t const* file = os_file_map(path, &size);
+    if (file == 0) {
+        fprintf(stderr, "- Stl file could not be opened: %s\n", path);
+        return false;
+    }
+
+    uint32_t triangles_count = 0;
+    if (size >= STL_HEADER_SIZE)
+        memcpy(&triangles_count, file + 80, sizeof(uint32_t));
+
+    if (size < STL_HEADER_SIZE || (uint64_t)triangles_count * STL_TRIANGLE_SIZE + STL_HEADER_SIZE > size) {
+        if (size >= 5 && memcmp(file, "solid", 5) == 0)
+            fprintf(stderr, "- Ascii stl is not supported, re-export as binary: %s\n", path);
+        else
+            fprintf(stderr, "- Stl file is truncated: %s\n", path);
+        os_file_unmap((void*)file, size);
+        return false;
+    }
+
+    float* triangles = OS_MALLOC(sizeof(float) * STL_TRIANGLE_FLOATS * triangles_count + 1);
+    stl_copy_triangles(file + STL_HEADER_SIZE, triangles_count, scale, triangles);
+    os_file_unmap((void*)file, size);
+
+    //mirroring scales flip the winding
+    bool flip = scale[0] * scale[1] * scale[2] < 0.0f;
+
+    /*
+     * Welding.
+     * Open addressing table over the output vertices, keyed by exact position bits and the quantized facet normal.
+     */
+    uint32_t max_vertices = triangles_count * 3;
+    uint32_t capacity = 64;
+    while (capacity < max_vertices * 2) capacity <<= 1;
+
+    uint32_t* table = OS_MALLOC(sizeof(uint32_t) * capacity);
+    os_memset(table, 0xff, sizeof(uint32_t) * capacity);
+    int16_t* keys = OS_MALLOC(sizeof(int16_t) * 3 * max_vertices + 1);
+    float* vertices = OS_MALLOC(sizeof(float) * STL_VERTEX_FLOATS * max_vertices + 1);
+    uint32_t* indices = OS_MALLOC(sizeof(uint32_t) * max_vertices + 1);
+    uint32_t vertices_count = 0;
+    uint32_t indices_count = 0;
+
+    for (uint32_t i = 0; i < triangles_count; ++i) {
+        float* tri = triangles + (size_t)i * STL_TRIANGLE_FLOATS;
+        float* p[3] = { tri + 3, flip ? tri + 9 : tri + 6, flip ? tri + 6 : tri + 9 };
+
+        float e0[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+        float e1[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+        float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+        float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len <= 0.0f || !isfinite(len)) continue; //degenerate, nothing to draw
+        n[0] /= len; n[1] /= len; n[2] /= len;
+
+        int16_t key[3] = {
+                (int16_t)lrintf(n[0] * STL_NORMAL_QUANTIZATION),
+                (int16_t)lrintf(n[1] * STL_NORMAL_QUANTIZATION),
+                (int16_t)lrintf(n[2] * STL_NORMAL_QUANTIZATION)
+        };
+
+        for (int32_t k = 0; k < 3; ++k) {
+            uint32_t slot = stl_hash(p[k], key) & (capacity - 1);
+            for (;;) {
+                uint32_t index = table[slot];
+                if (index == STL_EMPTY_SLOT) {
+                    index = vertices_count++;
+                    table[slot] = index;
+                    float* v = vertices + (size_t)index * STL_VERTEX_FLOATS;
+                    v[0] = p[k][0]; v[1] = p[k][1]; v[2] = p[k][2];
+                    v[3] = n[0]; v[4] = n[1]; v[5] = n[2];
+                    os_memcpy(keys + (size_t)index * 3, key, sizeof(key));
+                    indices[indices_count++] = index;
+                    break;
+                }
+                if (memcmp(vertices + (size_t)index * STL_VERTEX_FLOATS, p[k], sizeof(float) * 3) == 0 &&
+                    memcmp(keys + (size_t)index * 3, key, sizeof(key)) == 0) {
+                    indices[indices_count++] = index;
+                    break;
+                }
+                slot = (slot + 1) & (capacity - 1);
+            }
+        }
+    }
+
+    OS_FREE(table);
+    OS_FREE(keys);
+    OS_FREE(triangles);
+
+    if (indices_count == 0) {
+        fprintf(stderr, "- Stl file has no triangles: %s\n", path);
+        OS_FREE(vertices);
+        OS_FREE(indices);
+        return false;
+    }
+
+    primitive->primitive_type = MDL_PRIMITIVE_TYPE_TRIANGLES;
+    primitive->vertex_stride = sizeof(float) * STL_VERTEX_FLOATS;
+    primitive->vertices_count = (int32_t)vertices_count;
+    primitive->vertices = OS_REALLOC(vertices, sizeof(float) * STL_VERTEX_FLOATS * vertices_count);
+    primitive->indices_count = (int32_t)indices_count;
+    primitive->indices = OS_REALLOC(indices, sizeof(uint32_t) * indices_count);
+    primitive->material_id = -1;
+
+    primitive->attributes_count = 2;
+    primitive->attributes = OS_MALLOC(sizeof(mdl_attribute) * 2);
+    os_memset(primitive->attributes, 0, sizeof(mdl_attribute) * 2);
+    primitive->attributes[0].type = MDL_VERTEX_ATTRIBUTE_POSITION;
+    primitive->attributes[0].offset = 0;
+    primitive->attributes[0].count = 3;
+    primitive->attributes[0].element_size = 4;
+    primitive->attributes[1].type = MDL_VERTEX_ATTRIBUTE_NORMAL;
+    primitive->attributes[1].offset = sizeof(float) * 3;
+    primitive->attributes[1].count = 3;
+    primitive->attributes[1].element_size = 4;
+    primitive->attributes_flag = MDL_VERTEX_ATTRIBUTE_POSITION | MDL_VERTEX_ATTRIBUTE_NORMAL;
+
+    printf("- Loaded stl %s: %u triangles, %u welded vertices\n", path, triangles_count, vertices_count);
+    return true;
+}
+
+mdl_handle stl_load(const char* path)
+{
+    printf("Loading model %s\n", path != 0 ? path : "<null>");
+
+    float scale[3] = {1, 1, 1};
+    mdl_primitive primitive;
+    if (path == 0 || !stl_load_primitive(path, scale, &primitive))
+        return 0;
+
+    mdl_handle handle = OS_MALLOC(sizeof(mdl_data));
+    os_memset(handle, 0, sizeof(mdl_data));
+
+    const char* last_sep = strrchr(path, '/');
+    const char* last_bsep = strrchr(path, '\\');
+    const char* name = last_sep > last_bsep ? last_sep : last_bsep;
+    name = name != 0 ? name + 1 : path;
+
+    handle->meshes_count = 1;
+    handle->meshes = OS_MALLOC(sizeof(mdl_mesh));
+    handle->meshes->name = OS_MALLOC(strlen(name) + 1);
+    os_memcpy(handle->meshes->name, name, strlen(name) + 1);
+    handle->meshes->primitives_count = 1;
+    handle->meshes->primitives = OS_MALLOC(sizeof(mdl_primitive));
+    primitive.material_id = 0;
+    handle->meshes->primitives[0] = primitive;
+
+    handle->materials_count = 1;
+    handle->materials = OS_MALLOC(sizeof(mdl_material));
+    os_memset(handle->materials, 0, sizeof(mdl_material));
+    handle->materials->valid = true;
+    handle->materials->color_texture_id = -1;
+    handle->materials->color_factor[0] = 0.8f;
+    handle->materials->color_factor[1] = 0.8f;
+    handle->materials->color_factor[2] = 0.8f;
+    handle->materials->color_factor[3] = 1.0f;
+    handle->materials->roughness_factor = 0.6f;
+    handle->materials->metallic_factor = 0.0f;
+
+    handle->nodes_count = 1;
+    handle->nodes = OS_MALLOC(sizeof(mdl_node));
+    os_memset(handle->nodes, 0, sizeof(mdl_node));
+    mdl_node* node = handle->nodes;
+    node->node_type = MDL_NODE_MESH;
+    node->name = OS_MALLOC(strlen(name) + 1);
+    os_memcpy(node->name, name, strlen(name) + 1);
+    node->local_rot[3] = 1;
+    node->local_scale[0] = node->local_scale[1] = node->local_scale[2] = 1;
+    node->mesh_index = 0;
+    node->camera_index = node->light_index = -1;
+    node->parent_id = -1;
+
+    return handle;
+}
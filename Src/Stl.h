@@ -0,0 +1,33 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_STL_H
+#define IBCWEB_STL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Model.h"
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+/*
+ * Binary stl loading. The file is mapped, positions are scaled while copying,
+ * facet normals are rebuilt from the scaled triangles and vertices sharing both
+ * position and facet normal are welded. The primitive has position and normal attributes.
+ * Safe to call from worker threads.
+ */
+IBC_API bool stl_load_primitive(const char* path, float const scale[3], mdl_primitive* primitive);
+
+/*
+ * Single node model around one stl mesh, with a default material.
+ */
+IBC_API mdl_handle stl_load(const char* path);
+
+#endif //IBCWEB_STL_H
@@ -0,0 +1,706 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "TextureCompress.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "Allocator.h"
+#include "Thread.h"
+
+#define TEXTURE_POWER_ITERATIONS 8
+#define TEXTURE_LINEAR_TO_SRGB_SIZE 4096
+
+typedef struct texture_compress_job{
+    uint8_t const* rgba;
+    int32_t width;
+    int32_t height;
+    int32_t blocks_x;
+    uint32_t block_bytes;
+    mdl_texture_format format;
+    uint8_t* out;
+} texture_compress_job;
+
+typedef struct texture_mip_job{
+    uint8_t const* source;
+    int32_t source_width;
+    int32_t source_height;
+    uint8_t* target;
+    int32_t width;
+    float const* srgb_to_linear;
+    uint8_t const* linear_to_srgb;
+    bool srgb;
+} texture_mip_job;
+
+static const int32_t texture_bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static const int32_t texture_bc7_weights2[4] = { 0, 21, 43, 64 };
+static const int32_t texture_bc7_weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+
+static float texture_clamp(float value, float low, float high)
+{
+    return value < low ? low : value > high ? high : value;
+}
+
+static void texture_block_fetch(uint8_t const* rgba, int32_t width, int32_t height, int32_t bx, int32_t by, uint8_t block[16][4])
+{
+    for (int32_t y = 0; y < 4; ++y) {
+        int32_t sy = by * 4 + y < height ? by * 4 + y : height - 1;
+        for (int32_t x = 0; x < 4; ++x) {
+            int32_t sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+            memcpy(block[y * 4 + x], rgba + ((size_t)sy * width + sx) * 4, 4);
+        }
+    }
+}
+
+static void texture_principal_axis(uint8_t const block[16][4], int32_t channels, float mean[4], float axis[4])
+{
+    for (int32_t c = 0; c < 4; ++c) mean[c] = 0.0f;
+    for (int32_t i = 0; i < 16; ++i)
+        for (int32_t c = 0; c < channels; ++c)
+            mean[c] += block[i][c];
+    for (int32_t c = 0; c < channels; ++c) mean[c] /= 16.0f;
+
+    float covariance[4][4] = {{0}};
+    for (int32_t i = 0; i < 16; ++i) {
+        float d[4] = {0};
+        for (int32_t c = 0; c < channels; ++c) d[c] = block[i][c] - mean[c];
+        for (int32_t a = 0; a < channels; ++a)
+            for (int32_t b = 0; b < channels; ++b)
+                covariance[a][b] += d[a] * d[b];
+    }
+
+    //power iteration, flat blocks keep the diagonal
+    for (int32_t c = 0; c < 4; ++c) axis[c] = c < channels ? 1.0f : 0.0f;
+    for (int32_t it = 0; it < TEXTURE_POWER_ITERATIONS; ++it) {
+        float next[4] = {0};
+        for (int32_t a = 0; a < channels; ++a)
+            for (int32_t b = 0; b < channels; ++b)
+                next[a] += covariance[a][b] * axis[b];
+        float length = 0.0f;
+        for (int32_t c = 0; c < channels; ++c) length += next[c] * next[c];
+        if (length < 1e-8f) break;
+        length = 1.0f / sqrtf(length);
+        for (int32_t c = 0; c < channels; ++c) axis[c] = next[c] * length;
+    }
+}
+
+static void texture_axis_extents(uint8_t const block[16][4], int32_t channels, float lo[4], float hi[4])
+{
+    float mean[4], axis[4];
+    texture_principal_axis(block, channels, mean, axis);
+
+    float t_min = INFINITY, t_max = -INFINITY;
+    for (int32_t i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (int32_t c = 0; c < channels; ++c) t += (block[i][c] - mean[c]) * axis[c];
+        if (t < t_min) t_min = t;
+        if (t > t_max) t_max = t;
+    }
+    for (int32_t c = 0; c < 4; ++c) {
+        lo[c] = texture_clamp(mean[c] + axis[c] * t_min, 0.0f, 255.0f);
+        hi[c] = texture_clamp(mean[c] + axis[c] * t_max, 0.0f, 255.0f);
+    }
+}
+
+static uint16_t texture_pack_565(float const color[3])
+{
+    uint32_t r = (uint32_t)lrintf(texture_clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f);
+    uint32_t g = (uint32_t)lrintf(texture_clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f);
+    uint32_t b = (uint32_t)lrintf(texture_clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void texture_unpack_565(uint16_t value, int32_t color[3])
+{
+    int32_t r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+static void texture_encode_bc1(uint8_t const block[16][4], uint8_t* out)
+{
+    float lo[4], hi[4];
+    texture_axis_extents(block, 3, lo, hi);
+
+    //inset the endpoints a little, the extremes are usually outliers
+    for (int32_t c = 0; c < 3; ++c) {
+        float inset = (hi[c] - lo[c]) / 16.0f;
+        hi[c] -= inset;
+        lo[c] += inset;
+    }
+
+    uint16_t c0 = texture_pack_565(hi);
+    uint16_t c1 = texture_pack_565(lo);
+    if (c0 < c1) {
+        uint16_t t = c0; c0 = c1; c1 = t;
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int32_t palette[4][3];
+        texture_unpack_565(c0, palette[0]);
+        texture_unpack_565(c1, palette[1]);
+        for (int32_t c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int32_t i = 0; i < 16; ++i) {
+            int32_t best = 0, best_error = INT32_MAX;
+            for (int32_t k = 0; k < 4; ++k) {
+                int32_t dr = block[i][0] - palette[k][0], dg = block[i][1] - palette[k][1], db = block[i][2] - palette[k][2];
+                int32_t error = dr * dr + dg * dg + db * db;
+                if (error < best_error) {
+                    best_error = error;
+                    best = k;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+
+    out[0] = (uint8_t)(c0 & 0xff);
+    out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)(c1 & 0xff);
+    out[3] = (uint8_t)(c1 >> 8);
+    for (int32_t k = 0; k < 4; ++k) out[4 + k] = (uint8_t)(indices >> (k * 8));
+}
+
+static void texture_encode_bc4(uint8_t const values[16], uint8_t* out)
+{
+    uint8_t lo = 255, hi = 0;
+    for (int32_t i = 0; i < 16; ++i) {
+        if (values[i] < lo) lo = values[i];
+        if (values[i] > hi) hi = values[i];
+    }
+
+    //eight value mode, endpoint 0 is the larger one
+    uint64_t bits = 0;
+    if (hi > lo) {
+        for (int32_t i = 0; i < 16; ++i) {
+            int32_t k = (int32_t)lrintf((float)(hi - values[i]) * 7.0f / (float)(hi - lo));
+            uint64_t code = k == 0 ? 0 : k == 7 ? 1 : (uint64_t)(k + 1);
+            bits |= code << (i * 3);
+        }
+    }
+
+    out[0] = hi;
+    out[1] = lo;
+    for (int32_t k = 0; k < 6; ++k) out[2 + k] = (uint8_t)(bits >> (k * 8));
+}
+
+static void texture_write_bits(uint8_t* out, int32_t* position, uint32_t value, int32_t count)
+{
+    for (int32_t i = 0; i < count; ++i) {
+        if ((value >> i) & 1u)
+            out[(*position + i) >> 3] |= (uint8_t)(1u << ((*position + i) & 7));
+    }
+    *position += count;
+}
+
+static void texture_encode_bc7(uint8_t const block[16][4], uint8_t* out)
+{
+    /*
+     * Mode 6: one subset, rgba endpoints of 7 bits plus a shared lsb per endpoint, 4 bit indices.
+     * All four p bit combinations are tried, indices come from projecting on the quantized segment.
+     */
+    float lo[4], hi[4];
+    texture_axis_extents(block, 4, lo, hi);
+
+    int32_t best_q[2][4] = {{0}}, best_p[2] = {0}, best_indices[16] = {0};
+    int64_t best_error = INT64_MAX;
+
+    for (int32_t pbits = 0; pbits < 4; ++pbits) {
+        int32_t p[2] = { pbits & 1, pbits >> 1 };
+        int32_t q[2][4], e[2][4];
+        for (int32_t c = 0; c < 4; ++c) {
+            q[0][c] = (int32_t)texture_clamp((float)lrintf((lo[c] - p[0]) * 0.5f), 0.0f, 127.0f);
+            q[1][c] = (int32_t)texture_clamp((float)lrintf((hi[c] - p[1]) * 0.5f), 0.0f, 127.0f);
+            e[0][c] = (q[0][c] << 1) | p[0];
+            e[1][c] = (q[1][c] << 1) | p[1];
+        }
+
+        int32_t palette[16][4];
+        for (int32_t k = 0; k < 16; ++k)
+            for (int32_t c = 0; c < 4; ++c)
+                palette[k][c] = ((64 - texture_bc7_weights[k]) * e[0][c] + texture_bc7_weights[k] * e[1][c] + 32) >> 6;
+
+        float direction[4], length = 0.0f;
+        for (int32_t c = 0; c < 4; ++c) {
+            direction[c] = (float)(e[1][c] - e[0][c]);
+            length += direction[c] * direction[c];
+        }
+
+        int64_t error = 0;
+        int32_t indices[16];
+        for (int32_t i = 0; i < 16; ++i) {
+            int32_t index = 0;
+            if (length > 0.0f) {
+                float t = 0.0f;
+                for (int32_t c = 0; c < 4; ++c) t += (block[i][c] - e[0][c]) * direction[c];
+                index = (int32_t)texture_clamp((float)lrintf(t / length * 15.0f), 0.0f, 15.0f);
+            }
+            indices[i] = index;
+            for (int32_t c = 0; c < 4; ++c) {
+                int32_t d = block[i][c] - palette[index][c];
+                error += d * d;
+            }
+        }
+
+        if (error < best_error) {
+            best_error = error;
+            memcpy(best_q, q, sizeof(best_q));
+            memcpy(best_p, p, sizeof(best_p));
+            memcpy(best_indices, indices, sizeof(best_indices));
+        }
+    }
+
+    //the anchor index has an implicit zero msb, swap the endpoints when it is set
+    if (best_indices[0] & 8) {
+        for (int32_t c = 0; c < 4; ++c) {
+            int32_t t = best_q[0][c]; best_q[0][c] = best_q[1][c]; best_q[1][c] = t;
+        }
+        int32_t t = best_p[0]; best_p[0] = best_p[1]; best_p[1] = t;
+        for (int32_t i = 0; i < 16; ++i) best_indices[i] = 15 - best_indices[i];
+    }
+
+    memset(out, 0, 16);
+    int32_t position = 0;
+    texture_write_bits(out, &position, 1u << 6, 7);
+    for (int32_t c = 0; c < 4; ++c) {
+        texture_write_bits(out, &position, (uint32_t)best_q[0][c], 7);
+        texture_write_bits(out, &position, (uint32_t)best_q[1][c], 7);
+    }
+    texture_write_bits(out, &position, (uint32_t)best_p[0], 1);
+    texture_write_bits(out, &position, (uint32_t)best_p[1], 1);
+    texture_write_bits(out, &position, (uint32_t)best_indices[0], 3);
+    for (int32_t i = 1; i < 16; ++i)
+        texture_write_bits(out, &position, (uint32_t)best_indices[i], 4);
+}
+
+static void texture_decode_bc1(uint8_t const* in, uint8_t block[16][4], bool four_color)
+{
+    uint16_t c0 = (uint16_t)(in[0] | in[1] << 8);
+    uint16_t c1 = (uint16_t)(in[2] | in[3] << 8);
+
+    int32_t palette[4][4];
+    texture_unpack_565(c0, palette[0]);
+    texture_unpack_565(c1, palette[1]);
+    palette[0][3] = palette[1][3] = 255;
+    palette[2][3] = palette[3][3] = 255;
+    for (int32_t c = 0; c < 3; ++c) {
+        if (four_color || c0 > c1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    if (!four_color && c0 <= c1) palette[3][3] = 0;
+
+    uint32_t indices = (uint32_t)in[4] | (uint32_t)in[5] << 8 | (uint32_t)in[6] << 16 | (uint32_t)in[7] << 24;
+    for (int32_t i = 0; i < 16; ++i) {
+        int32_t k = (int32_t)((indices >> (i * 2)) & 3u);
+        for (int32_t c = 0; c < 4; ++c) block[i][c] = (uint8_t)palette[k][c];
+    }
+}
+
+static void texture_decode_bc4(uint8_t const* in, uint8_t block[16][4], int32_t channel)
+{
+    int32_t e0 = in[0], e1 = in[1];
+    int32_t values[8] = { e0, e1 };
+    if (e0 > e1) {
+        for (int32_t k = 2; k < 8; ++k) values[k] = ((8 - k) * e0 + (k - 1) * e1) / 7;
+    } else {
+        for (int32_t k = 2; k < 6; ++k) values[k] = ((6 - k) * e0 + (k - 1) * e1) / 5;
+        values[6] = 0;
+        values[7] = 255;
+    }
+
+    uint64_t bits = 0;
+    for (int32_t k = 0; k < 6; ++k) bits |= (uint64_t)in[2 + k] << (k * 8);
+    for (int32_t i = 0; i < 16; ++i)
+        block[i][channel] = (uint8_t)values[(bits >> (i * 3)) & 7u];
+}
+
+static uint32_t texture_read_bits(uint8_t const* in, int32_t* position, int32_t count)
+{
+    uint32_t value = 0;
+    for (int32_t i = 0; i < count; ++i) {
+        int32_t bit = *position + i;
+        value |= (uint32_t)((in[bit >> 3] >> (bit & 7)) & 1u) << i;
+    }
+    *position += count;
+    return value;
+}
+
+static int32_t texture_bc7_expand(int32_t value, int32_t bits)
+{
+    value <<= 8 - bits;
+    return value | (value >> bits);
+}
+
+static void texture_bc7_indices(uint8_t const* in, int32_t* position, int32_t bits, int32_t indices[16])
+{
+    //the anchor texel drops its msb
+    for (int32_t i = 0; i < 16; ++i)
+        indices[i] = (int32_t)texture_read_bits(in, position, i == 0 ? bits - 1 : bits);
+}
+
+/*
+ * Single subset modes only (4, 5 and 6). The partitioned modes need the bptc partition tables,
+ * those blocks decode to transparent black like reserved modes do and false is returned.
+ */
+static bool texture_decode_bc7(uint8_t const* in, uint8_t block[16][4])
+{
+    int32_t mode = 0;
+    while (mode < 8 && !((in[0] >> mode) & 1)) mode++;
+
+    memset(block, 0, sizeof(uint8_t) * 16 * 4);
+    if (mode != 4 && mode != 5 && mode != 6) return false;
+
+    int32_t position = mode + 1;
+    int32_t rotation = mode == 6 ? 0 : (int32_t)texture_read_bits(in, &position, 2);
+    int32_t index_mode = mode == 4 ? (int32_t)texture_read_bits(in, &position, 1) : 0;
+
+    int32_t color_bits = mode == 4 ? 5 : 7;
+    int32_t alpha_bits = mode == 4 ? 6 : mode == 5 ? 8 : 7;
+    int32_t e[2][4];
+    for (int32_t c = 0; c < 3; ++c)
+        for (int32_t k = 0; k < 2; ++k)
+            e[k][c] = (int32_t)texture_read_bits(in, &position, color_bits);
+    for (int32_t k = 0; k < 2; ++k)
+        e[k][3] = (int32_t)texture_read_bits(in, &position, alpha_bits);
+
+    for (int32_t k = 0; k < 2; ++k) {
+        if (mode == 6) {
+            int32_t p = (int32_t)texture_read_bits(in, &position, 1);
+            for (int32_t c = 0; c < 4; ++c) e[k][c] = (e[k][c] << 1) | p;
+        } else {
+            for (int32_t c = 0; c < 3; ++c) e[k][c] = texture_bc7_expand(e[k][c], color_bits);
+            e[k][3] = texture_bc7_expand(e[k][3], alpha_bits);
+        }
+    }
+
+    //mode 6 shares one index set, modes 4 and 5 store a second one for alpha
+    int32_t first[16], second[16];
+    texture_bc7_indices(in, &position, mode == 6 ? 4 : 2, first);
+    if (mode != 6) texture_bc7_indices(in, &position, mode == 4 ? 3 : 2, second);
+
+    int32_t const* color_indices = index_mode ? second : first;
+    int32_t const* alpha_indices = mode == 6 ? first : index_mode ? first : second;
+    int32_t const* color_weights = mode == 6 ? texture_bc7_weights : mode == 4 && index_mode ? texture_bc7_weights3 : texture_bc7_weights2;
+    int32_t const* alpha_weights = mode == 6 ? texture_bc7_weights : mode == 4 && !index_mode ? texture_bc7_weights3 : texture_bc7_weights2;
+
+    for (int32_t i = 0; i < 16; ++i) {
+        int32_t w = color_weights[color_indices[i]];
+        for (int32_t c = 0; c < 3; ++c)
+            block[i][c] = (uint8_t)(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+        w = alpha_weights[alpha_indices[i]];
+        block[i][3] = (uint8_t)(((64 - w) * e[0][3] + w * e[1][3] + 32) >> 6);
+
+        if (rotation > 0) {
+            uint8_t t = block[i][3];
+            block[i][3] = block[i][rotation - 1];
+            block[i][rotation - 1] = t;
+        }
+    }
+    return true;
+}
+
+static bool texture_decode_block(uint8_t const* in, mdl_texture_format format, uint8_t block[16][4])
+{
+    switch (format) {
+        case MDL_TEXTURE_FORMAT_BC1:
+            texture_decode_bc1(in, block, false);
+            return true;
+        case MDL_TEXTURE_FORMAT_BC3:
+            texture_decode_bc1(in + 8, block, true);
+            texture_decode_bc4(in, block, 3);
+            return true;
+        case MDL_TEXTURE_FORMAT_BC5:
+            texture_decode_bc4(in, block, 0);
+            texture_decode_bc4(in + 8, block, 1);
+            for (int32_t i = 0; i < 16; ++i) {
+                block[i][2] = 0;
+                block[i][3] = 255;
+            }
+            return true;
+        case MDL_TEXTURE_FORMAT_BC7:
+            return texture_decode_bc7(in, block);
+        default:
+            return false;
+    }
+}
+
+static void texture_encode_block(uint8_t const block[16][4], mdl_texture_format format, uint8_t* out)
+{
+    uint8_t channel[16];
+    switch (format) {
+        case MDL_TEXTURE_FORMAT_BC1:
+            texture_encode_bc1(block, out);
+            break;
+        case MDL_TEXTURE_FORMAT_BC3:
+            for (int32_t i = 0; i < 16; ++i) channel[i] = block[i][3];
+            texture_encode_bc4(channel, out);
+            texture_encode_bc1(block, out + 8);
+            break;
+        case MDL_TEXTURE_FORMAT_BC5:
+            for (int32_t i = 0; i < 16; ++i) channel[i] = block[i][0];
+            texture_encode_bc4(channel, out);
+            for (int32_t i = 0; i < 16; ++i) channel[i] = block[i][1];
+            texture_encode_bc4(channel, out + 8);
+            break;
+        case MDL_TEXTURE_FORMAT_BC7:
+            texture_encode_bc7(block, out);
+            break;
+        default:
+            break;
+    }
+}
+
+static void texture_compress_row(void* user_data, int32_t by)
+{
+    texture_compress_job const* job = user_data;
+    uint8_t block[16][4];
+    for (int32_t bx = 0; bx < job->blocks_x; ++bx) {
+        texture_block_fetch(job->rgba, job->width, job->height, bx, by, block);
+        texture_encode_block(block, job->format, job->out + ((size_t)by * job->blocks_x + bx) * job->block_bytes);
+    }
+}
+
+static void texture_srgb_tables(float srgb_to_linear[256], uint8_t linear_to_srgb[TEXTURE_LINEAR_TO_SRGB_SIZE])
+{
+    for (int32_t i = 0; i < 256; ++i) {
+        float c = i / 255.0f;
+        srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int32_t i = 0; i < TEXTURE_LINEAR_TO_SRGB_SIZE; ++i) {
+        float l = i / (float)(TEXTURE_LINEAR_TO_SRGB_SIZE - 1);
+        float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+        linear_to_srgb[i] = (uint8_t)lrintf(texture_clamp(c, 0.0f, 1.0f) * 255.0f);
+    }
+}
+
+static void texture_mip_row(void* user_data, int32_t y)
+{
+    texture_mip_job const* job = user_data;
+    int32_t y0 = y * 2 < job->source_height ? y * 2 : job->source_height - 1;
+    int32_t y1 = y * 2 + 1 < job->source_height ? y * 2 + 1 : job->source_height - 1;
+
+    for (int32_t x = 0; x < job->width; ++x) {
+        int32_t x0 = x * 2 < job->source_width ? x * 2 : job->source_width - 1;
+        int32_t x1 = x * 2 + 1 < job->source_width ? x * 2 + 1 : job->source_width - 1;
+        uint8_t const* texels[4] = {
+            job->source + ((size_t)y0 * job->source_width + x0) * 4,
+            job->source + ((size_t)y0 * job->source_width + x1) * 4,
+            job->source + ((size_t)y1 * job->source_width + x0) * 4,
+            job->source + ((size_t)y1 * job->source_width + x1) * 4
+        };
+
+        uint8_t* out = job->target + ((size_t)y * job->width + x) * 4;
+        if (!job->srgb) {
+            for (int32_t c = 0; c < 4; ++c)
+                out[c] = (uint8_t)((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+            continue;
+        }
+        for (int32_t c = 0; c < 3; ++c) {
+            float linear = 0.0f;
+            for (int32_t k = 0; k < 4; ++k) linear += job->srgb_to_linear[texels[k][c]];
+            out[c] = job->linear_to_srgb[(int32_t)lrintf(linear * 0.25f * (TEXTURE_LINEAR_TO_SRGB_SIZE - 1))];
+        }
+        out[3] = (uint8_t)((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+    }
+}
+
+uint32_t texture_compressed_size(mdl_texture_format format, int32_t width, int32_t height)
+{
+    uint32_t blocks = (uint32_t)((width + 3) / 4) * (uint32_t)((height + 3) / 4);
+    switch (format) {
+        case MDL_TEXTURE_FORMAT_RGBA8: return (uint32_t)width * (uint32_t)height * 4;
+        case MDL_TEXTURE_FORMAT_BC1: return blocks * 8;
+        default: return blocks * 16;
+    }
+}
+
+void texture_compress(uint8_t const* rgba, int32_t width, int32_t height, mdl_texture_format format,
+                      uint8_t* out, bool parallel)
+{
+    if (format == MDL_TEXTURE_FORMAT_RGBA8 || width <= 0 || height <= 0) return;
+
+    texture_compress_job job;
+    job.rgba = rgba;
+    job.width = width;
+    job.height = height;
+    job.blocks_x = (width + 3) / 4;
+    job.block_bytes = format == MDL_TEXTURE_FORMAT_BC1 ? 8 : 16;
+    job.format = format;
+    job.out = out;
+
+    int32_t blocks_y = (height + 3) / 4;
+    if (parallel) {
+        os_parallel_for(blocks_y, texture_compress_row, &job);
+    } else {
+        for (int32_t by = 0; by < blocks_y; ++by)
+            texture_compress_row(&job, by);
+    }
+}
+
+bool texture_compress_texture(mdl_texture* texture, mdl_texture_format format, bool parallel)
+{
+    if (!texture->valid || texture->format != MDL_TEXTURE_FORMAT_RGBA8 || format == MDL_TEXTURE_FORMAT_RGBA8)
+        return false;
+
+    uint32_t offsets[MDL_MAXIMUM_TEXTURE_LEVELS], sizes[MDL_MAXIMUM_TEXTURE_LEVELS], total = 0;
+    for (int32_t i = 0; i < texture->levels_count; ++i) {
+        int32_t width = texture->width >> i > 0 ? texture->width >> i : 1;
+        int32_t height = texture->height >> i > 0 ? texture->height >> i : 1;
+        offsets[i] = total;
+        sizes[i] = texture_compressed_size(format, width, height);
+        total += sizes[i];
+    }
+
+    uint8_t* buffer = OS_MALLOC(total);
+    for (int32_t i = 0; i < texture->levels_count; ++i) {
+        int32_t width = texture->width >> i > 0 ? texture->width >> i : 1;
+        int32_t height = texture->height >> i > 0 ? texture->height >> i : 1;
+        texture_compress((uint8_t const*)texture->buffer + texture->level_offsets[i], width, height, format,
+                         buffer + offsets[i], parallel);
+    }
+
+    OS_FREE(texture->buffer);
+    texture->buffer = buffer;
+    texture->size = (int32_t)total;
+    texture->format = format;
+    os_memcpy(texture->level_offsets, offsets, sizeof(uint32_t) * texture->levels_count);
+    os_memcpy(texture->level_sizes, sizes, sizeof(uint32_t) * texture->levels_count);
+    return true;
+}
+
+int32_t texture_decompress(uint8_t const* blocks, int32_t width, int32_t height, mdl_texture_format format, uint8_t* rgba)
+{
+    if (format == MDL_TEXTURE_FORMAT_RGBA8 || width <= 0 || height <= 0) return 0;
+
+    int32_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+    uint32_t block_bytes = format == MDL_TEXTURE_FORMAT_BC1 ? 8 : 16;
+    int32_t failed = 0;
+    uint8_t block[16][4];
+    for (int32_t by = 0; by < blocks_y; ++by) {
+        for (int32_t bx = 0; bx < blocks_x; ++bx) {
+            if (!texture_decode_block(blocks + ((size_t)by * blocks_x + bx) * block_bytes, format, block))
+                failed++;
+
+            //partial edge blocks only write the texels inside the image
+            for (int32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+                for (int32_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+                    memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, block[y * 4 + x], 4);
+        }
+    }
+    return failed;
+}
+
+bool texture_decompress_texture(mdl_texture* texture, int32_t* failed_blocks)
+{
+    if (failed_blocks) *failed_blocks = 0;
+    if (!texture->valid || texture->format == MDL_TEXTURE_FORMAT_RGBA8)
+        return false;
+
+    uint32_t offsets[MDL_MAXIMUM_TEXTURE_LEVELS], sizes[MDL_MAXIMUM_TEXTURE_LEVELS], total = 0;
+    for (int32_t i = 0; i < texture->levels_count; ++i) {
+        int32_t width = texture->width >> i > 0 ? texture->width >> i : 1;
+        int32_t height = texture->height >> i > 0 ? texture->height >> i : 1;
+        if (texture->level_sizes[i] < texture_compressed_size(texture->format, width, height))
+            return false;
+        offsets[i] = total;
+        sizes[i] = (uint32_t)width * (uint32_t)height * 4;
+        total += sizes[i];
+    }
+
+    uint8_t* buffer = OS_MALLOC(total);
+    int32_t failed = 0;
+    for (int32_t i = 0; i < texture->levels_count; ++i) {
+        int32_t width = texture->width >> i > 0 ? texture->width >> i : 1;
+        int32_t height = texture->height >> i > 0 ? texture->height >> i : 1;
+        failed += texture_decompress((uint8_t const*)texture->buffer + texture->level_offsets[i], width, height,
+                                     texture->format, buffer + offsets[i]);
+    }
+
+    OS_FREE(texture->buffer);
+    texture->buffer = buffer;
+    texture->size = (int32_t)total;
+    texture->format = MDL_TEXTURE_FORMAT_RGBA8;
+    os_memcpy(texture->level_offsets, offsets, sizeof(uint32_t) * texture->levels_count);
+    os_memcpy(texture->level_sizes, sizes, sizeof(uint32_t) * texture->levels_count);
+    if (failed_blocks) *failed_blocks = failed;
+    return true;
+}
+
+bool texture_has_alpha(mdl_texture const* texture)
+{
+    if (!texture->valid || texture->format != MDL_TEXTURE_FORMAT_RGBA8) return false;
+    uint8_t const* pixels = texture->buffer;
+    uint32_t count = (uint32_t)texture->width * (uint32_t)texture->height;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (pixels[i * 4 + 3] != 255) return true;
+    }
+    return false;
+}
+
+bool texture_generate_mips(mdl_texture* texture, bool parallel)
+{
+    if (!texture->valid || texture->format != MDL_TEXTURE_FORMAT_RGBA8 || texture->levels_count != 1)
+        return false;
+
+    float srgb_to_linear[256];
+    uint8_t linear_to_srgb[TEXTURE_LINEAR_TO_SRGB_SIZE];
+    texture_srgb_tables(srgb_to_linear, linear_to_srgb);
+
+    int32_t levels_count = 1;
+    uint32_t offsets[MDL_MAXIMUM_TEXTURE_LEVELS], sizes[MDL_MAXIMUM_TEXTURE_LEVELS], total = 0;
+    for (int32_t i = 0; i < MDL_MAXIMUM_TEXTURE_LEVELS; ++i) {
+        int32_t width = texture->width >> i > 0 ? texture->width >> i : 1;
+        int32_t height = texture->height >> i > 0 ? texture->height >> i : 1;
+        offsets[i] = total;
+        sizes[i] = (uint32_t)width * (uint32_t)height * 4;
+        total += sizes[i];
+        levels_count = i + 1;
+        if (width == 1 && height == 1) break;
+    }
+    if (levels_count == 1) return false;
+
+    uint8_t* buffer = OS_MALLOC(total);
+    os_memcpy(buffer, texture->buffer, (int32_t)sizes[0]);
+
+    for (int32_t i = 1; i < levels_count; ++i) {
+        texture_mip_job job;
+        job.source = buffer + offsets[i - 1];
+        job.source_width = texture->width >> (i - 1) > 0 ? texture->width >> (i - 1) : 1;
+        job.source_height = texture->height >> (i - 1) > 0 ? texture->height >> (i - 1) : 1;
+        job.target = buffer + offsets[i];
+        job.width = texture->width >> i > 0 ? texture->width >> i : 1;
+        job.srgb_to_linear = srgb_to_linear;
+        job.linear_to_srgb = linear_to_srgb;
+        job.srgb = texture->srgb;
+
+        int32_t height = texture->height >> i > 0 ? texture->height >> i : 1;
+        if (parallel) {
+            os_parallel_for(height, texture_mip_row, &job);
+        } else {
+            for (int32_t y = 0; y < height; ++y)
+                texture_mip_row(&job, y);
+        }
+    }
+
+    OS_FREE(texture->buffer);
+    texture->buffer = buffer;
+    texture->size = (int32_t)total;
+    texture->levels_count = levels_count;
+    os_memcpy(texture->level_offsets, offsets, sizeof(uint32_t) * levels_count);
+    os_memcpy(texture->level_sizes, sizes, sizeof(uint32_t) * levels_count);
+    return true;
+}
@@ -0,0 +1,70 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_TEXTURECOMPRESS_H
+#define IBCWEB_TEXTURECOMPRESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Model.h"
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+/*
+ * Block compression of rgba8 images for import time.
+ *
+ * bc1: rgb, 4 bits per texel, alpha dropped
+ * bc3: rgb + interpolated alpha, 8 bits per texel
+ * bc5: two channel red/green (normal maps), 8 bits per texel
+ * bc7: rgba, mode 6 only, 8 bits per texel
+ *
+ * Endpoints come from the principal axis of each 4x4 block. Quality sits between a fast
+ * realtime encoder and an exhaustive one, which is fine for base color maps.
+ */
+
+IBC_API uint32_t texture_compressed_size(mdl_texture_format format, int32_t width, int32_t height);
+
+/*
+ * Compresses one rgba8 image, rows of blocks are spread over all cores when parallel is set.
+ * Images that are not a multiple of 4 repeat their edge texels into the partial blocks.
+ */
+IBC_API void texture_compress(uint8_t const* rgba, int32_t width, int32_t height, mdl_texture_format format,
+                              uint8_t* out, bool parallel);
+
+/*
+ * Replaces every level of an rgba8 texture with its compressed version.
+ */
+IBC_API bool texture_compress_texture(mdl_texture* texture, mdl_texture_format format, bool parallel);
+
+/*
+ * Expands one block compressed image to rgba8, the fallback for drivers without the format.
+ * Bc5 fills blue with 0 and alpha with 255 like the gpu does. Bc7 only decodes the single subset
+ * modes (4, 5, 6), other blocks come out transparent black. Returns the number of such blocks.
+ */
+IBC_API int32_t texture_decompress(uint8_t const* blocks, int32_t width, int32_t height, mdl_texture_format format, uint8_t* rgba);
+
+/*
+ * Replaces every level of a block compressed texture with rgba8, srgb is kept.
+ * failed_blocks receives the bc7 blocks that could not be decoded.
+ */
+IBC_API bool texture_decompress_texture(mdl_texture* texture, int32_t* failed_blocks);
+
+/*
+ * Appends the full mip chain of an rgba8 texture with a single level.
+ * Srgb color is averaged in linear space and stored back as srgb, linear textures and alpha are averaged as is.
+ */
+IBC_API bool texture_generate_mips(mdl_texture* texture, bool parallel);
+
+/*
+ * True when any texel of the rgba8 texture is not fully opaque.
+ */
+IBC_API bool texture_has_alpha(mdl_texture const* texture);
+
+#endif //IBCWEB_TEXTURECOMPRESS_H
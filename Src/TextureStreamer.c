@@ -0,0 +1,435 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "TextureStreamer.h"
+
+#include <stdio.h>
+
+#include "Allocator.h"
+#include "TextureCompress.h"
+#include "Thread.h"
+
+typedef struct texture_streamer_entry{
+    mdl_texture source;
+    //mapping the source levels point into, 0 when the streamer owns the buffer
+    mdl_backing* backing;
+    //the worker still decodes or builds the mips, the placeholder is drawn meanwhile
+    bool pending;
+    //the worker could not decode the levels, the placeholder stays
+    bool failed;
+    gfx_texture_type type;
+    gfx_texture_handle texture;
+
+    //finest uploaded level, levels_count while nothing is resident
+    int32_t resident_level;
+    int32_t coarse_level;
+    int32_t wanted_level;
+
+    float requested_pixels;
+    uint64_t last_needed_frame;
+} texture_streamer_entry;
+
+/*
+ * Texture the worker prepares, the job owns its copy so entries can grow meanwhile.
+ */
+typedef struct texture_streamer_job{
+    int32_t id;
+    mdl_texture texture;
+    //texture.buffer still points into the source mapping
+    bool mapped;
+    bool decode;
+    bool valid;
+    int32_t failed_blocks;
+    struct texture_streamer_job* next;
+} texture_streamer_job;
+
+typedef struct texture_streamer{
+    texture_streamer_entry* entries;
+    int32_t entries_count;
+    int32_t entries_capacity;
+
+    int64_t budget_bytes;
+    int64_t resident_bytes;
+    int64_t uploaded_bytes;
+    int32_t evictions;
+
+    float anisotropy;
+    uint64_t frame;
+
+    //white 1x1 texture returned while a texture is prepared
+    gfx_texture_handle placeholder;
+
+    os_mutex_handle mutex;
+    //signaled when jobs are queued or the worker has to stop
+    os_condition_handle wake;
+    os_thread_handle thread;
+    volatile int32_t running;
+    texture_streamer_job* queued;
+    texture_streamer_job* queued_last;
+    texture_streamer_job* finished;
+} texture_streamer;
+
+static int64_t texture_streamer_chain_bytes(texture_streamer_entry const* entry, int32_t level)
+{
+    int64_t bytes = 0;
+    for (int32_t i = level; i < entry->source.levels_count; ++i)
+        bytes += entry->source.level_sizes[i];
+    return bytes;
+}
+
+/*
+ * Makes level the finest resident level. Raises upload only the levels that were missing,
+ * drops release the finest levels and upload nothing.
+ */
+static void texture_streamer_upload(texture_streamer* handle, texture_streamer_entry* entry, int32_t level)
+{
+    void const* levels[MDL_MAXIMUM_TEXTURE_LEVELS];
+    int32_t sizes[MDL_MAXIMUM_TEXTURE_LEVELS];
+    int32_t end = entry->texture == 0 ? entry->source.levels_count : entry->resident_level;
+    for (int32_t k = level; k < end; ++k) {
+        levels[k - level] = (uint8_t const*)entry->source.buffer + entry->source.level_offsets[k];
+        sizes[k - level] = (int32_t)entry->source.level_sizes[k];
+    }
+
+    if (entry->texture == 0) {
+        entry->texture = gfx_texture_create_partial(entry->source.width, entry->source.height, level,
+                                                    entry->source.levels_count, levels, sizes, entry->type,
+                                                    GFX_TEXTURE_FILTER_LINEAR, GFX_TEXTURE_WRAP_REPEAT);
+        gfx_texture_set_anisotropy(entry->texture, handle->anisotropy);
+    } else {
+        gfx_texture_set_base_level(entry->texture, level, levels, sizes);
+    }
+
+    int64_t current = texture_streamer_chain_bytes(entry, entry->resident_level);
+    int64_t next = texture_streamer_chain_bytes(entry, level);
+    handle->resident_bytes += next - current;
+    if (next > current)
+        handle->uploaded_bytes += next - current;
+    entry->resident_level = level;
+}
+
+/*
+ * Drops the finest level of the least recently needed texture that has more than its coarse mips.
+ * Textures needed this frame are only taken when allow_needed is set.
+ */
+static bool texture_streamer_evict(texture_streamer* handle, texture_streamer_entry const* except, bool allow_needed)
+{
+    texture_streamer_entry* victim = 0;
+    for (int32_t i = 0; i < handle->entries_count; ++i) {
+        texture_streamer_entry* entry = handle->entries + i;
+        if (entry == except || entry->texture == 0 || entry->resident_level >= entry->coarse_level) continue;
+        if (!allow_needed && entry->last_needed_frame == handle->frame) continue;
+
+        if (victim == 0 || entry->last_needed_frame < victim->last_needed_frame ||
+            (entry->last_needed_frame == victim->last_needed_frame &&
+             entry->source.level_sizes[entry->resident_level] > victim->source.level_sizes[victim->resident_level]))
+            victim = entry;
+    }
+
+    if (victim == 0) return false;
+    texture_streamer_upload(handle, victim, victim->resident_level + 1);
+    handle->evictions++;
+    return true;
+}
+
+//uploads the coarse mips of a texture whose levels are ready
+static void texture_streamer_place(texture_streamer* handle, texture_streamer_entry* entry)
+{
+    int32_t coarse = 0;
+    while (coarse + 1 < entry->source.levels_count &&
+           (entry->source.width >> coarse > TEXTURE_STREAMER_INITIAL_SIZE ||
+            entry->source.height >> coarse > TEXTURE_STREAMER_INITIAL_SIZE))
+        coarse++;
+
+    entry->coarse_level = coarse;
+    entry->wanted_level = coarse;
+    entry->resident_level = entry->source.levels_count;
+    texture_streamer_upload(handle, entry, coarse);
+}
+
+static void texture_streamer_job_free(texture_streamer_job* job)
+{
+    if (!job->mapped)
+        OS_FREE(job->texture.buffer);
+    OS_FREE(job);
+}
+
+static void texture_streamer_run(void* user_data)
+{
+    texture_streamer* handle = user_data;
+    for (;;) {
+        //blocks until add queues a job or destroy stops the worker
+        texture_streamer_job* job = 0;
+        os_mutex_lock(handle->mutex);
+        while (job == 0 && os_atomic_load(&handle->running)) {
+            job = handle->queued;
+            if (job != 0) {
+                handle->queued = job->next;
+                if (handle->queued == 0)
+                    handle->queued_last = 0;
+            } else {
+                os_condition_wait(handle->wake, handle->mutex);
+            }
+        }
+        os_mutex_unlock(handle->mutex);
+        if (job == 0) break;
+
+        //decoding and mip generation replace the buffer, mapped levels are copied out first
+        if (job->mapped) {
+            void* buffer = OS_MALLOC((uint32_t)job->texture.size);
+            os_memcpy(buffer, job->texture.buffer, (int32_t)job->texture.size);
+            job->texture.buffer = buffer;
+            job->mapped = false;
+        }
+        job->valid = true;
+        if (job->decode)
+            job->valid = texture_decompress_texture(&job->texture, &job->failed_blocks);
+        if (job->valid && job->texture.format == MDL_TEXTURE_FORMAT_RGBA8 && job->texture.levels_count == 1)
+            texture_generate_mips(&job->texture, false);
+
+        os_mutex_lock(handle->mutex);
+        job->next = handle->finished;
+        handle->finished = job;
+        os_mutex_unlock(handle->mutex);
+    }
+}
+
+/*
+ * Takes the textures the worker finished, true when any of them was uploaded.
+ */
+static bool texture_streamer_collect(texture_streamer* handle)
+{
+    os_mutex_lock(handle->mutex);
+    texture_streamer_job* job = handle->finished;
+    handle->finished = 0;
+    os_mutex_unlock(handle->mutex);
+
+    bool changed = false;
+    while (job != 0) {
+        texture_streamer_job* next = job->next;
+        texture_streamer_entry* entry = handle->entries + job->id;
+        entry->pending = false;
+        //the worker made its own copy, the mapping is not read anymore
+        mdl_backing_release(entry->backing);
+        entry->backing = 0;
+
+        if (!job->valid) {
+            entry->failed = true;
+            fprintf(stderr, "- Texture %i format is not supported by the driver, skipped\n", job->id);
+            texture_streamer_job_free(job);
+        } else {
+            if (job->decode) {
+                entry->type = job->texture.srgb ? GFX_TEXTURE_TYPE_SRGBA : GFX_TEXTURE_TYPE_RGBA;
+                printf("- Texture %i format is not supported by the driver, decoded to rgba8\n", job->id);
+                if (job->failed_blocks > 0)
+                    fprintf(stderr, "- - %i bc7 blocks use partitioned modes and were left blank\n", job->failed_blocks);
+            }
+            entry->source = job->texture;
+            OS_FREE(job);
+            texture_streamer_place(handle, entry);
+            changed = true;
+        }
+        job = next;
+    }
+    return changed;
+}
+
+texture_streamer_handle texture_streamer_create(int64_t budget_bytes)
+{
+    texture_streamer_handle handle = OS_MALLOC(sizeof(texture_streamer));
+    os_memset(handle, 0, sizeof(texture_streamer));
+    handle->budget_bytes = budget_bytes;
+    handle->anisotropy = 1.0f;
+
+    uint8_t white[4] = {255, 255, 255, 255};
+    handle->placeholder = gfx_texture_create(1, 1, white, GFX_TEXTURE_TYPE_RGBA,
+                                             GFX_TEXTURE_FILTER_NEAREST, GFX_TEXTURE_WRAP_REPEAT);
+
+    handle->mutex = os_mutex_create();
+    handle->wake = os_condition_create();
+    handle->running = 1;
+    handle->thread = os_thread_create(texture_streamer_run, handle);
+    return handle;
+}
+
+void texture_streamer_destroy(texture_streamer_handle handle)
+{
+    os_mutex_lock(handle->mutex);
+    os_atomic_store(&handle->running, 0);
+    os_condition_broadcast(handle->wake);
+    os_mutex_unlock(handle->mutex);
+    os_thread_join(handle->thread);
+    os_condition_destroy(handle->wake);
+    os_mutex_destroy(handle->mutex);
+
+    texture_streamer_job* lists[2] = {handle->queued, handle->finished};
+    for (int32_t i = 0; i < 2; ++i) {
+        while (lists[i] != 0) {
+            texture_streamer_job* next = lists[i]->next;
+            texture_streamer_job_free(lists[i]);
+            lists[i] = next;
+        }
+    }
+
+    for (int32_t i = 0; i < handle->entries_count; ++i) {
+        texture_streamer_entry* entry = handle->entries + i;
+        gfx_texture_destroy(entry->texture);
+        if (entry->backing == 0)
+            OS_FREE(entry->source.buffer);
+        mdl_backing_release(entry->backing);
+    }
+    gfx_texture_destroy(handle->placeholder);
+    OS_FREE(handle->entries);
+    OS_FREE(handle);
+}
+
+int32_t texture_streamer_add(texture_streamer_handle handle, mdl_texture const* texture, mdl_backing* backing, gfx_texture_type type)
+{
+    if (handle->entries_count == handle->entries_capacity) {
+        handle->entries_capacity = handle->entries_capacity > 0 ? handle->entries_capacity * 2 : 16;
+        handle->entries = OS_REALLOC(handle->entries, sizeof(texture_streamer_entry) * handle->entries_capacity);
+    }
+
+    int32_t id = handle->entries_count++;
+    texture_streamer_entry* entry = handle->entries + id;
+    os_memset(entry, 0, sizeof(texture_streamer_entry));
+    entry->type = type;
+
+    if (!texture->valid || texture->levels_count <= 0) return id;
+
+    //mapped levels are read in place, everything else is copied since the model may be unloaded
+    mdl_texture source = *texture;
+    source.name = 0;
+    bool mapped = mdl_backing_contains(backing, texture->buffer);
+    if (!mapped) {
+        source.buffer = OS_MALLOC((uint32_t)texture->size);
+        os_memcpy(source.buffer, texture->buffer, texture->size);
+    }
+
+    //block formats the driver lacks (bc7 on macos, s3tc on mobile webgl) are expanded on the worker
+    bool decode = !gfx_texture_type_supported(type);
+    if (decode || (source.format == MDL_TEXTURE_FORMAT_RGBA8 && source.levels_count == 1)) {
+        texture_streamer_job* job = OS_MALLOC(sizeof(texture_streamer_job));
+        os_memset(job, 0, sizeof(texture_streamer_job));
+        job->id = id;
+        job->texture = source;
+        job->mapped = mapped;
+        job->decode = decode;
+        entry->pending = true;
+        entry->backing = mapped ? mdl_backing_retain(backing) : 0;
+
+        os_mutex_lock(handle->mutex);
+        if (handle->queued_last != 0)
+            handle->queued_last->next = job;
+        else
+            handle->queued = job;
+        handle->queued_last = job;
+        os_condition_signal(handle->wake);
+        os_mutex_unlock(handle->mutex);
+        return id;
+    }
+
+    entry->source = source;
+    entry->backing = mapped ? mdl_backing_retain(backing) : 0;
+    texture_streamer_place(handle, entry);
+    return id;
+}
+
+gfx_texture_handle texture_streamer_get(texture_streamer_handle handle, int32_t id)
+{
+    if (id < 0 || id >= handle->entries_count) return 0;
+    texture_streamer_entry const* entry = handle->entries + id;
+    return entry->pending || entry->failed ? handle->placeholder : entry->texture;
+}
+
+void texture_streamer_request(texture_streamer_handle handle, int32_t id, float pixels)
+{
+    if (id < 0 || id >= handle->entries_count) return;
+    texture_streamer_entry* entry = handle->entries + id;
+    if (pixels > entry->requested_pixels)
+        entry->requested_pixels = pixels;
+}
+
+bool texture_streamer_update(texture_streamer_handle handle)
+{
+    handle->frame++;
+    bool changed = texture_streamer_collect(handle);
+
+    for (int32_t i = 0; i < handle->entries_count; ++i) {
+        texture_streamer_entry* entry = handle->entries + i;
+        if (entry->texture == 0) continue;
+
+        //finest level whose size still covers the requested pixels, unrequested textures keep what they have
+        if (entry->requested_pixels > 0.0f) {
+            int32_t size = entry->source.width > entry->source.height ? entry->source.width : entry->source.height;
+            int32_t level = 0;
+            while (level < entry->coarse_level && (float)(size >> (level + 1)) >= entry->requested_pixels)
+                level++;
+            entry->wanted_level = level;
+            entry->last_needed_frame = handle->frame;
+        } else {
+            entry->wanted_level = entry->resident_level;
+        }
+        entry->requested_pixels = 0.0f;
+    }
+
+    int64_t upload_left = TEXTURE_STREAMER_UPLOAD_PER_UPDATE;
+    for (int32_t i = 0; i < handle->entries_count && upload_left > 0; ++i) {
+        texture_streamer_entry* entry = handle->entries + i;
+        if (entry->texture == 0 || entry->wanted_level >= entry->resident_level) continue;
+
+        int32_t level = entry->wanted_level;
+        int64_t current = texture_streamer_chain_bytes(entry, entry->resident_level);
+        while (handle->resident_bytes + texture_streamer_chain_bytes(entry, level) - current > handle->budget_bytes &&
+               texture_streamer_evict(handle, entry, false)) {
+            changed = true;
+        }
+        while (level < entry->resident_level &&
+               handle->resident_bytes + texture_streamer_chain_bytes(entry, level) - current > handle->budget_bytes)
+            level++;
+        if (level == entry->resident_level) continue;
+
+        upload_left -= texture_streamer_chain_bytes(entry, level) - current;
+        texture_streamer_upload(handle, entry, level);
+        changed = true;
+    }
+
+    //the budget may have been lowered
+    while (handle->resident_bytes > handle->budget_bytes && texture_streamer_evict(handle, 0, true))
+        changed = true;
+
+    return changed;
+}
+
+void texture_streamer_set_budget(texture_streamer_handle handle, int64_t budget_bytes)
+{
+    handle->budget_bytes = budget_bytes;
+}
+
+void texture_streamer_set_anisotropy(texture_streamer_handle handle, float anisotropy)
+{
+    handle->anisotropy = anisotropy;
+    for (int32_t i = 0; i < handle->entries_count; ++i) {
+        if (handle->entries[i].texture != 0)
+            handle->anisotropy = gfx_texture_set_anisotropy(handle->entries[i].texture, anisotropy);
+    }
+}
+
+void texture_streamer_get_stats(texture_streamer_handle handle, texture_streamer_stats* stats)
+{
+    os_memset(stats, 0, sizeof(texture_streamer_stats));
+    stats->textures_count = handle->entries_count;
+    stats->resident_bytes = handle->resident_bytes;
+    stats->budget_bytes = handle->budget_bytes;
+    stats->uploaded_bytes = handle->uploaded_bytes;
+    stats->evictions = handle->evictions;
+    for (int32_t i = 0; i < handle->entries_count; ++i) {
+        texture_streamer_entry const* entry = handle->entries + i;
+        stats->total_levels += entry->source.levels_count;
+        if (entry->texture != 0)
+            stats->resident_levels += entry->source.levels_count - entry->resident_level;
+    }
+}
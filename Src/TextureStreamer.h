@@ -0,0 +1,79 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_TEXTURESTREAMER_H
+#define IBCWEB_TEXTURESTREAMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Graphics.h"
+#include "Model.h"
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+/*
+ * Mip residency of model textures.
+ *
+ * Every texture starts with its coarse mips only (up to TEXTURE_STREAMER_INITIAL_SIZE texels).
+ * Each frame the renderer requests the screen size a texture is seen at, update then raises
+ * the resident resolution towards it and drops the finest mips of the least recently needed
+ * textures whenever the gpu budget would be exceeded. The coarse mips are never dropped.
+ *
+ * Levels of baked assets are read from the file mapping, which the streamer keeps alive past the model.
+ * Other sources are copied once, so the source model can be unloaded. Decoding and mip generation run
+ * on a worker thread, a white placeholder is returned until the texture is ready.
+ */
+
+#define TEXTURE_STREAMER_INITIAL_SIZE 64
+#define TEXTURE_STREAMER_DEFAULT_BUDGET (256ll * 1024 * 1024)
+//gpu upload limit of a single update, larger raises continue on the next frames
+#define TEXTURE_STREAMER_UPLOAD_PER_UPDATE (16ll * 1024 * 1024)
+
+typedef struct texture_streamer* texture_streamer_handle;
+
+typedef struct texture_streamer_stats{
+    int32_t textures_count;
+    int32_t resident_levels;
+    int32_t total_levels;
+    int64_t resident_bytes;
+    int64_t budget_bytes;
+    int64_t uploaded_bytes;
+    int32_t evictions;
+} texture_streamer_stats;
+
+IBC_API texture_streamer_handle texture_streamer_create(int64_t budget_bytes);
+IBC_API void texture_streamer_destroy(texture_streamer_handle handle);
+
+/*
+ * Uploads the coarse mips and returns the texture id. Levels inside backing are referenced, not copied.
+ * Block formats the driver can't sample are decoded to rgba8 and rgba8 textures without a mip chain
+ * get one built, both on the worker, the coarse mips follow in a later update.
+ * Invalid textures still get an id, their handle stays 0.
+ */
+IBC_API int32_t texture_streamer_add(texture_streamer_handle handle, mdl_texture const* texture, mdl_backing* backing, gfx_texture_type type);
+
+IBC_API gfx_texture_handle texture_streamer_get(texture_streamer_handle handle, int32_t id);
+
+/*
+ * Screen size in pixels the texture covers this frame, several requests keep the largest.
+ */
+IBC_API void texture_streamer_request(texture_streamer_handle handle, int32_t id, float pixels);
+
+/*
+ * Uploads the textures the worker finished and applies this frame's requests,
+ * true when any resident texture changed.
+ */
+IBC_API bool texture_streamer_update(texture_streamer_handle handle);
+
+IBC_API void texture_streamer_set_budget(texture_streamer_handle handle, int64_t budget_bytes);
+IBC_API void texture_streamer_set_anisotropy(texture_streamer_handle handle, float anisotropy);
+IBC_API void texture_streamer_get_stats(texture_streamer_handle handle, texture_streamer_stats* stats);
+
+#endif //IBCWEB_TEXTURESTREAMER_H
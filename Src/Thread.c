@@ -0,0 +1,277 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "Thread.h"
+#include "Allocator.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifndef CORE_ASSERT
+#include "assert.h"
+#define CORE_ASSERT(e) assert(e)
+#endif
+
+#define MAXIMUM_PARALLEL_THREADS 64
+
+typedef struct os_thread{
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+    os_thread_func func;
+    void* user_data;
+} os_thread;
+
+typedef struct os_mutex{
+#ifdef _WIN32
+    CRITICAL_SECTION section;
+#else
+    pthread_mutex_t mutex;
+#endif
+} os_mutex;
+
+typedef struct os_condition{
+#ifdef _WIN32
+    CONDITION_VARIABLE condition;
+#else
+    pthread_cond_t condition;
+#endif
+} os_condition;
+
+typedef struct os_parallel_job{
+    os_parallel_func func;
+    void* user_data;
+    int32_t count;
+    volatile int32_t next;
+} os_parallel_job;
+
+int32_t os_cpu_count() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int32_t)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int32_t)count : 1;
+#endif
+}
+
+double os_timer_seconds() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+void os_sleep_seconds(double seconds) {
+    if (seconds <= 0.0) return;
+#ifdef _WIN32
+    Sleep((DWORD)(seconds * 1000.0));
+#else
+    struct timespec duration;
+    duration.tv_sec = (time_t)seconds;
+    duration.tv_nsec = (long)((seconds - (double)duration.tv_sec) * 1e9);
+    nanosleep(&duration, 0);
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI os_thread_entry(LPVOID arg) {
+    os_thread* thread = arg;
+    thread->func(thread->user_data);
+    return 0;
+}
+#else
+static void* os_thread_entry(void* arg) {
+    os_thread* thread = arg;
+    thread->func(thread->user_data);
+    return 0;
+}
+#endif
+
+os_thread_handle os_thread_create(os_thread_func func, void* user_data) {
+    os_thread_handle handle = OS_MALLOC(sizeof(struct os_thread));
+    handle->func = func;
+    handle->user_data = user_data;
+#ifdef _WIN32
+    handle->thread = CreateThread(0, 0, os_thread_entry, handle, 0, 0);
+    if (handle->thread == 0) {
+#else
+    if (pthread_create(&handle->thread, 0, os_thread_entry, handle) != 0) {
+#endif
+        OS_FREE(handle);
+        return 0;
+    }
+    return handle;
+}
+
+void os_thread_join(os_thread_handle handle) {
+    if (handle == 0) return;
+#ifdef _WIN32
+    WaitForSingleObject(handle->thread, INFINITE);
+    CloseHandle(handle->thread);
+#else
+    pthread_join(handle->thread, 0);
+#endif
+    OS_FREE(handle);
+}
+
+os_mutex_handle os_mutex_create() {
+    os_mutex_handle handle = OS_MALLOC(sizeof(struct os_mutex));
+#ifdef _WIN32
+    InitializeCriticalSection(&handle->section);
+#else
+    pthread_mutex_init(&handle->mutex, 0);
+#endif
+    return handle;
+}
+
+void os_mutex_lock(os_mutex_handle handle) {
+#ifdef _WIN32
+    EnterCriticalSection(&handle->section);
+#else
+    pthread_mutex_lock(&handle->mutex);
+#endif
+}
+
+void os_mutex_unlock(os_mutex_handle handle) {
+#ifdef _WIN32
+    LeaveCriticalSection(&handle->section);
+#else
+    pthread_mutex_unlock(&handle->mutex);
+#endif
+}
+
+void os_mutex_destroy(os_mutex_handle handle) {
+#ifdef _WIN32
+    DeleteCriticalSection(&handle->section);
+#else
+    pthread_mutex_destroy(&handle->mutex);
+#endif
+    OS_FREE(handle);
+}
+
+os_condition_handle os_condition_create() {
+    os_condition_handle handle = OS_MALLOC(sizeof(struct os_condition));
+#ifdef _WIN32
+    InitializeConditionVariable(&handle->condition);
+#else
+    pthread_cond_init(&handle->condition, 0);
+#endif
+    return handle;
+}
+
+void os_condition_wait(os_condition_handle handle, os_mutex_handle mutex) {
+#ifdef _WIN32
+    SleepConditionVariableCS(&handle->condition, &mutex->section, INFINITE);
+#else
+    pthread_cond_wait(&handle->condition, &mutex->mutex);
+#endif
+}
+
+void os_condition_signal(os_condition_handle handle) {
+#ifdef _WIN32
+    WakeConditionVariable(&handle->condition);
+#else
+    pthread_cond_signal(&handle->condition);
+#endif
+}
+
+void os_condition_broadcast(os_condition_handle handle) {
+#ifdef _WIN32
+    WakeAllConditionVariable(&handle->condition);
+#else
+    pthread_cond_broadcast(&handle->condition);
+#endif
+}
+
+void os_condition_destroy(os_condition_handle handle) {
+#ifndef _WIN32
+    pthread_cond_destroy(&handle->condition);
+#endif
+    OS_FREE(handle);
+}
+
+int32_t os_atomic_add(volatile int32_t* value, int32_t amount) {
+#ifdef _MSC_VER
+    return InterlockedExchangeAdd((volatile LONG*)value, amount);
+#else
+    return __atomic_fetch_add(value, amount, __ATOMIC_SEQ_CST);
+#endif
+}
+
+int32_t os_atomic_load(volatile int32_t* value) {
+#ifdef _MSC_VER
+    return InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+void os_atomic_store(volatile int32_t* value, int32_t new_value) {
+#ifdef _MSC_VER
+    InterlockedExchange((volatile LONG*)value, new_value);
+#else
+    __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+bool os_atomic_cas(volatile int32_t* value, int32_t expected, int32_t new_value) {
+#ifdef _MSC_VER
+    return InterlockedCompareExchange((volatile LONG*)value, new_value, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(value, &expected, new_value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void os_parallel_worker(void* user_data) {
+    os_parallel_job* job = user_data;
+    for (;;) {
+        int32_t index = os_atomic_add(&job->next, 1);
+        if (index >= job->count) break;
+        job->func(job->user_data, index);
+    }
+}
+
+void os_parallel_for(int32_t count, os_parallel_func func, void* user_data) {
+    if (count <= 0) return;
+
+    os_parallel_job job;
+    job.func = func;
+    job.user_data = user_data;
+    job.count = count;
+    job.next = 0;
+
+    int32_t threads_count = os_cpu_count();
+    if (threads_count > count) threads_count = count;
+    if (threads_count > MAXIMUM_PARALLEL_THREADS) threads_count = MAXIMUM_PARALLEL_THREADS;
+
+    //the calling thread is one of the workers
+    os_thread_handle threads[MAXIMUM_PARALLEL_THREADS];
+    for (int32_t i = 1; i < threads_count; ++i)
+        threads[i] = os_thread_create(os_parallel_worker, &job);
+
+    os_parallel_worker(&job);
+
+    for (int32_t i = 1; i < threads_count; ++i)
+        os_thread_join(threads[i]);
+}
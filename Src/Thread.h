@@ -0,0 +1,70 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_THREAD_H
+#define IBCWEB_THREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+typedef struct os_thread* os_thread_handle;
+typedef struct os_mutex* os_mutex_handle;
+typedef struct os_condition* os_condition_handle;
+
+typedef void(*os_thread_func)(void* user_data);
+typedef void(*os_parallel_func)(void* user_data, int32_t index);
+
+IBC_API int32_t os_cpu_count();
+
+/*
+ * Monotonic clock in seconds, for timing work outside of the frame loop.
+ */
+IBC_API double os_timer_seconds();
+
+/*
+ * Suspends the calling thread for about the given time, the scheduler may add a millisecond or so.
+ */
+IBC_API void os_sleep_seconds(double seconds);
+
+IBC_API os_thread_handle os_thread_create(os_thread_func func, void* user_data);
+IBC_API void os_thread_join(os_thread_handle handle);
+
+IBC_API os_mutex_handle os_mutex_create();
+IBC_API void os_mutex_lock(os_mutex_handle handle);
+IBC_API void os_mutex_unlock(os_mutex_handle handle);
+IBC_API void os_mutex_destroy(os_mutex_handle handle);
+
+/*
+ * Condition variable, wait releases the locked mutex while blocked and holds it again on return.
+ * Wakeups may be spurious, the waiter checks its condition in a loop.
+ */
+IBC_API os_condition_handle os_condition_create();
+IBC_API void os_condition_wait(os_condition_handle handle, os_mutex_handle mutex);
+IBC_API void os_condition_signal(os_condition_handle handle);
+IBC_API void os_condition_broadcast(os_condition_handle handle);
+IBC_API void os_condition_destroy(os_condition_handle handle);
+
+/*
+ * Sequentially consistent atomics on 32 bit integers.
+ * os_atomic_add returns the value before the addition.
+ */
+IBC_API int32_t os_atomic_add(volatile int32_t* value, int32_t amount);
+IBC_API int32_t os_atomic_load(volatile int32_t* value);
+IBC_API void os_atomic_store(volatile int32_t* value, int32_t new_value);
+IBC_API bool os_atomic_cas(volatile int32_t* value, int32_t expected, int32_t new_value);
+
+/*
+ * Calls func(user_data, i) for every i in [0, count) on all cores, the calling thread included.
+ * Indices are handed out one at a time so uneven work items balance themselves.
+ */
+IBC_API void os_parallel_for(int32_t count, os_parallel_func func, void* user_data);
+
+#endif //IBCWEB_THREAD_H
@@ -0,0 +1,657 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+#include "Urdf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Allocator.h"
+#include "Stl.h"
+#include "Thread.h"
+
+#define URDF_PATH_LENGTH 1024
+
+/*
+ * Minimal xml reader, enough for urdf.
+ * The document is parsed in place, names and values point into the buffer.
+ * Text content, cdata, comments and declarations are skipped.
+ */
+
+typedef struct urdf_xml_attr{
+    char* name;
+    char* value;
+} urdf_xml_attr;
+
+typedef struct urdf_xml_element{
+    char* name;
+    int32_t attrs_start;
+    int32_t attrs_count;
+    int32_t parent;
+    int32_t first_child;
+    int32_t last_child;
+    int32_t next_sibling;
+} urdf_xml_element;
+
+typedef struct urdf_xml{
+    char* buffer;
+    int32_t elements_count;
+    int32_t elements_capacity;
+    urdf_xml_element* elements;
+    int32_t attrs_count;
+    int32_t attrs_capacity;
+    urdf_xml_attr* attrs;
+} urdf_xml;
+
+static bool urdf_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static void urdf_xml_decode(char* str) {
+    static const char* entities[] = {"&lt;", "&gt;", "&amp;", "&quot;", "&apos;"};
+    static const char chars[] = {'<', '>', '&', '"', '\''};
+
+    char* out = str;
+    for (char* in = str; *in != '\0';) {
+        bool replaced = false;
+        if (*in == '&') {
+            for (int32_t i = 0; i < 5; ++i) {
+                size_t len = strlen(entities[i]);
+                if (strncmp(in, entities[i], len) == 0) {
+                    *out++ = chars[i];
+                    in += len;
+                    replaced = true;
+                    break;
+                }
+            }
+        }
+        if (!replaced) *out++ = *in++;
+    }
+    *out = '\0';
+}
+
+static int32_t urdf_xml_add_element(urdf_xml* xml, char* name, int32_t parent) {
+    if (xml->elements_count == xml->elements_capacity) {
+        xml->elements_capacity = xml->elements_capacity > 0 ? xml->elements_capacity * 2 : 64;
+        xml->elements = OS_REALLOC(xml->elements, sizeof(urdf_xml_element) * xml->elements_capacity);
+    }
+    int32_t index = xml->elements_count++;
+    urdf_xml_element* element = xml->elements + index;
+    element->name = name;
+    element->attrs_start = xml->attrs_count;
+    element->attrs_count = 0;
+    element->parent = parent;
+    element->first_child = element->last_child = element->next_sibling = -1;
+    if (parent != -1) {
+        urdf_xml_element* p = xml->elements + parent;
+        if (p->last_child != -1) xml->elements[p->last_child].next_sibling = index;
+        else p->first_child = index;
+        p->last_child = index;
+    }
+    return index;
+}
+
+static void urdf_xml_add_attr(urdf_xml* xml, int32_t element, char* name, char* value) {
+    if (xml->attrs_count == xml->attrs_capacity) {
+        xml->attrs_capacity = xml->attrs_capacity > 0 ? xml->attrs_capacity * 2 : 128;
+        xml->attrs = OS_REALLOC(xml->attrs, sizeof(urdf_xml_attr) * xml->attrs_capacity);
+    }
+    xml->attrs[xml->attrs_count].name = name;
+    xml->attrs[xml->attrs_count].value = value;
+    xml->attrs_count++;
+    xml->elements[element].attrs_count++;
+}
+
+static char* urdf_skip_past(char* p, const char* terminator) {
+    char* end = strstr(p, terminator);
+    return end != 0 ? end + strlen(terminator) : 0;
+}
+
+static bool urdf_xml_parse(urdf_xml* xml, char* p) {
+    int32_t current = -1;
+
+    while (p != 0 && *p != '\0') {
+        if (*p != '<') { p++; continue; }
+
+        if (strncmp(p, "<!--", 4) == 0) { p = urdf_skip_past(p + 4, "-->"); continue; }
+        if (strncmp(p, "<![CDATA[", 9) == 0) { p = urdf_skip_past(p + 9, "]]>"); continue; }
+        if (strncmp(p, "<?", 2) == 0) { p = urdf_skip_past(p + 2, "?>"); continue; }
+        if (strncmp(p, "<!", 2) == 0) { p = urdf_skip_past(p + 2, ">"); continue; }
+
+        if (p[1] == '/') {
+            if (current == -1) return false;
+            current = xml->elements[current].parent;
+            p = urdf_skip_past(p + 2, ">");
+            continue;
+        }
+
+        //element name
+        char* name = ++p;
+        while (*p != '\0' && !urdf_is_space(*p) && *p != '/' && *p != '>') p++;
+        if (*p == '\0' || p == name) return false;
+        char stop = *p;
+        *p++ = '\0';
+        int32_t element = urdf_xml_add_element(xml, name, current);
+
+        //attributes
+        bool closed = stop == '/';
+        bool open = stop == '>';
+        while (!closed && !open) {
+            while (urdf_is_space(*p)) p++;
+            if (*p == '\0') return false;
+            if (*p == '/') { closed = true; p++; break; }
+            if (*p == '>') { open = true; p++; break; }
+
+            char* attr_name = p;
+            while (*p != '\0' && *p != '=' && !urdf_is_space(*p)) p++;
+            char* attr_name_end = p;
+            while (urdf_is_space(*p)) p++;
+            if (*p != '=') return false;
+            p++;
+            while (urdf_is_space(*p)) p++;
+            char quote = *p;
+            if (quote != '"' && quote != '\'') return false;
+            char* value = ++p;
+            while (*p != '\0' && *p != quote) p++;
+            if (*p == '\0') return false;
+            *attr_name_end = '\0';
+            *p++ = '\0';
+            urdf_xml_decode(value);
+            urdf_xml_add_attr(xml, element, attr_name, value);
+        }
+
+        if (closed) {
+            while (*p != '\0' && *p != '>') p++;
+            if (*p == '>') p++;
+        } else {
+            current = element;
+        }
+    }
+    return p != 0;
+}
+
+static int32_t urdf_child(urdf_xml const* xml, int32_t element, const char* name) {
+    if (element == -1) return -1;
+    for (int32_t i = xml->elements[element].first_child; i != -1; i = xml->elements[i].next_sibling) {
+        if (strcmp(xml->elements[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int32_t urdf_next(urdf_xml const* xml, int32_t element, const char* name) {
+    for (int32_t i = xml->elements[element].next_sibling; i != -1; i = xml->elements[i].next_sibling) {
+        if (strcmp(xml->elements[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static const char* urdf_attr(urdf_xml const* xml, int32_t element, const char* name) {
+    if (element == -1) return 0;
+    urdf_xml_element const* e = xml->elements + element;
+    for (int32_t i = 0; i < e->attrs_count; ++i) {
+        if (strcmp(xml->attrs[e->attrs_start + i].name, name) == 0) return xml->attrs[e->attrs_start + i].value;
+    }
+    return 0;
+}
+
+static void urdf_parse_floats(const char* str, float* out, int32_t count) {
+    if (str == 0) return;
+    for (int32_t i = 0; i < count; ++i) {
+        char* end;
+        float value = strtof(str, &end);
+        if (end == str) break;
+        out[i] = value;
+        str = end;
+    }
+}
+
+/*
+ * Robot description.
+ */
+
+typedef struct urdf_material{
+    const char* name;
+    float color[4];
+} urdf_material;
+
+typedef struct urdf_mesh{
+    char path[URDF_PATH_LENGTH];
+    float scale[3];
+    int32_t material_id;
+    bool loaded;
+    mdl_primitive primitive;
+} urdf_mesh;
+
+typedef struct urdf_joint{
+    int32_t element;
+    int32_t parent_link;
+    int32_t child_link;
+} urdf_joint;
+
+typedef struct urdf_link{
+    int32_t element;
+    int32_t parent_joint;
+    bool visited;
+} urdf_link;
+
+typedef struct urdf_loader{
+    urdf_xml xml;
+    char dir[URDF_PATH_LENGTH];
+
+    int32_t links_count;
+    urdf_link* links;
+    int32_t joints_count;
+    urdf_joint* joints;
+
+    int32_t materials_count;
+    urdf_material* materials;
+    int32_t meshes_count;
+    urdf_mesh* meshes;
+
+    mdl_handle model;
+} urdf_loader;
+
+static char* urdf_strdup(const char* str) {
+    if (str == 0) return 0;
+    size_t len = strlen(str) + 1;
+    char* copy = OS_MALLOC(len);
+    os_memcpy(copy, str, len);
+    return copy;
+}
+
+static bool urdf_file_exists(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == 0) return false;
+    fclose(file);
+    return true;
+}
+
+static bool urdf_resolve_path(const char* dir, const char* filename, char* out) {
+    /*
+     * package://pkg/meshes/a.stl is resolved against the urdf directory and its parents,
+     * covering the usual pkg/urdf/robot.urdf + pkg/meshes layout without a ros workspace.
+     */
+    if (strncmp(filename, "file://", 7) == 0) {
+        snprintf(out, URDF_PATH_LENGTH, "%s", filename + 7);
+        return urdf_file_exists(out);
+    }
+
+    const char* rel = filename;
+    const char* in_package = filename;
+    if (strncmp(filename, "package://", 10) == 0) {
+        rel = filename + 10;
+        const char* sep = strchr(rel, '/');
+        in_package = sep != 0 ? sep + 1 : rel;
+    } else if (filename[0] == '/' || (filename[0] != '\0' && filename[1] == ':')) {
+        snprintf(out, URDF_PATH_LENGTH, "%s", filename);
+        return urdf_file_exists(out);
+    }
+
+    const char* formats[] = {"%s%s", "%s../%s", "%s../../%s"};
+    for (int32_t i = 0; i < 3; ++i) {
+        snprintf(out, URDF_PATH_LENGTH, formats[i], dir, in_package);
+        if (urdf_file_exists(out)) return true;
+        if (in_package != rel) {
+            snprintf(out, URDF_PATH_LENGTH, formats[i], dir, rel);
+            if (urdf_file_exists(out)) return true;
+        }
+    }
+    return false;
+}
+
+static int32_t urdf_find_link(urdf_loader const* loader, const char* name) {
+    if (name == 0) return -1;
+    for (int32_t i = 0; i < loader->links_count; ++i) {
+        if (strcmp(urdf_attr(&loader->xml, loader->links[i].element, "name"), name) == 0) return i;
+    }
+    return -1;
+}
+
+static int32_t urdf_find_material(urdf_loader const* loader, const char* name) {
+    if (name == 0) return -1;
+    for (int32_t i = 0; i < loader->materials_count; ++i) {
+        if (loader->materials[i].name != 0 && strcmp(loader->materials[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int32_t urdf_add_material(urdf_loader* loader, int32_t element) {
+    //named materials are shared, unnamed inline colors get their own entry
+    const char* name = urdf_attr(&loader->xml, element, "name");
+    if (name != 0 && name[0] == '\0') name = 0;
+    int32_t index = urdf_find_material(loader, name);
+    int32_t color = urdf_child(&loader->xml, element, "color");
+    if (index != -1 && color == -1) return index;
+    if (index == -1) {
+        if (name != 0 && color == -1) return 0;
+        index = loader->materials_count++;
+        loader->materials[index].name = name;
+        float grey[4] = {0.8f, 0.8f, 0.8f, 1.0f};
+        os_memcpy(loader->materials[index].color, grey, sizeof(grey));
+    }
+    urdf_parse_floats(urdf_attr(&loader->xml, color, "rgba"), loader->materials[index].color, 4);
+    return index;
+}
+
+static void urdf_rpy_to_quat(float const rpy[3], float q[4]) {
+    //fixed axis roll, pitch, yaw: R = Rz(yaw) * Ry(pitch) * Rx(roll)
+    float cr = cosf(rpy[0] * 0.5f), sr = sinf(rpy[0] * 0.5f);
+    float cp = cosf(rpy[1] * 0.5f), sp = sinf(rpy[1] * 0.5f);
+    float cy = cosf(rpy[2] * 0.5f), sy = sinf(rpy[2] * 0.5f);
+    q[0] = sr * cp * cy - cr * sp * sy;
+    q[1] = cr * sp * cy + sr * cp * sy;
+    q[2] = cr * cp * sy - sr * sp * cy;
+    q[3] = cr * cp * cy + sr * sp * sy;
+}
+
+static int32_t urdf_add_node(urdf_loader* loader, const char* name, int32_t parent, int32_t origin_element) {
+    mdl_handle model = loader->model;
+    int32_t index = model->nodes_count++;
+    mdl_node* node = model->nodes + index;
+    os_memset(node, 0, sizeof(mdl_node));
+    node->node_type = MDL_NODE_NODE;
+    node->name = urdf_strdup(name);
+    node->parent_id = parent;
+    node->mesh_index = node->camera_index = node->light_index = -1;
+    node->local_rot[3] = 1;
+    node->local_scale[0] = node->local_scale[1] = node->local_scale[2] = 1;
+
+    if (origin_element != -1) {
+        float rpy[3] = {0, 0, 0};
+        urdf_parse_floats(urdf_attr(&loader->xml, origin_element, "xyz"), node->local_pos, 3);
+        urdf_parse_floats(urdf_attr(&loader->xml, origin_element, "rpy"), rpy, 3);
+        urdf_rpy_to_quat(rpy, node->local_rot);
+    }
+    if (parent != -1) model->nodes[parent].children_count++;
+    return index;
+}
+
+static void urdf_add_visuals(urdf_loader* loader, int32_t link, int32_t link_node) {
+    urdf_xml const* xml = &loader->xml;
+    int32_t link_element = loader->links[link].element;
+    const char* link_name = urdf_attr(xml, link_element, "name");
+
+    int32_t visual_index = 0;
+    for (int32_t visual = urdf_child(xml, link_element, "visual"); visual != -1; visual = urdf_next(xml, visual, "visual"), ++visual_index) {
+        int32_t mesh_element = urdf_child(xml, urdf_child(xml, visual, "geometry"), "mesh");
+        const char* filename = urdf_attr(xml, mesh_element, "filename");
+        if (filename == 0) {
+            printf("- - Link %s: only mesh visual geometry is supported, visual skipped\n", link_name);
+            continue;
+        }
+
+        urdf_mesh candidate;
+        os_memset(&candidate, 0, sizeof(urdf_mesh));
+        candidate.scale[0] = candidate.scale[1] = candidate.scale[2] = 1;
+        urdf_parse_floats(urdf_attr(xml, mesh_element, "scale"), candidate.scale, 3);
+        int32_t material = urdf_child(xml, visual, "material");
+        candidate.material_id = material != -1 ? urdf_add_material(loader, material) : 0;
+
+        size_t len = strlen(filename);
+        if (len < 4 || (strcmp(filename + len - 4, ".stl") != 0 && strcmp(filename + len - 4, ".STL") != 0)) {
+            printf("- - Link %s: mesh %s is not stl, visual skipped\n", link_name, filename);
+            continue;
+        }
+        if (!urdf_resolve_path(loader->dir, filename, candidate.path)) {
+            fprintf(stderr, "- - Link %s: mesh %s could not be found\n", link_name, filename);
+            continue;
+        }
+
+        //identical file, scale and material share one mesh
+        int32_t mesh_index = -1;
+        for (int32_t i = 0; i < loader->meshes_count; ++i) {
+            urdf_mesh const* mesh = loader->meshes + i;
+            if (mesh->material_id == candidate.material_id && memcmp(mesh->scale, candidate.scale, sizeof(candidate.scale)) == 0 &&
+                strcmp(mesh->path, candidate.path) == 0) {
+                mesh_index = i;
+                break;
+            }
+        }
+        if (mesh_index == -1) {
+            mesh_index = loader->meshes_count++;
+            loader->meshes[mesh_index] = candidate;
+        }
+
+        char name[256];
+        const char* visual_name = urdf_attr(xml, visual, "name");
+        if (visual_name != 0) snprintf(name, sizeof(name), "%s", visual_name);
+        else if (visual_index == 0) snprintf(name, sizeof(name), "%s_visual", link_name);
+        else snprintf(name, sizeof(name), "%s_visual_%i", link_name, visual_index);
+
+        int32_t node = urdf_add_node(loader, name, link_node, urdf_child(xml, visual, "origin"));
+        loader->model->nodes[node].node_type = MDL_NODE_MESH;
+        loader->model->nodes[node].mesh_index = mesh_index;
+    }
+}
+
+static void urdf_add_link(urdf_loader* loader, int32_t link, int32_t parent_node) {
+    urdf_xml const* xml = &loader->xml;
+    if (loader->links[link].visited) return;
+    loader->links[link].visited = true;
+
+    int32_t link_node = urdf_add_node(loader, urdf_attr(xml, loader->links[link].element, "name"), parent_node, -1);
+    urdf_add_visuals(loader, link, link_node);
+
+    for (int32_t i = 0; i < loader->joints_count; ++i) {
+        urdf_joint const* joint = loader->joints + i;
+        if (joint->parent_link != link || joint->child_link == -1) continue;
+        if (loader->links[joint->child_link].visited) {
+            fprintf(stderr, "- Joint %s closes a kinematic loop, skipped\n", urdf_attr(xml, joint->element, "name"));
+            continue;
+        }
+
+        int32_t element = joint->element;
+        int32_t joint_node = urdf_add_node(loader, urdf_attr(xml, element, "name"), link_node, urdf_child(xml, element, "origin"));
+        int32_t child_node = loader->model->nodes_count;
+        urdf_add_link(loader, joint->child_link, joint_node);
+
+        mdl_joint* m_joint = loader->model->joints + loader->model->joints_count++;
+        os_memset(m_joint, 0, sizeof(mdl_joint));
+        m_joint->name = urdf_strdup(urdf_attr(xml, element, "name"));
+        m_joint->node_index = joint_node;
+        m_joint->child_node_index = child_node;
+        m_joint->axis[0] = 1;
+        urdf_parse_floats(urdf_attr(xml, urdf_child(xml, element, "axis"), "xyz"), m_joint->axis, 3);
+        int32_t limit = urdf_child(xml, element, "limit");
+        urdf_parse_floats(urdf_attr(xml, limit, "lower"), &m_joint->lower, 1);
+        urdf_parse_floats(urdf_attr(xml, limit, "upper"), &m_joint->upper, 1);
+
+        const char* type = urdf_attr(xml, element, "type");
+        m_joint->joint_type = MDL_JOINT_FIXED;
+        if (type == 0) {}
+        else if (strcmp(type, "revolute") == 0) m_joint->joint_type = MDL_JOINT_REVOLUTE;
+        else if (strcmp(type, "continuous") == 0) m_joint->joint_type = MDL_JOINT_CONTINUOUS;
+        else if (strcmp(type, "prismatic") == 0) m_joint->joint_type = MDL_JOINT_PRISMATIC;
+        else if (strcmp(type, "floating") == 0) m_joint->joint_type = MDL_JOINT_FLOATING;
+        else if (strcmp(type, "planar") == 0) m_joint->joint_type = MDL_JOINT_PLANAR;
+    }
+}
+
+static void urdf_load_mesh_job(void* user_data, int32_t index) {
+    urdf_loader* loader = user_data;
+    urdf_mesh* mesh = loader->meshes + index;
+    mesh->loaded = stl_load_primitive(mesh->path, mesh->scale, &mesh->primitive);
+}
+
+static void urdf_loader_free(urdf_loader* loader) {
+    OS_FREE(loader->xml.buffer);
+    OS_FREE(loader->xml.elements);
+    OS_FREE(loader->xml.attrs);
+    OS_FREE(loader->links);
+    OS_FREE(loader->joints);
+    OS_FREE(loader->materials);
+    OS_FREE(loader->meshes);
+}
+
+mdl_handle urdf_load(const char* path) {
+    printf("Loading model %s\n", path != 0 ? path : "<null>");
+
+    urdf_loader loader;
+    os_memset(&loader, 0, sizeof(urdf_loader));
+
+    uint64_t size = 0;
+    void* file = path != 0 ? os_file_map(path, &size) : 0;
+    if (file == 0) {
+        fprintf(stderr, "- Urdf file could not be opened\n");
+        return 0;
+    }
+    loader.xml.buffer = OS_MALLOC((uint32_t)size + 1);
+    os_memcpy(loader.xml.buffer, file, (int32_t)size);
+    loader.xml.buffer[size] = '\0';
+    os_file_unmap(file, size);
+
+    const char* last_sep = strrchr(path, '/');
+    const char* last_bsep = strrchr(path, '\\');
+    const char* last = last_sep > last_bsep ? last_sep : last_bsep;
+    if (last != 0 && (size_t)(last - path + 1) < sizeof(loader.dir))
+        os_memcpy(loader.dir, path, (int32_t)(last - path + 1));
+
+    if (!urdf_xml_parse(&loader.xml, loader.xml.buffer) || loader.xml.elements_count == 0) {
+        fprintf(stderr, "- Urdf xml is malformed\n");
+        urdf_loader_free(&loader);
+        return 0;
+    }
+
+    urdf_xml const* xml = &loader.xml;
+    int32_t robot = 0;
+    if (strcmp(xml->elements[robot].name, "robot") != 0) {
+        fprintf(stderr, "- Urdf root element is not robot\n");
+        urdf_loader_free(&loader);
+        return 0;
+    }
+
+    /*
+     * Links, joints and materials.
+     */
+    int32_t visuals_count = 0, materials_count = 0;
+    for (int32_t i = xml->elements[robot].first_child; i != -1; i = xml->elements[i].next_sibling) {
+        const char* name = xml->elements[i].name;
+        if (strcmp(name, "link") == 0) {
+            loader.links_count++;
+            for (int32_t v = urdf_child(xml, i, "visual"); v != -1; v = urdf_next(xml, v, "visual")) visuals_count++;
+        }
+        else if (strcmp(name, "joint") == 0) loader.joints_count++;
+        else if (strcmp(name, "material") == 0) materials_count++;
+    }
+
+    loader.links = OS_MALLOC(sizeof(urdf_link) * (loader.links_count + 1));
+    loader.joints = OS_MALLOC(sizeof(urdf_joint) * (loader.joints_count + 1));
+    loader.materials = OS_MALLOC(sizeof(urdf_material) * (1 + materials_count + visuals_count));
+    loader.meshes = OS_MALLOC(sizeof(urdf_mesh) * (visuals_count + 1));
+
+    //material 0 is the default for visuals without one
+    loader.materials_count = 1;
+    loader.materials[0].name = 0;
+    loader.materials[0].color[0] = loader.materials[0].color[1] = loader.materials[0].color[2] = 0.8f;
+    loader.materials[0].color[3] = 1.0f;
+
+    int32_t links_count = 0, joints_count = 0;
+    for (int32_t i = xml->elements[robot].first_child; i != -1; i = xml->elements[i].next_sibling) {
+        const char* name = xml->elements[i].name;
+        if (strcmp(name, "link") == 0 && urdf_attr(xml, i, "name") != 0) {
+            loader.links[links_count].element = i;
+            loader.links[links_count].parent_joint = -1;
+            loader.links[links_count].visited = false;
+            links_count++;
+        } else if (strcmp(name, "joint") == 0) {
+            loader.joints[joints_count++].element = i;
+        } else if (strcmp(name, "material") == 0) {
+            urdf_add_material(&loader, i);
+        }
+    }
+    loader.links_count = links_count;
+    loader.joints_count = joints_count;
+
+    for (int32_t i = 0; i < loader.joints_count; ++i) {
+        urdf_joint* joint = loader.joints + i;
+        joint->parent_link = urdf_find_link(&loader, urdf_attr(xml, urdf_child(xml, joint->element, "parent"), "link"));
+        joint->child_link = urdf_find_link(&loader, urdf_attr(xml, urdf_child(xml, joint->element, "child"), "link"));
+        if (joint->parent_link == -1 || joint->child_link == -1) {
+            fprintf(stderr, "- Joint %s references an unknown link\n", urdf_attr(xml, joint->element, "name"));
+            joint->child_link = -1;
+            continue;
+        }
+        loader.links[joint->child_link].parent_joint = i;
+    }
+
+    /*
+     * Node hierarchy.
+     */
+    mdl_handle handle = OS_MALLOC(sizeof(mdl_data));
+    os_memset(handle, 0, sizeof(mdl_data));
+    loader.model = handle;
+
+    int32_t max_nodes = 1 + loader.links_count + loader.joints_count + visuals_count;
+    handle->nodes = OS_MALLOC(sizeof(mdl_node) * max_nodes);
+    handle->joints = OS_MALLOC(sizeof(mdl_joint) * (loader.joints_count + 1));
+
+    const char* robot_name = urdf_attr(xml, robot, "name");
+    int32_t root = urdf_add_node(&loader, robot_name != 0 ? robot_name : "robot", -1, -1);
+    //urdf is z up, the viewer is y up
+    handle->nodes[root].local_rot[0] = -0.70710678f;
+    handle->nodes[root].local_rot[3] = 0.70710678f;
+
+    for (int32_t i = 0; i < loader.links_count; ++i) {
+        if (loader.links[i].parent_joint == -1)
+            urdf_add_link(&loader, i, root);
+    }
+
+    //children lists, parent_id was set while adding
+    for (int32_t i = 0; i < handle->nodes_count; ++i) {
+        mdl_node* node = handle->nodes + i;
+        node->children_id = node->children_count > 0 ? OS_MALLOC(sizeof(int32_t) * node->children_count) : 0;
+        node->children_count = 0;
+    }
+    for (int32_t i = 0; i < handle->nodes_count; ++i) {
+        mdl_node* node = handle->nodes + i;
+        if (node->parent_id != -1) {
+            mdl_node* parent = handle->nodes + node->parent_id;
+            parent->children_id[parent->children_count++] = i;
+        }
+    }
+
+    /*
+     * Meshes, parsed in parallel.
+     */
+    os_parallel_for(loader.meshes_count, urdf_load_mesh_job, &loader);
+
+    handle->meshes_count = loader.meshes_count;
+    handle->meshes = OS_MALLOC(sizeof(mdl_mesh) * (loader.meshes_count + 1));
+    for (int32_t i = 0; i < loader.meshes_count; ++i) {
+        urdf_mesh* mesh = loader.meshes + i;
+        mdl_mesh* m_mesh = handle->meshes + i;
+        const char* file_name = strrchr(mesh->path, '/');
+        m_mesh->name = urdf_strdup(file_name != 0 ? file_name + 1 : mesh->path);
+        m_mesh->primitives_count = mesh->loaded ? 1 : 0;
+        m_mesh->primitives = 0;
+        if (mesh->loaded) {
+            m_mesh->primitives = OS_MALLOC(sizeof(mdl_primitive));
+            mesh->primitive.material_id = mesh->material_id;
+            m_mesh->primitives[0] = mesh->primitive;
+        }
+    }
+
+    handle->materials_count = loader.materials_count;
+    handle->materials = OS_MALLOC(sizeof(mdl_material) * loader.materials_count);
+    os_memset(handle->materials, 0, sizeof(mdl_material) * loader.materials_count);
+    for (int32_t i = 0; i < loader.materials_count; ++i) {
+        mdl_material* mat = handle->materials + i;
+        mat->name = urdf_strdup(loader.materials[i].name);
+        mat->valid = true;
+        mat->color_texture_id = -1;
+        os_memcpy(mat->color_factor, loader.materials[i].color, sizeof(float) * 4);
+        mat->metallic_factor = 0.0f;
+        mat->roughness_factor = 0.6f;
+    }
+
+    printf("- Urdf %s: %i links, %i joints, %i meshes from %i visuals\n",
+           robot_name != 0 ? robot_name : "robot", loader.links_count, handle->joints_count, handle->meshes_count, visuals_count);
+
+    urdf_loader_free(&loader);
+    return handle;
+}
@@ -0,0 +1,28 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+
+#ifndef IBCWEB_URDF_H
+#define IBCWEB_URDF_H
+
+#include "Model.h"
+
+#ifndef IBC_API
+#define IBC_API extern
+#endif
+
+/*
+ * Loads an urdf robot description with binary stl link meshes into model data.
+ *
+ * Node hierarchy: robot root (z up to y up) -> root link -> joint (origin) -> child link -> ...
+ * Every link visual gets its own mesh node. Links carry an identity transform so a joint
+ * is posed through the local trs of its child link, the joints array describes the axes and limits.
+ * Stl files are parsed in parallel and a mesh file referenced with the same scale and
+ * material is loaded once and shared. Only stl visual geometry is supported.
+ */
+IBC_API mdl_handle urdf_load(const char* path);
+
+#endif //IBCWEB_URDF_H
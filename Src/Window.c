@@ -25,15 +25,21 @@
 #define CIMGUI_DEFINE_ENUMS_AND_STRUCTS
 #include "cimgui.h"
 #include "Allocator.h"
+#include "AssetCache.h"
 #include "Scene.h"
 #include "Model.h"
 #include "SceneView.h"
 #include "GlMath.h"
 #include "ManipulatorDemo.h"
+#include "Simulation.h"
 
 #define MAXIMUM_WINDOW_LOGS 1024
 #define MAXIMUM_SKYBOX_OPTIONS 32
 #define DEFAULT_SKYBOX_PATH "./Data/Default.hdr"
+#define DEFAULT_MODEL_PATH "./Data/Manipulator.gltf"
+//written by ibc-bake --chunks, the geometry is streamed when both are there
+#define DEFAULT_BAKED_MODEL_PATH "./Data/Manipulator.ibca"
+#define DEFAULT_CHUNKS_PATH "./Data/Manipulator.ibcc"
 
 typedef struct window_log_data{
     char* log;
@@ -273,6 +279,12 @@ static void window_view_options(void)
     bool wireframe = scene_view_get_wireframe(views[0]);
     if (igCheckbox("Zicani prikaz", &wireframe))
         scene_view_set_wireframe(views[0], wireframe);
+
+    float anisotropy = scene_get_texture_anisotropy(active_scene);
+    if (igSliderFloat("Anizotropija", &anisotropy, 1.0f, 16.0f, "%.0fx", 0)) {
+        scene_set_texture_anisotropy(active_scene, anisotropy);
+        scene_view_flag_dirty(views[0]);
+    }
 }
 
 static void window_scene_view_overlay(void);
@@ -280,6 +292,14 @@ static void window_object_inspector(void);
 static void window_material_inspector(void);
 
 static manipulator_demo demo;
+//steps the demo off the frame loop, 0 when the model has no manipulator
+static simulation_handle simulation;
+
+static void window_simulation_step(void* user_data, float dt, float* local_trs) {
+    manipulator_demo* simulated = user_data;
+    manipulator_demo_update(simulated, dt);
+    manipulator_demo_get_local_trs(simulated, local_trs);
+}
 
 void window_scene_view_draw(){
     int32_t ww, wh;
@@ -327,6 +347,22 @@ void window_scene_view_draw(){
                 (ImVec4){1, 1, 1, 1}, (ImVec4){0, 0, 0, 0}
             );
 
+            /* Left click picks the node under the cursor, empty space deselects. */
+            if (igIsItemClicked(0)) {
+                ImVec2 mouse, image_min;
+                igGetMousePos(&mouse);
+                igGetItemRectMin(&image_min);
+                float origin[3], direction[3];
+                scene_view_get_ray(views[0], mouse.x - image_min.x, mouse.y - image_min.y, origin, direction);
+
+                scene_ray_hit hit;
+                selected_node_valid = scene_raycast(active_scene, origin, direction, 1e30f, &hit);
+                if (selected_node_valid)
+                    selected_node = hit.node;
+                scene_set_selected_node(active_scene, selected_node_valid ? &selected_node : NULL);
+                scene_view_flag_dirty(views[0]);
+            }
+
             window_scene_view_overlay();
         }
         igEnd();
@@ -370,7 +406,11 @@ void window_scene_view_draw(){
             /* ---- Manipulator controls ---- */
             igTextDisabled("MANIPULATOR");
             igSpacing();
-            manipulator_demo_draw_ui(&demo);
+            if (simulation != 0) {
+                simulation_lock(simulation);
+                manipulator_demo_draw_ui(&demo);
+                simulation_unlock(simulation);
+            }
             igSeparator();
 
             /* ---- Object inspector ---- */
@@ -389,6 +429,54 @@ void window_scene_view_draw(){
             igTextDisabled("STATISTIKA");
             {
                 igText("FPS: %.0f", frame_dt > 0.00001f ? 1.0f / frame_dt : 0.0f);
+                igText("Teksture: %.1f MB (ukupno GPU %.1f MB)",
+                       scene_texture_bytes(active_scene) / (1024.0 * 1024.0),
+                       gfx_texture_total_bytes() / (1024.0 * 1024.0));
+                scene_texture_streaming streaming;
+                scene_texture_streaming_stats(active_scene, &streaming);
+                igText("Strimovanje: %i/%i mip, budzet %.0f MB, %i izbacivanja",
+                       streaming.resident_levels, streaming.total_levels,
+                       streaming.budget_bytes / (1024.0 * 1024.0), streaming.evictions);
+                igText("Sejder programi: %i", gfx_shader_cache_count());
+                asset_cache_stats cache_stats;
+                asset_cache_get_stats(&cache_stats);
+                igText("Deljeni resursi: %i (%i referenci), %.1f MB, ponovo korisceno %.1f MB",
+                       cache_stats.entries_count, cache_stats.references_count,
+                       cache_stats.bytes / (1024.0 * 1024.0), cache_stats.shared_bytes / (1024.0 * 1024.0));
+                scene_draw_stats draw_stats;
+                scene_get_draw_stats(active_scene, &draw_stats);
+                igText("Iscrtano: %i, odbaceno: %i (senke %i/%i)", draw_stats.drawn, draw_stats.culled,
+                       draw_stats.shadow_drawn, draw_stats.shadow_culled);
+                igText("Pozivi crtanja: %i (senke %i)", draw_stats.draw_calls, draw_stats.shadow_draw_calls);
+                int32_t static_batches, static_nodes;
+                scene_static_stats(active_scene, &static_batches, &static_nodes);
+                igText("Staticki paketi: %i (cvorova %i)", static_batches, static_nodes);
+                scene_chunk_streaming chunks;
+                scene_chunk_streaming_stats(active_scene, &chunks);
+                if (chunks.chunks_count > 0)
+                    igText("Delovi scene: %i/%i (%i u toku), %.0f/%.0f MB, %i izbacivanja",
+                           chunks.resident_count, chunks.chunks_count, chunks.pending_count,
+                           chunks.resident_bytes / (1024.0 * 1024.0), chunks.budget_bytes / (1024.0 * 1024.0),
+                           chunks.evictions);
+                igText("Promene geometrije: %i (senke %i)", draw_stats.pipeline_binds, draw_stats.shadow_pipeline_binds);
+                int32_t materials_count = 0, unique_materials_count = 0;
+                scene_material_count(active_scene, &materials_count, &unique_materials_count);
+                igText("Materijali: %i (jedinstvenih %i)", materials_count, unique_materials_count);
+
+                int32_t textures_count = 0;
+                scene_texture_count(active_scene, &textures_count);
+                if (textures_count > 0 && igTreeNodeEx_Str("Teksture modela", 0)) {
+                    for (int32_t i = 0; i < textures_count; ++i) {
+                        scene_texture texture;
+                        scene_texture_get_at(active_scene, i, &texture);
+                        if (texture.resident)
+                            igText("%i: %ix%i, %i mip, %.1f KB", i, texture.width, texture.height,
+                                   texture.levels, texture.bytes / 1024.0);
+                        else
+                            igTextDisabled("%i: nije ucitana", i);
+                    }
+                    igTreePop();
+                }
             }
             igSeparator();
         }
@@ -516,6 +604,13 @@ void window_log(){
 }
 
 
+static bool window_file_exists(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == 0) return false;
+    fclose(file);
+    return true;
+}
+
 void window_init(struct window_config const* config) {
     device_init(3, 3);
     device = device_new(config->title, config->width, config->height, config->vsync, config->fullscreen,
@@ -527,19 +622,30 @@ void window_init(struct window_config const* config) {
     gfx_log_callback_set(window_on_gfx_log);
     window_skybox_options_refresh();
 
-    model = mdl_load("./Data/Manipulator.gltf");
+    bool streamed = window_file_exists(DEFAULT_BAKED_MODEL_PATH) && window_file_exists(DEFAULT_CHUNKS_PATH);
+    model = mdl_load(streamed ? DEFAULT_BAKED_MODEL_PATH : DEFAULT_MODEL_PATH);
     scene_desc desc = {
             .skybox = {
                     .path = DEFAULT_SKYBOX_PATH,
                     .render = true,
             },
             .model = model,
+            .bake_static = true,
+            .dynamic_nodes = manipulator_demo_node_names,
+            .dynamic_nodes_count = MANIPULATOR_NODE_COUNT,
+            .consume_geometry = true,
+            .chunks_path = streamed ? DEFAULT_CHUNKS_PATH : 0,
     };
 
     active_scene = scene_new(&desc);
     mdl_unload(model);
 
-    manipulator_demo_init(&demo, active_scene);
+    simulation = 0;
+    if (manipulator_demo_init(&demo, active_scene)) {
+        float local_trs[MANIPULATOR_NODE_COUNT * 16];
+        manipulator_demo_get_local_trs(&demo, local_trs);
+        simulation = simulation_create(MANIPULATOR_NODE_COUNT, SIMULATION_DEFAULT_RATE, window_simulation_step, &demo, local_trs);
+    }
     scene_shadow_pass(active_scene);
 
     window_scene_view_create();
@@ -560,11 +666,21 @@ void window_run() {
         gui_begin_frame();
 
         frame_dt = (float)device_dt_get();
-        bool scene_changed = manipulator_demo_update(&demo, frame_dt);
-        if (scene_changed) {
+        scene_begin_changes(active_scene);
+        float local_trs[MANIPULATOR_NODE_COUNT * 16];
+        if (simulation != 0 && simulation_read(simulation, local_trs))
+            manipulator_demo_apply(&demo, local_trs);
+        scene_end_changes(active_scene);
+
+        scene_changes changes;
+        scene_get_changes(active_scene, &changes);
+        if (changes.flags & SCENE_CHANGE_SHADOWS)
             scene_shadow_pass(active_scene);
+        if (changes.flags != 0)
+            window_scene_views_mark_as_dirty();
+        scene_clear_changes(active_scene);
+        if (scene_update_streaming(active_scene))
             window_scene_views_mark_as_dirty();
-        }
 
         window_scene_view_draw();
 
@@ -583,6 +699,8 @@ void window_run() {
 }
 
 void window_finalize(){
+    if (simulation != 0)
+        simulation_destroy(simulation);
     scene_view_destroy(views[0]);
     scene_delete(active_scene);
     gui_finalize();
@@ -0,0 +1,365 @@
+/*
+ *  Copyright (C) 2021-2022 by Dragutin Sredojevic
+ *  https://www.nitugard.com
+ *  All Rights Reserved.
+ */
+
+/*
+ * ibc-bake, offline asset baker.
+ *
+ * Loads gltf/urdf/stl models with the regular loader and writes .ibca assets that the viewer maps
+ * without any import work: lods, vertex cache and fetch ordering, quantized attributes, bc textures.
+ * Several inputs are baked in parallel, a single input spreads its primitives over the cores instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Allocator.h"
+#include "Asset.h"
+#include "ChunkCache.h"
+#include "MeshOptimize.h"
+#include "Model.h"
+#include "TextureCompress.h"
+#include "Thread.h"
+
+#define BAKE_DEFAULT_LODS 3
+#define BAKE_LOD_REDUCTION 0.6f
+#define BAKE_MAXIMUM_PATH_LENGTH 1024
+
+typedef enum bake_stage{
+    BAKE_STAGE_LOAD,
+    BAKE_STAGE_LODS,
+    BAKE_STAGE_CACHE,
+    BAKE_STAGE_QUANTIZE,
+    BAKE_STAGE_TEXTURES,
+    BAKE_STAGE_WRITE,
+    BAKE_STAGE_COUNT
+} bake_stage;
+
+static const char* bake_stage_names[BAKE_STAGE_COUNT] = { "load", "lods", "cache", "quantize", "textures", "write" };
+
+typedef enum bake_texture_mode{
+    BAKE_TEXTURE_AUTO,
+    BAKE_TEXTURE_RGBA,
+    BAKE_TEXTURE_BC1,
+    BAKE_TEXTURE_BC3,
+    BAKE_TEXTURE_BC7
+} bake_texture_mode;
+
+typedef struct bake_options{
+    const char* output_dir;
+    int32_t lods;
+    bool optimize;
+    bool quantize;
+    bake_texture_mode textures;
+    bool mips;
+    bool chunks;
+    int64_t chunk_bytes;
+} bake_options;
+
+typedef struct bake_job{
+    const char* input;
+    char output[BAKE_MAXIMUM_PATH_LENGTH];
+    bool ok;
+
+    double stage_seconds[BAKE_STAGE_COUNT];
+    uint64_t input_bytes;
+    uint64_t source_vertex_bytes;
+    uint64_t source_texture_bytes;
+    int64_t triangles;
+    int64_t lod_triangles;
+    int32_t lods;
+    asset_write_stats stats;
+    char chunks_output[BAKE_MAXIMUM_PATH_LENGTH];
+    chunk_cache_write_stats chunk_stats;
+} bake_job;
+
+typedef struct bake_context{
+    bake_options const* options;
+    bake_job* jobs;
+    int32_t jobs_count;
+} bake_context;
+
+typedef struct bake_primitive_work{
+    bake_options const* options;
+    mdl_primitive** primitives;
+    bake_stage stage;
+} bake_primitive_work;
+
+static uint64_t bake_file_size(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == 0) return 0;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size > 0 ? (uint64_t)size : 0;
+}
+
+static void bake_output_path(const char* input, const char* output_dir, char* output, size_t output_size)
+{
+    const char* last_sep = strrchr(input, '/');
+    const char* last_bsep = strrchr(input, '\\');
+    const char* name = last_sep > last_bsep ? last_sep : last_bsep;
+    name = name != 0 ? name + 1 : input;
+
+    const char* dot = strrchr(name, '.');
+    int32_t stem = dot != 0 ? (int32_t)(dot - name) : (int32_t)strlen(name);
+
+    if (output_dir != 0)
+        snprintf(output, output_size, "%s/%.*s.ibca", output_dir, stem, name);
+    else
+        snprintf(output, output_size, "%.*s%.*s.ibca", (int32_t)(name - input), input, stem, name);
+}
+
+static void bake_primitive_stage(void* user_data, int32_t index)
+{
+    bake_primitive_work* work = user_data;
+    mdl_primitive* primitive = work->primitives[index];
+
+    switch (work->stage) {
+        case BAKE_STAGE_LODS:
+            mdl_optimize_lods(primitive, work->options->lods, BAKE_LOD_REDUCTION);
+            break;
+        case BAKE_STAGE_CACHE:
+            mdl_optimize_primitive_cache(primitive);
+            mdl_optimize_vertex_fetch(primitive);
+            break;
+        case BAKE_STAGE_QUANTIZE:
+            mdl_optimize_quantize(primitive);
+            break;
+        default:
+            break;
+    }
+}
+
+//baked assets are mapped read only, the optimizers free and grow the buffers they edit
+static bool bake_is_asset(const char* path)
+{
+    size_t length = strlen(path);
+    return length >= 5 && strcmp(path + length - 5, ".ibca") == 0;
+}
+
+static void bake_file(bake_job* job, bake_options const* options, bool parallel)
+{
+    if (bake_is_asset(job->input)) {
+        fprintf(stderr, "- Bake failed, input is already baked, bake its source model: %s\n", job->input);
+        return;
+    }
+
+    double start = os_timer_seconds();
+    job->input_bytes = bake_file_size(job->input);
+    mdl_handle model = mdl_load(job->input);
+    job->stage_seconds[BAKE_STAGE_LOAD] = os_timer_seconds() - start;
+    if (model == 0) {
+        fprintf(stderr, "- Bake failed, model could not be loaded: %s\n", job->input);
+        return;
+    }
+
+    int32_t primitives_count = 0;
+    for (int32_t i = 0; i < model->meshes_count; ++i)
+        primitives_count += (int32_t)model->meshes[i].primitives_count;
+
+    mdl_primitive** primitives = OS_MALLOC(sizeof(mdl_primitive*) * primitives_count + 1);
+    primitives_count = 0;
+    for (int32_t i = 0; i < model->meshes_count; ++i) {
+        for (uint32_t j = 0; j < model->meshes[i].primitives_count; ++j) {
+            mdl_primitive* primitive = model->meshes[i].primitives + j;
+            primitives[primitives_count++] = primitive;
+            job->source_vertex_bytes += (uint64_t)primitive->vertex_stride * primitive->vertices_count;
+            if (primitive->primitive_type == MDL_PRIMITIVE_TYPE_TRIANGLES)
+                job->triangles += primitive->indices_count / 3;
+        }
+    }
+
+    bake_primitive_work work = { options, primitives, BAKE_STAGE_LODS };
+    for (int32_t stage = BAKE_STAGE_LODS; stage < BAKE_STAGE_WRITE; ++stage) {
+        if (stage == BAKE_STAGE_LODS && (!options->optimize || options->lods <= 0)) continue;
+        if (stage == BAKE_STAGE_CACHE && !options->optimize) continue;
+        if (stage == BAKE_STAGE_QUANTIZE && !options->quantize) continue;
+
+        start = os_timer_seconds();
+        work.stage = (bake_stage)stage;
+        if (parallel) {
+            os_parallel_for(primitives_count, bake_primitive_stage, &work);
+        } else {
+            for (int32_t i = 0; i < primitives_count; ++i)
+                bake_primitive_stage(&work, i);
+        }
+        job->stage_seconds[stage] = os_timer_seconds() - start;
+    }
+
+    for (int32_t i = 0; i < primitives_count; ++i) {
+        job->lods += primitives[i]->lods_count;
+        for (int32_t k = 0; k < primitives[i]->lods_count; ++k)
+            job->lod_triangles += primitives[i]->lods[k].index_count / 3;
+    }
+    OS_FREE(primitives);
+
+    //textures, mip chains are built before compression, already compressed ones (ktx2) are kept as they are
+    start = os_timer_seconds();
+    for (int32_t i = 0; i < model->textures_count; ++i) {
+        mdl_texture* texture = model->textures + i;
+        if (!texture->valid) continue;
+        job->source_texture_bytes += (uint64_t)texture->size;
+        if (options->mips)
+            texture_generate_mips(texture, parallel);
+        if (options->textures == BAKE_TEXTURE_RGBA) continue;
+
+        mdl_texture_format format = options->textures == BAKE_TEXTURE_BC1 ? MDL_TEXTURE_FORMAT_BC1 :
+                                    options->textures == BAKE_TEXTURE_BC3 ? MDL_TEXTURE_FORMAT_BC3 :
+                                    options->textures == BAKE_TEXTURE_BC7 ? MDL_TEXTURE_FORMAT_BC7 :
+                                    texture_has_alpha(texture) ? MDL_TEXTURE_FORMAT_BC7 : MDL_TEXTURE_FORMAT_BC1;
+        texture_compress_texture(texture, format, parallel);
+    }
+    job->stage_seconds[BAKE_STAGE_TEXTURES] = os_timer_seconds() - start;
+
+    start = os_timer_seconds();
+    job->ok = asset_write(model, job->output, &job->stats);
+    if (job->ok && options->chunks) {
+        //same stem as the asset, the viewer pairs them by name
+        int32_t length = (int32_t)strlen(job->output);
+        snprintf(job->chunks_output, sizeof(job->chunks_output), "%.*s.ibcc", length - 5, job->output);
+        job->ok = chunk_cache_write(model, job->chunks_output, options->chunk_bytes, &job->chunk_stats);
+    }
+    job->stage_seconds[BAKE_STAGE_WRITE] = os_timer_seconds() - start;
+
+    mdl_unload(model);
+}
+
+static void bake_file_task(void* user_data, int32_t index)
+{
+    bake_context* context = user_data;
+    bake_file(context->jobs + index, context->options, false);
+}
+
+static void bake_report(bake_job const* job)
+{
+    printf("- %s -> %s%s\n", job->input, job->output, job->ok ? "" : " (failed)");
+    if (!job->ok) return;
+
+    printf("- - ");
+    for (int32_t i = 0; i < BAKE_STAGE_COUNT; ++i)
+        printf("%s %.1f ms%s", bake_stage_names[i], job->stage_seconds[i] * 1000.0, i + 1 < BAKE_STAGE_COUNT ? ", " : "\n");
+    printf("- - triangles %lld, lods %i with %lld triangles\n",
+           (long long)job->triangles, job->lods, (long long)job->lod_triangles);
+    printf("- - vertices %.1f KB -> %.1f KB, indices %.1f KB + %.1f KB lods, textures %.1f KB -> %.1f KB\n",
+           job->source_vertex_bytes / 1024.0, job->stats.vertex_bytes / 1024.0,
+           job->stats.index_bytes / 1024.0, job->stats.lod_index_bytes / 1024.0,
+           job->source_texture_bytes / 1024.0, job->stats.texture_bytes / 1024.0);
+    printf("- - file %.1f KB (source %.1f KB)\n", job->stats.file_bytes / 1024.0, job->input_bytes / 1024.0);
+    if (job->chunk_stats.chunks_count > 0)
+        printf("- - %s: %i chunks, depth %i, largest %.1f KB, file %.1f KB\n", job->chunks_output,
+               job->chunk_stats.chunks_count, job->chunk_stats.depth, job->chunk_stats.largest_chunk_bytes / 1024.0,
+               job->chunk_stats.file_bytes / 1024.0);
+}
+
+static void bake_usage()
+{
+    printf("usage: ibc-bake [options] <model> [model...]\n"
+           "  -o <dir>      output directory, default is next to each input\n"
+           "  --lods <n>    simplified levels per primitive, default %i\n"
+           "  --no-optimize skip lods and vertex cache/fetch ordering\n"
+           "  --no-quantize keep float32 attributes\n"
+           "  --no-mips     keep only the full size texture level\n"
+           "  --textures <auto|rgba|bc1|bc3|bc7>\n"
+           "                texture compression, auto picks bc7 for alpha and bc1 otherwise\n"
+           "  --chunks      also write the geometry as streamable octree chunks (.ibcc)\n"
+           "  --chunk-kb <n> chunk size, default %lld\n", BAKE_DEFAULT_LODS,
+           (long long)(CHUNK_CACHE_DEFAULT_CHUNK_BYTES / 1024));
+}
+
+int main(int argc, char** argv)
+{
+    bake_options options;
+    options.output_dir = 0;
+    options.lods = BAKE_DEFAULT_LODS;
+    options.optimize = true;
+    options.quantize = true;
+    options.textures = BAKE_TEXTURE_AUTO;
+    options.mips = true;
+    options.chunks = false;
+    options.chunk_bytes = CHUNK_CACHE_DEFAULT_CHUNK_BYTES;
+
+    os_allocator_init();
+
+    const char** inputs = OS_MALLOC(sizeof(const char*) * argc);
+    int32_t inputs_count = 0;
+    for (int32_t i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options.output_dir = argv[++i];
+        } else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc) {
+            options.lods = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-optimize") == 0) {
+            options.optimize = false;
+        } else if (strcmp(argv[i], "--no-quantize") == 0) {
+            options.quantize = false;
+        } else if (strcmp(argv[i], "--no-mips") == 0) {
+            options.mips = false;
+        } else if (strcmp(argv[i], "--chunks") == 0) {
+            options.chunks = true;
+        } else if (strcmp(argv[i], "--chunk-kb") == 0 && i + 1 < argc) {
+            options.chunk_bytes = (int64_t)atoi(argv[++i]) * 1024;
+        } else if (strcmp(argv[i], "--textures") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "rgba") == 0) options.textures = BAKE_TEXTURE_RGBA;
+            else if (strcmp(mode, "bc1") == 0) options.textures = BAKE_TEXTURE_BC1;
+            else if (strcmp(mode, "bc3") == 0) options.textures = BAKE_TEXTURE_BC3;
+            else if (strcmp(mode, "bc7") == 0) options.textures = BAKE_TEXTURE_BC7;
+            else options.textures = BAKE_TEXTURE_AUTO;
+        } else if (argv[i][0] == '-') {
+            bake_usage();
+            OS_FREE(inputs);
+            return 1;
+        } else {
+            inputs[inputs_count++] = argv[i];
+        }
+    }
+
+    if (inputs_count == 0) {
+        bake_usage();
+        OS_FREE(inputs);
+        return 1;
+    }
+
+    bake_context context;
+    context.options = &options;
+    context.jobs_count = inputs_count;
+    context.jobs = OS_MALLOC(sizeof(bake_job) * inputs_count);
+    os_memset(context.jobs, 0, sizeof(bake_job) * inputs_count);
+    for (int32_t i = 0; i < inputs_count; ++i) {
+        context.jobs[i].input = inputs[i];
+        bake_output_path(inputs[i], options.output_dir, context.jobs[i].output, sizeof(context.jobs[i].output));
+    }
+
+    double start = os_timer_seconds();
+    if (inputs_count == 1)
+        bake_file(context.jobs, &options, true);
+    else
+        os_parallel_for(inputs_count, bake_file_task, &context);
+    double wall = os_timer_seconds() - start;
+
+    printf("\nBake report\n");
+    int32_t baked = 0;
+    double summed = 0;
+    uint64_t input_bytes = 0, output_bytes = 0;
+    for (int32_t i = 0; i < inputs_count; ++i) {
+        bake_job const* job = context.jobs + i;
+        bake_report(job);
+        if (!job->ok) continue;
+        baked++;
+        input_bytes += job->input_bytes;
+        output_bytes += job->stats.file_bytes;
+        for (int32_t k = 0; k < BAKE_STAGE_COUNT; ++k)
+            summed += job->stage_seconds[k];
+    }
+    printf("Baked %i/%i files in %.1f ms (%.1f ms of work), %.1f KB -> %.1f KB\n",
+           baked, inputs_count, wall * 1000.0, summed * 1000.0, input_bytes / 1024.0, output_bytes / 1024.0);
+
+    OS_FREE(context.jobs);
+    OS_FREE(inputs);
+    os_allocator_terminate();
+    return baked == inputs_count ? 0 : 1;
+}